@@ -0,0 +1,816 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	analyze.c
+ *		SMPTE 337/340 compliance analysis of a formatted WAV or PCM file
+ *
+ *		The input is scanned in large blocks for preambles without reading
+ *		bursts into a buffer or writing any payload. Bursts are grouped by
+ *		data type and data stream number, and for each group the Pa spacing
+ *		is matched against every burst size and cadence frame337 formats
+ *		that data type with. The report is written as JSON.
+ *
+ *		With -crc the payloads of 16-bit AC-3, E-AC-3 and AC-4 bursts are
+ *		gathered as they go by and their frame CRCs counted per stream.
+ *
+ *	History:
+ *		10/19/26	Errors are returned to the caller instead of exiting
+ *		10/19/26	Gaps advance the cadence phase by the burst periods they span
+ *		10/19/26	Frame CRC counts
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "frame337.h"
+
+extern const int16_t frmsizetab [NFSCOD] [NDATARATE];
+extern const char *const pa_alignment_text[2];
+
+#define AN_BLOCK_WORDS		(1 << 18)	/* words per read */
+#define AN_MAX_STREAMS		256			/* 5-bit data type and 3-bit data stream number */
+#define AN_HIST_BINS		32			/* distinct spacings kept per stream, the rest count as other */
+#define AN_MAX_GAPS			64			/* gaps listed per stream, all are counted */
+#define AN_MAX_CADENCES		16
+#define AN_MAX_PAYLOAD		8192		/* bytes, the most a 16-bit Pd can describe */
+
+/* Burst sizes in words, a fixed size repeats the same value */
+typedef struct
+{
+	const char *name;
+	int32_t words[DDE_2997_REPRATE];
+}An_Cadence;
+
+#define AN_FIXED(name, size)	{ name, { size, size, size, size, size } }
+
+static const An_Cadence dd_cadences[] = { AN_FIXED("AC-3", DD_BURST_SIZE) };
+static const An_Cadence ddp_cadences[] = { AN_FIXED("E-AC-3", DD_PLUS_BURST_SIZE) };
+static const An_Cadence dde_cadences[] =
+{
+	AN_FIXED("23.98 fps", DDE_BURST_SIZE_2398FPS),
+	AN_FIXED("24 fps", DDE_BURST_SIZE_24FPS),
+	AN_FIXED("25 fps", DDE_BURST_SIZE_25FPS),
+	{ "29.97 fps", { 3204, 3202, 3204, 3204, 3202 } },
+	AN_FIXED("30 fps", DDE_BURST_SIZE_30FPS)
+};
+static const An_Cadence ac4_cadences[] =
+{
+	AN_FIXED("23.44 fps", AC4_BURST_SIZE_2343FPS),
+	AN_FIXED("23.98 fps", AC4_BURST_SIZE_2398FPS),
+	AN_FIXED("24 fps", AC4_BURST_SIZE_24FPS),
+	AN_FIXED("25 fps", AC4_BURST_SIZE_25FPS),
+	{ "29.97 fps", { AC4_BURST_SIZE_2997FPS_HIGH, AC4_BURST_SIZE_2997FPS_LOW, AC4_BURST_SIZE_2997FPS_HIGH, AC4_BURST_SIZE_2997FPS_LOW, AC4_BURST_SIZE_2997FPS_HIGH } },
+	AN_FIXED("30 fps", AC4_BURST_SIZE_30FPS),
+	AN_FIXED("47.95 fps", AC4_BURST_SIZE_4795FPS),
+	AN_FIXED("48 fps", AC4_BURST_SIZE_48FPS),
+	AN_FIXED("50 fps", AC4_BURST_SIZE_50FPS),
+	{ "59.94 fps", { AC4_BURST_SIZE_599FPS_HIGH, AC4_BURST_SIZE_599FPS_HIGH, AC4_BURST_SIZE_599FPS_LOW, AC4_BURST_SIZE_599FPS_HIGH, AC4_BURST_SIZE_599FPS_HIGH } },
+	AN_FIXED("60 fps", AC4_BURST_SIZE_60FPS),
+	AN_FIXED("100 fps", AC4_BURST_SIZE_100FPS),
+	{ "119.88 fps", { AC4_BURST_SIZE_11988FPS_LOW, AC4_BURST_SIZE_11988FPS_HIGH, AC4_BURST_SIZE_11988FPS_LOW, AC4_BURST_SIZE_11988FPS_HIGH, AC4_BURST_SIZE_11988FPS_LOW } },
+	AN_FIXED("120 fps", AC4_BURST_SIZE_120FPS)
+};
+
+typedef struct
+{
+	int spacing;					/* in frames */
+	long count;
+}An_Bin;
+
+typedef struct
+{
+	int64_t after;					/* frame of the Pa before the gap */
+	int frames;						/* beyond the expected spacing */
+}An_Gap;
+
+/* Bursts of one data type and data stream number */
+typedef struct
+{
+	int data_type;
+	int data_stream;
+	int bit_depth;
+	long bursts;
+	long error_flags;
+	long sync_errors;				/* DD/DD+ payload not starting with a sync word */
+	int pd_min, pd_max, pd_prev;
+	long pd_changes;
+	long pd_overruns;				/* payload running into the next preamble */
+	long pd_frame_mismatches;		/* AC-3 Pd not matching the frame size in its header */
+	Crc_Info crc;					/* frame CRCs, policy CRC_COUNT when checked */
+	int64_t last_pa;				/* word index of the previous Pa, -1 before the first */
+	int spacing_min, spacing_max;
+	int64_t spacing_sum;
+	long nspacings;
+	An_Bin hist[AN_HIST_BINS];
+	int nbins;
+	long hist_other;
+	const An_Cadence *cadences;
+	int ncadences;
+	long mismatches[AN_MAX_CADENCES][DDE_2997_REPRATE];	/* per cadence and starting phase */
+	long slots[AN_MAX_CADENCES];	/* burst periods of each cadence spanned so far */
+	int locked;						/* cadence used for gap detection, -1 until enough spacings */
+	int early_spacing[DDE_2997_REPRATE];
+	int64_t early_pa[DDE_2997_REPRATE];
+	long ngaps;
+	int64_t gap_frames;
+	An_Gap gaps[AN_MAX_GAPS];
+}An_Stream;
+
+typedef struct
+{
+	File_Info *file_info;
+	Wave_Struct *wavInfo;
+	An_Stream *streams[AN_MAX_STREAMS];
+	int order[AN_MAX_STREAMS];		/* stream keys in order of first appearance */
+	int nstreams;
+	int64_t words;					/* words scanned */
+	long bursts;
+	int64_t first_pa;				/* word index, -1 if no burst was found */
+	long pa_align_changes;
+	int64_t prev_pa;
+	long guard_violations;			/* gaps between bursts holding non-zero words */
+	int64_t guard_words;
+	An_Stream *cur;					/* stream of the burst being skipped */
+	int64_t payload_left;			/* words of its payload still to come */
+	int64_t payload_pos;			/* words of its payload seen */
+	int payload_word0;				/* first payload word, for DD/DD+ checks */
+	long truncated;
+	int collect;					/* payload is gathered for its frame CRCs */
+	int payload_len;				/* bytes gathered */
+	uint8_t payload[AN_MAX_PAYLOAD];
+}An_Ctx;
+
+static const char *data_type_name(int data_type)
+{
+	switch (data_type)
+	{
+		case 0:		return("Null");
+		case 3:		return("Pause");
+		case SMPTE_DD_ID:			return("AC-3");
+		case SMPTE_DD_PLUS_ID:		return("E-AC-3");
+		case SMPTE_DDE_ID:			return("Dolby E");
+		case SMPTE_AC4SIMPLE_ID:	return("AC-4");
+		case SMPTE_AAC_ID:
+		case SMPTE_AACPLUS_ID:		return("AAC");
+		default:	return("Other");
+	}
+}
+
+static An_Stream *get_stream(An_Ctx *ctx, int data_type, int data_stream, int bit_depth)
+{
+	int key = data_type | (data_stream << 5);
+	An_Stream *st;
+
+	if ((st = ctx->streams[key]) != NULL)
+	{
+		return(st);
+	}
+	if ((st = (An_Stream *)calloc(1, sizeof(An_Stream))) == NULL)
+	{
+		run_error(&ctx->file_info->err, ERR_NO_MEMORY, -1, -1, "Unable to allocate analysis buffers");
+		return(NULL);
+	}
+	st->data_type = data_type;
+	st->data_stream = data_stream;
+	st->bit_depth = bit_depth;
+	st->last_pa = -1;
+	st->locked = -1;
+	if ((ctx->file_info->crc.policy != CRC_OFF) && (bit_depth == 16)
+		&& ((data_type == SMPTE_DD_ID) || (data_type == SMPTE_DD_PLUS_ID) || (data_type == SMPTE_AC4SIMPLE_ID)))
+	{
+		st->crc.policy = CRC_COUNT;
+	}
+	switch (data_type)
+	{
+		case SMPTE_DD_ID:
+			st->cadences = dd_cadences;
+			st->ncadences = sizeof(dd_cadences) / sizeof(dd_cadences[0]);
+			break;
+		case SMPTE_DD_PLUS_ID:
+			st->cadences = ddp_cadences;
+			st->ncadences = sizeof(ddp_cadences) / sizeof(ddp_cadences[0]);
+			break;
+		case SMPTE_DDE_ID:
+			st->cadences = dde_cadences;
+			st->ncadences = sizeof(dde_cadences) / sizeof(dde_cadences[0]);
+			break;
+		case SMPTE_AC4SIMPLE_ID:
+			st->cadences = ac4_cadences;
+			st->ncadences = sizeof(ac4_cadences) / sizeof(ac4_cadences[0]);
+			break;
+	}
+
+	ctx->streams[key] = st;
+	ctx->order[ctx->nstreams++] = key;
+
+	return(st);
+}
+
+/* The cadence and phase with the fewest mismatches */
+static int best_cadence(An_Stream *st, int *phase)
+{
+	int best = -1;
+	int c, p;
+
+	for (c = 0; c < st->ncadences; c++)
+	{
+		for (p = 0; p < DDE_2997_REPRATE; p++)
+		{
+			if ((best < 0) || (st->mismatches[c][p] < st->mismatches[best][*phase]))
+			{
+				best = c;
+				*phase = p;
+			}
+		}
+	}
+	return(best);
+}
+
+static int cadence_max(const An_Cadence *cad)
+{
+	int i, max = 0;
+
+	for (i = 0; i < DDE_2997_REPRATE; i++)
+	{
+		if (cad->words[i] > max)
+		{
+			max = cad->words[i];
+		}
+	}
+	return(max / 2);
+}
+
+/* Frames in k burst periods of a cadence, from period first on */
+static int64_t cadence_span(const An_Cadence *cad, long first, long k)
+{
+	int64_t period = 0;
+	int64_t span;
+	int i;
+
+	for (i = 0; i < DDE_2997_REPRATE; i++)
+	{
+		period += cad->words[i] / 2;
+	}
+	span = (k / DDE_2997_REPRATE) * period;
+	for (i = 0; i < k % DDE_2997_REPRATE; i++)
+	{
+		span += cad->words[(first + i) % DDE_2997_REPRATE] / 2;
+	}
+	return(span);
+}
+
+static void check_gap(An_Stream *st, int64_t pa, int spacing)
+{
+	int expected = cadence_max(&st->cadences[st->locked]);
+
+	if (spacing > expected)
+	{
+		if (st->ngaps < AN_MAX_GAPS)
+		{
+			st->gaps[st->ngaps].after = pa / 2;
+			st->gaps[st->ngaps].frames = spacing - expected;
+		}
+		st->ngaps++;
+		st->gap_frames += spacing - expected;
+	}
+}
+
+/* Account for the Pa spacing from the previous burst of the same stream */
+static void add_spacing(An_Stream *st, int spacing)
+{
+	int64_t pa = st->last_pa;
+	long n = st->nspacings;
+	int c, p, i;
+	int phase = 0;
+	int64_t period;
+	long k;
+
+	if (!n || (spacing < st->spacing_min))
+		st->spacing_min = spacing;
+	if (!n || (spacing > st->spacing_max))
+		st->spacing_max = spacing;
+	st->spacing_sum += spacing;
+	st->nspacings++;
+
+	for (i = 0; i < st->nbins; i++)
+	{
+		if (st->hist[i].spacing == spacing)
+			break;
+	}
+	if (i < st->nbins)
+	{
+		st->hist[i].count++;
+	}
+	else if (st->nbins < AN_HIST_BINS)
+	{
+		st->hist[st->nbins].spacing = spacing;
+		st->hist[st->nbins++].count = 1;
+	}
+	else
+	{
+		st->hist_other++;
+	}
+
+	if (!st->ncadences)
+	{
+		return;
+	}
+	for (c = 0; c < st->ncadences; c++)
+	{
+		/* a gap filled with pause bursts, or left by lost frames, spans whole burst periods */
+		period = cadence_span(&st->cadences[c], 0, DDE_2997_REPRATE);
+		k = (long)((2 * (int64_t)spacing * DDE_2997_REPRATE + period) / (2 * period));
+		if (k < 1)
+		{
+			k = 1;
+		}
+		for (p = 0; p < DDE_2997_REPRATE; p++)
+		{
+			if (cadence_span(&st->cadences[c], p + st->slots[c], k) != spacing)
+			{
+				st->mismatches[c][p]++;
+			}
+		}
+		st->slots[c] += k;
+	}
+
+	/* gaps are judged against the cadence the stream settles on, the first spacings are held until then */
+	if (st->locked >= 0)
+	{
+		check_gap(st, pa, spacing);
+	}
+	else if (n < DDE_2997_REPRATE - 1)
+	{
+		st->early_spacing[n] = spacing;
+		st->early_pa[n] = pa;
+	}
+	else
+	{
+		st->locked = best_cadence(st, &phase);
+		for (i = 0; i < DDE_2997_REPRATE - 1; i++)
+		{
+			check_gap(st, st->early_pa[i], st->early_spacing[i]);
+		}
+		check_gap(st, pa, spacing);
+	}
+}
+
+/* A complete preamble was found at word pa, returns 0 on error */
+static int add_burst(An_Ctx *ctx, int64_t pa, int bit_depth, uint32_t pc, uint32_t pd)
+{
+	int data_type = (pc >> 16) & 0x1F;
+	int data_stream = (pc >> 29) & 0x07;
+	An_Stream *st = get_stream(ctx, data_type, data_stream, bit_depth);
+	int pd_bits = (int)(pd >> (32 - bit_depth));
+
+	if (st == NULL)
+	{
+		return(0);
+	}
+
+	/* the previous burst's payload, by its Pd, runs into this preamble */
+	if (ctx->payload_left > 0)
+	{
+		ctx->cur->pd_overruns++;
+	}
+
+	if (ctx->bursts == 0)
+	{
+		ctx->first_pa = pa;
+	}
+	else if ((pa - ctx->prev_pa) % 2)
+	{
+		ctx->pa_align_changes++;
+	}
+	ctx->prev_pa = pa;
+	ctx->bursts++;
+
+	if (st->last_pa >= 0)
+	{
+		add_spacing(st, (int)((pa - st->last_pa) / 2));
+	}
+	st->last_pa = pa;
+
+	if (st->bursts && (pd_bits != st->pd_prev))
+		st->pd_changes++;
+	if (!st->bursts || (pd_bits < st->pd_min))
+		st->pd_min = pd_bits;
+	if (!st->bursts || (pd_bits > st->pd_max))
+		st->pd_max = pd_bits;
+	st->pd_prev = pd_bits;
+	if ((pc >> 23) & 0x01)
+		st->error_flags++;
+	st->bursts++;
+
+	ctx->cur = st;
+	ctx->payload_pos = 0;
+	ctx->payload_left = (pd_bits + bit_depth - 1) / bit_depth;
+	ctx->collect = (st->crc.policy == CRC_COUNT) && (bit_depth == 16) && (ctx->payload_left * 2 <= AN_MAX_PAYLOAD);
+	ctx->payload_len = 0;
+
+	return(1);
+}
+
+/* Check the start of a DD/DD+ payload, only possible when its words are whole 16-bit words */
+static void check_dd_payload(An_Ctx *ctx, uint32_t v)
+{
+	An_Stream *st = ctx->cur;
+	int word = (int)(v >> 16);
+	int fscod, frmsizecod;
+
+	if (ctx->payload_pos == 0)
+	{
+		ctx->payload_word0 = word;
+		if ((word != SYNC_WD) && (word != SYNC_WD_REV))
+		{
+			st->sync_errors++;
+		}
+	}
+	else if ((ctx->payload_pos == 2) && (st->data_type == SMPTE_DD_ID))
+	{
+		if (ctx->payload_word0 == SYNC_WD_REV)
+		{
+			word = (uint16_t)bytereverse((short)word);
+		}
+		else if (ctx->payload_word0 != SYNC_WD)
+		{
+			return;
+		}
+		fscod = (word >> 14) & 0x03;
+		frmsizecod = (word >> 8) & 0x3F;
+		if ((fscod < NFSCOD) && (frmsizecod < NDATARATE) && (frmsizetab[fscod][frmsizecod] != FRMRSRV)
+			&& (st->pd_prev != frmsizetab[fscod][frmsizecod] * 16))
+		{
+			st->pd_frame_mismatches++;
+		}
+	}
+}
+
+/* Most significant byte of Pa at 16, 20 and 24 bits */
+static const uint8_t pa_top_byte[256] =
+{
+	[(PREAMBLE_A16 >> 8) & 0xFF] = 1,
+	[(PREAMBLE_A20 >> 12) & 0xFF] = 1,
+	[(PREAMBLE_A24 >> 16) & 0xFF] = 1
+};
+
+/* Bit depth of a word holding preamble Pa, 0 if it is not one */
+static int pa_bit_depth(uint32_t v)
+{
+	if ((v >> 16) == PREAMBLE_A16)
+		return 16;
+	if ((v >> 12) == PREAMBLE_A20)
+		return 20;
+	if ((v >> 8) == PREAMBLE_A24)
+		return 24;
+	return 0;
+}
+
+static int is_pb(uint32_t v, int bit_depth)
+{
+	switch (bit_depth)
+	{
+		case 16:	return((v >> 16) == PREAMBLE_B16);
+		case 20:	return((v >> 12) == PREAMBLE_B20);
+		default:	return((v >> 8) == PREAMBLE_B24);
+	}
+}
+
+/* Scan the input, one left aligned 32-bit value per word, returns 0 on error */
+static int scan_input(An_Ctx *ctx)
+{
+	File_Info *file_info = ctx->file_info;
+	int bps = file_info->bits_per_sample;
+	int bytes_per_word = file_info->bytes_per_word;
+	uint8_t *buf, *b;
+	size_t nread, i, k, nwords, skip;
+	int top = bytes_per_word - 1;	/* most significant byte of a little endian word */
+	uint32_t v, pc = 0;
+	int64_t w = 0, pa = 0;
+	int64_t stuffing_nz = 0;		/* non-zero words outside payloads since the last preamble */
+	int preamble_nz = 0;			/* of those, the ones in the preamble being matched */
+	int state = 0;
+	int bit_depth = 0;
+	int in_payload;
+
+	if ((buf = (uint8_t *)malloc(AN_BLOCK_WORDS * bytes_per_word)) == NULL)
+	{
+		return run_error(&file_info->err, ERR_NO_MEMORY, -1, -1, "Unable to allocate analysis buffers");
+	}
+
+	while ((nread = fread(buf, 1, AN_BLOCK_WORDS * bytes_per_word, file_info->smpte_file)) >= (size_t)bytes_per_word)
+	{
+		nwords = nread / bytes_per_word;
+		for (i = 0, b = buf; i < nwords; i++, w++, b += bytes_per_word)
+		{
+			/* deep in a payload only a Pa matters, skip words whose top byte cannot start one */
+			if ((state == 0) && (ctx->payload_left > 0) && (ctx->payload_pos >= 3) && !ctx->collect)
+			{
+				skip = nwords - i;
+				if ((int64_t)skip > ctx->payload_left)
+					skip = (size_t)ctx->payload_left;
+				for (k = 0; (k < skip) && !pa_top_byte[b[top]]; k++, b += bytes_per_word)
+					;
+				i += k;
+				w += k;
+				ctx->payload_pos += k;
+				ctx->payload_left -= k;
+				if (i == nwords)
+					break;
+			}
+
+			if (bps == 16)
+				v = (uint32_t)(b[0] | (b[1] << 8)) << 16;
+			else if (bps == 24)
+				v = ((uint32_t)b[0] << 8) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 24);
+			else
+				v = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+
+			in_payload = (ctx->payload_left > 0);
+			if (in_payload)
+			{
+				if ((ctx->cur->bit_depth == 16) && (ctx->payload_pos < 3)
+					&& ((ctx->cur->data_type == SMPTE_DD_ID) || (ctx->cur->data_type == SMPTE_DD_PLUS_ID)))
+				{
+					check_dd_payload(ctx, v);
+				}
+				if (ctx->collect)
+				{
+					ctx->payload[ctx->payload_len++] = (uint8_t)(v >> 24);
+					ctx->payload[ctx->payload_len++] = (uint8_t)(v >> 16);
+				}
+				ctx->payload_pos++;
+				if ((--ctx->payload_left == 0) && ctx->collect)
+				{
+					crc_verify_payload(&ctx->cur->crc, ctx->payload, ctx->payload_len);
+				}
+			}
+			else if (v)
+			{
+				stuffing_nz++;
+			}
+
+			switch (state)
+			{
+				case 1:
+					if (is_pb(v, bit_depth))
+					{
+						preamble_nz += !in_payload;
+						state = 2;
+						break;
+					}
+					/* not a preamble after all, this word may start one */
+					state = 0;
+					/* fall through */
+				case 0:
+					if ((bit_depth = pa_bit_depth(v)) != 0)
+					{
+						pa = w;
+						preamble_nz = !in_payload;
+						state = 1;
+					}
+					break;
+				case 2:
+					pc = v;
+					preamble_nz += (v && !in_payload);
+					state = 3;
+					break;
+				case 3:
+					preamble_nz += (v && !in_payload);
+					if (stuffing_nz > preamble_nz)
+					{
+						ctx->guard_violations++;
+						ctx->guard_words += stuffing_nz - preamble_nz;
+					}
+					stuffing_nz = 0;
+					if (!add_burst(ctx, pa, bit_depth, pc, v))
+					{
+						free(buf);
+						return(0);
+					}
+					state = 0;
+					break;
+			}
+		}
+		/* a partial word at the end of the file is ignored */
+		if (nread % bytes_per_word)
+		{
+			break;
+		}
+	}
+
+	if (ctx->payload_left > 0)
+	{
+		ctx->truncated++;
+	}
+	if (state)
+	{
+		stuffing_nz -= preamble_nz;
+	}
+	if (stuffing_nz > 0)
+	{
+		ctx->guard_violations++;
+		ctx->guard_words += stuffing_nz;
+	}
+	ctx->words = w;
+
+	free(buf);
+
+	return(1);
+}
+
+/* Write a string as a JSON string literal, also used by the planner */
+void json_string(FILE *fp, const char *s)
+{
+	fputc('"', fp);
+	for (; *s; s++)
+	{
+		if ((*s == '"') || (*s == '\\'))
+			fprintf(fp, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(fp, "\\u%04x", *s);
+		else
+			fputc(*s, fp);
+	}
+	fputc('"', fp);
+}
+
+/* Write one stream's statistics, returns 1 if it conforms */
+static int report_stream(FILE *fp, An_Stream *st)
+{
+	int conforms = !st->pd_overruns && !st->pd_frame_mismatches && !st->sync_errors && !st->crc.failed;
+	int best, phase = 0;
+	long i;
+
+	/* short streams never reached the point where gaps are checked */
+	if ((st->locked < 0) && st->ncadences && st->nspacings)
+	{
+		st->locked = best_cadence(st, &phase);
+		for (i = 0; i < st->nspacings; i++)
+		{
+			check_gap(st, st->early_pa[i], st->early_spacing[i]);
+		}
+	}
+
+	fprintf(fp, "    {\n");
+	fprintf(fp, "      \"data_type\": %d,\n", st->data_type);
+	fprintf(fp, "      \"name\": \"%s\",\n", data_type_name(st->data_type));
+	fprintf(fp, "      \"data_stream\": %d,\n", st->data_stream);
+	fprintf(fp, "      \"bit_depth\": %d,\n", st->bit_depth);
+	fprintf(fp, "      \"bursts\": %ld,\n", st->bursts);
+	fprintf(fp, "      \"error_flags\": %ld,\n", st->error_flags);
+	if ((st->data_type == SMPTE_DD_ID) || (st->data_type == SMPTE_DD_PLUS_ID))
+	{
+		fprintf(fp, "      \"sync_errors\": %ld,\n", st->sync_errors);
+	}
+	fprintf(fp, "      \"pd\": { \"min\": %d, \"max\": %d, \"changes\": %ld, \"overruns\": %ld", 
+		st->pd_min, st->pd_max, st->pd_changes, st->pd_overruns);
+	if (st->data_type == SMPTE_DD_ID)
+	{
+		fprintf(fp, ", \"frame_size_mismatches\": %ld", st->pd_frame_mismatches);
+	}
+	fprintf(fp, " },\n");
+	if (st->crc.policy == CRC_COUNT)
+	{
+		fprintf(fp, "      \"crc\": { \"checked\": %ld, \"failed\": %ld },\n", st->crc.checked, st->crc.failed);
+	}
+
+	fprintf(fp, "      \"spacing\": {");
+	if (st->nspacings)
+	{
+		fprintf(fp, " \"min\": %d, \"max\": %d, \"average\": %.2f, \"histogram\": [", 
+			st->spacing_min, st->spacing_max, (double)st->spacing_sum / (double)st->nspacings);
+		for (i = 0; i < st->nbins; i++)
+		{
+			fprintf(fp, "%s{ \"frames\": %d, \"count\": %ld }", i ? ", " : " ", st->hist[i].spacing, st->hist[i].count);
+		}
+		fprintf(fp, " ], \"other\": %ld ", st->hist_other);
+	}
+	fprintf(fp, "},\n");
+
+	fprintf(fp, "      \"cadence\": ");
+	if (st->ncadences && st->nspacings)
+	{
+		best = best_cadence(st, &phase);
+		fprintf(fp, "{ \"expected\": \"%s\", \"phase\": %d, \"conforming\": %ld, \"nonconforming\": %ld },\n",
+			st->cadences[best].name, phase, st->nspacings - st->mismatches[best][phase], st->mismatches[best][phase]);
+		conforms = conforms && !st->mismatches[best][phase];
+	}
+	else
+	{
+		fprintf(fp, "null,\n");
+	}
+
+	fprintf(fp, "      \"gaps\": { \"count\": %ld, \"frames\": %lld, \"list\": [", st->ngaps, (long long)st->gap_frames);
+	for (i = 0; (i < st->ngaps) && (i < AN_MAX_GAPS); i++)
+	{
+		fprintf(fp, "%s{ \"after\": %lld, \"frames\": %d }", i ? ", " : " ", (long long)st->gaps[i].after, st->gaps[i].frames);
+	}
+	fprintf(fp, " ] },\n");
+	conforms = conforms && !st->ngaps;
+
+	fprintf(fp, "      \"conformant\": %s\n", conforms ? "true" : "false");
+	fprintf(fp, "    }");
+
+	return(conforms);
+}
+
+static int write_report(An_Ctx *ctx, FILE *fp)
+{
+	static const char *container_name[] = { "PCM", "RIFF", "RF64", "W64" };
+	Wave_Struct *wavInfo = ctx->wavInfo;
+	int conforms = (ctx->bursts > 0) && !ctx->guard_violations && !ctx->truncated;
+	int i;
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"input\": ");
+	json_string(fp, ctx->file_info->smpte_fname);
+	fprintf(fp, ",\n");
+	fprintf(fp, "  \"container\": \"%s\",\n", container_name[wavInfo->container]);
+	fprintf(fp, "  \"bits_per_sample\": %d,\n", ctx->file_info->bits_per_sample);
+	if (wavInfo->container != WAVE_IN_PCM)
+	{
+		fprintf(fp, "  \"sample_rate\": %d,\n", wavInfo->sample_rate);
+	}
+	fprintf(fp, "  \"frames\": %lld,\n", (long long)(ctx->words / 2));
+	fprintf(fp, "  \"bursts\": %ld,\n", ctx->bursts);
+	if (ctx->bursts)
+	{
+		fprintf(fp, "  \"first_pa\": { \"frame\": %lld, \"alignment\": \"%s\" },\n", (long long)(ctx->first_pa / 2), 
+			pa_alignment_text[ctx->first_pa % 2]);
+	}
+	fprintf(fp, "  \"pa_alignment_changes\": %ld,\n", ctx->pa_align_changes);
+	fprintf(fp, "  \"truncated_bursts\": %ld,\n", ctx->truncated);
+	fprintf(fp, "  \"guard_band\": { \"violations\": %ld, \"nonzero_words\": %lld },\n", ctx->guard_violations, (long long)ctx->guard_words);
+	fprintf(fp, "  \"streams\": [\n");
+	for (i = 0; i < ctx->nstreams; i++)
+	{
+		conforms &= report_stream(fp, ctx->streams[ctx->order[i]]);
+		fprintf(fp, "%s\n", (i + 1 < ctx->nstreams) ? "," : "");
+	}
+	fprintf(fp, "  ],\n");
+	fprintf(fp, "  \"conformant\": %s\n", conforms ? "true" : "false");
+	fprintf(fp, "}\n");
+
+	return(conforms);
+}
+
+/* Analyze a SMPTE 337 file without deformatting it, the report goes to the output file */
+int analyze(File_Info *file_info,		/* IN: input positioned at its data, output open for the report */
+			Wave_Struct *wavInfo,		/* IN: input container, WAVE_IN_PCM for raw PCM */
+			int verbose)				/* IN: print a summary */
+										/* returns 1 if the input conforms, -1 on an error in file_info->err */
+{
+	An_Ctx ctx = { 0 };
+	int conforms = -1;
+	int i;
+
+	ctx.file_info = file_info;
+	ctx.wavInfo = wavInfo;
+	ctx.first_pa = -1;
+
+	if (scan_input(&ctx))
+	{
+		conforms = write_report(&ctx, file_info->ac3file);
+	}
+
+	if (verbose && (conforms >= 0))
+	{
+		fprintf(stderr, "Analyzed %lld frames, %ld bursts in %d streams, %s\n", (long long)(ctx.words / 2), ctx.bursts, 
+			ctx.nstreams, conforms ? "conformant" : "not conformant");
+	}
+
+	for (i = 0; i < ctx.nstreams; i++)
+	{
+		free(ctx.streams[ctx.order[i]]);
+	}
+
+	fclose(file_info->smpte_file);
+	if (fclose(file_info->ac3file))
+	{
+		run_error(&file_info->err, ERR_WRITE_ERROR, -1, -1, "decode: Unable to close output file, %s.", file_info->ac3fname);
+		conforms = -1;
+	}
+
+	return(conforms);
+}		//		analyze()
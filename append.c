@@ -0,0 +1,251 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	append.c
+ *		Appending to an existing SMPTE 337 WAV file
+ *
+ *		Only the new elementary stream data is formatted. The 29.97 fps
+ *		family of cadences alternates burst sizes over DDE_2997_REPRATE
+ *		bursts, so the phase the existing file ended on is recovered from
+ *		its data length and checked against the preamble of its last
+ *		burst before anything is written. If the appended stream turns out
+ *		not to match the file, the file is cut back to its original length.
+ *
+ *	History:
+ *		10/19/26	Errors are returned to the caller instead of exiting
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "frame337.h"
+
+#ifdef UNIX
+#include <unistd.h>
+#endif /* UNIX */
+#ifdef WIN32
+#include <io.h>
+#endif /* WIN32 */
+
+/* Read bytes of the existing data, safe while the writer stage appends on another thread */
+static int read_output_at(Format_Ctx *ctx, int64_t offset, uint8_t *buf, size_t len)
+{
+#ifdef UNIX
+	return(pread(fileno(ctx->file_info->smpte_file), buf, len, offset) != (ssize_t)len);
+#else
+	FILE *fp = ctx->file_info->smpte_file;
+	int64_t pos = ftell64(fp);
+	int status;
+
+	fseek64(fp, offset, SEEK_SET);
+	status = (fread(buf, 1, len, fp) != len);
+	fseek64(fp, pos, SEEK_SET);
+
+	return(status);
+#endif /* UNIX */
+}
+
+/* Cut the output back to the end of its original data chunk, returns 0 on error */
+static int resume_rollback(Format_Ctx *ctx)
+{
+	FILE *fp = ctx->file_info->smpte_file;
+	int64_t length = ctx->header_size + ctx->resume_bytes;
+
+	fflush(fp);
+#ifdef WIN32
+	_chsize_s(_fileno(fp), length);
+#else
+	if (ftruncate(fileno(fp), length))
+	{
+		return run_error(&ctx->file_info->err, ERR_WRITE_ERROR, -1, -1, "decode: Unable to write to output file");
+	}
+#endif /* WIN32 */
+
+	return 1;
+}
+
+/* Open an existing output for appending, returns 0 if it is empty and should be written from scratch,
+   -1 if it cannot be appended to */
+int resume_output(Format_Ctx *ctx)		/* IN/OUT: format context, output open for update */
+{
+	FILE *fp = ctx->file_info->smpte_file;
+	uint8_t hdr[WAVE_HEADER_SIZE_RF64];
+	uint8_t *fmt = &hdr[12];
+	size_t nread;
+	int32_t chunk_size, fmt_size, frate;
+	uint32_t data_size32;
+	int16_t format, channels, bps;
+	int64_t data_size;
+	int64_t length;
+	int rf64;
+
+	fseek64(fp, 0, SEEK_END);
+	length = ftell64(fp);
+	if (length == 0)
+	{
+		return 0;
+	}
+
+	rewind(fp);
+	nread = fread(hdr, 1, WAVE_HEADER_SIZE_RF64, fp);
+	if (nread < WAVE_HEADER_SIZE)
+	{
+		run_error(&ctx->file_info->err, ERR_BAD_OUTPUT, -1, -1, "append: Output file is too short to be a SMPTE 337 WAV file");
+		return -1;
+	}
+
+	/* only the layouts this tool writes can be continued */
+	rf64 = !memcmp(&hdr[0], "RF64", 4);
+	if ((!rf64 && memcmp(&hdr[0], "RIFF", 4)) || memcmp(&hdr[8], "WAVE", 4))
+	{
+		run_error(&ctx->file_info->err, ERR_BAD_OUTPUT, -1, -1, "append: Output file was not written by frame337");
+		return -1;
+	}
+	ctx->wave_layout = WAVE_RIFF;
+	if (!memcmp(&hdr[12], "ds64", 4) || !memcmp(&hdr[12], "JUNK", 4))
+	{
+		memcpy(&chunk_size, &hdr[16], 4);
+		if ((nread < WAVE_HEADER_SIZE_RF64) || (chunk_size != 28) || (rf64 != !memcmp(&hdr[12], "ds64", 4)))
+		{
+			run_error(&ctx->file_info->err, ERR_BAD_OUTPUT, -1, -1, "append: Output file was not written by frame337");
+			return -1;
+		}
+		ctx->wave_layout = rf64 ? WAVE_RF64 : WAVE_RESERVED;
+		fmt = &hdr[48];
+	}
+	else if (rf64)
+	{
+		run_error(&ctx->file_info->err, ERR_BAD_OUTPUT, -1, -1, "append: RF64 output file has no ds64 chunk");
+		return -1;
+	}
+	ctx->header_size = wave_header_size(ctx->wave_layout);
+
+	memcpy(&fmt_size, &fmt[4], 4);
+	memcpy(&format, &fmt[8], 2);
+	memcpy(&channels, &fmt[10], 2);
+	memcpy(&frate, &fmt[12], 4);
+	memcpy(&bps, &fmt[22], 2);
+	memcpy(&data_size32, &fmt[28], 4);
+	data_size = data_size32;
+	if (rf64)
+	{
+		memcpy(&data_size, &hdr[28], 8);
+	}
+
+	if (memcmp(&fmt[0], "fmt ", 4) || memcmp(&fmt[24], "data", 4) || (fmt_size != 16) || (format != 1)
+		|| (channels != 2) || ((bps != 16) && (bps != 24)))
+	{
+		run_error(&ctx->file_info->err, ERR_BAD_OUTPUT, -1, -1, "append: Output file was not written by frame337");
+		return -1;
+	}
+	if ((data_size < 0) || (ctx->header_size + data_size > length) || (data_size % (2 * (bps / 8))))
+	{
+		run_error(&ctx->file_info->err, ERR_BAD_OUTPUT, -1, -1, "append: Output file data chunk is damaged");
+		return -1;
+	}
+
+	ctx->resume_bytes = data_size;
+	ctx->resume_bps = bps;
+	ctx->resume_frate = frate;
+	ctx->resume_pending = (data_size > 0);
+
+	/* anything after the data chunk is dropped, the new bursts follow the last one */
+	if (!resume_rollback(ctx))
+	{
+		return -1;
+	}
+	fseek64(fp, ctx->header_size + data_size, SEEK_SET);
+
+	return 1;
+}		//		resume_output()
+
+/* Burst counter value that continues a 29.97 fps family cadence where the existing output left off,
+   -1 if it cannot be continued */
+int resume_cadence(Format_Ctx *ctx,				/* IN/OUT: format context of an appending run */
+				   const int32_t *cadence)		/* IN: DDE_2997_REPRATE burst sizes, in words */
+{
+	int wordbytes = ctx->resume_bps / 8;
+	int64_t words = ctx->resume_bytes / wordbytes;
+	int64_t cycle = 0;
+	int64_t rem, acc;
+	int phase = -1;
+	int last;
+	int i;
+	uint8_t first_pre[8], last_pre[8];
+
+	for (i = 0; i < DDE_2997_REPRATE; i++)
+	{
+		cycle += cadence[i];
+	}
+
+	/* the burst sizes of one cycle have distinct running sums, so the remainder gives the phase */
+	rem = words % cycle;
+	for (i = 0, acc = 0; i < DDE_2997_REPRATE; acc += cadence[i], i++)
+	{
+		if (acc == rem)
+		{
+			phase = i;
+			break;
+		}
+	}
+	if (phase < 0)
+	{
+		resume_rollback(ctx);
+		run_error(&ctx->file_info->err, ERR_BAD_OUTPUT, -1, -1, "append: Output file length does not fit the cadence of the appended stream");
+		return(-1);
+	}
+
+	/* the last burst must start where the cadence says it does */
+	last = cadence[(phase + DDE_2997_REPRATE - 1) % DDE_2997_REPRATE];
+	if ((last > words) || read_output_at(ctx, ctx->header_size, first_pre, 2 * wordbytes)
+		|| read_output_at(ctx, ctx->header_size + (words - last) * wordbytes, last_pre, 2 * wordbytes)
+		|| memcmp(first_pre, last_pre, 2 * wordbytes))
+	{
+		resume_rollback(ctx);
+		run_error(&ctx->file_info->err, ERR_BAD_OUTPUT, -1, -1, "append: Last burst of the output file does not match the cadence");
+		return(-1);
+	}
+
+	ctx->resume_pending = 0;
+
+	return(phase);
+}		//		resume_cadence()
+
+/* Check the appended stream matched the existing output, cutting it back if not */
+int finish_append(Format_Ctx *ctx)		/* IN/OUT: format context of an appending run */
+										/* returns 0 if it did not match */
+{
+	if (ctx->wave_bps == 0)
+	{
+		/* nothing appended */
+		ctx->wave_bps = ctx->resume_bps;
+		ctx->wave_frate = ctx->resume_frate;
+	}
+	if ((ctx->wave_bps != ctx->resume_bps) || (ctx->wave_frate != ctx->resume_frate))
+	{
+		resume_rollback(ctx);
+		return run_error(&ctx->file_info->err, ERR_BAD_OUTPUT, -1, -1, "append: Appended stream does not match the format of the output file");
+	}
+
+	return 1;
+}		//		finish_append()
@@ -0,0 +1,691 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	cache.c
+ *		Content addressed cache of conversion outputs
+ *
+ *		Outputs are stored under a hash of the input content, its size and
+ *		the options that change the output. Hashing is done on the fly as
+ *		the converter reads its input, through a stdio cookie stream, so a
+ *		miss costs no extra pass over the input. A small index keyed by the
+ *		input's identity (device, inode, size and modification time) lets a
+ *		later run find the object before reading anything.
+ *
+ *		A hit clones the cached object into the output (reflink) where the
+ *		file system allows, otherwise copies it. Objects are never hard
+ *		linked, an edit to a delivered file must not change the cache.
+ *		The cache is bounded in size and evicts the least recently used
+ *		objects first.
+ *
+ *		Cookie streams and reflinks are Linux only. On other UNIX systems
+ *		the input is hashed in a pass of its own and a hit is copied.
+ *
+ *	History:
+ *		10/19/26	Reflinks and cookie streams on Linux only, copies and a hashing pass elsewhere
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#ifdef __linux__
+#define _GNU_SOURCE					/* fopencookie() */
+#endif /* __linux__ */
+
+#include "frame337.h"
+
+#ifdef UNIX
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/fs.h>				/* FICLONE */
+#endif /* __linux__ */
+#ifdef __APPLE__
+#define st_mtim		st_mtimespec
+#endif /* __APPLE__ */
+
+#define CACHE_IO_SIZE		(1 << 20)	/* bytes per copy or gap fill chunk */
+#define CACHE_NAME_LEN		64
+
+/* XXH64 primes */
+#define XXH_P1	11400714785074694791ULL
+#define XXH_P2	14029467366897019727ULL
+#define XXH_P3	1609587929392839161ULL
+#define XXH_P4	9650029242287828579ULL
+#define XXH_P5	2870177450012600261ULL
+
+/* Input stream that hashes what it reads */
+typedef struct
+{
+	Cache_Info *cache;
+	FILE *file;						/* underlying input */
+	int fd;
+	off_t pos;						/* position of the cookie stream */
+	off_t hashed;					/* input bytes hashed so far, always a prefix */
+}Cache_Stream;
+
+static uint64_t xxh_rotl(uint64_t x, int r)
+{
+	return((x << r) | (x >> (64 - r)));
+}
+
+static uint64_t xxh_round(uint64_t acc, uint64_t input)
+{
+	acc += input * XXH_P2;
+	acc = xxh_rotl(acc, 31);
+	return(acc * XXH_P1);
+}
+
+static uint64_t xxh_merge(uint64_t acc, uint64_t val)
+{
+	acc ^= xxh_round(0, val);
+	return(acc * XXH_P1 + XXH_P4);
+}
+
+static uint64_t xxh_read64(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return(v);
+}
+
+static uint32_t xxh_read32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return(v);
+}
+
+/* Start a streaming XXH64 with seed 0 */
+static void xxh64_init(Xxh64_State *st)
+{
+	memset(st, 0, sizeof(*st));
+	st->v[0] = XXH_P1 + XXH_P2;
+	st->v[1] = XXH_P2;
+	st->v[2] = 0;
+	st->v[3] = 0 - XXH_P1;
+}
+
+static void xxh64_update(Xxh64_State *st, const uint8_t *p, size_t len)
+{
+	const uint8_t *end = p + len;
+	size_t fill;
+	int i;
+
+	st->total_len += len;
+
+	if (st->memsize + len < sizeof(st->mem))
+	{
+		memcpy(st->mem + st->memsize, p, len);
+		st->memsize += len;
+		return;
+	}
+
+	if (st->memsize)
+	{
+		fill = sizeof(st->mem) - st->memsize;
+		memcpy(st->mem + st->memsize, p, fill);
+		for (i = 0; i < 4; i++)
+		{
+			st->v[i] = xxh_round(st->v[i], xxh_read64(st->mem + 8 * i));
+		}
+		p += fill;
+		st->memsize = 0;
+	}
+
+	while (p + 32 <= end)
+	{
+		st->v[0] = xxh_round(st->v[0], xxh_read64(p));
+		st->v[1] = xxh_round(st->v[1], xxh_read64(p + 8));
+		st->v[2] = xxh_round(st->v[2], xxh_read64(p + 16));
+		st->v[3] = xxh_round(st->v[3], xxh_read64(p + 24));
+		p += 32;
+	}
+
+	if (p < end)
+	{
+		memcpy(st->mem, p, end - p);
+		st->memsize = end - p;
+	}
+}
+
+static uint64_t xxh64_digest(const Xxh64_State *st)
+{
+	const uint8_t *p = st->mem;
+	const uint8_t *end = st->mem + st->memsize;
+	uint64_t h;
+
+	if (st->total_len >= 32)
+	{
+		h = xxh_rotl(st->v[0], 1) + xxh_rotl(st->v[1], 7) + xxh_rotl(st->v[2], 12) + xxh_rotl(st->v[3], 18);
+		h = xxh_merge(h, st->v[0]);
+		h = xxh_merge(h, st->v[1]);
+		h = xxh_merge(h, st->v[2]);
+		h = xxh_merge(h, st->v[3]);
+	}
+	else
+	{
+		h = XXH_P5;
+	}
+
+	h += st->total_len;
+
+	while (p + 8 <= end)
+	{
+		h ^= xxh_round(0, xxh_read64(p));
+		h = xxh_rotl(h, 27) * XXH_P1 + XXH_P4;
+		p += 8;
+	}
+	if (p + 4 <= end)
+	{
+		h ^= (uint64_t)xxh_read32(p) * XXH_P1;
+		h = xxh_rotl(h, 23) * XXH_P2 + XXH_P3;
+		p += 4;
+	}
+	while (p < end)
+	{
+		h ^= (*p) * XXH_P5;
+		h = xxh_rotl(h, 11) * XXH_P1;
+		p++;
+	}
+
+	h ^= h >> 33;
+	h *= XXH_P2;
+	h ^= h >> 29;
+	h *= XXH_P3;
+	h ^= h >> 32;
+
+	return(h);
+}
+
+/* Hash input bytes from the hashed prefix up to end, reading whatever the converter skipped over */
+static int cache_fill_hash(Cache_Stream *cs, off_t end)
+{
+	uint8_t *buf;
+	ssize_t n;
+	size_t len;
+
+	if (cs->hashed >= end)
+	{
+		return 0;
+	}
+	if ((buf = (uint8_t *)malloc(CACHE_IO_SIZE)) == NULL)
+	{
+		return -1;
+	}
+	while (cs->hashed < end)
+	{
+		len = (end - cs->hashed > CACHE_IO_SIZE) ? CACHE_IO_SIZE : (size_t)(end - cs->hashed);
+		if ((n = pread(cs->fd, buf, len, cs->hashed)) <= 0)
+		{
+			free(buf);
+			return -1;
+		}
+		xxh64_update(&cs->cache->hash, buf, n);
+		cs->hashed += n;
+	}
+	free(buf);
+
+	return 0;
+}
+
+/* Hash the tail the converter never needed, the digest covers the whole input */
+static void cache_finish_hash(Cache_Stream *cs)
+{
+	Cache_Info *cache = cs->cache;
+	struct stat st;
+
+	/* not if the input changed while it was read */
+	if (!fstat(cs->fd, &st) && (st.st_size == cache->in_size) && (st.st_mtim.tv_sec == cache->in_mtime)
+		&& (st.st_mtim.tv_nsec == cache->in_mtime_ns) && !cache_fill_hash(cs, st.st_size))
+	{
+		cache->digest = xxh64_digest(&cache->hash);
+		cache->have_digest = 1;
+	}
+}
+
+#ifdef __linux__
+static ssize_t cache_stream_read(void *cookie, char *buf, size_t size)
+{
+	Cache_Stream *cs = (Cache_Stream *)cookie;
+	ssize_t n;
+
+	/* anything skipped by a forward seek is hashed first, so the hash stays sequential */
+	if (cs->pos > cs->hashed && cache_fill_hash(cs, cs->pos))
+	{
+		return -1;
+	}
+
+	if ((n = pread(cs->fd, buf, size, cs->pos)) < 0)
+	{
+		return -1;
+	}
+
+	if (cs->pos + n > cs->hashed)
+	{
+		xxh64_update(&cs->cache->hash, (uint8_t *)buf + (cs->hashed - cs->pos), cs->pos + n - cs->hashed);
+		cs->hashed = cs->pos + n;
+	}
+	cs->pos += n;
+
+	return(n);
+}
+
+static int cache_stream_seek(void *cookie, off64_t *offset, int whence)
+{
+	Cache_Stream *cs = (Cache_Stream *)cookie;
+	struct stat st;
+	off_t base;
+
+	switch (whence)
+	{
+		case SEEK_SET:
+			base = 0;
+			break;
+		case SEEK_CUR:
+			base = cs->pos;
+			break;
+		case SEEK_END:
+			if (fstat(cs->fd, &st))
+			{
+				return -1;
+			}
+			base = st.st_size;
+			break;
+		default:
+			return -1;
+	}
+	if (base + *offset < 0)
+	{
+		return -1;
+	}
+	cs->pos = base + *offset;
+	*offset = cs->pos;
+
+	return 0;
+}
+
+static int cache_stream_close(void *cookie)
+{
+	Cache_Stream *cs = (Cache_Stream *)cookie;
+
+	cache_finish_hash(cs);
+	fclose(cs->file);
+	free(cs);
+
+	return 0;
+}
+#endif /* __linux__ */
+
+/* Copy a file, cloning its extents where the file system allows */
+static int cache_copy_file(const char *src_name, const char *dst_name)
+{
+	int src, dst;
+	uint8_t *buf;
+	ssize_t n;
+	int status = -1;
+
+	if ((src = open(src_name, O_RDONLY)) < 0)
+	{
+		return -1;
+	}
+	if ((dst = open(dst_name, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+	{
+		close(src);
+		return -1;
+	}
+
+#ifdef __linux__
+	if (!ioctl(dst, FICLONE, src))
+	{
+		status = 0;
+	}
+	else
+#endif /* __linux__ */
+	if ((buf = (uint8_t *)malloc(CACHE_IO_SIZE)) != NULL)
+	{
+		while ((n = read(src, buf, CACHE_IO_SIZE)) > 0)
+		{
+			if (write(dst, buf, n) != n)
+			{
+				break;
+			}
+		}
+		status = n ? -1 : 0;
+		free(buf);
+	}
+
+	close(src);
+	if (close(dst))
+	{
+		status = -1;
+	}
+
+	return(status);
+}
+
+/* Read and update the hit and miss counters */
+static void cache_count(Cache_Info *cache, int hit)
+{
+	char path[CACHE_PATH_LEN];
+	FILE *fp;
+	long hits = 0;
+	long misses = 0;
+
+	snprintf(path, CACHE_PATH_LEN, "%s/stats", cache->dir);
+	if ((fp = fopen(path, "a+")) == NULL)
+	{
+		return;
+	}
+	flock(fileno(fp), LOCK_EX);
+	rewind(fp);
+	if (fscanf(fp, "hits %ld misses %ld", &hits, &misses) != 2)
+	{
+		hits = misses = 0;
+	}
+	if (hit)
+	{
+		hits++;
+	}
+	else
+	{
+		misses++;
+	}
+	if (!ftruncate(fileno(fp), 0))
+	{
+		fprintf(fp, "hits %ld misses %ld\n", hits, misses);
+	}
+	fclose(fp);
+
+	cache->hits = hits;
+	cache->misses = misses;
+}
+
+typedef struct
+{
+	char name[CACHE_NAME_LEN];
+	struct timespec mtime;			/* last use */
+	off_t size;
+}Cache_Object;
+
+static int cache_object_cmp(const void *a, const void *b)
+{
+	const struct timespec *ta = &((const Cache_Object *)a)->mtime;
+	const struct timespec *tb = &((const Cache_Object *)b)->mtime;
+
+	if (ta->tv_sec != tb->tv_sec)
+	{
+		return((ta->tv_sec > tb->tv_sec) ? 1 : -1);
+	}
+	return((ta->tv_nsec > tb->tv_nsec) - (ta->tv_nsec < tb->tv_nsec));
+}
+
+/* Remove the least recently used objects until the cache fits its size limit */
+static void cache_evict(Cache_Info *cache)
+{
+	char path[CACHE_PATH_LEN];
+	DIR *dir;
+	struct dirent *ent;
+	struct stat st;
+	Cache_Object *objs = NULL;
+	Cache_Object *tmp;
+	int nobjs = 0;
+	int maxobjs = 0;
+	long long total = 0;
+	int i;
+
+	snprintf(path, CACHE_PATH_LEN, "%s/objects", cache->dir);
+	if ((dir = opendir(path)) == NULL)
+	{
+		return;
+	}
+	while ((ent = readdir(dir)) != NULL)
+	{
+		if (ent->d_name[0] == '.' || strlen(ent->d_name) >= CACHE_NAME_LEN)
+		{
+			continue;
+		}
+		snprintf(path, CACHE_PATH_LEN, "%s/objects/%s", cache->dir, ent->d_name);
+		if (stat(path, &st))
+		{
+			continue;
+		}
+		if (nobjs == maxobjs)
+		{
+			maxobjs = maxobjs ? 2 * maxobjs : 64;
+			if ((tmp = (Cache_Object *)realloc(objs, maxobjs * sizeof(Cache_Object))) == NULL)
+			{
+				break;
+			}
+			objs = tmp;
+		}
+		strcpy(objs[nobjs].name, ent->d_name);
+		objs[nobjs].mtime = st.st_mtim;
+		objs[nobjs].size = st.st_size;
+		total += st.st_size;
+		nobjs++;
+	}
+	closedir(dir);
+
+	if (total > cache->max_bytes)
+	{
+		qsort(objs, nobjs, sizeof(Cache_Object), cache_object_cmp);
+		for (i = 0; i < nobjs && total > cache->max_bytes; i++)
+		{
+			snprintf(path, CACHE_PATH_LEN, "%s/objects/%s", cache->dir, objs[i].name);
+			if (!unlink(path))
+			{
+				total -= objs[i].size;
+			}
+		}
+	}
+	free(objs);
+}
+
+/* Name of the index entry for an input: its identity plus the option key */
+static void cache_index_path(Cache_Info *cache, char *path)
+{
+	Xxh64_State st;
+	char key[CACHE_PATH_LEN];
+	int len;
+
+	len = snprintf(key, CACHE_PATH_LEN, "%llu %llu %lld %lld.%09ld %s",
+		(unsigned long long)cache->in_dev, (unsigned long long)cache->in_ino, (long long)cache->in_size,
+		(long long)cache->in_mtime, cache->in_mtime_ns, cache->optkey);
+	xxh64_init(&st);
+	xxh64_update(&st, (const uint8_t *)key, len);
+	snprintf(path, CACHE_PATH_LEN, "%s/index/%016llx", cache->dir, (unsigned long long)xxh64_digest(&st));
+}
+#endif /* UNIX */
+
+/* Set up the cache for one conversion, returns 0 if caching is not available */
+int cache_open(Cache_Info *cache,		/* IN/OUT: dir, max_bytes and optkey set by the caller */
+			   const char *in_fname)	/* IN: input file name */
+{
+#ifdef UNIX
+	char path[CACHE_PATH_LEN];
+	struct stat st;
+
+	if (stat(in_fname, &st) || !S_ISREG(st.st_mode))
+	{
+		return 0;
+	}
+	cache->in_dev = st.st_dev;
+	cache->in_ino = st.st_ino;
+	cache->in_size = st.st_size;
+	cache->in_mtime = st.st_mtim.tv_sec;
+	cache->in_mtime_ns = st.st_mtim.tv_nsec;
+
+	mkdir(cache->dir, 0777);
+	snprintf(path, CACHE_PATH_LEN, "%s/objects", cache->dir);
+	mkdir(path, 0777);
+	snprintf(path, CACHE_PATH_LEN, "%s/index", cache->dir);
+	mkdir(path, 0777);
+	if (access(path, W_OK))
+	{
+		return 0;
+	}
+
+	xxh64_init(&cache->hash);
+	cache->have_digest = 0;
+
+	return 1;
+#else
+	return 0;
+#endif /* UNIX */
+}		//		cache_open()
+
+/* Look the input up and copy the cached output on a hit, returns 1 on a hit */
+int cache_fetch(Cache_Info *cache,			/* IN/OUT: opened cache */
+				const char *out_fname)		/* IN: output file name */
+{
+#ifdef UNIX
+	char path[CACHE_PATH_LEN];
+	char objpath[CACHE_PATH_LEN];
+	char name[CACHE_NAME_LEN];
+	FILE *fp;
+
+	cache_index_path(cache, path);
+	if ((fp = fopen(path, "r")) == NULL)
+	{
+		cache_count(cache, 0);
+		return 0;
+	}
+	if (fscanf(fp, "%63s", name) != 1)
+	{
+		name[0] = '\0';
+	}
+	fclose(fp);
+
+	snprintf(objpath, CACHE_PATH_LEN, "%s/objects/%s", cache->dir, name);
+	if (!name[0] || cache_copy_file(objpath, out_fname))
+	{
+		cache_count(cache, 0);
+		return 0;
+	}
+
+	/* mark the object as recently used */
+	utimensat(AT_FDCWD, objpath, NULL, 0);
+	cache_count(cache, 1);
+
+	return 1;
+#else
+	return 0;
+#endif /* UNIX */
+}		//		cache_fetch()
+
+/* Wrap the input so it is hashed as the converter reads it */
+FILE *cache_wrap_input(Cache_Info *cache,	/* IN/OUT: opened cache */
+					   FILE *infile)		/* IN: input opened for reading, owned by the returned stream */
+{
+#ifdef __linux__
+	Cache_Stream *cs;
+	cookie_io_functions_t io = { cache_stream_read, NULL, cache_stream_seek, cache_stream_close };
+	FILE *fp;
+
+	if ((cs = (Cache_Stream *)calloc(1, sizeof(Cache_Stream))) == NULL)
+	{
+		return(infile);
+	}
+	cs->cache = cache;
+	cs->file = infile;
+	cs->fd = fileno(infile);
+	cs->pos = ftello(infile);
+
+	if ((fp = fopencookie(cs, "rb", io)) == NULL)
+	{
+		free(cs);
+		return(infile);
+	}
+
+	return(fp);
+#elif defined(UNIX)
+	Cache_Stream cs = { 0 };
+
+	/* without cookie streams the input is hashed in a pass of its own, before it is converted */
+	cs.cache = cache;
+	cs.fd = fileno(infile);
+	cache_finish_hash(&cs);
+
+	return(infile);
+#else
+	return(infile);
+#endif /* __linux__ */
+}		//		cache_wrap_input()
+
+/* Store a finished output under the input's content hash, the input must already be closed */
+void cache_store(Cache_Info *cache,			/* IN: cache with the input digest */
+				 const char *out_fname)		/* IN: output file name */
+{
+#ifdef UNIX
+	char path[CACHE_PATH_LEN];
+	char objpath[CACHE_PATH_LEN];
+	char tmppath[CACHE_PATH_LEN + 16];			/* room for the pid suffix */
+	char name[CACHE_NAME_LEN];
+	Xxh64_State st;
+	FILE *fp;
+
+	if (!cache->have_digest)
+	{
+		return;
+	}
+
+	xxh64_init(&st);
+	xxh64_update(&st, (const uint8_t *)cache->optkey, strlen(cache->optkey));
+	snprintf(name, CACHE_NAME_LEN, "%016llx-%llx-%016llx", (unsigned long long)cache->digest,
+		(unsigned long long)cache->in_size, (unsigned long long)xxh64_digest(&st));
+
+	/* identical content converted with the same options is stored once */
+	snprintf(objpath, CACHE_PATH_LEN, "%s/objects/%s", cache->dir, name);
+	if (access(objpath, F_OK))
+	{
+		snprintf(tmppath, sizeof(tmppath), "%s.%d", objpath, (int)getpid());
+		if (cache_copy_file(out_fname, tmppath) || rename(tmppath, objpath))
+		{
+			unlink(tmppath);
+			return;
+		}
+	}
+
+	cache_index_path(cache, path);
+	snprintf(tmppath, sizeof(tmppath), "%s.%d", path, (int)getpid());
+	if ((fp = fopen(tmppath, "w")) == NULL)
+	{
+		return;
+	}
+	fprintf(fp, "%s\n", name);
+	if (fclose(fp) || rename(tmppath, path))
+	{
+		unlink(tmppath);
+		return;
+	}
+
+	cache_evict(cache);
+#endif /* UNIX */
+}		//		cache_store()
@@ -0,0 +1,319 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	crc.c
+ *		CRC-16 verification of AC-3, E-AC-3 and AC-4 frames
+ *
+ *		AC-3 and E-AC-3 frames end in crc2, and AC-4 frames with the 0xAC41
+ *		sync word end in crc_word. In both cases the CRC-16 with generator
+ *		x^16 + x^15 + x^2 + 1 over everything after the sync word, the CRC
+ *		included, is zero for an intact frame. AC-3 crc1 gives the same
+ *		property over the first 5/8 of the frame. The CRC is computed eight
+ *		bytes per step from eight 256 entry tables (slice-by-8).
+ *
+ *	History:
+ *		10/19/26	CRC_ABORT leaves the error to the caller instead of exiting
+ *		10/19/26	Tables built once however many runs call crc16_init()
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "frame337.h"
+
+#ifdef UNIX
+#include <pthread.h>
+#endif /* UNIX */
+
+extern const int16_t frmsizetab [NFSCOD] [NDATARATE];
+
+#define CRC16_POLY		0x8005				/* x^16 + x^15 + x^2 + 1 */
+
+/* crc16_tab[k][x] is the CRC of byte x followed by k zero bytes, written once and only read after */
+static uint16_t crc16_tab[8][256];
+
+#ifdef UNIX
+static pthread_once_t crc16_once = PTHREAD_ONCE_INIT;
+#endif /* UNIX */
+
+static void crc16_build(void)
+{
+	int i, k;
+	uint16_t c;
+
+	for (i = 0; i < 256; i++)
+	{
+		c = (uint16_t)(i << 8);
+		for (k = 0; k < 8; k++)
+		{
+			c = (c & 0x8000) ? (uint16_t)((c << 1) ^ CRC16_POLY) : (uint16_t)(c << 1);
+		}
+		crc16_tab[0][i] = c;
+	}
+	for (k = 1; k < 8; k++)
+	{
+		for (i = 0; i < 256; i++)
+		{
+			c = crc16_tab[k - 1][i];
+			crc16_tab[k][i] = (uint16_t)((c << 8) ^ crc16_tab[0][c >> 8]);
+		}
+	}
+}		//		crc16_build()
+
+/* Build the CRC tables, before any frame is checked; runs on several threads build them once */
+void crc16_init(void)
+{
+#ifdef UNIX
+	pthread_once(&crc16_once, crc16_build);
+#else
+	/* runs are not threaded without UNIX */
+	crc16_build();
+#endif /* UNIX */
+}		//		crc16_init()
+
+/* Continue a CRC-16 over len more bytes */
+uint16_t crc16(uint16_t crc,			/* IN: CRC so far, 0 to start */
+			   const uint8_t *buf,		/* IN: data */
+			   size_t len)				/* IN: in bytes */
+{
+	while (len >= 8)
+	{
+		crc = crc16_tab[7][buf[0] ^ (crc >> 8)] ^ crc16_tab[6][buf[1] ^ (crc & 0xFF)]
+			^ crc16_tab[5][buf[2]] ^ crc16_tab[4][buf[3]] ^ crc16_tab[3][buf[4]]
+			^ crc16_tab[2][buf[5]] ^ crc16_tab[1][buf[6]] ^ crc16_tab[0][buf[7]];
+		buf += 8;
+		len -= 8;
+	}
+	while (len--)
+	{
+		crc = (uint16_t)((crc << 8) ^ crc16_tab[0][(crc >> 8) ^ *buf++]);
+	}
+	return(crc);
+}		//		crc16()
+
+/* CRC-16 over byte reversed 16-bit words, without swapping them first */
+static uint16_t crc16_rev(uint16_t crc,			/* IN: CRC so far, 0 to start */
+						  const uint8_t *buf,	/* IN: data, each pair of bytes reversed */
+						  size_t len)			/* IN: in bytes, even */
+{
+	while (len >= 8)
+	{
+		crc = crc16_tab[7][buf[1] ^ (crc >> 8)] ^ crc16_tab[6][buf[0] ^ (crc & 0xFF)]
+			^ crc16_tab[5][buf[3]] ^ crc16_tab[4][buf[2]] ^ crc16_tab[3][buf[5]]
+			^ crc16_tab[2][buf[4]] ^ crc16_tab[1][buf[7]] ^ crc16_tab[0][buf[6]];
+		buf += 8;
+		len -= 8;
+	}
+	for (; len >= 2; buf += 2, len -= 2)
+	{
+		crc = (uint16_t)((crc << 8) ^ crc16_tab[0][(crc >> 8) ^ buf[1]]);
+		crc = (uint16_t)((crc << 8) ^ crc16_tab[0][(crc >> 8) ^ buf[0]]);
+	}
+	return(crc);
+}		//		crc16_rev()
+
+/* Size in bytes of the DD/DD+ or AC-4 frame starting at frame, 0 if none starts there */
+int crc_frame_size(const uint8_t *frame,	/* IN: frame as it is stored, DD/DD+ may be byte reversed */
+				   int nbytes)				/* IN: bytes available */
+{
+	int rev;								/* index xor for byte reversed DD/DD+ */
+	int size, fscod, frmsizecod, bsid;
+
+	if (nbytes < 8)
+	{
+		return(0);
+	}
+
+	if ((frame[0] == 0xAC) && ((frame[1] == 0x40) || (frame[1] == 0x41)))
+	{
+		size = (frame[2] << 8) | frame[3];
+		if (size == 0xFFFF)
+		{
+			size = ((frame[4] << 16) | (frame[5] << 8) | frame[6]) + 7;
+		}
+		else
+		{
+			size += 4;
+		}
+		return((frame[1] == 0x41) ? size + 2 : size);
+	}
+
+	if ((frame[0] == 0x0B) && (frame[1] == 0x77))
+		rev = 0;
+	else if ((frame[0] == 0x77) && (frame[1] == 0x0B))
+		rev = 1;
+	else
+		return(0);
+
+	bsid = frame[5 ^ rev] >> 3;
+	if (BSI_ISDD(bsid))
+	{
+		fscod = frame[4 ^ rev] >> 6;
+		frmsizecod = frame[4 ^ rev] & 0x3F;
+		if ((fscod > MAXFSCOD - 1) || (frmsizecod > MAXFRMSIZECOD - 1))
+		{
+			return(0);
+		}
+		return(frmsizetab[fscod][frmsizecod] * 2);
+	}
+	if (BSI_ISDDP(bsid))
+	{
+		return(((((frame[2 ^ rev] & 0x07) << 8) | frame[3 ^ rev]) + 1) * 2);
+	}
+	return(0);
+}		//		crc_frame_size()
+
+/* Check the CRCs of one whole frame */
+int crc_check_frame(const uint8_t *frame,	/* IN: frame as it is stored, DD/DD+ may be byte reversed */
+					int nbytes)				/* IN: frame size from crc_frame_size() */
+											/* returns CRC_OK, CRC_NONE, CRC_ERR_CRC1 or CRC_ERR_CRC2 */
+{
+	uint16_t (*crc_fn)(uint16_t, const uint8_t *, size_t) = crc16;
+	uint16_t crc;
+	int size_58;							/* bytes covered by AC-3 crc1 */
+	int rev = 0;							/* index xor for byte reversed DD/DD+ */
+
+	if (frame[0] == 0xAC)
+	{
+		if (frame[1] != 0x41)
+		{
+			return(CRC_NONE);
+		}
+		return(crc16(0, frame + 2, nbytes - 2) ? CRC_ERR_CRC2 : CRC_OK);
+	}
+
+	if (frame[0] == 0x77)
+	{
+		crc_fn = crc16_rev;
+		rev = 1;
+	}
+
+	if (BSI_ISDD(frame[5 ^ rev] >> 3))
+	{
+		size_58 = ((nbytes >> 2) + (nbytes >> 4)) << 1;
+		crc = crc_fn(0, frame + 2, size_58 - 2);
+		if (crc)
+		{
+			return(CRC_ERR_CRC1);
+		}
+		return(crc_fn(crc, frame + size_58, nbytes - size_58) ? CRC_ERR_CRC2 : CRC_OK);
+	}
+	return(crc_fn(0, frame + 2, nbytes - 2) ? CRC_ERR_CRC2 : CRC_OK);
+}		//		crc_check_frame()
+
+/* Check one frame and apply the CRC policy, returns 1 if the frame is kept */
+int crc_verify(Crc_Info *crc,				/* IN/OUT: policy and counts */
+			   const uint8_t *frame,		/* IN: frame as it is stored */
+			   int nbytes)					/* IN: frame size in bytes */
+{
+	char errstr[ERR_STR_BUF_LEN];
+	int status;
+
+	if ((status = crc_check_frame(frame, nbytes)) == CRC_NONE)
+	{
+		return(1);
+	}
+	crc->checked++;
+	if (status == CRC_OK)
+	{
+		return(1);
+	}
+	crc->failed++;
+
+	snprintf(errstr, ERR_STR_BUF_LEN, "CRC error in frame %ld (%s)%s", crc->checked - 1,
+		(status == CRC_ERR_CRC1) ? "crc1" : "crc2", (crc->policy == CRC_SKIP) ? ", frame dropped" : "");
+	switch (crc->policy)
+	{
+		case CRC_COUNT:
+			return(1);
+		case CRC_ABORT:
+			/* the caller stops the run, see crc_abort_error() */
+			crc->aborted = status;
+			return(0);
+		case CRC_SKIP:
+			error_msg(errstr, WARNING);
+			crc->skipped++;
+			return(0);
+		default:
+			error_msg(errstr, WARNING);
+			break;
+	}
+	return(1);
+}		//		crc_verify()
+
+/* Check every frame of a payload, dropping failed frames under CRC_SKIP */
+int crc_verify_payload(Crc_Info *crc,		/* IN/OUT: policy and counts */
+					   uint8_t *buf,		/* IN/OUT: frames back to back, compacted if any are dropped */
+					   int nbytes)			/* IN: payload size in bytes */
+											/* returns the payload size after dropping frames */
+{
+	int pos = 0, out = 0;
+	int size;
+
+	while ((size = crc_frame_size(buf + pos, nbytes - pos)) && (size <= nbytes - pos))
+	{
+		if (crc->aborted)
+		{
+			return(out);
+		}
+		if (crc_verify(crc, buf + pos, size))
+		{
+			if (out != pos)
+			{
+				memmove(buf + out, buf + pos, size);
+			}
+			out += size;
+		}
+		pos += size;
+	}
+
+	/* anything that does not parse as frames is passed on as it is */
+	if (pos < nbytes)
+	{
+		if (out != pos)
+		{
+			memmove(buf + out, buf + pos, nbytes - pos);
+		}
+		out += nbytes - pos;
+	}
+	return(out);
+}		//		crc_verify_payload()
+
+/* Record the frame that stopped a run under CRC_ABORT */
+int crc_abort_error(Crc_Info *crc,			/* IN: counts, aborted set by crc_verify() */
+					Run_Error *err,			/* IN/OUT: error of the run */
+					int64_t offset)			/* IN: input byte offset of the frame, -1 if unknown */
+											/* returns 0 */
+{
+	return run_error(err, ERR_CRC, offset, crc->checked - 1, "CRC error (%s), aborting",
+		(crc->aborted == CRC_ERR_CRC1) ? "crc1" : "crc2");
+}		//		crc_abort_error()
+
+/* Report the CRC counts of a conversion */
+void show_crc_stats(Crc_Info *crc)		/* IN: counts after the conversion */
+{
+	if (crc->policy != CRC_OFF)
+	{
+		printf("CRC: %ld frames checked, %ld failed, %ld dropped\n", crc->checked, crc->failed, crc->skipped);
+	}
+}		//		show_crc_stats()
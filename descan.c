@@ -0,0 +1,253 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+/****************************************************************************
+ *	File:	descan.c
+ *		Preamble search and payload conversion for deformatting, one
+ *		instance per sample size
+ *
+ *		The search and the conversion run over every word of the input, so
+ *		both are built by macro once for each sample size, and once for each
+ *		output word size for the conversion, with the word load and shifts
+ *		fixed at compile time. The instance is picked once per file. The
+ *		search reads the input in blocks rather than a word at a time and
+ *		compares each word, left aligned, with Pa of all three data word
+ *		sizes; the data word size only sets how many words a burst holds.
+ *		Everything after Pa is read once per burst and is shared.
+ *
+ *	History:
+ *		10/19/26	Errors are returned to the caller instead of exiting
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "frame337.h"
+
+#define DESCAN_BLOCK_WORDS	4096		/* words read per search block */
+#define DESCAN_RESCAN		-1			/* Pb did not follow Pa, search on */
+
+/* Little endian samples, left aligned in 32 bits */
+#define DESCAN_LOAD16(p)	((uint32_t)((p)[0] | ((p)[1] << 8)) << 16)
+#define DESCAN_LOAD24(p)	((uint32_t)((p)[0] | ((p)[1] << 8) | ((p)[2] << 16)) << 8)
+#define DESCAN_LOAD32(p)	((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8) | ((uint32_t)(p)[2] << 16) | ((uint32_t)(p)[3] << 24))
+
+/* Search for Pa from the input position, leaving the input after it; returns 0 at the end of the input */
+#define DESCAN_FIND_PA(bps)																\
+static int find_pa##bps(File_Info *file_info)											\
+{																						\
+	uint8_t block[DESCAN_BLOCK_WORDS * (bps / 8)];										\
+	FILE *fp = file_info->smpte_file;													\
+	int64_t pos = ftell64(fp);															\
+	uint32_t word;																		\
+	int n, i;																			\
+																						\
+	while ((n = (int)fread(block, bps / 8, DESCAN_BLOCK_WORDS, fp)) > 0)				\
+	{																					\
+		for (i = 0; i < n; i++)															\
+		{																				\
+			word = DESCAN_LOAD##bps(&block[i * (bps / 8)]);								\
+			if (((word >> 16) == PREAMBLE_A16) || ((word >> 12) == PREAMBLE_A20)		\
+				|| ((word >> 8) == PREAMBLE_A24))										\
+			{																			\
+				/* the narrowest match wins, as when searching word by word */			\
+				file_info->bit_depth = ((word >> 16) == PREAMBLE_A16) ? 16				\
+					: (((word >> 12) == PREAMBLE_A20) ? 20 : 24);						\
+				fseek64(fp, pos + (int64_t)(i + 1) * (bps / 8), SEEK_SET);				\
+				return(1);																\
+			}																			\
+		}																				\
+		pos += (int64_t)n * (bps / 8);													\
+	}																					\
+																						\
+	return(0);																			\
+}
+
+/* Convert nwords payload words into elementary stream words of outw bits */
+#define DESCAN_CONVERT(bps, outw)														\
+static void convert##bps##_##outw(const uint8_t *inbuf, void *outbuf, int nwords)		\
+{																						\
+	uint##outw##_t *out = (uint##outw##_t *)outbuf;										\
+	int i;																				\
+																						\
+	for (i = 0; i < nwords; i++)														\
+	{																					\
+		out[i] = (uint##outw##_t)(DESCAN_LOAD##bps(&inbuf[i * (bps / 8)]) >> (32 - outw));	\
+	}																					\
+}
+
+DESCAN_FIND_PA(16)
+DESCAN_FIND_PA(24)
+DESCAN_FIND_PA(32)
+
+DESCAN_CONVERT(16, 16)
+DESCAN_CONVERT(24, 16)
+DESCAN_CONVERT(32, 16)
+DESCAN_CONVERT(16, 32)
+DESCAN_CONVERT(24, 32)
+DESCAN_CONVERT(32, 32)
+
+/* Read Pb to Pd after a Pa, returns the payload size in bits, DESCAN_RESCAN if no Pb follows or 0 at the end */
+static int read_burst_info(File_Info *file_info,	/* IN/OUT: input after Pa, bit_depth of the Pa */
+						   uint8_t *dfbuf)			/* OUT: Pc, Pd and the word after */
+{
+	uint32_t word32val;
+
+	if (fread (dfbuf, file_info->bytes_per_word, 1, file_info->smpte_file) != 1)
+	{
+		return 0;
+	}
+
+	// look for preamble B
+	word32val = getword32value(dfbuf, file_info->bits_per_sample);
+
+	if ((((word32val >> file_info->shiftbits) & 0x0000FFFF) != (uint32_t)PREAMBLE_B16) && (file_info->bit_depth == 16)) 
+		return DESCAN_RESCAN;
+	if ((((word32val >> (file_info->shiftbits - 4)) & 0x000FFFFF) != (uint32_t)PREAMBLE_B20) && (file_info->bit_depth == 20)) 
+		return DESCAN_RESCAN;
+	if ((((word32val >> (file_info->shiftbits - 8)) & 0x00FFFFFF) != (uint32_t)PREAMBLE_B24) && (file_info->bit_depth == 24)) 
+		return DESCAN_RESCAN;
+
+	fread (dfbuf, file_info->bits_per_sample / 8, 3, file_info->smpte_file);
+	if (feof (file_info->smpte_file)) return 0;
+
+	// check value of preamble C
+	word32val = getword32value(dfbuf, file_info->bits_per_sample);
+
+	if(((word32val >> file_info->shiftbits) & 0x0000001F) == SMPTE_DD_PLUS_ID)
+		file_info->stream_type = EAC3;
+	else if(((word32val >> file_info->shiftbits) & 0x0000001F) == SMPTE_DD_ID)
+		file_info->stream_type = AC3;
+	else if(((word32val >> file_info->shiftbits) & 0x0000001F) == SMPTE_DDE_ID)
+		file_info->stream_type = DOLBYE;
+    else if (((word32val >> file_info->shiftbits) & 0x0000001F) == SMPTE_AC4SIMPLE_ID)
+        file_info->stream_type = AC4;
+	else
+		file_info->stream_type = UNKNOWN;
+
+	if (file_info->stream_type == AC3 || file_info->stream_type == EAC3)
+	{
+		word32val = getword32value((unsigned char *)dfbuf + (file_info->bytes_per_word * 2), file_info->bits_per_sample);
+
+		// check if the DD/DD+ frame sync word is valid
+		if((((word32val >> file_info->shiftbits) & 0x0000FFFF) != (uint32_t)SYNC_WD) && 
+			(((word32val >> file_info->shiftbits) & 0x0000FFFF) != (uint32_t)SYNC_WD_REV))
+		{
+			return run_error(&file_info->err, ERR_SYNCH_ERROR, ftell64(file_info->smpte_file), -1, "Invalid Sync Word Found");
+		}
+
+		fseek64(file_info->smpte_file, -file_info->bytes_per_word, SEEK_CUR);
+
+		// calculate the burst size
+		word32val = getword32value((unsigned char *)dfbuf + file_info->bytes_per_word, file_info->bits_per_sample);
+		word32val = (word32val >> (file_info->bits_per_sample - file_info->bit_depth));
+
+		return (int) word32val;
+	}
+	else if(file_info->stream_type == DOLBYE)
+	{
+		word32val = getword32value((unsigned char *)dfbuf + (file_info->bytes_per_word * 2), file_info->bits_per_sample);
+
+		// check if the Dolby E frame sync word is valid
+		if(((((word32val >> file_info->shiftbits) & 0x0000FFFE) != (uint32_t)DDE_SYNC16) && (file_info->bit_depth == 16))
+		  || ((((word32val >> (file_info->shiftbits - 4)) & 0x000FFFFE) != (uint32_t)DDE_SYNC20) && (file_info->bit_depth == 20))
+		  || ((((word32val >> (file_info->shiftbits - 8)) & 0x00FFFFFE) != (uint32_t)DDE_SYNC24) && (file_info->bit_depth == 24)))
+		{
+			error_msg("Invalid Sync Word Found", WARNING);
+		}
+
+		fseek64(file_info->smpte_file, -(file_info->bytes_per_word * 5), SEEK_CUR);
+
+		// calculate the burst size
+		word32val = getword32value((unsigned char *)dfbuf + file_info->bytes_per_word, file_info->bits_per_sample);
+		word32val = ((uint32_t)word32val >> (file_info->bits_per_sample - file_info->bit_depth));
+
+		//return the DDE burst size + (4*bps); //+4 to compensate for the IEC header words
+		return (int)(word32val + (4 * file_info->bit_depth));
+	}
+	else // AC-4 or unknown data
+	{
+		fseek64(file_info->smpte_file, -file_info->bytes_per_word, SEEK_CUR);
+
+		// calculate the burst size
+		word32val = getword32value((unsigned char *)dfbuf + file_info->bytes_per_word, file_info->bits_per_sample);
+		word32val = (word32val >> (file_info->bits_per_sample - file_info->bit_depth));
+
+		return (int) word32val;
+	}
+}		//		read_burst_info()
+
+#define DESCAN_GETSYNC(bps)																\
+static int getsync##bps(File_Info *file_info, uint8_t *dfbuf)							\
+{																						\
+	int nbits;																			\
+																						\
+	do																					\
+	{																					\
+		if (!find_pa##bps(file_info))													\
+		{																				\
+			return(0);																	\
+		}																				\
+	} while ((nbits = read_burst_info(file_info, dfbuf)) == DESCAN_RESCAN);			\
+																						\
+	return(nbits);																		\
+}
+
+DESCAN_GETSYNC(16)
+DESCAN_GETSYNC(24)
+DESCAN_GETSYNC(32)
+
+/* Preamble search for a sample size, also sets the shift getword32value() values need,
+   NULL if there is none for the sample size */
+Getsync_Fn select_getsync(File_Info *file_info)		/* IN/OUT: bits_per_sample set, shiftbits set here */
+{
+	switch (file_info->bits_per_sample)
+	{
+		case 16:
+			file_info->shiftbits = 0;
+			return(getsync16);
+		case 24:
+			file_info->shiftbits = 8;
+			return(getsync24);
+		case 32:
+			file_info->shiftbits = 16;
+			return(getsync32);
+		default:
+			return(NULL);
+	}
+}		//		select_getsync()
+
+/* Payload conversion from a sample size to elementary stream words of 16 or 32 bits, NULL if there is none */
+Convert_Fn select_convert(int bits_per_sample,	/* IN: 16, 24 or 32 */
+						  int outwordsize)		/* IN: 16 or 32 */
+{
+	switch (bits_per_sample)
+	{
+		case 16:
+			return((outwordsize == 16) ? convert16_16 : convert16_32);
+		case 24:
+			return((outwordsize == 16) ? convert24_16 : convert24_32);
+		case 32:
+			return((outwordsize == 16) ? convert32_16 : convert32_32);
+		default:
+			return(NULL);
+	}
+}		//		select_convert()
@@ -0,0 +1,287 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	follow.c
+ *		Following an elementary stream file that is still being written
+ *
+ *		The input is read through a stdio cookie stream that, instead of
+ *		reporting end of file, waits for the file to grow. It is woken by
+ *		inotify where available and polls otherwise. The input ends when
+ *		a sentinel file, the input name with FOLLOW_SENTINEL_EXT appended,
+ *		appears or when the file has not grown for the idle timeout. While
+ *		following, the output header is rewritten after every burst so the
+ *		output is a valid file at all times.
+ *
+ *	History:
+ *		10/19/26	inotify follow built on Linux only
+ *		10/19/26	Header checkpoints take the output format from the burst
+ *		10/19/26	Errors are returned to the caller instead of exiting
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#ifdef __linux__
+#define _GNU_SOURCE					/* fopencookie() */
+#endif /* __linux__ */
+
+#include "frame337.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#define FOLLOW_POLL_MS		100			/* wait between size checks without inotify */
+#define FOLLOW_RECHECK_MS	1000		/* longest inotify wait, catches missed events */
+
+typedef struct
+{
+	FILE *file;						/* underlying input */
+	int fd;
+	off_t pos;
+	int notify_fd;					/* inotify instance, -1 to poll */
+	char *sentinel;					/* name of the end of stream marker */
+	int idle_secs;					/* give up after this long without new data */
+	int verbose;
+}Follow_Stream;
+
+static double follow_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+/* Wait for the input to change or for the wait to time out */
+static void follow_wait(Follow_Stream *fs)
+{
+	struct pollfd pfd;
+	char events[4096];
+
+	if (fs->notify_fd < 0)
+	{
+		usleep(FOLLOW_POLL_MS * 1000);
+		return;
+	}
+
+	pfd.fd = fs->notify_fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, FOLLOW_RECHECK_MS) > 0)
+	{
+		/* the events only wake us, drain them */
+		while (read(fs->notify_fd, events, sizeof(events)) > 0)
+		{
+		}
+	}
+}
+
+static ssize_t follow_stream_read(void *cookie, char *buf, size_t size)
+{
+	Follow_Stream *fs = (Follow_Stream *)cookie;
+	double idle_start = follow_now();
+	ssize_t n;
+	int done = 0;
+
+	while (1)
+	{
+		if ((n = pread(fs->fd, buf, size, fs->pos)) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return -1;
+		}
+		if (n > 0)
+		{
+			fs->pos += n;
+			return(n);
+		}
+
+		/* the writer may have appended just before the sentinel appeared, so read once more */
+		if (done)
+		{
+			return 0;
+		}
+		if (!access(fs->sentinel, F_OK))
+		{
+			if (fs->verbose)
+			{
+				printf("\nFollow: end of stream marker %s found\n", fs->sentinel);
+			}
+			done = 1;
+			continue;
+		}
+		if (follow_now() - idle_start >= fs->idle_secs)
+		{
+			if (fs->verbose)
+			{
+				printf("\nFollow: no new data for %d seconds, finishing\n", fs->idle_secs);
+			}
+			done = 1;
+			continue;
+		}
+
+		follow_wait(fs);
+	}
+}
+
+static int follow_stream_seek(void *cookie, off64_t *offset, int whence)
+{
+	Follow_Stream *fs = (Follow_Stream *)cookie;
+	struct stat st;
+	off_t base;
+
+	switch (whence)
+	{
+		case SEEK_SET:
+			base = 0;
+			break;
+		case SEEK_CUR:
+			base = fs->pos;
+			break;
+		case SEEK_END:
+			/* the end so far */
+			if (fstat(fs->fd, &st))
+			{
+				return -1;
+			}
+			base = st.st_size;
+			break;
+		default:
+			return -1;
+	}
+	if (base + *offset < 0)
+	{
+		return -1;
+	}
+	fs->pos = base + *offset;
+	*offset = fs->pos;
+
+	return 0;
+}
+
+static int follow_stream_close(void *cookie)
+{
+	Follow_Stream *fs = (Follow_Stream *)cookie;
+
+	if (fs->notify_fd >= 0)
+	{
+		close(fs->notify_fd);
+	}
+	fclose(fs->file);
+	free(fs->sentinel);
+	free(fs);
+
+	return 0;
+}
+#endif /* __linux__ */
+
+/* Wrap an input that is still being written so reads wait for more data instead of ending,
+   NULL if it cannot be wrapped, the input then stays with the caller */
+FILE *follow_input(FILE *infile,			/* IN: input opened for reading, owned by the returned stream */
+				   const char *fname,		/* IN: input file name */
+				   int idle_secs,			/* IN: finish after this many seconds without new data */
+				   int verbose)				/* IN: report why following ended */
+{
+#ifdef __linux__
+	Follow_Stream *fs;
+	cookie_io_functions_t io = { follow_stream_read, NULL, follow_stream_seek, follow_stream_close };
+	size_t len = strlen(fname) + strlen(FOLLOW_SENTINEL_EXT) + 1;
+	FILE *fp;
+
+	if ((fs = (Follow_Stream *)calloc(1, sizeof(Follow_Stream))) == NULL
+		|| (fs->sentinel = (char *)malloc(len)) == NULL)
+	{
+		free(fs);
+		return(NULL);
+	}
+	snprintf(fs->sentinel, len, "%s%s", fname, FOLLOW_SENTINEL_EXT);
+
+	fs->file = infile;
+	fs->fd = fileno(infile);
+	fs->pos = ftello(infile);
+	fs->idle_secs = idle_secs;
+	fs->verbose = verbose;
+
+	/* fall back to polling if inotify is not available, e.g. on network file systems it may not fire */
+	if ((fs->notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) >= 0
+		&& inotify_add_watch(fs->notify_fd, fname, IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB) < 0)
+	{
+		close(fs->notify_fd);
+		fs->notify_fd = -1;
+	}
+
+	if ((fp = fopencookie(fs, "rb", io)) == NULL)
+	{
+		if (fs->notify_fd >= 0)
+		{
+			close(fs->notify_fd);
+		}
+		free(fs->sentinel);
+		free(fs);
+	}
+
+	return(fp);
+#else
+	error_msg("Follow mode is not supported on this platform", WARNING);
+	return(infile);
+#endif /* __linux__ */
+}		//		follow_input()
+
+/* Rewrite the output header for the data written so far */
+int checkpoint_output(Format_Ctx *ctx,		/* IN: format context, called from the writer stage */
+					  const Burst_Buf *burst)	/* IN: burst just written, with the output format */
+											/* returns 0 if the header could not be written */
+{
+	FILE *fp = ctx->file_info->smpte_file;
+	uint8_t hdr[WAVE_HEADER_SIZE_RF64];
+	int64_t length;
+
+	if (fflush(fp))
+	{
+		return run_error(&ctx->file_info->err, ERR_WRITE_ERROR, -1, -1, "decode: Unable to write to output file");
+	}
+	length = ftell64(fp);
+	make_wave_header(hdr, ctx->wave_layout, length - ctx->header_size, burst->wave_bps, burst->wave_frate);
+
+#ifdef UNIX
+	/* leave the stream position alone */
+	if (pwrite(fileno(fp), hdr, ctx->header_size, 0) != ctx->header_size)
+	{
+		return run_error(&ctx->file_info->err, ERR_WRITE_ERROR, -1, -1, "decode: Unable to write to output file");
+	}
+#else
+	rewind(fp);
+	fwrite(hdr, ctx->header_size, 1, fp);
+	fseek64(fp, length, SEEK_SET);
+#endif /* UNIX */
+
+	return 1;
+}		//		checkpoint_output()
@@ -31,6 +31,34 @@
  *		complient with the SMPTE S337M and S340M standards.
  *
  *	History:
+ *      10/19/26    -fillgaps also follows the decoded DD/DD+ timecode
+ *      10/19/26    -timecode decodes the timecode frames into the index and a bext TimeReference
+ *      10/19/26    Bursts carry the output format to the writer stage
+ *      10/19/26    -rt stdio buffers installed as the files are opened, before any read or seek
+ *      10/19/26    -playlist formats several inputs into one output, -grid pads them to video frames
+ *      10/19/26    -mp4 formats an AC-3, E-AC-3 or AC-4 track of an MP4 file
+ *      10/19/26    -ts formats the Dolby audio of an MPEG-2 transport stream
+ *      10/19/26    -rtpin deformats RTP received through a jitter buffer
+ *      10/19/26    -rtp sends the output as L24 RTP packets, batched with sendmmsg()
+ *      10/19/26    -shm publishes the bursts in a shared memory ring instead of a file
+ *      10/19/26    -rt real-time profile: locked, pre-faulted buffers and a burst time histogram
+ *      10/19/26    Parsers and writers return errors with offset and frame, only main exits
+ *      10/19/26    No mutable statics or globals, all run state in the contexts
+ *      10/19/26    Deformat preamble search and payload conversion specialised per sample size
+ *      10/19/26    -rewrap moves SMPTE 337 bursts to another sample size in one pass
+ *      10/19/26    Pause bursts for gaps in the AC-4 sequence counter or DD/DD+ timecode
+ *      10/19/26    Resynchronisation past damaged input, with pause bursts for the lost time
+ *      10/19/26    Inline CRC checks of AC-3, E-AC-3 and AC-4 frames, flag, skip or abort
+ *      10/19/26    Planner mode, output size and data rate headroom from frame headers
+ *      10/19/26    Analyzer mode, SMPTE 337/340 compliance report as JSON
+ *      10/19/26    RF64, BW64 and Wave64 deformat inputs, stop at the end of the data chunk
+ *      10/19/26    64-bit file offsets, RF64 output beyond 4 GiB
+ *      10/19/26    Follow mode for inputs that are still being written
+ *      10/19/26    Append mode for growing outputs
+ *      10/19/26    Content addressed cache of conversion outputs
+ *      10/19/26    Preallocated, memory mapped output with size prediction
+ *      10/19/26    Zero-copy formatting of AC-3/E-AC-3 from a memory mapped input
+ *      10/19/26    Split conversion into reader/packer/writer stages, optionally threaded
  *      11/20/21    Addition of AC-4
  *      12/12/16    Preparation for open source contribution
  *		11/27/14	Commented legacy code to allow Linux binary build (line 1135, char * p_strn)
@@ -45,78 +73,78 @@
 /**** Include Files ****/
 
 #include "frame337.h"
+#include <stdarg.h>
 
 /**** Constants ****/
 
-#define ERR_STR_BUF_LEN 256
-
 extern const int16_t frmsizetab [NFSCOD] [NDATARATE];
 extern const int16_t varratetab [NFSCOD] [NDATARATE];
 extern const uint16_t fratetab [NFSCOD];
 extern const int bitdepthtab [3];
 
-const char *pa_alignment_text[2] = {"Left", "Right"};
-const char *default_ac3fname =    "output.ac3";
-const char *default_smpte_fname = "output.wav";
+const char *const pa_alignment_text[2] = {"Left", "Right"};
+const char *const default_ac3fname =    "output.ac3";
+const char *const default_smpte_fname = "output.wav";
+
+const Pipe_Stages format_stages = { format_read_stage, format_pack_burst, format_write_burst };
+const Pipe_Stages deformat_stages = { deformat_read_burst, deformat_pack_burst, deformat_write_burst };
 
 /**** Main function ****/
 
 int main (int argc, char *argv [])
 {
-	uint16_t iobuf  [BUFWORDSIZE];			/* Holds 1 packed AC-3 frame = 8 AES blocks */
-	uint32_t Eiobuf [MAX_DDE_BURST_SIZE];	/* Holds 1 packed Dolby E frame */
-    unsigned char ac4_work_buffer[MAX_DDE_BURST_SIZE * sizeof(int32_t)];		/* AC-4 work buffer */
-
-	/* iobuf Buffer pointers */
-	uint16_t *p_buf;
-	int i,j;
+	int i;
 
-	SLC_INFO sinfo;
-    File_Info file_info = { 0 };
-	long numbytes;
-	short status;
+	File_Info file_info = { 0 };
+	Format_Ctx fmt_ctx = { 0 };
+	Burst_Buf *bursts;
+	int nbursts;
 	int wave_bps;
 	int wave_frate;
-	int outbufval;
-	int done; /* looping flag */
-	char *outbyteptr;
-	int framesizecod;				/* size of frame */
-	int sampratecod;				/* sample rate */
-
-	int nwords;						/* # words in frame */
-	long framecount = 0;			/* current frame number */
-	long file_length;				/* in bytes */
-	long numframes;					/* derived from file_length */
-	double percent = 0.0;			/* 1 frame percent of file */
+	int64_t file_length;			/* in bytes */
 	int altformat = 0;				/* flag for 2/3 sync pt format */
-	int size_23 = 0;				/* 2/3 size of current frame */
 	int deformat_mode = 0;
+	int pipeline_mode = 0;			/* run reader, packer and writer on separate threads */
+	int zerocopy_mode = 0;			/* map the input and write bursts with writev() */
+	int prealloc_mode = 0;			/* predict the output size, allocate and map it */
+	int append_mode = 0;			/* add to an existing output, file type APPEND */
+	int follow_mode = 0;			/* input is still being written */
+	int follow_idle = FOLLOW_DEFAULT_IDLE;
+	int analyze_mode = 0;			/* report on a SMPTE file without deformatting it */
+	int plan_mode = 0;				/* report what formatting would produce without doing it */
+	int resync_mode = 0;			/* search past damaged input instead of stopping */
+	int fillgaps_mode = 0;			/* write pause bursts for time missing from the input */
+	int timecode_mode = 0;			/* keep DD/DD+ timecode frames beside the output */
+	int rewrap_mode = 0;			/* copy the bursts of a SMPTE file into a new one */
+	int rewrap_bps = 0;				/* bits per sample of the new one, 0 for the input's */
+	int rt_mode = 0;				/* locked memory, no allocation and burst times for live playout */
+	char *shm_name = NULL;			/* publish the bursts in this shared memory ring instead of a file */
+	char *rtp_dest = NULL;			/* send the bursts as RTP to this host:port instead of a file */
+	int rtp_ptime = RTP_DEFAULT_PTIME;	/* in microseconds */
+	int rtp_pace = 0;				/* send each packet when it is due by the wall clock */
+	const char *live_opt = NULL;	/* -shm or -rtp, the output is not a file */
+	char *rtpin_addr = NULL;		/* deformat RTP received on this [host:]port instead of a file */
+	int ts_mode = 0;				/* the input is a transport stream */
+	int ts_pid = -1;				/* its audio PID, -1 for the first Dolby audio stream */
+	int mp4_mode = 0;				/* the input is an MP4 file */
+	int mp4_track = 0;				/* its track_ID, 0 for the first Dolby audio track */
+	char *playlist_fname = NULL;	/* format the inputs listed in this file one after another */
+	char *grid = NULL;				/* video frame rate each playlist input is padded to */
+	Rt_Info rt = { 0 };
+	Cache_Info cache = { 0 };		/* output cache, off unless -cache is given */
+	int cache_mode = 0;
 	int nStreamNum = 0;
-	int burst_size;                 /* size of IEC payload per data burst */
-									/* for DD, this is in bits            */  
-									/* for DDplus, this is in bytes       */
-	int16_t dolbye_fps;	 			/* Dolby E fps */
-
-	int numblocks;							/* accumulated # of blocks per 1536 AES frames */
-	int lastnumblocks;						/* to catch changes in numblocks */
-	int frameset;							/* indicator of complete frame set */
-	int flushbuf = 0;
-    int framesiz = 0;
-    int raw_framesiz = 0;
-	int dolbye;
-	int dde_frame_ctr = 0;
-    int AC4_AES_burst_count = 0;
-	unsigned int accumwords = 0;
 	int no_bit_depth_specified = 0;
-	int scratch_int;
-	short scratch_short;
+	uint8_t wave_header[WAVE_HEADER_SIZE_RF64];
+	int64_t predicted_bytes = -1;	/* data bytes predicted before formatting */
 	char *in_fname = NULL;
 	char *out_fname = NULL;
 	char errstr[ERR_STR_BUF_LEN];				/* string for error message */
-	uint16_t altbuf [BUFWORDSIZE];			/* Alternate buffer for 2/3 alignment */
 	int verbose = 0;				/* print progress messages */
 
-	Wave_Struct wavInfo;
+	Wave_Struct wavInfo = { 0 };
+	int wave_status;
+	int status;
 
 
 
@@ -124,15 +152,10 @@ int main (int argc, char *argv [])
 	file_info.ac3fname = (char *)default_ac3fname;
 	file_info.smpte_fname = (char *)default_smpte_fname;
 
-	/* Set up counters */
-	file_info.pa_align_changes = 0;
-	file_info.pc_value_changes = 0;
-	file_info.pd_value_changes = 0;
-
 	/*	Display sign-on banner */
 	fprintf (stderr, "\nCopyright 2007-2021 Dolby Laboratories, Inc. and");
 	fprintf (stderr, "\nDolby Laboratories Licensing Corporation. All Rights Reserved.\n");
-    fprintf(stderr, "\nDolby Digital(AC-3), Dolby Digital Plus (E-AC-3), Dolby AC-4, Dolby E SMPTE Conversion Program Ver 2.1.0\n\n");
+    fprintf(stderr, "\nDolby Digital(AC-3), Dolby Digital Plus (E-AC-3), Dolby AC-4, Dolby E SMPTE Conversion Program Ver " FRAME337_VERSION "\n\n");
 
 	/*	Parse command line arguments */
 	for (i = 1; i < argc; i++)
@@ -159,7 +182,19 @@ int main (int argc, char *argv [])
 					break;
 				case 'a':
 				case 'A':
-					altformat = 1;
+					if (!strcmp(argv[i] + 1, "append"))
+					{
+						append_mode = 1;
+					}
+					else if (!strcmp(argv[i] + 1, "analyze"))
+					{
+						analyze_mode = 1;
+						deformat_mode = 1;
+					}
+					else
+					{
+						altformat = 1;
+					}
 					break;
 				case 'b':
 				case 'B':
@@ -175,6 +210,195 @@ int main (int argc, char *argv [])
 				case 'D':
 					deformat_mode = 1;
 					break;              
+				case 'p':
+				case 'P':
+					if (!strcmp(argv[i] + 1, "pipeline"))
+					{
+						pipeline_mode = 1;
+					}
+					else if (!strcmp(argv[i] + 1, "prealloc"))
+					{
+						prealloc_mode = 1;
+					}
+					else if (!strcmp(argv[i] + 1, "plan"))
+					{
+						plan_mode = 1;
+					}
+					else if (!strncmp(argv[i] + 1, "playlist", 8) && *(argv[i] + 9))
+					{
+						playlist_fname = argv[i] + 9;
+					}
+					else if (!strcmp(argv[i] + 1, "pace"))
+					{
+						rtp_pace = 1;
+					}
+					else if (!strncmp(argv[i] + 1, "ptime", 5))
+					{
+						/* a whole number of sample frames, up to 1 ms */
+						rtp_ptime = atoi(argv[i] + 6);
+						if ((rtp_ptime <= 0) || (rtp_ptime > 1000) || ((rtp_ptime * (RTP_CLOCK / 1000)) % 1000))
+						{
+							show_usage ();
+						}
+					}
+					else
+					{
+						show_usage ();
+					}
+					break;
+				case 'c':
+				case 'C':
+					if (!strncmp(argv[i] + 1, "cachesize", 9))
+					{
+						cache.max_bytes = atoll(argv[i] + 10) * 1024 * 1024;
+					}
+					else if (!strncmp(argv[i] + 1, "cache", 5) && *(argv[i] + 6))
+					{
+						cache.dir = argv[i] + 6;
+					}
+					else if (!strcmp(argv[i] + 1, "crc") || !strcmp(argv[i] + 1, "crcflag"))
+					{
+						file_info.crc.policy = CRC_FLAG;
+					}
+					else if (!strcmp(argv[i] + 1, "crcskip"))
+					{
+						file_info.crc.policy = CRC_SKIP;
+					}
+					else if (!strcmp(argv[i] + 1, "crcabort"))
+					{
+						file_info.crc.policy = CRC_ABORT;
+					}
+					else
+					{
+						show_usage ();
+					}
+					break;
+				case 'f':
+				case 'F':
+					if (!strcmp(argv[i] + 1, "fillgaps"))
+					{
+						fillgaps_mode = 1;
+					}
+					else if (!strncmp(argv[i] + 1, "follow", 6))
+					{
+						follow_mode = 1;
+						if (*(argv[i] + 7))
+						{
+							follow_idle = atoi(argv[i] + 7);
+						}
+					}
+					else
+					{
+						show_usage ();
+					}
+					break;
+				case 'r':
+				case 'R':
+					if (!strcmp(argv[i] + 1, "resync"))
+					{
+						resync_mode = 1;
+					}
+					else if (!strncmp(argv[i] + 1, "rewrap", 6))
+					{
+						/* the input is read as when deformatting */
+						rewrap_mode = 1;
+						deformat_mode = 1;
+						rewrap_bps = atoi(argv[i] + 7);
+					}
+					else if (!strncmp(argv[i] + 1, "rtpin", 5) && *(argv[i] + 6))
+					{
+						rtpin_addr = argv[i] + 6;
+						deformat_mode = 1;
+					}
+					else if (!strncmp(argv[i] + 1, "rtp", 3) && *(argv[i] + 4))
+					{
+						rtp_dest = argv[i] + 4;
+					}
+					else if (!strncmp(argv[i] + 1, "rt", 2))
+					{
+						rt_mode = 1;
+						if (*(argv[i] + 3))
+						{
+							rt.priority = atoi(argv[i] + 3);
+							if (rt.priority < 1 || rt.priority > 99)
+							{
+								show_usage ();
+							}
+						}
+					}
+					else
+					{
+						show_usage ();
+					}
+					break;
+				case 's':
+				case 'S':
+					if (!strncmp(argv[i] + 1, "shm", 3) && *(argv[i] + 4))
+					{
+						shm_name = argv[i] + 4;
+					}
+					else
+					{
+						show_usage ();
+					}
+					break;
+				case 't':
+				case 'T':
+					if (!strcmp(argv[i] + 1, "timecode"))
+					{
+						timecode_mode = 1;
+					}
+					else if (!strncmp(argv[i] + 1, "ts", 2))
+					{
+						/* decimal or 0x hex */
+						ts_mode = 1;
+						if (*(argv[i] + 3) && (((ts_pid = (int)strtol(argv[i] + 3, NULL, 0)) < 0) || (ts_pid > 0x1fff)))
+						{
+							show_usage ();
+						}
+					}
+					else
+					{
+						show_usage ();
+					}
+					break;
+				case 'm':
+				case 'M':
+					if (!strncmp(argv[i] + 1, "mp4", 3))
+					{
+						mp4_mode = 1;
+						if (*(argv[i] + 4) && ((mp4_track = atoi(argv[i] + 4)) <= 0))
+						{
+							show_usage ();
+						}
+					}
+					else
+					{
+						show_usage ();
+					}
+					break;
+				case 'g':
+				case 'G':
+					if (!strncmp(argv[i] + 1, "grid", 4) && *(argv[i] + 5))
+					{
+						grid = argv[i] + 5;
+					}
+					else
+					{
+						show_usage ();
+					}
+					break;
+				case 'z':
+				case 'Z':
+					if (!strcmp(argv[i] + 1, "zerocopy"))
+					{
+						zerocopy_mode = 1;
+					}
+					else
+					{
+						show_usage ();
+					}
+					break;
 				default:
 					show_usage ();
 					break;
@@ -191,6 +415,212 @@ int main (int argc, char *argv [])
 		no_bit_depth_specified = 1;
 	}
 
+	if (follow_mode)
+	{
+		/* neither can work from an input that is not complete */
+		if (cache.dir)
+		{
+			fprintf(stderr, "Warning: -cache is not used when following\n");
+			cache.dir = NULL;
+		}
+		if (prealloc_mode)
+		{
+			fprintf(stderr, "Warning: -prealloc is not used when following\n");
+			prealloc_mode = 0;
+		}
+	}
+
+	if (rewrap_mode && follow_mode)
+	{
+		/* the output header is written first, from the input length */
+		fprintf(stderr, "Warning: -follow is not used with -rewrap\n");
+		follow_mode = 0;
+	}
+
+	if (shm_name && rtp_dest)
+	{
+		show_usage ();
+	}
+	if (rtpin_addr)
+	{
+		if (analyze_mode || rewrap_mode)
+		{
+			error_msg("-rtpin is only used for deformatting", FATAL);
+		}
+		/* a live stream is neither a file to follow nor content to look up */
+		if (follow_mode || cache.dir)
+		{
+			fprintf(stderr, "Warning: %s is not used with -rtpin\n", follow_mode ? "-follow" : "-cache");
+			follow_mode = 0;
+			cache.dir = NULL;
+		}
+		/* L24 carries 16-bit SMPTE 337 in the top of 24-bit samples as well */
+		if (no_bit_depth_specified)
+		{
+			file_info.bits_per_sample = 24;
+			file_info.bytes_per_word = 3;
+			no_bit_depth_specified = 0;
+		}
+	}
+	live_opt = shm_name ? "-shm" : rtp_dest ? "-rtp" : NULL;
+	if (live_opt && deformat_mode)
+	{
+		fprintf(stderr, "Warning: %s is only used when formatting\n", live_opt);
+		shm_name = rtp_dest = NULL;
+		live_opt = NULL;
+	}
+	if (ts_mode && mp4_mode)
+	{
+		show_usage ();
+	}
+	if ((ts_mode || mp4_mode) && deformat_mode)
+	{
+		fprintf(stderr, "Warning: %s is only used when formatting\n", ts_mode ? "-ts" : "-mp4");
+		ts_mode = mp4_mode = 0;
+	}
+	if (playlist_fname && deformat_mode)
+	{
+		fprintf(stderr, "Warning: -playlist is only used when formatting\n");
+		playlist_fname = NULL;
+	}
+	if (grid && !playlist_fname)
+	{
+		fprintf(stderr, "Warning: -grid is only used with -playlist\n");
+		grid = NULL;
+	}
+	if (playlist_fname)
+	{
+		if (plan_mode)
+		{
+			error_msg("-plan reports on one input, not a playlist", FATAL);
+		}
+		/* each entry names its own input type, and the inputs are opened one at a time as they are reached */
+		if (ts_mode || mp4_mode)
+		{
+			fprintf(stderr, "Warning: %s is not used with -playlist, give it after the input in the list\n", ts_mode ? "-ts" : "-mp4");
+			ts_mode = mp4_mode = 0;
+		}
+		if (cache.dir || follow_mode || zerocopy_mode || prealloc_mode)
+		{
+			fprintf(stderr, "Warning: %s is not used with -playlist\n", cache.dir ? "-cache" : follow_mode ? "-follow"
+				: zerocopy_mode ? "-zerocopy" : "-prealloc");
+			cache.dir = NULL;
+			follow_mode = zerocopy_mode = prealloc_mode = 0;
+		}
+	}
+	if (ts_mode && (zerocopy_mode || prealloc_mode))
+	{
+		/* the frames are not in the file as they are in the stream, and prediction would read it twice */
+		fprintf(stderr, "Warning: %s is not used with -ts\n", zerocopy_mode ? "-zerocopy" : "-prealloc");
+		zerocopy_mode = prealloc_mode = 0;
+	}
+	if (mp4_mode && (zerocopy_mode || follow_mode))
+	{
+		/* the samples are not contiguous in the file, and its sample table is only complete once written */
+		fprintf(stderr, "Warning: %s is not used with -mp4\n", zerocopy_mode ? "-zerocopy" : "-follow");
+		zerocopy_mode = follow_mode = 0;
+	}
+
+	if (live_opt)
+	{
+		/* the ring or the network replaces the output file */
+		if (cache.dir)
+		{
+			fprintf(stderr, "Warning: -cache is not used with %s\n", live_opt);
+			cache.dir = NULL;
+		}
+		if (append_mode || prealloc_mode || zerocopy_mode || timecode_mode)
+		{
+			fprintf(stderr, "Warning: %s is not used with %s\n", append_mode ? "-append" : prealloc_mode ? "-prealloc"
+				: zerocopy_mode ? "-zerocopy" : "-timecode", live_opt);
+			append_mode = prealloc_mode = zerocopy_mode = timecode_mode = 0;
+		}
+	}
+
+	if (rt_mode && (analyze_mode || plan_mode || rewrap_mode))
+	{
+		/* none of them runs the stages */
+		fprintf(stderr, "Warning: -rt is not used with %s\n", analyze_mode ? "-analyze" : plan_mode ? "-plan" : "-rewrap");
+		rt_mode = 0;
+	}
+	if (rt_mode)
+	{
+		/* per burst progress would block on the terminal */
+		if (verbose)
+		{
+			fprintf(stderr, "Warning: -v is not used with -rt\n");
+			verbose = 0;
+		}
+		file_info.rt = &rt;
+	}
+
+	if ((analyze_mode || plan_mode) && cache.dir)
+	{
+		/* the report is cheaper to produce than to look up */
+		fprintf(stderr, "Warning: -cache is not used for reports\n");
+		cache.dir = NULL;
+	}
+
+	if (append_mode && !deformat_mode)
+	{
+		/* the output depends on what is already in it */
+		if (cache.dir)
+		{
+			fprintf(stderr, "Warning: -cache is not used when appending\n");
+			cache.dir = NULL;
+		}
+		if (prealloc_mode)
+		{
+			fprintf(stderr, "Warning: -prealloc is not used when appending\n");
+			prealloc_mode = 0;
+		}
+	}
+
+	if ((resync_mode || fillgaps_mode) && !deformat_mode)
+	{
+		/* neither goes through format_read_burst(), where pause bursts are added */
+		if (zerocopy_mode)
+		{
+			fprintf(stderr, "Warning: -zerocopy is not used with %s\n", resync_mode ? "-resync" : "-fillgaps");
+			zerocopy_mode = 0;
+		}
+		if (prealloc_mode)
+		{
+			fprintf(stderr, "Warning: -prealloc is not used with %s\n", resync_mode ? "-resync" : "-fillgaps");
+			prealloc_mode = 0;
+		}
+	}
+
+	if (timecode_mode && !deformat_mode)
+	{
+		/* the index is written beside the output, and zero-copy does not read the timecode frames */
+		if (cache.dir)
+		{
+			fprintf(stderr, "Warning: -cache is not used with -timecode\n");
+			cache.dir = NULL;
+		}
+		if (zerocopy_mode)
+		{
+			fprintf(stderr, "Warning: -zerocopy is not used with -timecode\n");
+			zerocopy_mode = 0;
+		}
+	}
+
+	/* everything that changes the output goes in the cache key */
+	if (!cache.max_bytes)
+	{
+		cache.max_bytes = CACHE_DEFAULT_MB * 1024LL * 1024;
+	}
+	snprintf(cache.optkey, sizeof(cache.optkey), "frame337 %s d%d a%d b%d n%d c%d r%d g%d t%d w%d:%d s%d:%d m%d:%d", FRAME337_VERSION,
+		deformat_mode, altformat, file_info.bits_per_sample, nStreamNum, file_info.crc.policy, resync_mode, fillgaps_mode, timecode_mode,
+		rewrap_mode, rewrap_bps, ts_mode, ts_pid, mp4_mode, mp4_track);
+
+	/* resynchronisation accepts a frame whose CRC checks */
+	if ((file_info.crc.policy != CRC_OFF) || resync_mode)
+	{
+		crc16_init();
+	}
+
 
 	/*	Open i/o files */
 	if (deformat_mode) {
@@ -210,44 +640,136 @@ int main (int argc, char *argv [])
 		{
 			file_info.ac3fname = (char *)default_ac3fname;
 		}
+
+		if (cache.dir && (cache_mode = cache_open(&cache, file_info.smpte_fname)) && cache_fetch(&cache, file_info.ac3fname))
+		{
+			show_cache_stats(&cache, verbose, 1);
+			exit (0);
+		}
 		
-		if ((file_info.ac3file = fopen (file_info.ac3fname, "wb")) == NULL)
+		if (analyze_mode)
+		{
+			/* the report goes to stdout unless an output is named */
+			file_info.ac3fname = out_fname ? out_fname : "stdout";
+			file_info.ac3file = out_fname ? fopen (out_fname, "w") : stdout;
+		}
+		else
+		{
+			file_info.ac3file = fopen (file_info.ac3fname, "wb");
+		}
+		if (file_info.ac3file == NULL)
 		{
 			snprintf (errstr, ERR_STR_BUF_LEN, "decode: Unable to create output file, %s.", file_info.ac3fname);
 			error_msg (errstr, FATAL);
 		}
+		if (rt_mode && !rtpin_addr)
+		{
+			/* before anything is written, the output of a live input stays unbuffered */
+			rt_stdio(&rt, NULL, file_info.ac3file);
+		}
 		
-		if ((file_info.smpte_file = fopen (file_info.smpte_fname, "rb")) == NULL)
+		if (rtpin_addr)
+		{
+			file_info.smpte_fname = rtpin_addr;
+			if ((file_info.smpte_file = rtp_input(rtpin_addr, file_info.bits_per_sample, verbose)) == NULL)
+			{
+				snprintf (errstr, ERR_STR_BUF_LEN, "decode: Unable to receive RTP on %s.", rtpin_addr);
+				error_msg (errstr, FATAL);
+			}
+			/* each burst reaches the output as soon as it is deformatted */
+			setvbuf(file_info.ac3file, NULL, _IONBF, 0);
+		}
+		else if ((file_info.smpte_file = fopen (file_info.smpte_fname, "rb")) == NULL)
 		{
 			fprintf (stderr, "\nFATAL ERROR: decode: Input file, %s, not found.\n\n", file_info.smpte_fname);
 			show_usage ();
 			//		error_msg (errstr, FATAL);	
 		}
+		if (rt_mode)
+		{
+			/* before the header is parsed, streams wrapped around it read through this buffer */
+			rt_stdio(&rt, file_info.smpte_file, NULL);
+		}
+
+		if (cache_mode)
+		{
+			file_info.smpte_file = cache_wrap_input(&cache, file_info.smpte_file);
+		}
+		if (follow_mode && ((file_info.smpte_file = follow_input(file_info.smpte_file, file_info.smpte_fname, follow_idle, verbose)) == NULL))
+		{
+			error_msg("Unable to open follow stream", FATAL);
+		}
 
-		file_info.in_file_start = ftell(file_info.smpte_file);
+		file_info.in_file_start = ftell64(file_info.smpte_file);
 
-		if( parse_header(file_info.smpte_file, &wavInfo) )
+		if (rtpin_addr)
+		{
+			/* samples only, with no end to seek to */
+			wavInfo.data_offset = 0;
+		}
+		else if( (wave_status = parse_wave_header(file_info.smpte_file, &wavInfo)) == WAVE_OK )
 		{
-			file_info.in_file_start = ftell(file_info.smpte_file);
+			file_info.in_file_start = wavInfo.data_offset;
 			// wave file
 			file_info.bits_per_sample = wavInfo.nbits;			
 
 			file_info.bytes_per_word = file_info.bits_per_sample / 8;
+
+			/* stop at the end of the data chunk, a followed capture's header is not final */
+			if ((wavInfo.data_length >= 0) && !follow_mode
+				&& ((file_info.smpte_file = limit_input(file_info.smpte_file, wavInfo.data_offset + wavInfo.data_length)) == NULL))
+			{
+				error_msg("Unable to open input stream", FATAL);
+			}
+		}
+		else if (wave_status != WAVE_ERR_NOT_WAVE)
+		{
+			snprintf (errstr, ERR_STR_BUF_LEN, "decode: Input file, %s: %s.", file_info.smpte_fname, wave_error_msg(wave_status));
+			error_msg (errstr, FATAL);
 		}
 		else
 		{
+			wavInfo.data_offset = 0;
 			if(no_bit_depth_specified)
 			{
-				fprintf(stderr, "Error: Bit Depth Must Be Specified If Input is Not a Wave File\n");
-				exit(0);
+				error_msg("Bit Depth Must Be Specified If Input is Not a Wave File", FATAL);
 			}
 		}
 		
-		fseek (file_info.smpte_file, 0, SEEK_END);
-		file_length = ftell (file_info.smpte_file);
-		rewind (file_info.smpte_file);
-		fseek (file_info.smpte_file, wavInfo.wavheadersize, SEEK_SET);
-		framecount += deformat (&file_info, verbose); // smpte_file, ac3file);
+		if (!rtpin_addr)
+		{
+			fseek64(file_info.smpte_file, 0, SEEK_END);
+			file_length = ftell64(file_info.smpte_file);
+			rewind (file_info.smpte_file);
+			fseek64(file_info.smpte_file, wavInfo.data_offset, SEEK_SET);
+		}
+		if (analyze_mode)
+		{
+			if (analyze (&file_info, &wavInfo, verbose) < 0)
+			{
+				exit_on_error(&file_info);
+			}
+			exit (0);
+		}
+		if (rewrap_mode)
+		{
+			rewrap (&file_info, &wavInfo, rewrap_bps, verbose);
+		}
+		else
+		{
+			deformat (&file_info, verbose, pipeline_mode); // smpte_file, ac3file);
+			show_crc_stats(&file_info.crc);
+			if (rt_mode)
+			{
+				show_rt_stats(&rt);
+			}
+		}
+		exit_on_error(&file_info);
+		if (cache_mode)
+		{
+			cache_store(&cache, file_info.ac3fname);
+			show_cache_stats(&cache, verbose, 0);
+		}
 		exit (0);
 
 	}
@@ -271,591 +793,1343 @@ int main (int argc, char *argv [])
 			file_info.smpte_fname = (char *)default_smpte_fname;
 		}
 
-		if ((file_info.ac3file = fopen (file_info.ac3fname, "rb")) == NULL)
+		if (cache.dir && (cache_mode = cache_open(&cache, file_info.ac3fname)) && cache_fetch(&cache, file_info.smpte_fname))
 		{
-			fprintf (stderr, "\nFATAL ERROR: decode: Input file, %s, not found.\n\n", file_info.ac3fname);
-			show_usage ();
-			error_msg (errstr, FATAL);
+			show_cache_stats(&cache, verbose, 1);
+			return(0);
 		}
-		
-		fseek (file_info.ac3file, 0, SEEK_END);
-		file_length = ftell (file_info.ac3file);
-		rewind (file_info.ac3file);
-		
-		if ((file_info.smpte_file = fopen (file_info.smpte_fname, "wb")) == NULL)
+
+		if (playlist_fname)
 		{
-			snprintf (errstr, ERR_STR_BUF_LEN, "decode: Unable to create output file, %s.", file_info.smpte_fname);
-			error_msg (errstr, FATAL);
+			/* the first input is opened here, the others as the reader reaches them */
+			fmt_ctx.file_info = &file_info;
+			fmt_ctx.verbose = verbose;
+			if (!open_playlist(&fmt_ctx, playlist_fname, grid))
+			{
+				exit_on_error(&file_info);
+			}
+			file_length = fmt_ctx.file_length;
+		}
+		else
+		{
+			if ((file_info.ac3file = fopen (file_info.ac3fname, "rb")) == NULL)
+			{
+				fprintf (stderr, "\nFATAL ERROR: decode: Input file, %s, not found.\n\n", file_info.ac3fname);
+				show_usage ();
+				error_msg (errstr, FATAL);
+			}
+			if (rt_mode)
+			{
+				/* before the length is found, streams wrapped around it read through this buffer */
+				rt_stdio(&rt, file_info.ac3file, NULL);
+			}
+
+			if (cache_mode)
+			{
+				file_info.ac3file = cache_wrap_input(&cache, file_info.ac3file);
+			}
+			if (follow_mode && ((file_info.ac3file = follow_input(file_info.ac3file, file_info.ac3fname, follow_idle, verbose)) == NULL))
+			{
+				error_msg("Unable to open follow stream", FATAL);
+			}
+		
+			fseek64(file_info.ac3file, 0, SEEK_END);
+			file_length = ftell64(file_info.ac3file);
+			rewind (file_info.ac3file);
+
+			/* the stream is shorter than the file it is carried in, which is all file_length needs to bound */
+			if (ts_mode && ((file_info.ac3file = ts_input(file_info.ac3file, ts_pid, verbose)) == NULL))
+			{
+				error_msg("Unable to open transport stream input", FATAL);
+			}
+			if (mp4_mode)
+			{
+				if ((file_info.ac3file = mp4_input(file_info.ac3file, mp4_track, &file_info.err)) == NULL)
+				{
+					exit_on_error(&file_info);
+				}
+				/* the samples of the track, known from its sample table */
+				fseek64(file_info.ac3file, 0, SEEK_END);
+				file_length = ftell64(file_info.ac3file);
+				rewind (file_info.ac3file);
+			}
+		}
+		
+		if (plan_mode)
+		{
+			/* the report goes to stdout unless an output is named */
+			file_info.smpte_fname = out_fname ? out_fname : "stdout";
+			if ((file_info.smpte_file = out_fname ? fopen (out_fname, "w") : stdout) == NULL)
+			{
+				snprintf (errstr, ERR_STR_BUF_LEN, "decode: Unable to create output file, %s.", file_info.smpte_fname);
+				error_msg (errstr, FATAL);
+			}
+			fmt_ctx.file_info = &file_info;
+			fmt_ctx.file_length = file_length;
+			plan_format (&fmt_ctx, file_info.smpte_file, verbose);
+			fclose (file_info.ac3file);
+			if (fclose (file_info.smpte_file))
+			{
+				snprintf (errstr, ERR_STR_BUF_LEN, "decode: Unable to close output file, %s.", file_info.smpte_fname);
+				error_msg (errstr, FATAL);
+			}
+			exit (0);
 		}
 
-		fseek(file_info.smpte_file, 44, SEEK_SET); // advance pointer beyond wave header size
+		/* an output being appended to is kept, one that does not exist yet is created */
+		if (live_opt)
+		{
+			/* nothing is written to a file */
+			file_info.smpte_fname = shm_name ? shm_name : rtp_dest;
+		}
+		else if (append_mode && ((file_info.smpte_file = fopen (file_info.smpte_fname, "r+b")) != NULL))
+		{
+			file_info.smpte_ftype = APPEND;
+		}
+		/* the output map and a move to RF64 need read access as well */
+		else if ((file_info.smpte_file = fopen (file_info.smpte_fname, "w+b")) == NULL)
+		{
+			snprintf (errstr, ERR_STR_BUF_LEN, "decode: Unable to create output file, %s.", file_info.smpte_fname);
+			error_msg (errstr, FATAL);
+		}
+		if (rt_mode)
+		{
+			/* before an appended output is read back */
+			rt_stdio(&rt, NULL, file_info.smpte_file);
+		}
 
 	}		//	!deformat_mode
 
-	done = 0;
 	/*	Read frames of DD data */
-	while (! done)
+	fmt_ctx.file_info = &file_info;
+	fmt_ctx.verbose = verbose;
+	fmt_ctx.altformat = altformat;
+	fmt_ctx.nStreamNum = nStreamNum;
+	fmt_ctx.file_length = file_length;
+	fmt_ctx.checkpoint = follow_mode && !live_opt;
+	fmt_ctx.resync = resync_mode;
+	fmt_ctx.fill_gaps = fillgaps_mode;
+
+	if ((file_info.smpte_ftype == APPEND) && timecode_mode)
+	{
+		/* read before the append drops it */
+		resume_time_ref(&fmt_ctx);
+	}
+	if ((file_info.smpte_ftype == APPEND) && ((status = resume_output(&fmt_ctx)) <= 0))
 	{
-		frameset = 0;
-		numblocks = 0;
-		accumwords = 0;
+		/* an empty output is written from scratch, one that cannot be continued is an error */
+		exit_on_error(&file_info);
+		file_info.smpte_ftype = WRITE;
+	}
+	if (timecode_mode)
+	{
+		if ((fmt_ctx.tc_index = open_tc_index(file_info.smpte_fname, file_info.smpte_ftype == APPEND, &file_info.err)) == NULL)
+		{
+			exit_on_error(&file_info);
+		}
+	}
+	if (file_info.smpte_ftype == APPEND)
+	{
+		/* the timecode and the playlist grid count from the start of the output */
+		fmt_ctx.out_samples = fmt_ctx.resume_bytes / (2 * (fmt_ctx.resume_bps / 8));
+	}
 
-		dolbye = parse_preamble(&file_info);
+	if ((shm_name && !open_ring(&fmt_ctx, shm_name)) || (rtp_dest && !open_rtp(&fmt_ctx, rtp_dest, rtp_ptime, rtp_pace)))
+	{
+		exit_on_error(&file_info);
+	}
 
-		if(dolbye && (dolbye != SMPTE_DDE_ID))
-		{ 
-			done = checkstatus(dolbye);
-			if(done){ break; }
+	/* choose the header layout before any data is written, so the header never has to grow */
+	if ((file_info.smpte_ftype == WRITE) && !live_opt)
+	{
+		fmt_ctx.wave_layout = WAVE_RIFF;
+		if (follow_mode)
+		{
+			/* no telling how long a live input runs */
+			fmt_ctx.wave_layout = WAVE_RESERVED;
+		}
+		else if (prealloc_mode)
+		{
+			if ((predicted_bytes = predict_format_size(&fmt_ctx)) < 0)
+			{
+				exit_on_error(&file_info);
+			}
+			if (!wave_header_fits(WAVE_RIFF, predicted_bytes))
+			{
+				fmt_ctx.wave_layout = WAVE_RF64;
+			}
 		}
+		else if (file_length > WAVE_RIFF_MAX / WAVE_MAX_EXPANSION)
+		{
+			/* the output may pass 4 GiB, keep room for ds64 rather than reading the input twice to know */
+			fmt_ctx.wave_layout = WAVE_RESERVED;
+		}
+		fmt_ctx.header_size = wave_header_size(fmt_ctx.wave_layout);
+		fseek64(file_info.smpte_file, fmt_ctx.header_size, SEEK_SET); // advance pointer beyond wave header size
+	}
 
-		if(dolbye == SMPTE_DDE_ID)
-			file_info.stream_type = DOLBYE;
+	if (prealloc_mode)
+	{
+		if ((status = map_output(&fmt_ctx, fmt_ctx.header_size + predicted_bytes)) > 0)
+		{
+			make_wave_header(fmt_ctx.out_map, fmt_ctx.wave_layout, predicted_bytes, fmt_ctx.wave_bps, fmt_ctx.wave_frate);
+			fmt_ctx.out_map_pos = fmt_ctx.header_size;
+		}
+		else if (status < 0)
+		{
+			exit_on_error(&file_info);
+		}
 		else
 		{
-			fread(iobuf, 2, 1, file_info.ac3file);
+			fprintf(stderr, "Warning: unable to preallocate and map the output, writing it instead\n");
+		}
+	}
 
-			if(*iobuf == SYNC_WD || *iobuf == SYNC_WD_REV)
-				file_info.stream_type = AC3;
-            else if (((bytereverse(*iobuf) & 0xffff)) == AC4SIMPLE_SYNC_WD0)
-            {
-                file_info.stream_type = AC4;	// without CRC
-                file_info.b_ac4_with_crc = 0;
-            }
-            else if (((bytereverse(*iobuf) & 0xffff)) == AC4SIMPLE_SYNC_WD1)
-            {
-                file_info.stream_type = AC4;	// with CRC
-                file_info.b_ac4_with_crc = 1;
-            }
-			else
-				file_info.stream_type = -1;
+	if (!(zerocopy_mode && format_zerocopy(&fmt_ctx, pipeline_mode)))
+	{
+		if (zerocopy_mode)
+		{
+			fprintf(stderr, "Warning: zero-copy mode needs a mappable AC-3 or E-AC-3 input, copying instead\n");
+		}
 
-			fseek(file_info.ac3file, -2, SEEK_CUR);
+		nbursts = pipeline_mode ? PIPE_NUM_BUFS : 1;
+		if ((bursts = (Burst_Buf *)calloc(nbursts, sizeof(Burst_Buf))) == NULL)
+		{
+			error_msg("Unable to allocate burst buffers", FATAL);
 		}
 
-		if(file_info.stream_type == DOLBYE)
-		{	
-			wave_bps = 24;
-			wave_frate = 48000;
+		run_stages(&fmt_ctx, &format_stages, bursts, sizeof(Burst_Buf), nbursts, pipeline_mode, fmt_ctx.verbose, file_info.rt);
 
-			if(fread((void *)(&Eiobuf[0]), sizeof(int), file_info.dolbye_frame_sz + PRMBLSIZE, file_info.ac3file) 
-				!= (file_info.dolbye_frame_sz + PRMBLSIZE))
+		free(bursts);
+	}
+	if (live_opt)
+	{
+		/* a ring consumer sees how the run ended, the last RTP packet is sent, there is no header to write */
+		if (shm_name)
+		{
+			close_ring(&fmt_ctx, file_info.err.code != ERR_NO_ERROR);
+		}
+		else
+		{
+			close_rtp(&fmt_ctx, file_info.err.code != ERR_NO_ERROR);
+		}
+		exit_on_error(&file_info);
+		fclose (file_info.ac3file);
+		show_crc_stats(&file_info.crc);
+		show_resync_stats(&fmt_ctx);
+		show_gap_stats(&fmt_ctx);
+		show_playlist_stats(&fmt_ctx);
+		close_playlist(&fmt_ctx);
+		show_ring_stats(&fmt_ctx);
+		show_rtp_stats(&fmt_ctx);
+		if (rt_mode)
+		{
+			show_rt_stats(&rt);
+		}
+		exit (0);
+	}
+	/* a failed run leaves the output without its header */
+	exit_on_error(&file_info);
+	if ((file_info.smpte_ftype == APPEND) && !finish_append(&fmt_ctx))
+	{
+		exit_on_error(&file_info);
+	}
+	wave_bps = fmt_ctx.wave_bps;
+	wave_frate = fmt_ctx.wave_frate;
+
+	// Write wave header to output file
+
+	if (fmt_ctx.out_map)
+	{
+		if (fmt_ctx.out_map_pos != fmt_ctx.header_size + predicted_bytes)
+		{
+			/* input changed under us, trim to what was written */
+			make_wave_header(fmt_ctx.out_map, fmt_ctx.wave_layout, fmt_ctx.out_map_pos - fmt_ctx.header_size, wave_bps, wave_frate);
+		}
+		if (!unmap_output(&fmt_ctx))
+		{
+			exit_on_error(&file_info);
+		}
+	}
+	else
+	{
+		fseek64(file_info.smpte_file, 0, SEEK_END);
+		file_length = ftell64(file_info.smpte_file);
+
+		/* only if the input grew past the estimate, or a plain RIFF output was appended to */
+		if (!wave_header_fits(fmt_ctx.wave_layout, file_length - fmt_ctx.header_size))
+		{
+			if (!promote_to_rf64(&fmt_ctx, file_length - fmt_ctx.header_size))
 			{
-				error_msg("File read error", FATAL);
+				exit_on_error(&file_info);
 			}
-			else
-			{					
-				/* verify that the sync word is correct */
-				switch(file_info.bit_depth)
-				{
-					case BITD16:
-						if(((Eiobuf[4] & 0xFFFE0000) >> 16) != DDE_SYNC16)
-						{
-							error_msg("Invalid Dolby E syncword.", WARNING);
-						}
-						break;
-					case BITD20:
-						if(((Eiobuf[4] & 0xFFFFE000) >> 12) != DDE_SYNC20)
-						{
-							error_msg("Invalid Dolby E syncword.", WARNING);
-						}
-						break;
-					case BITD24:
-						if(((Eiobuf[4] & 0xFFFFFE00) >> 8) != DDE_SYNC24)
-						{
-							error_msg("Invalid Dolby E syncword.", WARNING);
-						}
-						break;
-					default:
-						error_msg("Invalid preamble syncword 2.", FATAL);
-						break;
-				}
+			file_length += WAVE_HEADER_SIZE_RF64 - WAVE_HEADER_SIZE;
+		}
+		rewind(file_info.smpte_file);
 
-				//get frame rate
-				dolbye_fps = get_dde_frame_rate(&Eiobuf[0], file_info.bit_depth);					
-				switch(dolbye_fps)
-				{
-					case FPS_2398:
-						burst_size = DDE_BURST_SIZE_2398FPS;							
-						break;
-					case FPS_24:
-						burst_size = DDE_BURST_SIZE_24FPS;							
-						break;
-					case FPS_25:
-						burst_size = DDE_BURST_SIZE_25FPS;							
-						break;
-					case FPS_2997:
-						burst_size = DDE_BURST_SIZE_2997FPS[dde_frame_ctr % DDE_2997_REPRATE];							
-						break;
-					case FPS_30:
-						burst_size = DDE_BURST_SIZE_30FPS;							
-						break;
-				}					
-			}			
-
-			memset((void *)(&Eiobuf[file_info.dolbye_frame_sz + PRMBLSIZE]), 0,
-				(burst_size - (file_info.dolbye_frame_sz + PRMBLSIZE))*sizeof(int));
-
-			outbyteptr = (char *)Eiobuf;
-
-			for (i=0; i<burst_size; i++)
-			{ 
-				outbufval = Eiobuf[i];
-
-				*outbyteptr++ = (char)(outbufval >> 8);
-				*outbyteptr++ = (char)(outbufval >> 16);
-				*outbyteptr++ = (char)(outbufval >> 24);
-			}
+		make_wave_header(wave_header, fmt_ctx.wave_layout, file_length - fmt_ctx.header_size, wave_bps, wave_frate);
+		fwrite(wave_header, fmt_ctx.header_size, 1, file_info.smpte_file);
+	}
 
-			if (fwrite ((void *)Eiobuf, 3, burst_size, file_info.smpte_file) != (size_t) burst_size)
+	if (fmt_ctx.tc_index)
+	{
+		if (fmt_ctx.have_time_ref)
+		{
+			fseek64(file_info.smpte_file, 0, SEEK_END);
+			if (!write_bext(&fmt_ctx, ftell64(file_info.smpte_file) - fmt_ctx.header_size))
 			{
-				snprintf (errstr, ERR_STR_BUF_LEN, "decode: Unable to write to output file, %s.", file_info.smpte_fname);
-				error_msg (errstr, FATAL);
+				exit_on_error(&file_info);
 			}
+		}
+		if (fclose(fmt_ctx.tc_index))
+		{
+			error_msg("decode: Unable to close timecode index", FATAL);
+		}
+	}
+
+/*	Close i/o files */
+
+	if (fclose (file_info.smpte_file))
+	{
+		snprintf (errstr, ERR_STR_BUF_LEN, "decode: Unable to close output file, %s.", file_info.smpte_fname);
+		error_msg (errstr, FATAL);
+	}
+
+	if (fclose (file_info.ac3file))
+	{
+		snprintf(errstr, ERR_STR_BUF_LEN, "decode: Unable to close input file, %s.", file_info.ac3fname);
+		error_msg (errstr, FATAL);
+	}
 
-			dde_frame_ctr++;
+	show_crc_stats(&file_info.crc);
+	show_resync_stats(&fmt_ctx);
+	show_gap_stats(&fmt_ctx);
+	show_tc_stats(&fmt_ctx);
+	show_playlist_stats(&fmt_ctx);
+	close_playlist(&fmt_ctx);
+	if (rt_mode)
+	{
+		show_rt_stats(&rt);
+	}
+
+	if (cache_mode)
+	{
+		cache_store(&cache, file_info.smpte_fname);
+		show_cache_stats(&cache, verbose, 0);
+	}
+
+	return(0);
+} //  main
+
+/* Report a cache lookup and the running hit and miss counts */
+void show_cache_stats(Cache_Info *cache,	/* IN: cache after lookup */
+					  int verbose,			/* IN: print anything at all */
+					  int hit)				/* IN: the output came from the cache */
+{
+	if (verbose)
+	{
+		printf("Cache %s: %ld hits, %ld misses\n", hit ? "hit" : "miss", cache->hits, cache->misses);
+	}
+}		//		show_cache_stats()
+
+
+/* Format stage 1: find the next burst in the elementary stream and read its frames */
+int format_read_burst(void *context, /* IN/OUT: Format_Ctx */
+					  void *buffer)	 /* OUT: Burst_Buf to be filled */
+									 /* returns 1 if a burst was read, 0 at end of input */
+{
+	Format_Ctx *ctx = (Format_Ctx *)context;
+	Burst_Buf *burst = (Burst_Buf *)buffer;
+	File_Info *file_info = ctx->file_info;
+	SLC_INFO *sinfo = &ctx->sinfo;
+	uint16_t *iobuf = (uint16_t *)burst->data;			/* Holds 1 packed AC-3 frame = 8 AES blocks */
+	uint32_t *Eiobuf = burst->data;						/* Holds 1 packed Dolby E frame */
+	unsigned char *ac4_work_buffer = (unsigned char *)burst->data;	/* AC-4 work buffer */
+	uint16_t *p_buf;
+	int i;
+	long numbytes;
+	short status;
+	int dolbye;
+	int16_t dolbye_fps;	 			/* Dolby E fps */
+	int64_t numframes;				/* derived from file_length */
+	double percent = 0.0;			/* 1 frame percent of file */
+	int numblocks;					/* accumulated # of blocks per 1536 AES frames */
+	int lastnumblocks = 0;			/* to catch changes in numblocks */
+	int frameset;					/* indicator of complete frame set */
+	int keep;						/* frame passed its CRC or is not checked */
+	int resync_status;
+	int64_t burst_pos = 0;			/* input position of the burst, with -resync */
+	int64_t frame_pos = 0;
+	SLC_INFO look_sinfo;
+	unsigned int accumwords;
+	char errstr[ERR_STR_BUF_LEN];	/* string for error message */
+
+	if (ctx->done)
+	{
+		return 0;
+	}
+
+	frameset = 0;
+	numblocks = 0;
+	accumwords = 0;
+	burst->nframes = 0;
+	burst->pause = 0;
+
+	/* time missing from the input, or lost to damage, is written before what follows it */
+	if (ctx->pause_bursts > 0)
+	{
+		ctx->pause_bursts--;
+		fill_pause_burst(ctx, burst);
+		ctx->out_samples += burst->burst_size / 2;
+		return 1;
+	}
+
+	if (ctx->resync)
+	{
+		/* DD/DD+ frames are checked one by one as the frame set is read */
+		resync_status = (ctx->resync_family == RESYNC_DD) ? RESYNC_OK : resync_frame(ctx);
+		if ((resync_status == RESYNC_END) && (ctx->resync_family == RESYNC_ANY))
+		{
+			return format_error(ctx, ERR_BAD_INPUT, "input file type not recognized");
+		}
+		if (resync_status == RESYNC_END)
+		{
+			ctx->done = 1;
+			return 0;
 		}
-		else if(file_info.stream_type == AC3)//DD or DD+
+		if (resync_status == RESYNC_MOVED)
 		{
-			wave_bps = 16;
+			return format_read_burst(ctx, buffer);
+		}
+		burst_pos = ftell64(file_info->ac3file);
+	}
 
-			/* Write preamble */
-			iobuf[0] = (int16_t) 0x0f872;						/* IEC958_SYNCA */
-			iobuf[1] = (int16_t) 0x04e1f;						/* IEC958_SYNCB */
+	dolbye = parse_preamble(file_info);
 
-			/* Clear rest of buffer */
-			for (i = 3; i < BUFWORDSIZE; i++)
+	if(dolbye && (dolbye != SMPTE_DDE_ID))
+	{ 
+		ctx->done = checkstatus(ctx, dolbye);
+		if(ctx->done){ return 0; }
+	}
+
+	if(dolbye == SMPTE_DDE_ID)
+		file_info->stream_type = DOLBYE;
+	else
+	{
+		fread(iobuf, 2, 1, file_info->ac3file);
+
+		/* a DD/DD+ stream can start with a timecode frame */
+		if(*iobuf == SYNC_WD || *iobuf == SYNC_WD_REV || *iobuf == TC_SYNC_WD || *iobuf == TC_SYNC_WD_REV)
+			file_info->stream_type = AC3;
+		else if (((bytereverse(*iobuf) & 0xffff)) == AC4SIMPLE_SYNC_WD0)
+		{
+			file_info->stream_type = AC4;	// without CRC
+			file_info->b_ac4_with_crc = 0;
+		}
+		else if (((bytereverse(*iobuf) & 0xffff)) == AC4SIMPLE_SYNC_WD1)
+		{
+			file_info->stream_type = AC4;	// with CRC
+			file_info->b_ac4_with_crc = 1;
+		}
+		else
+			file_info->stream_type = -1;
+
+		fseek64(file_info->ac3file, -2, SEEK_CUR);
+	}
+
+	burst->stream_type = file_info->stream_type;
+
+	if(file_info->stream_type == DOLBYE)
+	{	
+		ctx->wave_bps = 24;
+		ctx->wave_frate = 48000;
+
+		if(fread((void *)(&Eiobuf[0]), sizeof(int), file_info->dolbye_frame_sz + PRMBLSIZE, file_info->ac3file) 
+			!= (file_info->dolbye_frame_sz + PRMBLSIZE))
+		{
+			return format_error(ctx, ERR_READ_ERROR, "File read error");
+		}
+		else
+		{					
+			/* verify that the sync word is correct */
+			switch(file_info->bit_depth)
 			{
-				iobuf[i] = 0;
+				case BITD16:
+					if(((Eiobuf[4] & 0xFFFE0000) >> 16) != DDE_SYNC16)
+					{
+						error_msg("Invalid Dolby E syncword.", WARNING);
+					}
+					break;
+				case BITD20:
+					if(((Eiobuf[4] & 0xFFFFE000) >> 12) != DDE_SYNC20)
+					{
+						error_msg("Invalid Dolby E syncword.", WARNING);
+					}
+					break;
+				case BITD24:
+					if(((Eiobuf[4] & 0xFFFFFE00) >> 8) != DDE_SYNC24)
+					{
+						error_msg("Invalid Dolby E syncword.", WARNING);
+					}
+					break;
+				default:
+					return format_error(ctx, ERR_SYNCH_ERROR, "Invalid preamble syncword 2.");
 			}
 
-			accumwords += PRMBLSIZE;
+			//get frame rate
+			dolbye_fps = get_dde_frame_rate(&Eiobuf[0], file_info->bit_depth);					
+			if ((i = dde_burst_size(ctx, dolbye_fps)) < 0)
+			{
+				/* the cadence of the output being appended to did not match */
+				ctx->done = 1;
+				return 0;
+			}
+			if (i != 0)
+			{
+				ctx->burst_size = i;
+				ctx->dde_fps = dolbye_fps;
+			}
+		}			
 
-			/* Set the buffer pointer */
-			p_buf = iobuf;
-			p_buf += PRMBLSIZE;
+		burst->burst_size = ctx->burst_size;
+		burst->skipped = 0;
+		burst->payload_words = file_info->dolbye_frame_sz + PRMBLSIZE;
 
-			/*****************************************************/
-			/* Read frames until we accumulate a full frameset   */
-			/*****************************************************/
-			while(!frameset && !done)
+		ctx->dde_frame_ctr++;
+	}
+	else if(file_info->stream_type == AC3)//DD or DD+
+	{
+		ctx->wave_bps = 16;
+
+		/* Clear rest of buffer, the preamble is written by the packer */
+		for (i = 3; i < BUFWORDSIZE; i++)
+		{
+			iobuf[i] = 0;
+		}
+
+		accumwords += PRMBLSIZE;
+
+		/* Set the buffer pointer */
+		p_buf = iobuf;
+		p_buf += PRMBLSIZE;
+
+		/*****************************************************/
+		/* Read frames until we accumulate a full frameset   */
+		/*****************************************************/
+		while(!frameset && !ctx->done)
+		{
+			
+			/* get the whole frame (and skip the timecode) */
+
+			resync_status = RESYNC_OK;
+			if (ctx->resync)
 			{
-				
-				/* get the whole frame (and skip the timecode) */
+				frame_pos = ftell64(file_info->ac3file);
+				resync_status = resync_frame(ctx);
+			}
+			if (resync_status == RESYNC_OK)
+			{
+				status = get_timeslice(2, p_buf, file_info->ac3file, &numbytes, sinfo, 0, accumwords);
+				if (status && (status != ERR_EOF) && ctx->resync)
+				{
+					/* passed the search, but not the parser */
+					memset(p_buf, 0, 4*sizeof(short));
+					resync_status = resync_input(ctx, frame_pos) ? RESYNC_MOVED : RESYNC_END;
+				}
+			}
+			if (resync_status != RESYNC_OK)
+			{
+				ctx->done = (resync_status == RESYNC_END);
+				if (numblocks > 0)
+				{
+					/* write out the partial frame set, the pauses follow it */
+					ctx->flushbuf = ctx->done;
+					break;
+				}
+				return (ctx->done ? 0 : format_read_burst(ctx, buffer));
+			}
+
+			ctx->wave_frate = fratetab[sinfo->fscod];
 
-				status = get_timeslice(2, p_buf, file_info.ac3file, &numbytes, &sinfo, 0, accumwords);
+			if(numblocks == 0){ lastnumblocks = sinfo->numblks; }
+
+			/* if blocks per frame changes at non-frameset boundary */
+			if(sinfo->numblks != lastnumblocks)
+			{
+				// zero out what was just added to iobuf
+				memset(p_buf, 0, sinfo->framesize*sizeof(short));	
+
+				// rewind file ptr to beginning of frame with new bpf			
+				fseek64(file_info->ac3file, -sinfo->framesize * sizeof(short), SEEK_CUR);	
+
+				break; //jump to write out partial frame set
+			}
 
-				wave_frate = fratetab[sinfo.fscod];
 
-				if(numblocks == 0){ lastnumblocks = sinfo.numblks; }
+			if (sinfo->is_ddp == 0) 
+			{
+				file_info->stream_type = EAC3;
+				ctx->burst_size = DD_BURST_SIZE;
+			}
+			else
+			{
+				ctx->burst_size = DD_PLUS_BURST_SIZE;
+			}
+			burst->burst_info_ddp = sinfo->is_ddp;
 
-				/* if blocks per frame changes at non-frameset boundary */
-				if(sinfo.numblks != lastnumblocks)
+			if(status) 
+			{
+				ctx->done = checkstatus(ctx, status);
+				if((numblocks > 0) && (status == ERR_EOF)){ ctx->flushbuf = 1; }
+			}
+			else 
+			{
+				if (sinfo->has_tc)
 				{
-					// zero out what was just added to iobuf
-					memset(p_buf, 0, sinfo.framesize*sizeof(short));	
+					/* timecode in front of the first frame, later ones are met by the look ahead */
+					if (ctx->fill_gaps)
+					{
+						gap_check_tc(ctx, sinfo->tc);
+					}
+					if (ctx->tc_index)
+					{
+						index_timecode(ctx, sinfo->tc, numblocks);
+					}
+				}
+				ctx->nwords = sinfo->framesize;
+				ctx->framesizecod = sinfo->frmsizecod;		/* size of frame */
+				ctx->sampratecod = sinfo->fscod;			/* sample rate */
 
-					// rewind file ptr to beginning of frame with new bpf			
-					fseek(file_info.ac3file, -sinfo.framesize * sizeof(short), SEEK_CUR);	
+				/* a dropped frame still counts towards the frameset, its time is left silent */
+				keep = (file_info->crc.policy == CRC_OFF) || crc_verify(&file_info->crc, (uint8_t *)p_buf, sinfo->framesize * 2);
+				if (file_info->crc.aborted)
+				{
+					ctx->done = 1;
+					return crc_abort_error(&file_info->crc, &file_info->err, ftell64(file_info->ac3file) - sinfo->framesize * 2);
+				}
+				
+				/* Remember the frame so the packer can byte reverse it */
+				if(burst->nframes >= MAX_BURST_FRAMES)
+				{
+					return format_error(ctx, ERR_LIMIT, "decode: too many frames in frameset");
+				}
+				if(keep)
+				{
+					burst->frames[burst->nframes].offset = (int)(p_buf - iobuf);
+					burst->frames[burst->nframes].nwords = ctx->nwords;
+					burst->frames[burst->nframes].byte_rev = sinfo->byte_rev;
+					burst->nframes++;
+				}
+				
+				numframes = ctx->file_length / (2 * ctx->nwords);
+				percent = 100. * (1. / (double) numframes);
 
-					break; //jump to write out partial frame set
+				if (ctx->verbose)
+				{
+					printf ("\nReformatting frame %ld     (%d%% done)\n", ctx->framecount,
+						(int)(ctx->framecount * percent));
+
+					if(ctx->framecount == 0)
+					{
+						if(sinfo->is_ddp == 0)
+						{
+							printf("Dolby Digital frames detected\nBlocks per frame: 6\n");
+							printf("bsid: %d\n", sinfo->bsid);
+						}
+						else
+						{
+							printf("Dolby Digital Plus frames detected\nBlocks per frame: %d\n", sinfo->numblks);
+							printf("bsid: %d\n", sinfo->bsid);
+						}
+					}
 				}
 
+				/* increment # of blocks received on independent or transcoded frames*/
+				if(((sinfo->strmtyp == 0) || (sinfo->strmtyp == 2)) 
+					&& (sinfo->substreamid == 0))
+				{					
+					numblocks += sinfo->numblks;
+					ctx->tc_elapsed += sinfo->numblks * 256;
+				}
 
-				if (sinfo.is_ddp == 0) 
+				if(keep)
 				{
-					file_info.stream_type = EAC3;
-					iobuf[2] = (int16_t)(SMPTE_DD_ID | (nStreamNum << 13)); /* AC3BURSTINFO */
-					burst_size = DD_BURST_SIZE;
+					p_buf += ctx->nwords;
+					accumwords += ctx->nwords;
 				}
 				else
 				{
-					iobuf[2] = (int16_t)(SMPTE_DD_PLUS_ID | (nStreamNum << 13)); /* EC3BURSTINFO */			    
-					burst_size = DD_PLUS_BURST_SIZE;
-				}		      
-				if(status) 
-				{
-					done = checkstatus(status);
-					if(numblocks > 0){ flushbuf = 1; }
+					memset(p_buf, 0, ctx->nwords * sizeof(short));
 				}
-				else 
+				
+				if(ctx->nwords + PRMBLSIZE > ctx->burst_size - 4)
 				{
-					
+					return format_error(ctx, ERR_LIMIT, "decode: frame size too large for SMPTE format");
+				}
 
-					nwords = sinfo.framesize;
-					framesizecod = sinfo.frmsizecod;		/* size of frame */
-					sampratecod = sinfo.fscod;				/* sample rate */
-					
-					/* Byte Reverse */
-					if(sinfo.byte_rev)
+				if((unsigned int) accumwords > (unsigned int) ctx->burst_size - 4)
+				{					
+					return format_error(ctx, ERR_LIMIT, "decode: Accumulation of frameset data exceeds 1.536Mbps data limit");
+				}
+
+				ctx->framecount++;
+
+				//look ahead at next frame *required to support substreams*
+				look_sinfo = *sinfo;
+				frame_pos = ftell64(file_info->ac3file);
+				status = get_timeslice(2, p_buf, file_info->ac3file, &numbytes, sinfo, 1, 0);
+				if(status && (status != ERR_EOF) && ctx->resync)
+				{
+					/* a damaged next frame is dealt with when it is read */
+					*sinfo = look_sinfo;
+					memset(p_buf, 0, 4*sizeof(short));
+					fseek64(file_info->ac3file, frame_pos, SEEK_SET);
+				}
+				else
+				{
+					if(status)
+					{
+						ctx->done = checkstatus(ctx, status); // check to see if file is eof or an error occured
+						if((numblocks > 0) && (status == ERR_EOF)){ ctx->flushbuf = 1; }
+					}
+					memset(p_buf, 0, 4*sizeof(short)); // zero out 4 info words written to buffer							
+					fseek64(file_info->ac3file, -8, SEEK_CUR); // rewind file pointer by look ahead amount
+					if (!status && sinfo->has_tc)
 					{
-						for(i = 0; i < nwords; i++)
+						/* the time the next frame starts at, pause bursts go in after this burst */
+						if (ctx->fill_gaps)
+						{
+							gap_check_tc(ctx, sinfo->tc);
+						}
+						if (ctx->tc_index)
 						{
-							p_buf[i] = bytereverse(p_buf[i]);
+							index_timecode(ctx, sinfo->tc, numblocks);
 						}
 					}
-					
-					numframes = file_length / (2 * nwords);
-					percent = 100. * (1. / (double) numframes);
+				}
+
+				if((numblocks == 6) && (((sinfo->strmtyp == 0) || (sinfo->strmtyp == 2)) 
+					&& (sinfo->substreamid == 0)))
+				{ 
+					frameset = 1; 
+				}
+				
+			}
+
+		}
+
+		if(ctx->done && !ctx->flushbuf)
+		{
+			return 0;
+		}
+
+		burst->burst_size = ctx->burst_size;
+		burst->skipped = (burst->nframes == 0);
+		if (ctx->resync && !frameset)
+		{
+			/* a partial frame set does not tell how long a burst is */
+			burst_pos = -1;
+		}
+		burst->accumwords = accumwords;
+		burst->is_ddp = sinfo->is_ddp;
+		if (ctx->altformat && burst->is_ddp)
+		{
+			/* found here rather than by the packer, which may run on another thread */
+			return format_error(ctx, ERR_BAD_INPUT, "decode: Cannot use alternate packing with DD+ inputs.");
+		}
+		burst->nwords = ctx->nwords;
+		burst->framesizecod = ctx->framesizecod;
+		burst->sampratecod = ctx->sampratecod;
+	} /* if ac3 or eac3 */
+	else if (file_info->stream_type == AC4)
+	{
+		/* temp buf for bsreader */
+		unsigned char buf[1024];
+		AC4_BITREADER bs = { buf, 1024, 0 };
+		size_t nbytes;
+		int wait_frames, fs_idx, fr_idx, seq_cnt;
+		int read_offset;
+		int framesiz = 0;
+		int raw_framesiz = 0;
+
+		size_t rdlen;
+
+		ctx->wave_bps = 16;
+		ctx->wave_frate = 48000; /* fixed for now */
+
+		frame_pos = ftell64(file_info->ac3file);
+
+		/* determine the AC4 frame size (in bytes) */
+		rdlen = fread(ac4_work_buffer, 1, 4, file_info->ac3file);
+
+		/* this byte swapping is somewhat of a hack; proper way is ntohs() and ntohl()? */
+		if (ac4_work_buffer[2] == 0xFF && ac4_work_buffer[3] == 0xFF) {
+			/* extended length field! extend current 16 bit field by an additional 24 bit */
+			rdlen += fread(&ac4_work_buffer[4], 1, 3, file_info->ac3file);
+#ifdef LITEND
+
+			framesiz = (int32_t)((((uint32_t)ac4_work_buffer[4]) << 16) | (((uint32_t)ac4_work_buffer[5]) << 8) | ((uint32_t)ac4_work_buffer[6]));
+#else
+			framesiz = (int32_t)((((uint32_t)ac4_work_buffer[6]) << 16) | (((uint32_t)ac4_work_buffer[5]) << 8) | ((uint32_t)ac4_work_buffer[4]));
+#endif
+			raw_framesiz = framesiz;
+			framesiz += 7;	// +2 for sync, +5 for the now (2+3)-sized len field
+		}
+		else {
+#ifdef LITEND
+			framesiz = (int32_t)((((uint32_t)ac4_work_buffer[2]) << 8) | ((uint32_t)ac4_work_buffer[3]));
+#else
+			framesiz = (int32_t)((((uint32_t)ac4_work_buffer[3]) << 8) | ((uint32_t)ac4_work_buffer[2]));
+#endif
+			raw_framesiz = framesiz;
+			framesiz += 4; // +4 for sync and framelen
+		}
+		if (file_info->b_ac4_with_crc) framesiz += 2;	// +2 for CRC, in case it's the CRC variant
+
+		if (framesiz > sizeof(burst->data)) {
+			// currently buffer is static. until it's malloced, check for buffer overflows!
+			return format_error(ctx, ERR_LIMIT, "AC-4 frame size too big for buffer");
+		}
+
+		nbytes = raw_framesiz;
+		/* read a max of 1024 just for bitstream parsing of the frame rate */
+		if (nbytes > 1024) nbytes = 1024;
+
+		/* read into bs buf */
+		if (nbytes != fread(buf, 1, nbytes, file_info->ac3file))
+		{
+			return format_error(ctx, ERR_READ_ERROR, "File read error");
+		}
+
+		bs.bytes = nbytes;
+
+		/* bs version */
+		ac4_bread(&bs, 2);
+		/* seq counter */
+		seq_cnt = ac4_bread(&bs, 10);
+		/* wait frames */
+		if (ac4_bread(&bs, 1))
+		{
+			wait_frames = ac4_bread(&bs, 3);
+			if (wait_frames > 0)
+			{
+				/* br code */
+				ac4_bread(&bs, 2);
+			}
+		}
+		/* sample rate */
+		fs_idx = ac4_bread(&bs, 1);
+		if (!(fs_idx))
+		{
+			if (ctx->resync)
+			{
+				return resync_read_burst(ctx, buffer, frame_pos);
+			}
+			return format_error(ctx, ERR_INV_SAMP_RATE, "AC-4 sample rate must be 48 kHz");
+		}
+		/* frame rate */
+		fr_idx = ac4_bread(&bs, 4);
+
+		rdlen += nbytes;
+
+		read_offset = rdlen;
+
+		if (ctx->fill_gaps && ((i = gap_check_ac4(ctx, seq_cnt)) > 0))
+		{
+			/* the missing frames' time goes in ahead of this frame */
+			ctx->pause_bursts += i;
+			ctx->ac4_fr_idx = fr_idx;
+			fseek64(file_info->ac3file, frame_pos, SEEK_SET);
+			return format_read_burst(ctx, buffer);
+		}
+
+		/* return file pointer to frame start */
+		fseek64(file_info->ac3file, -read_offset, SEEK_CUR);
+
+		/* clear the SMPTE burst buffer */
+		memset(ac4_work_buffer, 0, sizeof(burst->data));
+
+		/* read in the entire AC4 frame (offset 4 SMPTE preamble words - 8 bytes) */
+		rdlen = fread(&ac4_work_buffer[8], 1, framesiz, file_info->ac3file);
+		if (rdlen != framesiz) {
+			return format_error(ctx, ERR_READ_ERROR, "File read error");
+		}
+
+		/* a dropped frame keeps its burst period, as a pause burst */
+		burst->skipped = 0;
+		if (file_info->b_ac4_with_crc && (file_info->crc.policy != CRC_OFF)
+			&& !crc_verify(&file_info->crc, &ac4_work_buffer[8], framesiz))
+		{
+			burst->skipped = 1;
+		}
+		if (file_info->crc.aborted)
+		{
+			ctx->done = 1;
+			return crc_abort_error(&file_info->crc, &file_info->err, frame_pos);
+		}
+
+		if ((ctx->burst_size = ac4_burst_size(ctx, fr_idx)) < 0)
+		{
+			/* the cadence of the output being appended to did not match */
+			ctx->done = 1;
+			return 0;
+		}
+		if (ctx->burst_size == 0)
+		{
+			if (ctx->resync)
+			{
+				return resync_read_burst(ctx, buffer, frame_pos);
+			}
+			snprintf(errstr, ERR_STR_BUF_LEN, "Unsupported AC-4 frame rate (%i)", fr_idx);
+			return format_error(ctx, ERR_INV_DATA_RATE, errstr);
+		}
+		ctx->AC4_AES_burst_count++;
+
+		/* safety check parameters..
+		* - burst size bigger than buffer size? In that case we'd read raw memory
+		* - burst size smaller than the AC-4 frame plus SMPTE header? In that case we'd truncate the data!
+		*/
+		if (ctx->burst_size * 2 > sizeof(burst->data)) 
+		{
+			return format_error(ctx, ERR_LIMIT, "AC-4 frame size too big for buffer");
+		}
+		if (ctx->burst_size * 2 < framesiz + 4)
+		{
+			return format_error(ctx, ERR_LIMIT, "AC-4 frame size too big for buffer");
+		}
+		if (get_ac4_data_type_dependent(ctx->burst_size, fr_idx) < 0)
+		{
+			return format_error(ctx, ERR_INV_DATA_RATE, "Unrecognized AC-4 burst size. Failed to create preamble C");
+		}
+
+		burst->burst_size = ctx->burst_size;
+		burst->framesiz = framesiz;
+		burst->fr_idx = fr_idx;
+		ctx->ac4_fr_idx = fr_idx;
+	}
+	else
+	{
+		return format_error(ctx, ERR_BAD_INPUT, "input file type not recognized");
+	}
+
+	if (ctx->resync && (burst_pos >= 0))
+	{
+		resync_burst_read(ctx, ftell64(file_info->ac3file) - burst_pos);
+	}
+
+	/* only the first appended burst continues a cadence */
+	ctx->resume_pending = 0;
+	ctx->out_samples += burst->burst_size / 2;
+
+	return 1;
+}		//		format_read_burst()
 
-					if (verbose)
-					{
-						printf ("\nReformatting frame %ld     (%d%% done)\n", framecount,
-							(int)(framecount * percent));
+/* Read stage of a format run, the burst carries the output format to the writer */
+int format_read_stage(void *context,	/* IN/OUT: Format_Ctx */
+					  void *buffer)		/* OUT: Burst_Buf to be filled */
+										/* returns as format_read_burst() does */
+{
+	Format_Ctx *ctx = (Format_Ctx *)context;
+	Burst_Buf *burst = (Burst_Buf *)buffer;
 
-						if(framecount == 0)
-						{
-							if(sinfo.is_ddp == 0)
-							{
-								printf("Dolby Digital frames detected\nBlocks per frame: 6\n");
-								printf("bsid: %d\n", sinfo.bsid);
-							}
-							else
-							{
-								printf("Dolby Digital Plus frames detected\nBlocks per frame: %d\n", sinfo.numblks);
-								printf("bsid: %d\n", sinfo.bsid);
-							}
-						}
-					}
+	/* a playlist reads its inputs one after another through the same reader */
+	if (!(ctx->playlist ? playlist_read_burst(ctx, buffer) : format_read_burst(ctx, buffer)))
+	{
+		return(0);
+	}
 
-					/* increment # of blocks received on independent or transcoded frames*/
-					if(((sinfo.strmtyp == 0) || (sinfo.strmtyp == 2)) 
-						&& (sinfo.substreamid == 0))
-					{					
-						numblocks += sinfo.numblks;
-					}
+	/* the context is the reader's, the writer may run on another thread */
+	burst->wave_bps = ctx->wave_bps;
+	burst->wave_frate = ctx->wave_frate;
 
-					p_buf += nwords;
-					accumwords += nwords;
-					
-					if(nwords + PRMBLSIZE > burst_size - 4)
-					{
-						error_msg ("decode: frame size too large for SMPTE format", FATAL);
-					}
+	return(1);
+}		//		format_read_stage()
 
-					if((unsigned int) accumwords > (unsigned int) burst_size - 4)
-					{					
-						snprintf(errstr, ERR_STR_BUF_LEN, "decode: Accumulation of frameset data exceeds 1.536Mbps data limit");
-						error_msg(errstr, FATAL);
-					}
+/* Burst size of the next Dolby E frame, 0 if the frame rate is not supported,
+   -1 if it does not continue the output being appended to */
+int dde_burst_size(Format_Ctx *ctx,		/* IN/OUT: format context, 29.97 fps cadence position */
+				   int dolbye_fps)		/* IN: frame_rate_code of the frame */
+{
+	switch(dolbye_fps)
+	{
+		case FPS_2398:
+			return DDE_BURST_SIZE_2398FPS;
+		case FPS_24:
+			return DDE_BURST_SIZE_24FPS;
+		case FPS_25:
+			return DDE_BURST_SIZE_25FPS;
+		case FPS_2997:
+			if (ctx->resume_pending && ((ctx->dde_frame_ctr = resume_cadence(ctx, DDE_BURST_SIZE_2997FPS)) < 0))
+			{
+				return -1;
+			}
+			return DDE_BURST_SIZE_2997FPS[ctx->dde_frame_ctr % DDE_2997_REPRATE];
+		case FPS_30:
+			return DDE_BURST_SIZE_30FPS;
+		default:
+			return 0;
+	}
+}		//		dde_burst_size()
 
-					framecount++;
+/* Burst size of the next AC-4 frame, 0 if the frame rate is not supported,
+   -1 if it does not continue the output being appended to */
+int ac4_burst_size(Format_Ctx *ctx,		/* IN/OUT: format context, fractional rate cadence position */
+				   int fr_idx)			/* IN: frame_rate_index from the AC-4 TOC */
+{
+	switch (fr_idx)
+	{
+	case AC4_FPS_2398:
+		return AC4_BURST_SIZE_2398FPS;
+	case AC4_FPS_24:
+		return AC4_BURST_SIZE_24FPS;
+	case AC4_FPS_25:
+		return AC4_BURST_SIZE_25FPS;
+	case AC4_FPS_2997:
+		if (ctx->resume_pending && ((ctx->AC4_AES_burst_count = resume_cadence(ctx, AC4_BURST_SIZE_2997FPS)) < 0))
+		{
+			return -1;
+		}
+		return AC4_BURST_SIZE_2997FPS[ctx->AC4_AES_burst_count % DDE_2997_REPRATE]; // same burst pattern as DE
+	case AC4_FPS_30:
+		return AC4_BURST_SIZE_30FPS;
+	case AC4_FPS_4795:
+		return AC4_BURST_SIZE_4795FPS;
+	case AC4_FPS_48:
+		return AC4_BURST_SIZE_48FPS;
+	case AC4_FPS_50:
+		return AC4_BURST_SIZE_50FPS;
+	case AC4_FPS_599:
+		if (ctx->resume_pending && ((ctx->AC4_AES_burst_count = resume_cadence(ctx, AC4_BURST_SIZE_599FPS)) < 0))
+		{
+			return -1;
+		}
+		return AC4_BURST_SIZE_599FPS[ctx->AC4_AES_burst_count % DDE_2997_REPRATE];
+	case AC4_FPS_60:
+		return AC4_BURST_SIZE_60FPS;
+	case AC4_FPS_100:
+		return AC4_BURST_SIZE_100FPS;
+	case AC4_FPS_11988:
+		if (ctx->resume_pending && ((ctx->AC4_AES_burst_count = resume_cadence(ctx, AC4_BURST_SIZE_11988FPS)) < 0))
+		{
+			return -1;
+		}
+		return AC4_BURST_SIZE_11988FPS[ctx->AC4_AES_burst_count % DDE_2997_REPRATE];
+	case AC4_FPS_120:
+		return AC4_BURST_SIZE_120FPS;
+	case AC4_FPS_2343:
+		return AC4_BURST_SIZE_2343FPS;
+	default:
+		return 0;
+	}
+}		//		ac4_burst_size()
 
-					//look ahead at next frame *required to support substreams*
-					status = get_timeslice(2, p_buf, file_info.ac3file, &numbytes, &sinfo, 1, 0);
-					if(status)
-					{
-						done = checkstatus(status); // check to see if file is eof or an error occured
-						if(numblocks > 0){ flushbuf = 1; }
-					}
-					memset(p_buf, 0, 4*sizeof(short)); // zero out 4 info words written to buffer							
-					fseek(file_info.ac3file, -8, SEEK_CUR); // rewind file pointer by look ahead amount
+/* Format stage 2: assemble the SMPTE 337 burst around the frames that were read */
+int format_pack_burst(void *context,	/* IN: Format_Ctx */
+					  void *buffer)		/* IN/OUT: Burst_Buf to be packed */
+										/* returns 1, bursts are checked by the reader */
+{
+	Format_Ctx *ctx = (Format_Ctx *)context;
+	Burst_Buf *burst = (Burst_Buf *)buffer;
+	uint16_t *iobuf = (uint16_t *)burst->data;
+	uint16_t *p_buf;
+	int i, j;
 
-					if((numblocks == 6) && (((sinfo.strmtyp == 0) || (sinfo.strmtyp == 2)) 
-						&& (sinfo.substreamid == 0)))
-					{ 
-						frameset = 1; 
-					}
-					
-				}
+	if(burst->pause)
+	{
+		/* filled in by the reader */
+		return 1;
+	}
 
-			}
+	if(burst->skipped)
+	{
+		/* nothing left to carry, a pause burst keeps the burst period and the receiver in sync */
+		memset(burst->data, 0, burst->burst_size * sizeof(uint16_t));
+		fill_pause_preamble(ctx, iobuf, burst->burst_size);
+		burst->out = (unsigned char *)burst->data;
+		burst->out_wordbytes = 2;
+		return 1;
+	}
 
-			if(!done || flushbuf) 
-			{
-				iobuf[3] = (uint16_t)((accumwords - PRMBLSIZE)*16);						/* length code */
-				
-				/*	Write AES frame to output file */
-				if (altformat)
-				{
-					if(sinfo.is_ddp)
-					{
-						error_msg("decode: Cannot use alternate packing with DD+ inputs.", FATAL);
-					}
+	if(burst->stream_type == DOLBYE)
+	{
+		uint32_t *Eiobuf = burst->data;
+		char *outbyteptr;
+		int outbufval;
 
-					size_23 = (int) (varratetab [sampratecod] [framesizecod]);
-					for (i = 0; i < (2048 - size_23 - PRMBLSIZE); i++)
-					{
-						altbuf [i] = 0;
-					}
-					j = 0;
-					for (i = (2048 - size_23 - PRMBLSIZE); i < (2048 - size_23 + nwords); i++)
-					{
-						altbuf [i] = iobuf [j];
-						j++;
-					}
-					for (i = (2048 - size_23 + nwords); i < burst_size; i++)
-					{
-						altbuf[i] = 0;
-					}
-					if (verbose)
-					{
-						printf ("Two thirds size = %d", size_23);
-					}
-					if (fwrite ((void *)altbuf, 2, burst_size, file_info.smpte_file) != (size_t) burst_size)
-					{
-						snprintf (errstr, ERR_STR_BUF_LEN, "decode: Unable to write to output file, %s.", file_info.smpte_fname);
-						error_msg (errstr, FATAL);
-					}
-				}
-				else
-				{
-					if (fwrite ((void *)iobuf, 2, burst_size, file_info.smpte_file) != (size_t) burst_size)
-					{
-						snprintf (errstr, ERR_STR_BUF_LEN, "decode: Unable to write to output file, %s.", file_info.smpte_fname);
-						error_msg (errstr, FATAL);
-					}
-				}
+		memset((void *)(&Eiobuf[burst->payload_words]), 0,
+			(burst->burst_size - burst->payload_words)*sizeof(int));
 
-			}
-		} /* if ac3 or eac3 */
-        else if (file_info.stream_type == AC4)
-        {
-            unsigned char tmp_byte;
-            /* temp buf for bsreader */
-            unsigned char buf[1024];
-            AC4_BITREADER bs = { buf, 1024, 0 };
-            size_t nbytes;
-            unsigned char *temp_p;
-            int bs_ver, seq_cnt, wait_frames, br_code, fs_idx, fr_idx;
-            int read_offset;
-
-            size_t rdlen, wrlen;
-
-            wave_bps = 16;
-            wave_frate = 48000; /* fixed for now */
-
-            /* determine the AC4 frame size (in bytes) */
-            rdlen = fread(ac4_work_buffer, 1, 4, file_info.ac3file);
-
-            /* this byte swapping is somewhat of a hack; proper way is ntohs() and ntohl()? */
-            if (ac4_work_buffer[2] == 0xFF && ac4_work_buffer[3] == 0xFF) {
-                /* extended length field! extend current 16 bit field by an additional 24 bit */
-                rdlen += fread(&ac4_work_buffer[4], 1, 3, file_info.ac3file);
-#ifdef LITEND
+		outbyteptr = (char *)Eiobuf;
 
-                framesiz = (int32_t)((((uint32_t)ac4_work_buffer[4]) << 16) | (((uint32_t)ac4_work_buffer[5]) << 8) | ((uint32_t)ac4_work_buffer[6]));
-#else
-                framesiz = (int32_t)((((uint32_t)ac4_work_buffer[6]) << 16) | (((uint32_t)ac4_work_buffer[5]) << 8) | ((uint32_t)ac4_work_buffer[4]));
-#endif
-                raw_framesiz = framesiz;
-                framesiz += 7;	// +2 for sync, +5 for the now (2+3)-sized len field
-            }
-            else {
-#ifdef LITEND
-                framesiz = (int32_t)((((uint32_t)ac4_work_buffer[2]) << 8) | ((uint32_t)ac4_work_buffer[3]));
-#else
-                framesiz = (int32_t)((((uint32_t)ac4_work_buffer[3]) << 8) | ((uint32_t)ac4_work_buffer[2]));
-#endif
-                raw_framesiz = framesiz;
-                framesiz += 4; // +4 for sync and framelen
-            }
-            if (file_info.b_ac4_with_crc) framesiz += 2;	// +2 for CRC, in case it's the CRC variant
+		for (i=0; i<burst->burst_size; i++)
+		{ 
+			outbufval = Eiobuf[i];
 
-            if (framesiz > sizeof(ac4_work_buffer)) {
-                // currently buffer is static. until it's malloced, check for buffer overflows!
-                error_msg("AC-4 frame size too big for buffer", FATAL);
-            }
+			*outbyteptr++ = (char)(outbufval >> 8);
+			*outbyteptr++ = (char)(outbufval >> 16);
+			*outbyteptr++ = (char)(outbufval >> 24);
+		}
 
-            nbytes = raw_framesiz;
-            /* read a max of 1024 just for bitstream parsing of the frame rate */
-            if (nbytes > 1024) nbytes = 1024;
+		burst->out = (unsigned char *)Eiobuf;
+		burst->out_wordbytes = 3;
+	}
+	else if(burst->stream_type == AC3)
+	{
+		int size_23;				/* 2/3 size of current frame */
 
-            /* read into bs buf */
-            if (nbytes != fread(buf, 1, nbytes, file_info.ac3file))
-            {
-                error_msg("File read error", FATAL);
-            }
+		/* Byte Reverse */
+		for(j = 0; j < burst->nframes; j++)
+		{
+			if(burst->frames[j].byte_rev)
+			{
+				p_buf = iobuf + burst->frames[j].offset;
+				for(i = 0; i < burst->frames[j].nwords; i++)
+				{
+					p_buf[i] = bytereverse(p_buf[i]);
+				}
+			}
+		}
 
-            bs.bytes = nbytes;
+		/* Write preamble */
+		iobuf[0] = (int16_t) 0x0f872;						/* IEC958_SYNCA */
+		iobuf[1] = (int16_t) 0x04e1f;						/* IEC958_SYNCB */
+		if (burst->burst_info_ddp == 0)
+		{
+			iobuf[2] = (int16_t)(SMPTE_DD_ID | (ctx->nStreamNum << 13)); /* AC3BURSTINFO */
+		}
+		else
+		{
+			iobuf[2] = (int16_t)(SMPTE_DD_PLUS_ID | (ctx->nStreamNum << 13)); /* EC3BURSTINFO */
+		}
+		iobuf[3] = (uint16_t)((burst->accumwords - PRMBLSIZE)*16);						/* length code */
 
-            /* bs version */
-            bs_ver = ac4_bread(&bs, 2);
-            /* seq counter */
-            seq_cnt = ac4_bread(&bs, 10);
-            /* wait frames */
-            if (ac4_bread(&bs, 1))
-            {
-                wait_frames = ac4_bread(&bs, 3);
-                if (wait_frames > 0)
-                {
-                    br_code = ac4_bread(&bs, 2);
-                }
-            }
-            /* sample rate */
-            fs_idx = ac4_bread(&bs, 1);
-            if (!(fs_idx))
-            {
-                error_msg("AC-4 sample rate must be 48 kHz", FATAL);
-            }
-            /* frame rate */
-            fr_idx = ac4_bread(&bs, 4);
+		/*	Write AES frame to output file */
+		if (ctx->altformat)
+		{
+			size_23 = (int) (varratetab [burst->sampratecod] [burst->framesizecod]);
+			for (i = 0; i < (2048 - size_23 - PRMBLSIZE); i++)
+			{
+				burst->altbuf [i] = 0;
+			}
+			j = 0;
+			for (i = (2048 - size_23 - PRMBLSIZE); i < (2048 - size_23 + burst->nwords); i++)
+			{
+				burst->altbuf [i] = iobuf [j];
+				j++;
+			}
+			for (i = (2048 - size_23 + burst->nwords); i < burst->burst_size; i++)
+			{
+				burst->altbuf[i] = 0;
+			}
+			if (ctx->verbose)
+			{
+				printf ("Two thirds size = %d", size_23);
+			}
+			burst->out = (unsigned char *)burst->altbuf;
+		}
+		else
+		{
+			burst->out = (unsigned char *)iobuf;
+		}
+		burst->out_wordbytes = 2;
+	}
+	else if(burst->stream_type == AC4)
+	{
+		unsigned char tmp_byte;
+		unsigned char *temp_p;
 
-            rdlen += nbytes;
+		p_buf = iobuf;
 
-            read_offset = rdlen;
+		/* write preambles */
+		*p_buf++ = PREAMBLE_A16;
+		*p_buf++ = PREAMBLE_B16;
+		*p_buf++ = get_ac4_preamble_c(burst->burst_size, burst->fr_idx); 	/* Preamble C - AC4SIMPLE data type */
+		*p_buf++ = (int16_t)(burst->framesiz * 8);	/* Preamble D - payload size in bits */
 
-            /* return file pointer to frame start */
-            fseek(file_info.ac3file, -read_offset, SEEK_CUR);
+		/* byte reverse the payload */
+		temp_p = (unsigned char *)p_buf;
 
-            /* clear temp bread buf */
-            memset(buf, 0, sizeof(buf));
+		for (i = 0; i < ((burst->framesiz / 2) + 1); i++)
+		{
+			tmp_byte = temp_p[(i * 2)];
+			temp_p[(i * 2)] = temp_p[(i * 2) + 1];
+			temp_p[(i * 2) + 1] = tmp_byte;
+		}
 
-            /* clear the SMPTE burst buffer */
-            memset(ac4_work_buffer, 0, sizeof(ac4_work_buffer));
+		burst->out = (unsigned char *)iobuf;
+		burst->out_wordbytes = 2;
+	}
 
-            /* read in the entire AC4 frame (offset 4 SMPTE preamble words - 8 bytes) */
-            rdlen = fread(&ac4_work_buffer[8], 1, framesiz, file_info.ac3file);
-            if (rdlen != framesiz) {
-                error_msg("File read error", FATAL);
-            }
+	return 1;
+}		//		format_pack_burst()
 
-            p_buf = (uint16_t *)ac4_work_buffer;
+/* Format stage 3: write the packed burst to the SMPTE file */
+int format_write_burst(void *context,	/* IN: Format_Ctx */
+					   void *buffer)	/* IN: packed Burst_Buf */
+										/* returns 0 if the burst could not be written */
+{
+	Format_Ctx *ctx = (Format_Ctx *)context;
+	Burst_Buf *burst = (Burst_Buf *)buffer;
 
-            /* write preambles */
-            *p_buf++ = PREAMBLE_A16;
-            *p_buf++ = PREAMBLE_B16;
+	size_t nbytes = (size_t)burst->out_wordbytes * burst->burst_size;
 
-            burst_size = 4096;	// default burst size.. in 16 bit pairs (= samples), i.e. size in bytes is *2 that value!
+	if (ctx->ring)
+	{
+		return ring_write_burst(ctx, burst);
+	}
+	if (ctx->rtp)
+	{
+		return rtp_write_burst(ctx, burst);
+	}
+	if (ctx->out_map)
+	{
+		if (ctx->out_map_pos + nbytes > ctx->out_map_len)
+		{
+			return run_error(&ctx->file_info->err, ERR_LIMIT, -1, -1, "decode: Output exceeds the predicted size");
+		}
+		memcpy(ctx->out_map + ctx->out_map_pos, burst->out, nbytes);
+		ctx->out_map_pos += nbytes;
+	}
+	else if (fwrite ((void *)burst->out, burst->out_wordbytes, burst->burst_size, ctx->file_info->smpte_file) != (size_t) burst->burst_size)
+	{
+		if (burst->stream_type == AC4)
+		{
+			return run_error(&ctx->file_info->err, ERR_WRITE_ERROR, -1, -1, "File write error");
+		}
+		return run_error(&ctx->file_info->err, ERR_WRITE_ERROR, -1, -1, "decode: Unable to write to output file, %s.", ctx->file_info->smpte_fname);
+	}
 
-            switch (fr_idx)
-            {
-            case AC4_FPS_2398:
-                burst_size = AC4_BURST_SIZE_2398FPS;
-                break;
-            case AC4_FPS_24:
-                burst_size = AC4_BURST_SIZE_24FPS;
-                break;
-            case AC4_FPS_25:
-                burst_size = AC4_BURST_SIZE_25FPS;
-                break;
-            case AC4_FPS_2997:
-                burst_size = AC4_BURST_SIZE_2997FPS[AC4_AES_burst_count % DDE_2997_REPRATE]; // same burst pattern as DE
-                break;
-            case AC4_FPS_30:
-                burst_size = AC4_BURST_SIZE_30FPS;
-                break;
-            case AC4_FPS_4795:
-                burst_size = AC4_BURST_SIZE_4795FPS;
-                break;
-            case AC4_FPS_48:
-                burst_size = AC4_BURST_SIZE_48FPS;
-                break;
-            case AC4_FPS_50:
-                burst_size = AC4_BURST_SIZE_50FPS;
-                break;
-            case AC4_FPS_599:
-                burst_size = AC4_BURST_SIZE_599FPS[AC4_AES_burst_count % DDE_2997_REPRATE];
-                break;
-            case AC4_FPS_60:
-                burst_size = AC4_BURST_SIZE_60FPS;
-                break;
-            case AC4_FPS_100:
-                burst_size = AC4_BURST_SIZE_100FPS;
-                break;
-            case AC4_FPS_11988:
-                burst_size = AC4_BURST_SIZE_11988FPS[AC4_AES_burst_count % DDE_2997_REPRATE];
-                break;
-            case AC4_FPS_120:
-                burst_size = AC4_BURST_SIZE_120FPS;
-                break;
-            case AC4_FPS_2343:
-                burst_size = AC4_BURST_SIZE_2343FPS;
-                break;
-            default:
-                snprintf(errstr, ERR_STR_BUF_LEN, "Unsupported AC-4 frame rate (%i)", fr_idx);
-                error_msg(errstr, FATAL);
-                break;
-            }
-            AC4_AES_burst_count++;
+	if (ctx->checkpoint)
+	{
+		return checkpoint_output(ctx, burst);
+	}
 
-            /* safety check parameters..
-            * - burst size bigger than buffer size? In that case we'd read raw memory
-            * - burst size smaller than the AC-4 frame plus SMPTE header? In that case we'd truncate the data!
-            */
-            if (burst_size * 2 > sizeof(ac4_work_buffer)) 
-            {
-                error_msg("AC-4 frame size too big for buffer", FATAL);
-            }
-            if (burst_size * 2 < framesiz + 4)
-            {
-                error_msg("AC-4 frame size too big for buffer", FATAL);
-            }
+	return 1;
+}		//		format_write_burst()
 
-            *p_buf++ = get_ac4_preamble_c(burst_size, fr_idx); 	/* Preamble C - AC4SIMPLE data type */
-            *p_buf++ = (int16_t)(framesiz * 8);	/* Preamble D - payload size in bits */
+/* Size of the header of a layout */
+int wave_header_size(int layout)	/* IN: WAVE_RIFF, WAVE_RESERVED or WAVE_RF64 */
+{
+	return((layout == WAVE_RIFF) ? WAVE_HEADER_SIZE : WAVE_HEADER_SIZE_RF64);
+}		//		wave_header_size()
 
-            /* byte reverse the payload */
-            temp_p = (unsigned char *)p_buf;
+/* Check whether a layout can describe a data chunk of the given size */
+int wave_header_fits(int layout,			/* IN: WAVE_RIFF, WAVE_RESERVED or WAVE_RF64 */
+					 int64_t data_bytes)	/* IN: size of the data chunk */
+{
+	return((layout != WAVE_RIFF) || (data_bytes + WAVE_HEADER_SIZE - 8 <= WAVE_RIFF_MAX));
+}		//		wave_header_fits()
+
+/* Build the RIFF/WAVE header of a formatted file, RF64 (EBU Tech 3306) once the sizes need it */
+void make_wave_header(uint8_t *hdr,			/* OUT: wave_header_size(layout) bytes */
+					  int layout,			/* IN: WAVE_RIFF, WAVE_RESERVED or WAVE_RF64 */
+					  int64_t data_bytes,	/* IN: size of the data chunk */
+					  int wave_bps,			/* IN: bits per sample */
+					  int wave_frate)		/* IN: sample rate */
+{
+	int64_t riff_size = data_bytes + wave_header_size(layout) - 8;
+	int rf64 = (layout == WAVE_RF64) || ((layout == WAVE_RESERVED) && (riff_size > WAVE_RIFF_MAX));
+	uint64_t scratch_64;
+	int scratch_int;
+	short scratch_short;
+	uint8_t *p = hdr;
 
-            for (i = 0; i < ((framesiz / 2) + 1); i++)
-            {
-                tmp_byte = temp_p[(i * 2)];
-                temp_p[(i * 2)] = temp_p[(i * 2) + 1];
-                temp_p[(i * 2) + 1] = tmp_byte;
-            }
+	memcpy(p, rf64 ? "RF64" : "RIFF", 4);
+	scratch_int = rf64 ? -1 : (int)riff_size;
+	memcpy(p + 4, &scratch_int, 4); //file length
+	memcpy(p + 8, "WAVE", 4);
+	p += 12;
 
-            /* write out the SMPTE burst to file */
-            wrlen = fwrite(ac4_work_buffer, 2, burst_size, file_info.smpte_file);
-            if (wrlen != burst_size) {
-                error_msg("File write error", FATAL);
-            }
-        }
-		else
+	if (layout != WAVE_RIFF)
+	{
+		/* ds64, or a JUNK chunk of the same size holding its place */
+		memset(p, 0, 36);
+		memcpy(p, rf64 ? "ds64" : "JUNK", 4);
+		scratch_int = 28;
+		memcpy(p + 4, &scratch_int, 4);
+		if (rf64)
 		{
-			snprintf (errstr, ERR_STR_BUF_LEN, "input file type not recognized");
-			error_msg (errstr, FATAL);	
+			scratch_64 = riff_size;
+			memcpy(p + 8, &scratch_64, 8);		// RIFF size
+			scratch_64 = data_bytes;
+			memcpy(p + 16, &scratch_64, 8);		// data size
+			scratch_64 = data_bytes / (2 * (wave_bps / 8));
+			memcpy(p + 24, &scratch_64, 8);		// sample count, table length stays 0
 		}
-	}	/* while */
+		p += 36;
+	}
 
-	// Write wave header to output file
-	
-	fseek(file_info.smpte_file, 0, SEEK_END);	
-	file_length = ftell (file_info.smpte_file);	
-	rewind(file_info.smpte_file);	
-	
-	fwrite("RIFF", 4, 1, file_info.smpte_file);
-	scratch_int = file_length - 8;
-	fwrite(&scratch_int, 4, 1, file_info.smpte_file); //file length
-	fwrite("WAVE", 4, 1, file_info.smpte_file);
-	fwrite("fmt ", 4, 1, file_info.smpte_file);
+	memcpy(p, "fmt ", 4);
 	scratch_int = 16;
-	fwrite(&scratch_int, 4, 1, file_info.smpte_file);	//format length
+	memcpy(p + 4, &scratch_int, 4);	//format length
 	scratch_short = 1;
-	fwrite(&scratch_short, 2, 1, file_info.smpte_file); //format tab
+	memcpy(p + 8, &scratch_short, 2); //format tab
 	scratch_short = 2;
-	fwrite(&scratch_short, 2, 1, file_info.smpte_file); //channels
-	fwrite(&wave_frate, 4, 1, file_info.smpte_file);  //sample rate
+	memcpy(p + 10, &scratch_short, 2); //channels
+	memcpy(p + 12, &wave_frate, 4);  //sample rate
 	scratch_int = wave_frate * 2 * (wave_bps / 8);
-	fwrite(&scratch_int, 4, 1, file_info.smpte_file);  // avg bytes per sec
+	memcpy(p + 16, &scratch_int, 4);  // avg bytes per sec
 	scratch_short = 2 * (wave_bps / 8);
-	fwrite(&scratch_short, 2, 1, file_info.smpte_file);  // block align
-	fwrite(&wave_bps, 2, 1, file_info.smpte_file);  // bits per sample
-	fwrite("data", 4, 1, file_info.smpte_file);  // data size
-	scratch_int = file_length - 44;
-	fwrite(&scratch_int, 4, 1, file_info.smpte_file);
+	memcpy(p + 20, &scratch_short, 2);  // block align
+	scratch_short = wave_bps;
+	memcpy(p + 22, &scratch_short, 2);  // bits per sample
+	memcpy(p + 24, "data", 4);  // data size
+	scratch_int = rf64 ? -1 : (int)data_bytes;
+	memcpy(p + 28, &scratch_int, 4);
+}		//		make_wave_header()
+
+/* Move the data of a plain RIFF output up to make room for a ds64 chunk, for when the size was not known up front */
+int promote_to_rf64(Format_Ctx *ctx,		/* IN/OUT: format context, switched to WAVE_RF64 */
+					int64_t data_bytes)		/* IN: size of the data chunk */
+											/* returns 0 if the data could not be moved */
+{
+	FILE *fp = ctx->file_info->smpte_file;
+	int shift = WAVE_HEADER_SIZE_RF64 - WAVE_HEADER_SIZE;
+	int64_t end = WAVE_HEADER_SIZE + data_bytes;
+	int64_t pos;
+	size_t len;
+	uint8_t *buf;
 
-/*	Close i/o files */
+	error_msg("Output exceeds 4 GiB, moving the data to make room for an RF64 header", WARNING);
 
-	if (fclose (file_info.smpte_file))
+	if ((buf = (uint8_t *)malloc(1 << 20)) == NULL)
 	{
-		snprintf (errstr, ERR_STR_BUF_LEN, "decode: Unable to close output file, %s.", file_info.smpte_fname);
-		error_msg (errstr, FATAL);
+		return run_error(&ctx->file_info->err, ERR_NO_MEMORY, -1, -1, "Unable to allocate RF64 buffer");
 	}
 
-	if (fclose (file_info.ac3file))
+	/* copy from the end backwards so nothing is overwritten before it is moved */
+	fflush(fp);
+	while (end > WAVE_HEADER_SIZE)
 	{
-		snprintf(errstr, ERR_STR_BUF_LEN, "decode: Unable to close input file, %s.", file_info.ac3fname);
-		error_msg (errstr, FATAL);
+		len = (end - WAVE_HEADER_SIZE > (1 << 20)) ? (1 << 20) : (size_t)(end - WAVE_HEADER_SIZE);
+		pos = end - len;
+		fseek64(fp, pos, SEEK_SET);
+		if (fread(buf, 1, len, fp) != len)
+		{
+			free(buf);
+			return run_error(&ctx->file_info->err, ERR_READ_ERROR, -1, -1, "decode: Unable to read back output file");
+		}
+		fseek64(fp, pos + shift, SEEK_SET);
+		if (fwrite(buf, 1, len, fp) != len)
+		{
+			free(buf);
+			return run_error(&ctx->file_info->err, ERR_WRITE_ERROR, -1, -1, "decode: Unable to write to output file");
+		}
+		end = pos;
 	}
+	fflush(fp);
+	free(buf);
 
-	return(0);
-} //  main
+	ctx->wave_layout = WAVE_RF64;
+	ctx->header_size = WAVE_HEADER_SIZE_RF64;
 
+	return 1;
+}		//		promote_to_rf64()
 
 void show_usage (void)
 {
 	puts(
-		"Usage: frame337 [-h][-i<filename.ext>][-o<filename.ext>][-a][-b][-v][-d][-n<#>]\n"
+		"Usage: frame337 [-h][-i<filename.ext>][-o<filename.ext>][-a][-b][-v][-d][-n<#>][-pipeline][-zerocopy][-prealloc]\n                [-cache<dir>][-cachesize<MB>][-append][-follow<sec>][-analyze][-plan]\n                [-crc|-crcskip|-crcabort][-resync][-fillgaps][-timecode]\n                [-rewrap<bits>][-rt<priority>][-shm<name>]\n                [-rtp<host:port>][-ptime<us>][-pace][-rtpin<[host:]port>][-ts<pid>]\n                [-mp4<track>][-playlist<file>][-grid<fps>]\n"
 		"       -h     Show this usage message and abort\n"
 		"       -i     Input AC-3, E-AC-3, AC-4 or Dolby E file name \n"
 		"              (default output.ac3) (or .smp if deformat)\n"
@@ -868,6 +2142,70 @@ void show_usage (void)
 		"              Display frame # and % done (SMPTE 337M status if deformat)\n"
 		"       -d     Deformat. Output AC-3, E-AC-3, AC-4 or Dolby E file\n"
 		"              from SMPTE file\n"
+		"       -pipeline  Run reading, packing and writing on separate threads\n"
+		"              (with -v, report queue occupancy of each stage)\n"
+		"       -zerocopy  Map the AC-3/E-AC-3 input and write each burst straight\n"
+		"              from the map (not used for deformatting)\n"
+		"       -prealloc  Predict the output size, allocate it in one piece and\n"
+		"              write the bursts into a map of it (not used for deformatting)\n"
+		"       -cache     Reuse outputs of earlier runs on the same input content and\n"
+		"              options, kept in the given directory\n"
+		"       -cachesize Size limit of the cache in MB (default 1024), least\n"
+		"              recently used outputs are evicted first\n"
+		"       -append    Format the input onto the end of an existing output file,\n"
+		"              continuing its burst cadence (not used for deformatting)\n"
+		"       -follow    Keep reading an input that is still being written, until\n"
+		"              <input>" FOLLOW_SENTINEL_EXT " exists or it has not grown for <sec> seconds\n"
+		"              (default 30), keeping the output header valid meanwhile\n"
+		"       -analyze   Check a SMPTE file's bursts, spacing and cadence without\n"
+		"              deformatting it, JSON report to the -o file or stdout\n"
+		"       -plan      Report the bursts, size, duration and data rate headroom\n"
+		"              formatting would give from frame headers only, JSON report\n"
+		"              to the -o file or stdout\n"
+		"       -crc       Check the CRCs of AC-3, E-AC-3 and AC-4 frames and warn\n"
+		"              about frames that fail, -crcskip drops them (a burst left\n"
+		"              empty is written as a pause burst), -crcabort stops at the\n"
+		"              first one. With -analyze the counts go in the report\n"
+		"       -resync    Skip damaged input instead of stopping: search for the next\n"
+		"              whole frame, log the skipped bytes and write pause bursts\n"
+		"              for the time they held (not used for deformatting)\n"
+		"       -fillgaps  Write pause bursts for frames missing from an AC-4 stream\n"
+		"              (sequence counter jumps) or DD/DD+ stream (timecode frames\n"
+		"              ahead of the audio), so the output keeps the input's timeline\n"
+		"       -timecode  Keep the timecode frames of a DD/DD+ stream: each goes in\n"
+		"              <output>.tc with the burst and sample it starts and its\n"
+		"              HH:MM:SS:FF, the first sets the TimeReference of a BWF bext\n"
+		"              chunk after the data\n"
+		"       -rewrap    Copy the bursts of a SMPTE WAV or PCM file (-b for PCM) into\n"
+		"              a WAV file of 16, 24 or 32-bit samples (default the input's)\n"
+		"              at the same positions, without deformatting; only the\n"
+		"              container changes, the bursts keep their data word size\n"
+		"       -rt        Real-time profile for live playout: memory is locked and\n"
+		"              faulted in before the run, nothing is allocated or printed\n"
+		"              per burst, and burst times are reported as a histogram.\n"
+		"              With a priority (1-99) the run uses SCHED_FIFO\n"
+		"       -shm       Publish the bursts in the shared memory ring /<name> for a\n"
+		"              local playout process instead of writing an output file,\n"
+		"              waiting while the ring is full (see shmring.h)\n"
+		"       -rtp       Send the output as RTP, L24/48000/2 with payload type 97,\n"
+		"              to host:port ([host]:port for IPv6) instead of writing a file\n"
+		"       -ptime     RTP packet time in microseconds, 1000 (default) or 125\n"
+		"              or any other giving whole sample frames\n"
+		"       -pace      Send RTP packets when due by the wall clock instead of\n"
+		"              as fast as the input is read\n"
+		"       -rtpin     Deformat L24 stereo RTP received on [host:]port (host may\n"
+		"              be a multicast group) instead of a file, as -b samples\n"
+		"              (default 24), until no packet arrives for 10 seconds\n"
+		"       -ts        The input is an MPEG-2 transport stream, format the audio\n"
+		"              of <pid> (default the first AC-3, E-AC-3 or AC-4 stream),\n"
+		"              reporting continuity errors and PTS gaps\n"
+		"       -mp4       The input is an MP4 file, format the ac-3, ec-3 or ac-4\n"
+		"              track with track_ID <track> (default the first of them)\n"
+		"       -playlist  Format the inputs listed in <file>, one per line and\n"
+		"              optionally followed by -ts[<pid>] or -mp4[<track>], into\n"
+		"              one output, carrying the burst cadence across them\n"
+		"       -grid      Pad each playlist input with a pause burst to the next\n"
+		"              frame of <fps>: 23.98, 24, 25, 29.97, 30, 50, 59.94 or 60\n"
 	);
 	exit(1);
 }
@@ -885,340 +2223,354 @@ void error_msg (char *msg, int errcode)
 	}
 }
 
+/* Record why a run has to stop, only the first error is kept */
+int run_error(Run_Error *err,		/* IN/OUT: error of the run */
+			  int code,				/* IN: ERR_ code */
+			  int64_t offset,		/* IN: input byte offset, -1 if unknown */
+			  long frame,			/* IN: frame or burst index, -1 if unknown */
+			  const char *fmt, ...)	/* IN: reason, printf style */
+									/* returns 0, for the caller to return in turn */
+{
+	va_list args;
 
-int getsync (File_Info *file_info, uint8_t *dfbuf) {
-
-	uint32_t word32val;
+#ifdef UNIX
+	if (atomic_exchange(&err->claimed, 1))
+	{
+		return 0;
+	}
+#else
+	if (err->code != ERR_NO_ERROR)
+	{
+		return 0;
+	}
+#endif /* UNIX */
 
-	while (fread (dfbuf, file_info->bytes_per_word, 1, file_info->smpte_file)) {
-		// look for preamble A
-		word32val = getword32value(dfbuf, file_info->bits_per_sample);		
+	err->code = code;
+	err->offset = offset;
+	err->frame = frame;
+	va_start(args, fmt);
+	vsnprintf(err->reason, ERR_STR_BUF_LEN, fmt, args);
+	va_end(args);
 
-		if (((word32val >> file_info->shiftbits) & 0x0000FFFF) == (uint32_t)PREAMBLE_A16)
-			{ file_info->bit_depth = 16; break;}
-		if (((word32val >> (file_info->shiftbits - 4)) & 0x000FFFFF) == (uint32_t)PREAMBLE_A20)
-			{ file_info->bit_depth = 20; break;}
-		if (((word32val >> (file_info->shiftbits - 8)) & 0x00FFFFFF) == (uint32_t)PREAMBLE_A24)
-			{ file_info->bit_depth = 24; break;}
+	return 0;
+}		//		run_error()
 
-		if (feof (file_info->smpte_file)) return 0;
+/* Front end: report the error a run stopped on and exit, if it did stop on one */
+void exit_on_error(const File_Info *file_info)	/* IN: file info after the run */
+{
+	if (file_info->err.code != ERR_NO_ERROR)
+	{
+		report_error(&file_info->err);
+		exit(FATAL);
 	}
+}		//		exit_on_error()
 
-	if (feof (file_info->smpte_file)) return 0;
-	fread (dfbuf, file_info->bytes_per_word, 1, file_info->smpte_file);
+/* Print the error a run stopped on */
+void report_error(const Run_Error *err)	/* IN: error recorded by run_error() */
+{
+	fprintf(stderr, "\nFATAL ERROR: %s", err->reason);
+	if ((err->frame >= 0) && (err->offset >= 0))
+	{
+		fprintf(stderr, " (frame %ld, input offset %lld)", err->frame, (long long)err->offset);
+	}
+	else if (err->frame >= 0)
+	{
+		fprintf(stderr, " (frame %ld)", err->frame);
+	}
+	else if (err->offset >= 0)
+	{
+		fprintf(stderr, " (input offset %lld)", (long long)err->offset);
+	}
+	fprintf(stderr, "\n");
+}		//		report_error()
 
-	// look for preamble B
-	word32val = getword32value(dfbuf, file_info->bits_per_sample);
 
-	if ((((word32val >> file_info->shiftbits) & 0x0000FFFF) != (uint32_t)PREAMBLE_B16) && (file_info->bit_depth == 16)) 
-		return getsync (file_info, dfbuf);
-	if ((((word32val >> (file_info->shiftbits - 4)) & 0x000FFFFF) != (uint32_t)PREAMBLE_B20) && (file_info->bit_depth == 20)) 
-		return getsync (file_info, dfbuf);
-	if ((((word32val >> (file_info->shiftbits - 8)) & 0x00FFFFFF) != (uint32_t)PREAMBLE_B24) && (file_info->bit_depth == 24)) 
-		return getsync (file_info, dfbuf);
+uint32_t getword32value( unsigned char *buf,/* IN: pointer to 4 bytes */
+						 int bps)			/* IN: bits per sample */
+											/* OUT: left aligned value */
+{
+	if(bps == 16){ return (uint32_t)*(uint16_t *)buf; }
+	else if(bps == 24){ return( buf[0] + (buf[1] << 8) + (buf[2] << 16)); }
+	else if(bps == 32){ return *(uint32_t *)buf; }
+	else{ return 0; }
+}
 
-	fread (dfbuf, file_info->bits_per_sample / 8, 3, file_info->smpte_file);
-	if (feof (file_info->smpte_file)) return 0;
+/* deformat from file pointer */
+int deformat (File_Info *file_info, int verbose, int threaded)
+										/* returns the number of bursts, -1 on an error in file_info->err */
+{
+	Deformat_Ctx ctx = { 0 };
+	Deformat_Buf *dfbufs;
+	int ndfbufs;
 
-	// check value of preamble C
-	word32val = getword32value(dfbuf, file_info->bits_per_sample);
+	/* the word loops are picked once for the file */
+	ctx.getsync = select_getsync(file_info);
+	ctx.convert16 = select_convert(file_info->bits_per_sample, 16);
+	ctx.convert32 = select_convert(file_info->bits_per_sample, 32);
 
-	if(((word32val >> file_info->shiftbits) & 0x0000001F) == SMPTE_DD_PLUS_ID)
-		file_info->stream_type = EAC3;
-	else if(((word32val >> file_info->shiftbits) & 0x0000001F) == SMPTE_DD_ID)
-		file_info->stream_type = AC3;
-	else if(((word32val >> file_info->shiftbits) & 0x0000001F) == SMPTE_DDE_ID)
-		file_info->stream_type = DOLBYE;
-    else if (((word32val >> file_info->shiftbits) & 0x0000001F) == SMPTE_AC4SIMPLE_ID)
-        file_info->stream_type = AC4;
-	else
-		file_info->stream_type = UNKNOWN;
+	ctx.file_info = file_info;
+	ctx.verbose = verbose;
 
-	if (file_info->stream_type == AC3 || file_info->stream_type == EAC3)
+	ndfbufs = threaded ? PIPE_NUM_BUFS : 1;
+	if (!ctx.getsync || !ctx.convert16 || !ctx.convert32)
 	{
-		word32val = getword32value((unsigned char *)dfbuf + (file_info->bytes_per_word * 2), file_info->bits_per_sample);
-
-		// check if the DD/DD+ frame sync word is valid
-		if((((word32val >> file_info->shiftbits) & 0x0000FFFF) != (uint32_t)SYNC_WD) && 
-			(((word32val >> file_info->shiftbits) & 0x0000FFFF) != (uint32_t)SYNC_WD_REV))
-		{
-			error_msg("Invalid Sync Word Found", FATAL);
-		}
-
-		fseek(file_info->smpte_file, -file_info->bytes_per_word, SEEK_CUR);
-
-		// calculate the burst size
-		word32val = getword32value((unsigned char *)dfbuf + file_info->bytes_per_word, file_info->bits_per_sample);
-		word32val = (word32val >> (file_info->bits_per_sample - file_info->bit_depth));
-
-		return (int) word32val;
+		run_error(&file_info->err, ERR_BAD_INPUT, -1, -1, "Unknown bit depth");
 	}
-	else if(file_info->stream_type == DOLBYE)
+	else if ((dfbufs = (Deformat_Buf *)calloc(ndfbufs, sizeof(Deformat_Buf))) == NULL)
 	{
-		word32val = getword32value((unsigned char *)dfbuf + (file_info->bytes_per_word * 2), file_info->bits_per_sample);
-
-		// check if the Dolby E frame sync word is valid
-		if(((((word32val >> file_info->shiftbits) & 0x0000FFFE) != (uint32_t)DDE_SYNC16) && (file_info->bit_depth == 16))
-		  || ((((word32val >> (file_info->shiftbits - 4)) & 0x000FFFFE) != (uint32_t)DDE_SYNC20) && (file_info->bit_depth == 20))
-		  || ((((word32val >> (file_info->shiftbits - 8)) & 0x00FFFFFE) != (uint32_t)DDE_SYNC24) && (file_info->bit_depth == 24)))
-		{
-			error_msg("Invalid Sync Word Found", WARNING);
-		}
-
-		fseek(file_info->smpte_file, -(file_info->bytes_per_word * 5), SEEK_CUR);
+		run_error(&file_info->err, ERR_NO_MEMORY, -1, -1, "Unable to allocate deformat buffers");
+	}
+	else
+	{
+/*	Read frames of AC-3, EC-3, AC-4, or Dolby E data */
 
-		// calculate the burst size
-		word32val = getword32value((unsigned char *)dfbuf + file_info->bytes_per_word, file_info->bits_per_sample);
-		word32val = ((uint32_t)word32val >> (file_info->bits_per_sample - file_info->bit_depth));
+		run_stages(&ctx, &deformat_stages, dfbufs, sizeof(Deformat_Buf), ndfbufs, threaded, verbose, file_info->rt);
 
-		//return the DDE burst size + (4*bps); //+4 to compensate for the IEC header words
-		return (int)(word32val + (4 * file_info->bit_depth));
+		free(dfbufs);
 	}
-    else if (file_info->stream_type == AC4)
-    {
-        word32val = getword32value((unsigned char *)dfbuf + (file_info->bytes_per_word * 2), file_info->bits_per_sample);
 
-        fseek(file_info->smpte_file, -file_info->bytes_per_word, SEEK_CUR);
+/*	Close i/o files, after an error as well so a worker can go on with its next job */
 
-        /* calculate burst size */
-        word32val = getword32value((unsigned char *)dfbuf + file_info->bytes_per_word, file_info->bits_per_sample);
-        word32val = (word32val >> (file_info->bits_per_sample - file_info->bit_depth));
-
-        return (int32_t)word32val;
-    }
-	else // unknown data
+	if (fclose (file_info->smpte_file))
 	{
-		fseek(file_info->smpte_file, -file_info->bytes_per_word, SEEK_CUR);
+		run_error(&file_info->err, ERR_READ_ERROR, -1, -1, "decode: Unable to close input file, %s.", file_info->smpte_fname);
+	}
 
-		// calculate the burst size
-		word32val = getword32value((unsigned char *)dfbuf + file_info->bytes_per_word, file_info->bits_per_sample);
-		word32val = (word32val >> (file_info->bits_per_sample - file_info->bit_depth));
+	if (fclose (file_info->ac3file))
+	{
+		run_error(&file_info->err, ERR_WRITE_ERROR, -1, -1, "decode: Unable to close output file, %s.", file_info->ac3fname);
+	}
 
-		return (int) word32val;
+	if (file_info->err.code)
+	{
+		return(-1);
 	}
-}
 
+	if(verbose)
+	{
+		printf("SMPTE 337M Statistics:\n");
+		printf("-----------------------\n");
+		printf("Initial Pa Offset = %i\n", ctx.pa_first);
+		printf("Pa Spacing Average = %4.2f\n", ctx.pa_spacing_average);
+		printf("Pa Spacing Maximum = %i\n", ctx.pa_max);
+		printf("Pa Spacing Minimum = %i\n", ctx.pa_min);
+		printf("Pa Alignment Changes = %i\n", ctx.pa_align_changes);
+		printf("Pc Value Changes = %i\n", ctx.pc_value_changes);
+		printf("Pd Value Changes = %i\n", ctx.pd_value_changes);
+	}
 
-uint32_t getword32value( unsigned char *buf,/* IN: pointer to 4 bytes */
-						 int bps)			/* IN: bits per sample */
-											/* OUT: left aligned value */
-{
-	if(bps == 16){ return (uint32_t)*(uint16_t *)buf; }
-	else if(bps == 24){ return( buf[0] + (buf[1] << 8) + (buf[2] << 16)); }
-	else if(bps == 32){ return *(uint32_t *)buf; }
-	else{ return 0; }
-}
+	return(ctx.num_frames);
+}		//		deformat ()
 
-/* deformat from file pointer */
-int deformat (File_Info *file_info, int verbose)
+/* Deformat stage 1: search for the next SMPTE preamble and read the burst payload */
+int deformat_read_burst(void *context,	/* IN/OUT: Deformat_Ctx */
+						void *buffer)	/* OUT: Deformat_Buf to be filled */
+										/* returns 1 if a burst was read, 0 at end of input */
 {
-	uint32_t dde_temp_buf [MAX_DDE_BURST_SIZE];	/* Holds 1 packed Dolby E frame */
-	uint16_t *dd_temp_buf = (uint16_t *)&dde_temp_buf[0];
-	uint8_t dfbuf  [MAX_DDE_BURST_SIZE	/* Deformat Buffer */
-			* sizeof(uint32_t)];
-	static int last_file_loc;
-	static int prev_pc_value, prev_pd_value;
+	Deformat_Ctx *ctx = (Deformat_Ctx *)context;
+	Deformat_Buf *dbuf = (Deformat_Buf *)buffer;
+	File_Info *file_info = ctx->file_info;
+	uint8_t *dfbuf = dbuf->dfbuf;
 	int spacing_temp;
 	int remaining_bytes;
 	int nreadbytes;
 	int nbits;						/* # of bits in SMPTE payload */
-	int i,j;
-	int num_frames = 0;
-	uint16_t *shortbuf;
-
-	int pa_first = 0;
-	int pa_spacing, pa_spacing_sum = 0, preamble_count = 0;
-	int pa_max, pa_min;
+	int pa_spacing;
 	int pa_alignment;
-	double pa_spacing_average;
 	int pc_value, pd_value;
-	char errstr[ERR_STR_BUF_LEN];				/* string for error message */
 
+	if (!(nbits = ctx->getsync (file_info, dfbuf)))
+	{
+		return 0;
+	}
+
+	/* SMPTE formatting statistics */
+	switch(file_info->bit_depth)
+	{
+		case 16:
+			pc_value = (getword32value(dfbuf, file_info->bits_per_sample) >> file_info->shiftbits) & 0x0000ffff;
+			pd_value = (getword32value((unsigned char *)dfbuf + file_info->bytes_per_word, 
+				file_info->bits_per_sample) >> file_info->shiftbits) & 0x0000ffff;
+			break;
+		case 20:
+			pc_value = (getword32value(dfbuf, file_info->bits_per_sample) >> (file_info->shiftbits - 4)) & 0x000fffff;
+			pd_value = (getword32value((unsigned char *)dfbuf + file_info->bytes_per_word, 
+				file_info->bits_per_sample) >> (file_info->shiftbits - 4)) & 0x000fffff;
+			break;
+		case 24:
+			pc_value = (getword32value(dfbuf, file_info->bits_per_sample) >> (file_info->shiftbits - 8)) & 0x00ffffff;
+			pd_value = (getword32value((unsigned char *)dfbuf + file_info->bytes_per_word, 
+				file_info->bits_per_sample) >> (file_info->shiftbits - 8)) & 0x00ffffff;
+			break;
+	}	
+
+	if(ctx->preamble_count)
+	{	
+		spacing_temp = (ftell64(file_info->smpte_file) - ctx->last_file_loc) / file_info->bytes_per_word;
+
+		if((spacing_temp % 2) || (pc_value != ctx->prev_pc_value) || (pd_value != ctx->prev_pd_value))
+		{
+			if(spacing_temp % 2)
+				ctx->pa_align_changes++;
+			if(pc_value != ctx->prev_pc_value)
+				ctx->pc_value_changes++;
+			if(pd_value != ctx->prev_pd_value)
+				ctx->pd_value_changes++;
+
+			pa_alignment = ((ftell64(file_info->smpte_file) - file_info->in_file_start) / file_info->bytes_per_word) % 2;					
+			
+			if(ctx->verbose)
+				print_337_info(ctx->preamble_count, pa_alignment_text[pa_alignment], pc_value, pd_value);
+		}
+
+		pa_spacing = ((ftell64(file_info->smpte_file) - ctx->last_file_loc) / file_info->bytes_per_word) / 2;
+		ctx->pa_spacing_sum += pa_spacing;
 
-#ifdef LITEND
-	int k;
-#endif
+		if(ctx->preamble_count == 1)
+		{
+			ctx->pa_max = pa_spacing;
+			ctx->pa_min = pa_spacing;
+		}
 
-	if(file_info->bits_per_sample == 16){ file_info->shiftbits = 0; }
-	else if(file_info->bits_per_sample == 24){ file_info->shiftbits = 8; }
-	else if(file_info->bits_per_sample == 32){ file_info->shiftbits = 16; }
-	else { error_msg ("Unknown bit depth", FATAL); }
+		if(pa_spacing > ctx->pa_max)
+			ctx->pa_max = pa_spacing;
+		if(pa_spacing < ctx->pa_min)
+			ctx->pa_min = pa_spacing;
+	}
+	else
+	{
+		pa_alignment = ((ftell64(file_info->smpte_file) - file_info->in_file_start) / file_info->bytes_per_word) % 2;
+		
+		if(ctx->verbose)
+			print_337_info(ctx->preamble_count, pa_alignment_text[pa_alignment], pc_value, pd_value);			
 
-/*	Read frames of AC-3, EC-3, AC-4, or Dolby E data */
+		ctx->pa_first = (((ftell64(file_info->smpte_file) - file_info->in_file_start) / file_info->bytes_per_word) - PRMBLSIZE) / 2;
+	}
 
-		while ((nbits = getsync (file_info, dfbuf)))
-		{
-			/* SMPTE formatting statistics */
-			switch(file_info->bit_depth)
-			{
-				case 16:
-					pc_value = (getword32value(dfbuf, file_info->bits_per_sample) >> file_info->shiftbits) & 0x0000ffff;
-					pd_value = (getword32value((unsigned char *)dfbuf + file_info->bytes_per_word, 
-						file_info->bits_per_sample) >> file_info->shiftbits) & 0x0000ffff;
-					break;
-				case 20:
-					pc_value = (getword32value(dfbuf, file_info->bits_per_sample) >> (file_info->shiftbits - 4)) & 0x000fffff;
-					pd_value = (getword32value((unsigned char *)dfbuf + file_info->bytes_per_word, 
-						file_info->bits_per_sample) >> (file_info->shiftbits - 4)) & 0x000fffff;
-					break;
-				case 24:
-					pc_value = (getword32value(dfbuf, file_info->bits_per_sample) >> (file_info->shiftbits - 8)) & 0x00ffffff;
-					pd_value = (getword32value((unsigned char *)dfbuf + file_info->bytes_per_word, 
-						file_info->bits_per_sample) >> (file_info->shiftbits - 8)) & 0x00ffffff;
-					break;
-			}	
+	ctx->preamble_count++;
+	ctx->pa_spacing_average = (double)ctx->pa_spacing_sum / (double)(ctx->preamble_count - 1);
 
-			if(preamble_count)
-			{	
-				spacing_temp = (ftell(file_info->smpte_file) - last_file_loc) / file_info->bytes_per_word;
+	ctx->prev_pc_value = pc_value;
+	ctx->prev_pd_value = pd_value;
 
-				if((spacing_temp % 2) || (pc_value != prev_pc_value) || (pd_value != prev_pd_value))
-				{
-					if(spacing_temp % 2)
-						file_info->pa_align_changes++;
-					if(pc_value != prev_pc_value)
-						file_info->pc_value_changes++;
-					if(pd_value != prev_pd_value)
-						file_info->pd_value_changes++;
-
-					pa_alignment = ((ftell(file_info->smpte_file) - file_info->in_file_start) / file_info->bytes_per_word) % 2;					
-					
-					if(verbose)
-						print_337_info(preamble_count, pa_alignment_text[pa_alignment], pc_value, pd_value);
-				}
+	ctx->last_file_loc = ftell64(file_info->smpte_file);
+	/*------------------------------*/
 
-				pa_spacing = ((ftell(file_info->smpte_file) - last_file_loc) / file_info->bytes_per_word) / 2;
-				pa_spacing_sum += pa_spacing;
+	nreadbytes = ((nbits * file_info->bits_per_sample) / file_info->bit_depth) / 8;
+	if(nbits % file_info->bit_depth)
+		nreadbytes += (file_info->bit_depth / 8);
 
-				if(preamble_count == 1)
-				{
-					pa_max = pa_spacing;
-					pa_min = pa_spacing;
-				}
+	dbuf->stream_type = file_info->stream_type;
+	dbuf->bit_depth = file_info->bit_depth;
+	dbuf->nbits = nbits;
+	dbuf->offset = ctx->last_file_loc;
+	dbuf->index = ctx->num_frames;
+	dbuf->valid = (nreadbytes == fread(dfbuf, 1, nreadbytes, file_info->smpte_file));
 
-				if(pa_spacing > pa_max)
-					pa_max = pa_spacing;
-				if(pa_spacing < pa_min)
-					pa_min = pa_spacing;
-			}
-			else
-			{
-				pa_alignment = ((ftell(file_info->smpte_file) - file_info->in_file_start) / file_info->bytes_per_word) % 2;
-				
-				if(verbose)
-					print_337_info(preamble_count, pa_alignment_text[pa_alignment], pc_value, pd_value);			
+	if(dbuf->valid)
+	{
+		// ensure we're aligned to a word boundary
+		// to begin searching for next SMPTE preamble
+		if((remaining_bytes = (nreadbytes % file_info->bytes_per_word)))
+			fseek64(file_info->smpte_file, (file_info->bytes_per_word - remaining_bytes), SEEK_CUR);
+	}
 
-				pa_first = (((ftell(file_info->smpte_file) - file_info->in_file_start) / file_info->bytes_per_word) - PRMBLSIZE) / 2;
-			}
+	ctx->num_frames++;
 
-			preamble_count++;
-			pa_spacing_average = (double)pa_spacing_sum / (double)(preamble_count - 1);
+	return 1;
+}		//		deformat_read_burst()
 
-			prev_pc_value = pc_value;
-			prev_pd_value = pd_value;
+/* Deformat stage 2: convert the burst payload into elementary stream layout */
+int deformat_pack_burst(void *context,	/* IN: Deformat_Ctx */
+						void *buffer)	/* IN/OUT: Deformat_Buf to be converted */
+										/* returns 0 if a CRC error aborts the run */
+{
+	Deformat_Ctx *ctx = (Deformat_Ctx *)context;
+	Deformat_Buf *dbuf = (Deformat_Buf *)buffer;
+	int bits_per_sample = ctx->file_info->bits_per_sample;
+	int nbits = dbuf->nbits;
+	int nwords = (nbits + dbuf->bit_depth - 1) / dbuf->bit_depth;	/* payload words, the last one partly used */
+	uint8_t *dfbuf = dbuf->dfbuf;
+	uint16_t *shortbuf;
+	int i,j;
 
-			last_file_loc = ftell(file_info->smpte_file);
-			/*------------------------------*/
+#ifdef LITEND
+	int k;
+#endif
 
-			nreadbytes = ((nbits * file_info->bits_per_sample) / file_info->bit_depth) / 8;
-			if(nbits % file_info->bit_depth)
-				nreadbytes += (file_info->bit_depth / 8);
+	dbuf->outbytes = 0;
 
-			if(nreadbytes == fread(dfbuf, 1, nreadbytes, file_info->smpte_file)) 
-			{
+	if(!dbuf->valid)
+	{
+		return 1;
+	}
 
 #ifdef LITEND
 
 /*	Byte swap the buffer words on little-endian machines */
 
-				if(file_info->bits_per_sample == 16)
-				{
-                    int nwords = nbits / 16;
-                    if (nbits % 16)
-                        nwords++;
-
-					shortbuf = (uint16_t *)dfbuf;
+	if(bits_per_sample == 16)
+	{
+		shortbuf = (uint16_t *)dfbuf;
 
-					for (i = 0; i < nwords; i ++)
-					{
-						j = shortbuf [i];
-						k = ( j >> 8 ) & 0x00ff;
-						j = ( j << 8 ) & 0xff00;
-						shortbuf [i] = (uint16_t)(j | k);
-					}
-				}
+		for (i = 0; i < nwords; i ++)
+		{
+			j = shortbuf [i];
+			k = ( j >> 8 ) & 0x00ff;
+			j = ( j << 8 ) & 0xff00;
+			shortbuf [i] = (uint16_t)(j | k);
+		}
+	}
 #endif /* LITEND */
-				// convert buffer //
-				if(file_info->stream_type == DOLBYE)
-				{
-					convertbuffer(dfbuf, (void *)dde_temp_buf, file_info->bits_per_sample, 32, nbits, file_info->bit_depth);
+	// convert buffer //
+	if(dbuf->stream_type == DOLBYE)
+	{
+		ctx->convert32(dfbuf, (void *)dbuf->outbuf, nwords);
+		dbuf->outbytes = 4 * (nbits / dbuf->bit_depth);
+	}
+	else if(dbuf->stream_type == AC3 || dbuf->stream_type == EAC3 || dbuf->stream_type == AC4) //DD, DD+, AC-4
+	{
+		ctx->convert16(dfbuf, (void *)dbuf->outbuf, nwords);
+		dbuf->outbytes = nbits / 8;
 
-					if(fwrite((void *)dde_temp_buf, 4, (nbits / file_info->bit_depth), file_info->ac3file) 
-						!= (size_t) (nbits / file_info->bit_depth))
-					{
-						snprintf (errstr, ERR_STR_BUF_LEN, "decode: Unable to write to output file, %s.", file_info->ac3fname);
-						error_msg (errstr, FATAL);
-					}
-				}
-				else if(file_info->stream_type == AC3 || file_info->stream_type == EAC3) //DD, DD+
-				{
-					convertbuffer(dfbuf, (void *)dd_temp_buf, file_info->bits_per_sample, 16, nbits, file_info->bit_depth);
-					if(fwrite((void *)dd_temp_buf, 1, (nbits / 8), file_info->ac3file) != (size_t) (nbits / 8))
-					{
-							snprintf (errstr, ERR_STR_BUF_LEN, "decode: Unable to write to output file, %s.", file_info->ac3fname);
-							error_msg (errstr, FATAL);
-					}	
-				}
-                else if (file_info->stream_type == AC4) //AC-4
-                {
-                    convertbuffer(dfbuf, (void *)dd_temp_buf, file_info->bits_per_sample, 16, nbits, file_info->bit_depth);
-                    if (fwrite((void *)dd_temp_buf, 1, (nbits / 8), file_info->ac3file) != (size_t)(nbits / 8))
-                    {
-                        snprintf(errstr, ERR_STR_BUF_LEN, "decode: Unable to write to output file, %s.", file_info->ac3fname);
-                        error_msg(errstr, FATAL);
-                    }
-                }
-				// ensure we're aligned to a word boundary
-				// to begin searching for next SMPTE preamble
-				if((remaining_bytes = (nreadbytes % file_info->bytes_per_word)))
-					fseek(file_info->smpte_file, (file_info->bytes_per_word - remaining_bytes), SEEK_CUR);
-
-				// clear the deformat buffer to remove
-				// any stale data
-				memset(dfbuf, 0, sizeof(dfbuf));
-			}	
-			num_frames++;
-		}	/* while */
+		if(ctx->file_info->crc.policy != CRC_OFF)
+		{
+			dbuf->outbytes = crc_verify_payload(&ctx->file_info->crc, (uint8_t *)dbuf->outbuf, dbuf->outbytes);
+			if (ctx->file_info->crc.aborted)
+			{
+				return crc_abort_error(&ctx->file_info->crc, &ctx->file_info->err, dbuf->offset);
+			}
+		}
+	}
 
-/*	Close i/o files */
+	// clear the deformat buffer to remove
+	// any stale data
+	memset(dfbuf, 0, sizeof(dbuf->dfbuf));
 
-	if (fclose (file_info->smpte_file))
-	{
-		snprintf (errstr, ERR_STR_BUF_LEN, "decode: Unable to close input file, %s.", file_info->smpte_fname);
-		error_msg (errstr, FATAL);
-	}
+	return 1;
+}		//		deformat_pack_burst()
 
-	if (fclose (file_info->ac3file))
+/* Deformat stage 3: write the converted payload to the elementary stream file */
+int deformat_write_burst(void *context,	/* IN: Deformat_Ctx */
+						 void *buffer)		/* IN: converted Deformat_Buf */
+											/* returns 0 if the payload could not be written */
+{
+	Deformat_Ctx *ctx = (Deformat_Ctx *)context;
+	Deformat_Buf *dbuf = (Deformat_Buf *)buffer;
+
+	if(dbuf->outbytes == 0)
 	{
-		snprintf (errstr, ERR_STR_BUF_LEN, "decode: Unable to close output file, %s.", file_info->ac3fname);
-		error_msg (errstr, FATAL);
+		return 1;
 	}
 
-	if(verbose)
+	if(fwrite((void *)dbuf->outbuf, 1, dbuf->outbytes, ctx->file_info->ac3file) != (size_t) dbuf->outbytes)
 	{
-		printf("SMPTE 337M Statistics:\n");
-		printf("-----------------------\n");
-		printf("Initial Pa Offset = %i\n", pa_first);
-		printf("Pa Spacing Average = %4.2f\n", pa_spacing_average);
-		printf("Pa Spacing Maximum = %i\n", pa_max);
-		printf("Pa Spacing Minimum = %i\n", pa_min);
-		printf("Pa Alignment Changes = %i\n", file_info->pa_align_changes);
-		printf("Pc Value Changes = %i\n", file_info->pc_value_changes);
-		printf("Pd Value Changes = %i\n", file_info->pd_value_changes);
+		return run_error(&ctx->file_info->err, ERR_WRITE_ERROR, dbuf->offset, dbuf->index,
+			"decode: Unable to write to output file, %s.", ctx->file_info->ac3fname);
 	}
 
-	return(num_frames);
-}		//		deformat ()
+	return 1;
+}		//		deformat_write_burst()
 
 
 void print_337_info(int frame_count, const char *pa_alignment_text, int pc_value, int pd_value)
@@ -1231,107 +2583,47 @@ void print_337_info(int frame_count, const char *pa_alignment_text, int pc_value
 	printf("-------------------------\n\n");
 }
 
-/* Function to format words into elementary stream layout when deformatting */
-
-void convertbuffer(unsigned char *inbuf, /* IN: input buffer */
-				   void *outbuf,		 /* OUT: output buffer */
-				   int bps,				 /* IN: bits per sample */
-				   int outwordsize,		 /* IN: output word size, 16,24 or 32 */
-				   int bitcount,		 /* IN: number of bits to conver */
-				   int bit_depth)		 /* IN: bit depth */
+/* Stop formatting on an error at the current input position */
+int format_error(Format_Ctx *ctx,		/* IN/OUT: format context, done is set */
+				 int code,				/* IN: ERR_ code */
+				 const char *reason)	/* IN: what went wrong */
+										/* returns 0, for the read stage to return */
 {
-	short *dd_buf;
-	uint32_t *de_buf;
-	int wordcount = bitcount / bit_depth;
-	int i;
+	int64_t offset = ctx->in_map ? (int64_t)ctx->in_pos : ftell64(ctx->file_info->ac3file);
 
-	if(bitcount % bit_depth)
-		wordcount++;
-
-	if(outwordsize == 16)
-	{ 
-		dd_buf = (short *)outbuf;
-		if(bps == 16)
-		{
-			for(i = 0; i < wordcount; i++)
-			{
-				dd_buf[i] = *(((short *)inbuf) + i);
-			}	
-		}
-		if(bps == 24)
-		{
-			for(i = 0; i < wordcount; i++)
-			{
-				dd_buf[i] = inbuf[(i * 3) + 1] + (inbuf[(i * 3) + 2] << 8);
-			}
-		}
-		if(bps == 32)
-		{			
-			de_buf = (uint32_t *)inbuf;
-			for(i = 0; i < wordcount; i++)
-			{
-				dd_buf[i] = (short)(de_buf[i] >> 16);
-			}
-		}
-	}
-	if(outwordsize == 32)
-	{ 
-		de_buf = (uint32_t *)outbuf;
-		if(bps == 16)
-		{
-			dd_buf = (short *)inbuf;
-			for(i = 0; i < wordcount; i++)
-			{
-				de_buf[i] = (uint32_t)(dd_buf[i] << 16);
-			}	
-		}
-		if(bps == 24)
-		{
-			for(i = 0; i < wordcount; i++)
-			{
-				de_buf[i] = (inbuf[i * 3] << 8) + (inbuf[(i * 3) + 1] << 16)
-					+ (inbuf[(i * 3) + 2] << 24);
-			}
-		}
-		if(bps == 32)
-		{
-			for(i = 0; i < wordcount; i++)
-			{
-				de_buf[i] = *(((uint32_t *)inbuf) + i);
-			}	
-		}
-	}
-}		// convertbuffer
+	ctx->done = 1;
+	return run_error(&ctx->file_info->err, code, offset, ctx->framecount, "%s", reason);
+}		//		format_error()
 
 /* Function to generate error message from error code */
-int checkstatus(int status) 
+int checkstatus(Format_Ctx *ctx,	/* IN/OUT: format context, the error is recorded in its file info */
+				int status)			/* IN: ERR_ code from get_timeslice() */
+									/* returns 1 at end of input or on an error */
 {
-	if(status) 
-	{
-		switch(status) 
-		{
-			case ERR_READ_ERROR: 
-				error_msg("File read error", FATAL);	
-				break;
-			case ERR_SYNCH_ERROR:
-				error_msg("Sync word not found", FATAL);
-				break;
-			case ERR_INV_SAMP_RATE:
-				error_msg("Invalid sample rate", FATAL);
-				break;
-			case ERR_INV_DATA_RATE: 
-				error_msg("Invalid data rate", FATAL);
-				break;
-			case ERR_BSID:
-				error_msg("Invalid bitstream ID", FATAL);
-				break;
-			case ERR_EOF:
-				return(1);
-		}
-	}
-	else
+	switch(status) 
 	{
-		return(0);
+		case ERR_NO_ERROR:
+			return(0);
+		case ERR_EOF:
+			return(1);
+		case ERR_READ_ERROR: 
+			format_error(ctx, status, "File read error");	
+			break;
+		case ERR_SYNCH_ERROR:
+			format_error(ctx, status, "Sync word not found");
+			break;
+		case ERR_INV_SAMP_RATE:
+			format_error(ctx, status, "Invalid sample rate");
+			break;
+		case ERR_INV_DATA_RATE: 
+			format_error(ctx, status, "Invalid data rate");
+			break;
+		case ERR_BSID:
+			format_error(ctx, status, "Invalid bitstream ID");
+			break;
+		default:
+			format_error(ctx, status, "Invalid frame header");
+			break;
 	}
 
 	return(1);
@@ -1354,9 +2646,8 @@ int get_timeslice(short readtype,    /* IN: */
 	short tc = 0;
 	short tcread = 0;
 	short ddread = 0;
-	short ddinfo[4];
-	short i;
-	int numblkscod;
+	int status;
+	int i;
 
 	sinfo->has_tc = 0;
 	sinfo->byte_rev = 0;
@@ -1388,7 +2679,7 @@ int get_timeslice(short readtype,    /* IN: */
 			}
 		}
 
-		if(fseek(fileptr, -2, SEEK_CUR) != 0) /* reset fileptr to beginning of timeslice */
+		if(fseek64(fileptr, -2, SEEK_CUR) != 0) /* reset fileptr to beginning of timeslice */
 		{
 			return(ERR_READ_ERROR);
 		}
@@ -1399,11 +2690,9 @@ int get_timeslice(short readtype,    /* IN: */
 		switch (syncword)
 		{
 		case TC_SYNC_WD:
-			sinfo->has_tc = 1;
 			tc = 1;
 			break;
 		case TC_SYNC_WD_REV:
-			sinfo->has_tc = 1;	
 			tc = 1;
 			break;
 		case SYNC_WD:
@@ -1427,6 +2716,8 @@ int get_timeslice(short readtype,    /* IN: */
 			{
 				break;
 			}
+			/* only a timecode frame in front of this timeslice's frame is kept */
+			sinfo->has_tc = 1;
 
 			/* Output TC frame */
 			if((readtype == 0) || (readtype == 1)) 
@@ -1436,13 +2727,25 @@ int get_timeslice(short readtype,    /* IN: */
 				{
 					return(ERR_READ_ERROR);
 				}
+				memcpy(sinfo->tc, p_buf, TC_FRMSIZE);
 				p_buf += 8;
 				*numbytes += TC_FRMSIZE;
 			}
-			/* Skip TC frame */
+			/* Skip TC frame, keeping it for the timecode index */
 			else 
 			{
-				fseek(fileptr, TC_FRMSIZE, SEEK_CUR);
+				if (fread((void *)(sinfo->tc), sizeof(char), TC_FRMSIZE, fileptr) != TC_FRMSIZE)
+				{
+					/* cut short at the end of the input, as if skipped */
+					sinfo->has_tc = 0;
+				}
+			}
+			if (syncword == TC_SYNC_WD_REV)
+			{
+				for (i = 0; i < TC_FRMSIZE / 2; i++)
+				{
+					sinfo->tc[i] = bytereverse(sinfo->tc[i]);
+				}
 			}
 
 			sinfo->bytecount += TC_FRMSIZE;
@@ -1468,95 +2771,9 @@ int get_timeslice(short readtype,    /* IN: */
 			p_frame = p_buf;
 			p_buf += 4;
 			
-			if(p_frame[0] == SYNC_WD_REV)
-			{
-				sinfo->byte_rev = 1;
-			}
-			else
-			{
-				sinfo->byte_rev = 0;
-			}
-
-			/* Handle byte reversal */
-			for(i = 0; i < 4; i++)
-			{
-				if(sinfo->byte_rev)
-				{
-					ddinfo[i] = bytereverse(p_frame[i]);
-				}
-				else
-				{
-					ddinfo[i] = p_frame[i];
-				}
-			}
-			
-			sinfo->bsid  = (int)((ddinfo[2] >> 3) & 0x001F);
-			
-			if (BSI_ISDD(sinfo->bsid)) /* Dolby Digital */
-			{
-				sinfo->is_ddp = 0;
-				sinfo->fscod = (int)((ddinfo[2] >> 14) & 0x0003);
-				
-				if (sinfo->fscod > MAXFSCOD)
-				{
-					return(ERR_INV_SAMP_RATE);
-				}
-				
-				sinfo->frmsizecod = (int)((ddinfo[2] >> 8) & 0x003f);
-				
-				if (sinfo->frmsizecod > MAXFRMSIZECOD)
-				{
-					return(ERR_INV_DATA_RATE);
-				}
-				
-				sinfo->datarate = sinfo->frmsizecod >> 1;
-				sinfo->framesize = frmsizetab[sinfo->fscod][sinfo->frmsizecod];
-				sinfo->numblks = 6; /* DD always has 6 frames per block */
-				sinfo->strmtyp = 0; /* DD only has one stream type */
-				sinfo->substreamid = 0; /* DD does not support substreams */
-			}
-			else if (BSI_ISDDP(sinfo->bsid)) /* DD+ */
-			{
-				sinfo->is_ddp = 1;
-				sinfo->fscod = (int)((ddinfo[2] >> 14) & 0x0003);
-				
-				if (sinfo->fscod > MAXFSCOD)
-				{
-					return(ERR_INV_SAMP_RATE);
-				}
-				
-				sinfo->framesize = (int)(ddinfo[1] & 0x07FF) + 1;
-	
-				if(sinfo->fscod == 3)
-				{					
-					sinfo->numblks = 6;
-				}
-				else
-				{
-					numblkscod = (int)((ddinfo[2] >> 12) & 0x0003);
-					
-					switch(numblkscod) 
-					{
-					case 0:
-					case 1:
-					case 2:
-						sinfo->numblks = numblkscod + 1;
-						break;
-					case 3:
-						sinfo->numblks = 6;
-						break;
-					default:
-						error_msg("Invalid numblkscod", FATAL);
-					}
-				}
-
-				sinfo->strmtyp = (int)((ddinfo[1] >> 14) & 0x0003);		
-				sinfo->substreamid = (int)((ddinfo[1] >> 11) & 0x0007);
-
-			}
-			else	
+			if((status = parse_dd_frame_header(p_frame, sinfo)) != ERR_NO_ERROR)
 			{
-				return(ERR_BSID);
+				return(status);
 			}
 			
 			if(!justinfo)
@@ -1580,7 +2797,7 @@ int get_timeslice(short readtype,    /* IN: */
 				}
 				else
 				{
-					fseek(fileptr, (sinfo->framesize - 4) * 2, SEEK_CUR);
+					fseek64(fileptr, (sinfo->framesize - 4) * 2, SEEK_CUR);
 				}
 				
 				sinfo->bytecount += (sinfo->framesize * sizeof(short));
@@ -1598,106 +2815,106 @@ int get_timeslice(short readtype,    /* IN: */
 	return(0);
 }
 
-/* This function reads a wave file header for deformatting */
-int parse_header(FILE *infile, Wave_Struct *wavInfo)
+/* Parse the first 4 words of a DD/DD+ frame into the time slice info */
+int parse_dd_frame_header(uint16_t *p_frame,	/* IN: first 4 words of the frame, as read from file */
+						  SLC_INFO *sinfo)		/* OUT: Time slice info structure */
 {
-	char headerbytes[5] = "";
-	int subchunk_size;
-    uint16_t short_val;
-
-	if (infile != NULL)
-	{		
-		unsigned char status = 0;
-
-		fread(headerbytes, 4, 1, infile);
-
-		if (!strcmp(headerbytes, "RIFF"))
-		{  //We got a RIFF
-			status = status | 0x01;
-
-			////////////////
-			// Wave File
-			////////////////
-			fread(&subchunk_size, 4, 1, infile);	// read in size of RIFF chunk
-
-			fread(headerbytes, 4, 1, infile);
-			if (!strcmp(headerbytes, "WAVE"))		// if WAVE, continue 
-				status = status | 0x02;					
-			else								// else, PCM, exit 
-				return 0;
-
-			while(1)
-			{
-				if(fread(headerbytes, 1, 4, infile) != 4)	// read next subchunk ID 
-					break;
-				if(fread(&subchunk_size, 1, 4, infile) != 4)	// read subchunk size 
-					break;
-
-				if (!strcmp(headerbytes, "fmt ")) 
-				{
-					status = status | 0x04;
-
-					if(subchunk_size < 16)
-						return 1;
-
-					fseek(infile, 2, SEEK_CUR);
-
-					fread(&short_val, 2, 1, infile);
-                    wavInfo->nchannels = short_val;
-
-					fread(&wavInfo->sample_rate, 4, 1, infile);
-
-					fseek(infile, 6, SEEK_CUR);
-
-					fread(&short_val, 2, 1, infile);
-                    wavInfo->nbits = short_val;
-
-					if(subchunk_size > 16)	/* if necessary, advance beyond remaining subchunk bytes */
-						fseek(infile, subchunk_size - 16, SEEK_CUR);
-
-					if(wavInfo->nchannels != 2)
-					{
-						fprintf(stderr, "Error: Wave File Must be 2-Channels!\n");
-						exit(0);
-					}
-
-					if((wavInfo->nbits%8 != 0) || (wavInfo->nbits > 32) || (wavInfo->nbits < 16))
-					{
-						fprintf(stderr, "Error: Only 16, 24, & 32 bit wave files are supported\n");
-						exit(0);
-					}				
-				}
-				else if (!strcmp(headerbytes,"data")) 
-				{
-					status = status | 0x08;
-
-					wavInfo->wavfilesize = subchunk_size;
-					
-					wavInfo->wavheadersize = ftell(infile);
-					wavInfo->wavfilesize += wavInfo->wavheadersize;
+	short ddinfo[4];
+	short i;
+	int numblkscod;
 
-					break;					
-				}
-				else
-				{
-					// Advance beyond unsupported subchunks
-					fseek(infile, subchunk_size, SEEK_CUR);
-				}
-			}
-			if(status == 0xF)
-				return(1);
-			else
-				return(0);
+	if(p_frame[0] == SYNC_WD_REV)
+	{
+		sinfo->byte_rev = 1;
+	}
+	else
+	{
+		sinfo->byte_rev = 0;
+	}
 
-		}		
+	/* Handle byte reversal */
+	for(i = 0; i < 4; i++)
+	{
+		if(sinfo->byte_rev)
+		{
+			ddinfo[i] = bytereverse(p_frame[i]);
+		}
 		else
 		{
-			// Assume a PCM file
-			return(0);
+			ddinfo[i] = p_frame[i];
+		}
+	}
+	
+	sinfo->bsid  = (int)((ddinfo[2] >> 3) & 0x001F);
+	
+	if (BSI_ISDD(sinfo->bsid)) /* Dolby Digital */
+	{
+		sinfo->is_ddp = 0;
+		sinfo->fscod = (int)((ddinfo[2] >> 14) & 0x0003);
+		
+		if (sinfo->fscod > MAXFSCOD)
+		{
+			return(ERR_INV_SAMP_RATE);
+		}
+		
+		sinfo->frmsizecod = (int)((ddinfo[2] >> 8) & 0x003f);
+		
+		if (sinfo->frmsizecod > MAXFRMSIZECOD)
+		{
+			return(ERR_INV_DATA_RATE);
+		}
+		
+		sinfo->datarate = sinfo->frmsizecod >> 1;
+		sinfo->framesize = frmsizetab[sinfo->fscod][sinfo->frmsizecod];
+		sinfo->numblks = 6; /* DD always has 6 frames per block */
+		sinfo->strmtyp = 0; /* DD only has one stream type */
+		sinfo->substreamid = 0; /* DD does not support substreams */
+	}
+	else if (BSI_ISDDP(sinfo->bsid)) /* DD+ */
+	{
+		sinfo->is_ddp = 1;
+		sinfo->fscod = (int)((ddinfo[2] >> 14) & 0x0003);
+		
+		if (sinfo->fscod > MAXFSCOD)
+		{
+			return(ERR_INV_SAMP_RATE);
 		}
+		
+		sinfo->framesize = (int)(ddinfo[1] & 0x07FF) + 1;
+	
+		if(sinfo->fscod == 3)
+		{					
+			sinfo->numblks = 6;
+		}
+		else
+		{
+			numblkscod = (int)((ddinfo[2] >> 12) & 0x0003);
+			
+			switch(numblkscod) 
+			{
+			case 0:
+			case 1:
+			case 2:
+				sinfo->numblks = numblkscod + 1;
+				break;
+			case 3:
+				sinfo->numblks = 6;
+				break;
+			default:
+				return(ERR_BAD_INPUT);
+			}
+		}
+
+		sinfo->strmtyp = (int)((ddinfo[1] >> 14) & 0x0003);		
+		sinfo->substreamid = (int)((ddinfo[1] >> 11) & 0x0007);
+
+	}
+	else	
+	{
+		return(ERR_BSID);
 	}
 
-	return(0);
+	return(ERR_NO_ERROR);
 }
 
 short bytereverse(short in)
@@ -1748,7 +2965,7 @@ int parse_preamble(File_Info *file_info) /* rewinds file pointer */
 	}
 	else
 	{
-		fseek(file_info->ac3file, -16, SEEK_CUR);
+		fseek64(file_info->ac3file, -16, SEEK_CUR);
 		return(0);
 	}
 
@@ -1759,7 +2976,7 @@ int parse_preamble(File_Info *file_info) /* rewinds file pointer */
 		case BITD16:
 			if(((iecsync[1] & 0xFFFF0000) >> 16) != PREAMBLE_B16)
 			{
-				fseek(file_info->ac3file, -16, SEEK_CUR);
+				fseek64(file_info->ac3file, -16, SEEK_CUR);
 				return(0);
 			}
 			break;
@@ -1767,7 +2984,7 @@ int parse_preamble(File_Info *file_info) /* rewinds file pointer */
 		case BITD20:
 			if(((iecsync[1] & 0xFFFFF000) >> 12) != PREAMBLE_B20)
 			{
-				fseek(file_info->ac3file, -16, SEEK_CUR);
+				fseek64(file_info->ac3file, -16, SEEK_CUR);
 				return(0);
 			}
 			break;
@@ -1775,13 +2992,13 @@ int parse_preamble(File_Info *file_info) /* rewinds file pointer */
 		case BITD24:
 			if(((iecsync[1] & 0xFFFFFF00) >> 8) != PREAMBLE_B24)
 			{
-				fseek(file_info->ac3file, -16, SEEK_CUR);
+				fseek64(file_info->ac3file, -16, SEEK_CUR);
 				return(0);
 			}
 			break;
 
 		default:
-			fseek(file_info->ac3file, -16, SEEK_CUR);
+			fseek64(file_info->ac3file, -16, SEEK_CUR);
 			return(0);
 			break;
 	}
@@ -1792,7 +3009,7 @@ int parse_preamble(File_Info *file_info) /* rewinds file pointer */
 		case BITD16:
 			if(((iecsync[2] & 0xFFFF0000) >> 16) != PREAMBLE_C16)	/* stream 0, 16-bit, Dolby E */
 			{
-				fseek(file_info->ac3file, -16, SEEK_CUR);
+				fseek64(file_info->ac3file, -16, SEEK_CUR);
 				return(0);
 			}
 			break;
@@ -1800,7 +3017,7 @@ int parse_preamble(File_Info *file_info) /* rewinds file pointer */
 		case BITD20:
 			if(((iecsync[2] & 0xFFFFF000) >> 12) != PREAMBLE_C20)	/* stream 0, 20-bit, Dolby E */
 			{
-				fseek(file_info->ac3file, -16, SEEK_CUR);
+				fseek64(file_info->ac3file, -16, SEEK_CUR);
 				return(0);
 			}
 			break;
@@ -1808,13 +3025,13 @@ int parse_preamble(File_Info *file_info) /* rewinds file pointer */
 		case BITD24:
 			if(((iecsync[2] & 0xFFFFFF00) >> 8) != PREAMBLE_C24)	/* stream 0, 24-bit, Dolby E */
 			{
-				fseek(file_info->ac3file, -16, SEEK_CUR);
+				fseek64(file_info->ac3file, -16, SEEK_CUR);
 				return(0);
 			}
 			break;
 
 		default:
-			fseek(file_info->ac3file, -16, SEEK_CUR);
+			fseek64(file_info->ac3file, -16, SEEK_CUR);
 			return(0);
 			break;
 	}
@@ -1837,7 +3054,7 @@ int parse_preamble(File_Info *file_info) /* rewinds file pointer */
 	}
 
 	/* return file pointer by bytes read */
-	fseek(file_info->ac3file, -16, SEEK_CUR);
+	fseek64(file_info->ac3file, -16, SEEK_CUR);
 	return(SMPTE_DDE_ID);
 }
 
@@ -2014,10 +3231,9 @@ int16_t get_ac4_data_type_dependent(int32_t burst_size, int32_t fr_idx) {
     case AC4_BURST_SIZE_2343FPS:
         return 13;
     default:
-        error_msg("Unrecognized AC-4 burst size. Failed to create preamble C", FATAL);
-        break;
+        /* checked by the reader before the burst is packed */
+        return -1;
     }
-    return 0;
 }
 
 int16_t get_ac4_preamble_c(int32_t burst_size, int32_t fr_idx) {
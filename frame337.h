@@ -43,6 +43,9 @@
 #include <io.h>
 #include <stdint.h>
 
+/* 64-bit file offsets */
+#define fseek64 _fseeki64
+#define ftell64 _ftelli64
 #endif
 
 #ifdef		UNIX
@@ -54,6 +57,11 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <stdint.h>
+#include <stdatomic.h>
+
+/* 64-bit file offsets, built with _FILE_OFFSET_BITS=64 */
+#define fseek64 fseeko
+#define ftell64 ftello
 #endif /* UNIX */
 
 /* Enumerations */
@@ -62,8 +70,16 @@ enum {AC3=0, EAC3, DOLBYE, AC4, UNKNOWN};
 enum { FPS_2398 = 1, FPS_24, FPS_25, FPS_2997, FPS_30 };
 enum { BITD16, BITD20, BITD24 };		/* bit depth enumeration */
 enum { WRITE, APPEND };					/* File types						*/
+enum { WAVE_RIFF, WAVE_RESERVED, WAVE_RF64 };	/* Output header layouts, WAVE_RESERVED becomes RF64 when needed */
+enum { WAVE_IN_PCM, WAVE_IN_RIFF, WAVE_IN_RF64, WAVE_IN_W64 };	/* Deformat input containers */
+enum { WAVE_OK, WAVE_ERR_NOT_WAVE, WAVE_ERR_TRUNCATED, WAVE_ERR_NO_FMT, WAVE_ERR_NO_DATA, WAVE_ERR_DS64, WAVE_ERR_CHANNELS, WAVE_ERR_BITS };
+enum { CRC_OFF, CRC_FLAG, CRC_SKIP, CRC_ABORT, CRC_COUNT };	/* What to do with a frame that fails its CRC */
+enum { CRC_OK, CRC_NONE, CRC_ERR_CRC1, CRC_ERR_CRC2 };
+enum { RESYNC_ANY, RESYNC_DD, RESYNC_AC4, RESYNC_DDE };	/* Stream families searched for after damage */
+enum { RESYNC_OK, RESYNC_MOVED, RESYNC_END };
 enum { WARNING, FATAL };				/* Error message types				*/
-enum {ERR_NO_ERROR, ERR_READ_ERROR, ERR_SYNCH_ERROR, ERR_INV_SAMP_RATE, ERR_INV_DATA_RATE, ERR_BSID, ERR_EOF};
+enum {ERR_NO_ERROR, ERR_READ_ERROR, ERR_SYNCH_ERROR, ERR_INV_SAMP_RATE, ERR_INV_DATA_RATE, ERR_BSID, ERR_EOF,
+	  ERR_WRITE_ERROR, ERR_NO_MEMORY, ERR_BAD_INPUT, ERR_BAD_OUTPUT, ERR_LIMIT, ERR_CRC};
 
 
 /*	Frame size equates */
@@ -99,6 +115,16 @@ enum { MODE11, MODE10, MODE20, MODE30, MODE21, MODE31, MODE22, MODE32 };
 #define DDE_BURST_SIZE_25FPS	3840
 #define DDE_BURST_SIZE_30FPS	3200
 #define BUFWORDSIZE	3072
+#define ERR_STR_BUF_LEN 256
+#define WAVE_HEADER_SIZE 44
+#define WAVE_HEADER_SIZE_RF64 80				/* with a ds64 chunk, or the JUNK chunk reserving its place */
+#define WAVE_RIFF_MAX 0xFFFFFFFFLL				/* largest size a RIFF chunk can hold */
+#define WAVE_MAX_EXPANSION 64					/* output bytes per input byte, at 24 kbps and above */
+#define CACHE_PATH_LEN 1024
+#define CACHE_DEFAULT_MB 1024
+#define FOLLOW_DEFAULT_IDLE 30			/* seconds */
+#define FOLLOW_SENTINEL_EXT ".done"
+#define FRAME337_VERSION "2.1.0"
 
 #define DDE_2997_REPRATE	5
 
@@ -133,6 +159,7 @@ enum { AC4_FPS_2398 = 0, AC4_FPS_24, AC4_FPS_25, AC4_FPS_2997, AC4_FPS_30, AC4_F
 
 
 #define PRMBLSIZE	4
+#define PAUSE_PREAMBLE_WORDS	5	/* Pa, Pb, Pc, Pd and the gap length of a pause burst */
 #define INITREADSIZE  3 
 
 
@@ -193,6 +220,9 @@ enum { AC4_FPS_2398 = 0, AC4_FPS_24, AC4_FPS_25, AC4_FPS_2997, AC4_FPS_30, AC4_F
 #define MAXFRMSIZECOD	38
 #define TC_FRMSIZE		16
 
+/* Timecode frame, 16-bit words in the byte order of its sync word, rate as FPS_2398..FPS_30, see timecode.c */
+enum { TC_WORD_SYNC, TC_WORD_HOURS, TC_WORD_MINUTES, TC_WORD_SECONDS, TC_WORD_FRAMES, TC_WORD_RATE };
+
 #define MAXSLICE		2056
 
 #define		BSI_BSID_STD			8					/* Standard ATSC A/52 bit-stream id	*/
@@ -221,19 +251,81 @@ typedef struct {
 	int substreamid;
 	short is_ddp;
 	int numblks;	
+	uint16_t tc[TC_FRMSIZE / 2];	/* timecode frame in front, native byte order, when has_tc */
 	} SLC_INFO;
 
+/* Decoded timecode frame */
 typedef struct
 {
-	int wavfilesize;
+	int hours;
+	int minutes;
+	int seconds;
+	int frames;
+	int rate;						/* FPS_2398..FPS_30 */
+} Timecode;
+
+typedef struct
+{
+	int container;					/* WAVE_IN_PCM, WAVE_IN_RIFF, WAVE_IN_RF64 or WAVE_IN_W64 */
 	int nchannels;
 	int nbits;
 	int sample_rate;
-	int wavheadersize;
+	int64_t data_offset;			/* start of the data chunk payload */
+	int64_t data_length;			/* in bytes, -1 if the data runs to the end of the file */
 
 }Wave_Struct;
 
 
+/* First error a run stopped on, left for the front end to report */
+typedef struct
+{
+	int code;						/* ERR_NO_ERROR while the run is going */
+	int64_t offset;					/* input byte offset, -1 if unknown */
+	long frame;						/* frame or burst index, -1 if unknown */
+	char reason[ERR_STR_BUF_LEN];
+#ifdef UNIX
+	atomic_int claimed;				/* stages on other threads can fail at once, the first keeps the error */
+#endif /* UNIX */
+}Run_Error;
+
+/* Frame CRC checking, see crc.c */
+typedef struct
+{
+	int policy;						/* CRC_OFF, CRC_FLAG, CRC_SKIP, CRC_ABORT, or CRC_COUNT to only count */
+	long checked;					/* frames carrying a CRC */
+	long failed;
+	long skipped;
+	int aborted;					/* CRC_ERR_ status that stopped the run under CRC_ABORT, at frame checked - 1 */
+}Crc_Info;
+
+/* RTP output, see rtp.c */
+#define RTP_CLOCK			48000		/* sample rate of every output */
+#define RTP_DEFAULT_PTIME	1000		/* packet time in microseconds */
+
+/* Real-time profile, see rt.c */
+#define RT_HIST_BUCKETS		24			/* powers of 2 in microseconds, the last one is open ended */
+#define RT_STDIO_BUF		65536		/* bytes of each stdio buffer */
+
+typedef struct
+{
+	long count;
+	int64_t total_ns;
+	int64_t min_ns;
+	int64_t max_ns;
+	long bucket[RT_HIST_BUCKETS];		/* bucket i counts times below 2^i us */
+}Rt_Hist;
+
+typedef struct
+{
+	int priority;						/* SCHED_FIFO priority, 0 to keep the normal scheduler */
+	int locked;							/* memory was locked for the run */
+	int fifo;							/* the run was moved to SCHED_FIFO */
+	Rt_Hist read_hist;					/* reading one burst */
+	Rt_Hist burst_hist;					/* from a burst being read to it being written */
+	unsigned char inbuf[RT_STDIO_BUF];	/* stdio buffers, in place before the run */
+	unsigned char outbuf[RT_STDIO_BUF];
+}Rt_Info;
+
 typedef struct 
 {
 	int bit_depth;
@@ -243,40 +335,333 @@ typedef struct
 	FILE *ac3file;
 	char *ac3fname;
 	char *smpte_fname;
+	int smpte_ftype;				/* WRITE or APPEND */
 	int shiftbits;
 	int stream_type;
 	int dolbye_frame_sz;  
-	int in_file_start;
-	int pa_align_changes;
-	int pc_value_changes;
-	int pd_value_changes;
+	int64_t in_file_start;
     int b_ac4_with_crc;
+	Crc_Info crc;
+	Run_Error err;
+	Rt_Info *rt;					/* real-time profile, NULL unless -rt */
 }File_Info;
 
+/* Deformat word loops, one instance per sample size, see descan.c */
+typedef int (*Getsync_Fn)(File_Info *file_info, uint8_t *dfbuf);	/* returns 0 at end of input or on error */
+typedef void (*Convert_Fn)(const uint8_t *inbuf, void *outbuf, int nwords);
+
 typedef struct {
     unsigned char *p;
     size_t bytes;
     unsigned long bit_offs;
 } AC4_BITREADER;
 
+/* Reader/packer/writer stages */
+
+#define PIPE_NUM_BUFS		8			/* burst buffers recycled through the pipeline */
+#define MAX_BURST_FRAMES	64			/* max DD/DD+ frames accumulated in one burst */
+
+typedef int (*Pipe_Read_Fn)(void *ctx, void *buf);		/* returns 0 at end of input or on error */
+typedef int (*Pipe_Work_Fn)(void *ctx, void *buf);		/* returns 0 on error */
+
+typedef struct
+{
+	Pipe_Read_Fn read;					/* parse input into a buffer */
+	Pipe_Work_Fn pack;					/* assemble / convert the buffer in place */
+	Pipe_Work_Fn write;					/* write the buffer to the output file */
+}Pipe_Stages;
+
+/* One SMPTE 337 burst on its way from the elementary stream to the output file */
+typedef struct
+{
+	int stream_type;
+	int burst_size;						/* in output words */
+	int out_wordbytes;					/* bytes per output word */
+	unsigned char *out;					/* packed burst, points into data or altbuf */
+	int skipped;						/* every frame failed its CRC, the burst is written as silence */
+	int pause;							/* pause burst filled in by the reader, written as it is */
+	int wave_bps;						/* output format as the reader knew it, for the writer */
+	int wave_frate;
+
+	/* DD/DD+ */
+	unsigned int accumwords;
+	int burst_info_ddp;
+	int is_ddp;
+	int nwords;
+	int framesizecod;
+	int sampratecod;
+	int nframes;
+	struct
+	{
+		int offset;						/* in 16-bit words from start of data */
+		int nwords;
+		short byte_rev;
+	} frames[MAX_BURST_FRAMES];
+
+	/* Dolby E */
+	int payload_words;
+
+	/* AC-4 */
+	int framesiz;
+	int fr_idx;
+
+	uint32_t data[MAX_DDE_BURST_SIZE];	/* frame data, packed in place */
+	uint16_t altbuf[BUFWORDSIZE];		/* Alternate buffer for 2/3 alignment */
+}Burst_Buf;
+
+typedef struct
+{
+	File_Info *file_info;
+	SLC_INFO sinfo;
+	int verbose;
+	int altformat;
+	int nStreamNum;
+	int done;
+	int flushbuf;
+	int burst_size;
+	int nwords;							/* # words in frame */
+	int framesizecod;					/* size of frame */
+	int sampratecod;					/* sample rate */
+	long framecount;					/* current frame number */
+	int64_t file_length;				/* in bytes */
+	int dde_frame_ctr;
+	int AC4_AES_burst_count;
+	int wave_bps;
+	int wave_frate;
+
+	/* zero-copy input map and output descriptor */
+	const uint8_t *in_map;
+	size_t in_len;
+	size_t in_pos;
+	int out_fd;
+
+	/* state of the output being appended to */
+	int64_t resume_bytes;				/* data bytes already in the output */
+	int resume_bps;
+	int resume_frate;
+	int resume_pending;					/* cadence phase still to be recovered */
+
+	int checkpoint;						/* rewrite the header after every burst */
+
+	int wave_layout;					/* WAVE_RIFF, WAVE_RESERVED or WAVE_RF64 */
+	int header_size;					/* bytes before the data */
+
+	/* preallocated output map, NULL when writing through the FILE */
+	uint8_t *out_map;
+	size_t out_map_len;
+	size_t out_map_pos;
+
+	/* recovery from damaged input, see resync.c */
+	int resync;							/* search past damage instead of stopping */
+	int resync_family;					/* RESYNC_ANY until the first burst is read */
+	int64_t burst_bytes;				/* input bytes of the last whole burst */
+	int pause_bursts;					/* pause bursts still to be written */
+	int64_t unsized_skip;				/* bytes skipped before the burst length was known */
+	int ac4_fr_idx;						/* frame rate of the last AC-4 frame */
+	int dde_fps;						/* frame rate of the last Dolby E frame */
+	long resync_count;
+	int64_t resync_skipped;
+	long resync_pauses;
+
+	/* gaps in the input timeline, see gapfill.c */
+	int fill_gaps;						/* write pause bursts for time missing from the input */
+	int ac4_seq_cnt;					/* sequence_counter of the last AC-4 frame, 0 if none */
+	int tc_valid;						/* a timecode frame anchors the DD/DD+ timeline */
+	int64_t tc_anchor;					/* sample frames from midnight at the anchor */
+	int64_t tc_elapsed;					/* sample frames read or paused since the anchor */
+	long gap_count;
+	long gap_pauses;
+
+	/* DD/DD+ timecode kept beside the output, see timecode.c */
+	FILE *tc_index;						/* per timecode frame index, NULL unless -timecode */
+	int64_t out_samples;				/* sample frames of the output before the burst being read */
+	int have_time_ref;
+	int64_t time_ref;					/* sample frames from midnight to the first sample */
+	long tc_count;
+
+	/* shared memory burst ring written instead of the output file, see shmring.c */
+	struct Shm_Ring_Header *ring;		/* NULL unless -shm */
+	size_t ring_len;
+	int64_t ring_frames;				/* sample frames published */
+	long ring_waits;					/* times the ring was full */
+
+	/* RTP sender used instead of the output file, see rtp.c */
+	struct Rtp_Sender *rtp;				/* NULL unless -rtp */
+	long rtp_packets;
+	long rtp_batches;
+	long rtp_refused;
+	long rtp_late;
+
+	/* inputs formatted one after another, see playlist.c */
+	struct Playlist *playlist;			/* NULL unless -playlist */
+}Format_Ctx;
+
+/* One SMPTE 337 burst payload on its way from the SMPTE file to the elementary stream */
+typedef struct
+{
+	int stream_type;
+	int bit_depth;
+	int nbits;							/* # of bits in SMPTE payload */
+	int valid;							/* payload was read completely */
+	int64_t offset;						/* input position of the payload */
+	long index;							/* burst number, from 0 */
+	int outbytes;
+	uint8_t dfbuf[MAX_DDE_BURST_SIZE * sizeof(uint32_t)];	/* Deformat Buffer */
+	uint32_t outbuf[MAX_DDE_BURST_SIZE];
+}Deformat_Buf;
+
+typedef struct
+{
+	File_Info *file_info;
+	Getsync_Fn getsync;					/* preamble search for the input's sample size */
+	Convert_Fn convert16, convert32;	/* payload to 16-bit or 32-bit stream words */
+	int verbose;
+	int num_frames;
+	int pa_first;
+	int pa_spacing_sum;
+	int preamble_count;
+	int pa_max, pa_min;
+	double pa_spacing_average;
+	int64_t last_file_loc;				/* input position after the last burst's preamble */
+	int prev_pc_value, prev_pd_value;
+	int pa_align_changes;
+	int pc_value_changes;
+	int pd_value_changes;
+}Deformat_Ctx;
+
+
+/* Streaming XXH64 state */
+typedef struct
+{
+	uint64_t total_len;
+	uint64_t v[4];
+	uint8_t mem[32];
+	size_t memsize;
+}Xxh64_State;
+
+/* Output cache, see cache.c */
+typedef struct
+{
+	const char *dir;					/* NULL when caching is off */
+	long long max_bytes;				/* size limit of the stored objects */
+	char optkey[128];					/* version and options that change the output */
+	uint64_t in_dev;					/* identity of the input */
+	uint64_t in_ino;
+	long long in_size;
+	long long in_mtime;
+	long in_mtime_ns;
+	Xxh64_State hash;					/* input content hash, fed as the input is read */
+	uint64_t digest;
+	int have_digest;
+	long hits;
+	long misses;
+}Cache_Info;
 
 /**** User code function prototypes ****/
 
 void show_usage(void);
+void show_cache_stats(Cache_Info *cache, int verbose, int hit);
 void error_msg(char *msg, int errcode);
-int deformat(File_Info *file_info, int verbose);
-int getsync (File_Info *file_info, uint8_t *dfbuf);
+int run_error(Run_Error *err, int code, int64_t offset, long frame, const char *fmt, ...);
+void report_error(const Run_Error *err);
+void exit_on_error(const File_Info *file_info);
+int deformat(File_Info *file_info, int verbose, int threaded);
 uint32_t getword32value(unsigned char *buf, int bps);
-void convertbuffer(unsigned char *inbuf, void *outbuf, int bps, int outwordsize, int bitcount, int bit_depth);
+Getsync_Fn select_getsync(File_Info *file_info);
+Convert_Fn select_convert(int bits_per_sample, int outwordsize);
 int parse_preamble(File_Info *file_info);
 int get_dde_frame_rate(uint32_t *dde_frame, int bit_depth);
 int BitUnkey(uint32_t *in_buf, int keyvalue, 	int bit_pointer, int numitems, int bit_depth);
 uint32_t *BitUnp_rj(uint32_t *in_buf, int datalist[], int *bit_pointer, int numitems, int numbits, int bit_depth);
-int checkstatus(int status);
-int parse_header(FILE *infile, Wave_Struct *wavInfo);
+int format_error(Format_Ctx *ctx, int code, const char *reason);
+int checkstatus(Format_Ctx *ctx, int status);
 short bytereverse(short in);
 void print_337_info(int frame_count, const char *pa_alignment_text, int pc_value, int pd_value);
+int parse_dd_frame_header(uint16_t *p_frame, SLC_INFO *sinfo);
 int get_timeslice(short readtype, uint16_t *inbuf, FILE *fileptr, long *numbytes, SLC_INFO *sinfo, int justinfo, int bufwords);
 unsigned long ac4_bread(AC4_BITREADER *bs, unsigned long nbits);
 int16_t get_ac4_data_type_dependent(int32_t burst_size, int32_t fr_idx);
-int16_t get_ac4_preamble_c(int32_t burst_size, int32_t fr_idx);
\ No newline at end of file
+int16_t get_ac4_preamble_c(int32_t burst_size, int32_t fr_idx);
+int format_read_burst(void *context, void *buffer);
+int format_read_stage(void *context, void *buffer);
+int dde_burst_size(Format_Ctx *ctx, int dolbye_fps);
+int ac4_burst_size(Format_Ctx *ctx, int fr_idx);
+int format_pack_burst(void *context, void *buffer);
+int format_write_burst(void *context, void *buffer);
+int deformat_read_burst(void *context, void *buffer);
+int deformat_pack_burst(void *context, void *buffer);
+int deformat_write_burst(void *context, void *buffer);
+int run_stages(void *ctx, const Pipe_Stages *stages, void *bufs, size_t bufsize, int nbufs, int threaded, int verbose, Rt_Info *rt);
+int format_zerocopy(Format_Ctx *ctx, int threaded);
+int wave_header_size(int layout);
+int wave_header_fits(int layout, int64_t data_bytes);
+void make_wave_header(uint8_t *hdr, int layout, int64_t data_bytes, int wave_bps, int wave_frate);
+int promote_to_rf64(Format_Ctx *ctx, int64_t data_bytes);
+int map_output(Format_Ctx *ctx, size_t total_bytes);
+int unmap_output(Format_Ctx *ctx);
+int cache_open(Cache_Info *cache, const char *in_fname);
+int cache_fetch(Cache_Info *cache, const char *out_fname);
+FILE *cache_wrap_input(Cache_Info *cache, FILE *infile);
+void cache_store(Cache_Info *cache, const char *out_fname);
+int resume_output(Format_Ctx *ctx);
+int resume_cadence(Format_Ctx *ctx, const int32_t *cadence);
+int finish_append(Format_Ctx *ctx);
+FILE *follow_input(FILE *infile, const char *fname, int idle_secs, int verbose);
+FILE *rtp_input(const char *addr, int bits_per_sample, int verbose);
+FILE *ts_input(FILE *infile, int pid, int verbose);
+FILE *mp4_input(FILE *infile, int track_id, Run_Error *err);
+int checkpoint_output(Format_Ctx *ctx, const Burst_Buf *burst);
+int parse_wave_header(FILE *infile, Wave_Struct *wavInfo);
+const char *wave_error_msg(int err);
+FILE *limit_input(FILE *infile, int64_t end);
+int analyze(File_Info *file_info, Wave_Struct *wavInfo, int verbose);
+long rewrap(File_Info *file_info, Wave_Struct *wavInfo, int out_bps, int verbose);
+void json_string(FILE *fp, const char *s);
+int plan_format(Format_Ctx *ctx, FILE *report, int verbose);
+int64_t predict_format_size(Format_Ctx *ctx);
+void crc16_init(void);
+uint16_t crc16(uint16_t crc, const uint8_t *buf, size_t len);
+int crc_frame_size(const uint8_t *frame, int nbytes);
+int crc_check_frame(const uint8_t *frame, int nbytes);
+int crc_verify(Crc_Info *crc, const uint8_t *frame, int nbytes);
+int crc_verify_payload(Crc_Info *crc, uint8_t *buf, int nbytes);
+int crc_abort_error(Crc_Info *crc, Run_Error *err, int64_t offset);
+void show_crc_stats(Crc_Info *crc);
+int stream_family(int stream_type);
+int resync_input(Format_Ctx *ctx, int64_t bad_pos);
+int resync_frame(Format_Ctx *ctx);
+void resync_burst_read(Format_Ctx *ctx, int64_t nbytes);
+int resync_read_burst(Format_Ctx *ctx, void *buffer, int64_t bad_pos);
+void fill_pause_words(Format_Ctx *ctx, Burst_Buf *burst, int burst_size);
+void fill_pause_preamble(Format_Ctx *ctx, uint16_t *words, int burst_size);
+void fill_pause_burst(Format_Ctx *ctx, Burst_Buf *burst);
+void show_resync_stats(Format_Ctx *ctx);
+int gap_check_ac4(Format_Ctx *ctx, int seq_cnt);
+void gap_check_tc(Format_Ctx *ctx, const uint16_t *tc);
+int gap_timed(Format_Ctx *ctx);
+void show_gap_stats(Format_Ctx *ctx);
+FILE *open_tc_index(const char *out_fname, int append, Run_Error *err);
+int decode_timecode(const uint16_t *tc, Timecode *time);
+int64_t tc_samples(const Timecode *time);
+void index_timecode(Format_Ctx *ctx, const uint16_t *tc, int numblocks);
+void resume_time_ref(Format_Ctx *ctx);
+int write_bext(Format_Ctx *ctx, int64_t data_bytes);
+void show_tc_stats(Format_Ctx *ctx);
+int open_ring(Format_Ctx *ctx, const char *name);
+int ring_write_burst(Format_Ctx *ctx, Burst_Buf *burst);
+void close_ring(Format_Ctx *ctx, int failed);
+void show_ring_stats(Format_Ctx *ctx);
+int open_rtp(Format_Ctx *ctx, const char *dest, int ptime_us, int pace);
+int rtp_write_burst(Format_Ctx *ctx, Burst_Buf *burst);
+int close_rtp(Format_Ctx *ctx, int failed);
+void show_rtp_stats(Format_Ctx *ctx);
+int64_t rt_now(void);
+void rt_record(Rt_Hist *hist, int64_t ns);
+void rt_stdio(Rt_Info *rt, FILE *infile, FILE *outfile);
+void rt_start(Rt_Info *rt, void *bufs, size_t len);
+void rt_stop(Rt_Info *rt);
+void show_rt_stats(Rt_Info *rt);
+int open_playlist(Format_Ctx *ctx, const char *list_fname, const char *grid);
+int playlist_read_burst(void *context, void *buffer);
+void close_playlist(Format_Ctx *ctx);
+void show_playlist_stats(Format_Ctx *ctx);
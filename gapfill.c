@@ -0,0 +1,170 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	gapfill.c
+ *		Pause bursts for time missing from the elementary stream
+ *
+ *		AC-4 frames carry a sequence_counter that runs from 1 to 1020 and
+ *		wraps to 1, 0 marking a start or splice. A jump means frames are
+ *		missing, and a pause burst goes in for each, ahead of the frame after
+ *		the jump.
+ *
+ *		DD/DD+ streams can carry timecode frames, each holding the video frame
+ *		the next audio frame starts in, decoded as in timecode.c. The first
+ *		valid one anchors the timeline, and each later one is compared with
+ *		the anchor plus the audio blocks read and pause bursts written since.
+ *		Without a gap the timecode is at most one video frame behind that;
+ *		when it is ahead, time is missing, and the fewest pause bursts of
+ *		1536 samples that cover it go in. A later timecode adds more if that
+ *		was short. Comparing with the anchor rather than the last timecode
+ *		keeps the rounding from building up.
+ *
+ *	History:
+ *		10/19/26	Gaps found from the decoded DD/DD+ timecode as well
+ *		10/19/26	Gaps found from the AC-4 sequence_counter only
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "frame337.h"
+
+#define AC4_SEQ_CNT_MAX		1020		/* sequence_counter wraps from here to 1 */
+#define GAP_MAX_SECONDS		60			/* longer jumps are taken as a new timeline, not filled */
+#define DD_BURST_SAMPLES	1536		/* sample frames in a DD/DD+ burst period */
+#define GAP_SAMPLE_RATE		48000
+
+/* Pause bursts needed ahead of an AC-4 frame for the frames missing before it, the caller reads it again after them */
+int gap_check_ac4(Format_Ctx *ctx,		/* IN/OUT: format context, last sequence_counter */
+				  int seq_cnt)			/* IN: sequence_counter of the frame */
+										/* returns the number of frames missing */
+{
+	int prev = ctx->ac4_seq_cnt;
+	int missing;
+	char errstr[ERR_STR_BUF_LEN];
+
+	ctx->ac4_seq_cnt = seq_cnt;
+	if (!prev || !seq_cnt)
+	{
+		return(0);
+	}
+
+	missing = (seq_cnt - (prev % AC4_SEQ_CNT_MAX + 1) + AC4_SEQ_CNT_MAX) % AC4_SEQ_CNT_MAX;
+	if (!missing)
+	{
+		return(0);
+	}
+
+	ctx->gap_count++;
+	if (missing > AC4_SEQ_CNT_MAX / 2)
+	{
+		/* as likely a restarted counter as lost frames */
+		snprintf(errstr, ERR_STR_BUF_LEN, "gap: AC-4 sequence_counter jumps from %d to %d, not filled", prev, seq_cnt);
+		error_msg(errstr, WARNING);
+		return(0);
+	}
+
+	snprintf(errstr, ERR_STR_BUF_LEN, "gap: AC-4 sequence_counter jumps from %d to %d, %d pause bursts", prev, seq_cnt, missing);
+	error_msg(errstr, WARNING);
+	ctx->gap_pauses += missing;
+
+	/* the frame is read again after the pauses, as the one following its predecessor */
+	ctx->ac4_seq_cnt = (seq_cnt + AC4_SEQ_CNT_MAX - 2) % AC4_SEQ_CNT_MAX + 1;
+
+	return(missing);
+}		//		gap_check_ac4()
+
+/* Compare a DD/DD+ timecode frame with the time read so far, queueing pause bursts for time missing */
+void gap_check_tc(Format_Ctx *ctx,		/* IN/OUT: format context, timeline and pause_bursts */
+				  const uint16_t *tc)	/* IN: timecode frame in front of the next frame, native byte order */
+{
+	Timecode time;
+	int64_t now, drift;
+	int lost;
+	char errstr[ERR_STR_BUF_LEN];
+
+	if (!decode_timecode(tc, &time))
+	{
+		return;
+	}
+	now = tc_samples(&time);
+	if (!ctx->tc_valid)
+	{
+		ctx->tc_valid = 1;
+		ctx->tc_anchor = now;
+		ctx->tc_elapsed = 0;
+		return;
+	}
+
+	drift = now - (ctx->tc_anchor + ctx->tc_elapsed);
+	if ((drift < -(int64_t)GAP_MAX_SECONDS * GAP_SAMPLE_RATE) || (drift > (int64_t)GAP_MAX_SECONDS * GAP_SAMPLE_RATE))
+	{
+		snprintf(errstr, ERR_STR_BUF_LEN, "gap: timecode jumps by %.3f s, taken as a new timeline",
+			(double)drift / GAP_SAMPLE_RATE);
+		error_msg(errstr, WARNING);
+		ctx->tc_anchor = now;
+		ctx->tc_elapsed = 0;
+		return;
+	}
+	if (drift <= 0)
+	{
+		return;
+	}
+
+	lost = (int)((drift + DD_BURST_SAMPLES - 1) / DD_BURST_SAMPLES);
+	ctx->pause_bursts += lost;
+	ctx->tc_elapsed += (int64_t)lost * DD_BURST_SAMPLES;
+	ctx->gap_count++;
+	ctx->gap_pauses += lost;
+
+	snprintf(errstr, ERR_STR_BUF_LEN, "gap: timecode %02d:%02d:%02d:%02d is %.3f s ahead of the audio, %d pause bursts",
+		time.hours, time.minutes, time.seconds, time.frames, (double)drift / GAP_SAMPLE_RATE, lost);
+	error_msg(errstr, WARNING);
+}		//		gap_check_tc()
+
+/* The stream times its own gaps, so skipped damage needs no estimate */
+int gap_timed(Format_Ctx *ctx)
+{
+	if (!ctx->fill_gaps)
+	{
+		return(0);
+	}
+	switch (stream_family(ctx->file_info->stream_type))
+	{
+		case RESYNC_AC4:
+			return(ctx->ac4_seq_cnt != 0);
+		case RESYNC_DD:
+			return(ctx->tc_valid);
+		default:
+			return(0);
+	}
+}		//		gap_timed()
+
+/* Report the gaps found */
+void show_gap_stats(Format_Ctx *ctx)	/* IN: format context after the conversion */
+{
+	if (ctx->fill_gaps)
+	{
+		printf("Gaps: %ld found, %ld pause bursts\n", ctx->gap_count, ctx->gap_pauses);
+	}
+}		//		show_gap_stats()
@@ -0,0 +1,546 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	mp4in.c
+ *		ISO base media file (MP4) input for formatting
+ *
+ *		The samples of one ac-3, ec-3 or ac-4 track are handed to the
+ *		formatter, in decoding order, through a stdio cookie stream, so
+ *		the frame reader sees the bytes it would read from an ES file.
+ *		The sample table (stsz, stsc and stco or co64) is turned into the
+ *		file offset, size and stream position of every sample when the
+ *		input is opened. Reads then copy each sample straight from a map of
+ *		the file, or read it in place when the input is another cookie
+ *		stream. An AC-4 sample is a raw frame, and a sync frame header
+ *		(0xAC40 and the frame size) is put in front of it, as the AC-4 path
+ *		expects. The stream length is known, so it can be seeked anywhere.
+ *
+ *		Fragmented files (moof) carry their samples outside the sample
+ *		table and are not read.
+ *
+ *	History:
+ *		10/19/26	Cookie stream track reader built on Linux only
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#ifdef __linux__
+#define _GNU_SOURCE					/* fopencookie() */
+#endif /* __linux__ */
+
+#include "frame337.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MP4_MOOV_MAX		(256 * 1024 * 1024)	/* a larger moov is taken as damage */
+#define MP4_AC4_HDR_SHORT	4					/* sync word and 16-bit size */
+#define MP4_AC4_HDR_LONG	7					/* sync word, 0xffff and 24-bit size */
+
+typedef struct
+{
+	FILE *file;
+	uint8_t *map;						/* NULL if the input cannot be mapped */
+	size_t map_len;
+
+	uint32_t track_id;
+	const char *codec;
+	int ac4;							/* samples get a sync frame header */
+	uint32_t nsamples;
+	int64_t *offset;					/* in the file */
+	uint32_t *size;
+	int64_t *start;						/* in the stream handed over, nsamples + 1 of them */
+
+	int64_t pos;						/* read position */
+	uint32_t cur;						/* sample at pos */
+}Mp4_Input;
+
+static uint32_t mp4_be32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t mp4_be64(const uint8_t *p)
+{
+	return ((uint64_t)mp4_be32(p) << 32) | mp4_be32(p + 4);
+}
+
+/* Find a box among the boxes in [p, end), returns its payload or NULL */
+static const uint8_t *mp4_find(const uint8_t *p, const uint8_t *end,
+							   const char *type,		/* IN: four character code */
+							   const uint8_t **box_end)	/* OUT: end of the payload */
+{
+	uint64_t size;
+	int hdr;
+
+	while (end - p >= 8)
+	{
+		size = mp4_be32(p);
+		hdr = 8;
+		if (size == 1)
+		{
+			if (end - p < 16)
+			{
+				return(NULL);
+			}
+			size = mp4_be64(p + 8);
+			hdr = 16;
+		}
+		else if (size == 0)
+		{
+			/* to the end of the enclosing box */
+			size = end - p;
+		}
+		if ((size < (uint64_t)hdr) || (size > (uint64_t)(end - p)))
+		{
+			return(NULL);
+		}
+		if (!memcmp(p + 4, type, 4))
+		{
+			*box_end = p + size;
+			return(p + hdr);
+		}
+		p += size;
+	}
+
+	return(NULL);
+}		//		mp4_find()
+
+/* Read from the input at a file offset, returns the bytes read */
+static size_t mp4_pread(Mp4_Input *in, int64_t off, void *buf, size_t len)
+{
+	if (in->map)
+	{
+		if ((off < 0) || ((uint64_t)off >= in->map_len))
+		{
+			return 0;
+		}
+		if (len > in->map_len - (size_t)off)
+		{
+			len = in->map_len - (size_t)off;
+		}
+		memcpy(buf, in->map + off, len);
+		return len;
+	}
+	if (fseek64(in->file, off, SEEK_SET))
+	{
+		return 0;
+	}
+	return fread(buf, 1, len, in->file);
+}
+
+/* Load the moov box, NULL if there is none */
+static uint8_t *mp4_load_moov(Mp4_Input *in, int64_t *moov_len, int *fragmented)
+{
+	uint8_t hdr[16];
+	uint8_t *moov = NULL;
+	int64_t off = 0;
+	uint64_t size;
+	int hlen;
+
+	*fragmented = 0;
+	while (mp4_pread(in, off, hdr, 16) >= 8)
+	{
+		size = mp4_be32(hdr);
+		hlen = 8;
+		if (size == 1)
+		{
+			size = mp4_be64(hdr + 8);
+			hlen = 16;
+		}
+		if (!memcmp(hdr + 4, "moof", 4))
+		{
+			*fragmented = 1;
+		}
+		if (!memcmp(hdr + 4, "moov", 4) && !moov && (size > (uint64_t)hlen) && (size - hlen <= MP4_MOOV_MAX))
+		{
+			*moov_len = size - hlen;
+			if (((moov = (uint8_t *)malloc(*moov_len)) == NULL)
+				|| (mp4_pread(in, off + hlen, moov, *moov_len) != (size_t)*moov_len))
+			{
+				free(moov);
+				return(NULL);
+			}
+		}
+		if ((size == 0) || (size < (uint64_t)hlen))
+		{
+			/* the last box, or damage */
+			break;
+		}
+		off += size;
+	}
+
+	return(moov);
+}		//		mp4_load_moov()
+
+/* Build the sample positions of a track from its sample table, returns 0 if the table is damaged */
+static int mp4_samples(Mp4_Input *in, const uint8_t *stbl, const uint8_t *stbl_end)
+{
+	const uint8_t *stsz, *stsc, *stco, *end, *sz_end, *sc_end;
+	uint32_t const_size, nchunks, nstsc, chunk, last_chunk, per_chunk, i, j, s;
+	int co64 = 0;
+	int64_t off;
+
+	if ((stco = mp4_find(stbl, stbl_end, "stco", &end)) == NULL)
+	{
+		stco = mp4_find(stbl, stbl_end, "co64", &end);
+		co64 = 1;
+	}
+	if ((stco == NULL) || ((stsz = mp4_find(stbl, stbl_end, "stsz", &sz_end)) == NULL)
+		|| ((stsc = mp4_find(stbl, stbl_end, "stsc", &sc_end)) == NULL))
+	{
+		return 0;
+	}
+	if ((sz_end - stsz < 12) || (sc_end - stsc < 8) || (end - stco < 8))
+	{
+		return 0;
+	}
+
+	const_size = mp4_be32(stsz + 4);
+	in->nsamples = mp4_be32(stsz + 8);
+	nstsc = mp4_be32(stsc + 4);
+	nchunks = mp4_be32(stco + 4);
+	if ((!const_size && ((uint64_t)(sz_end - stsz - 12) < 4ULL * in->nsamples))
+		|| ((uint64_t)(sc_end - stsc - 8) < 12ULL * nstsc)
+		|| ((uint64_t)(end - stco - 8) < (co64 ? 8ULL : 4ULL) * nchunks))
+	{
+		return 0;
+	}
+
+	/* one more than needed, so an empty track still has its tables */
+	if (((in->offset = (int64_t *)malloc((in->nsamples + 1) * sizeof(int64_t))) == NULL)
+		|| ((in->size = (uint32_t *)malloc((in->nsamples + 1) * sizeof(uint32_t))) == NULL)
+		|| ((in->start = (int64_t *)malloc((in->nsamples + 1) * sizeof(int64_t))) == NULL))
+	{
+		return 0;
+	}
+
+	/* each stsc run of chunks holds the same number of samples, laid end to end in the chunk */
+	s = 0;
+	for (i = 0; (i < nstsc) && (s < in->nsamples); i++)
+	{
+		chunk = mp4_be32(stsc + 8 + 12 * i);
+		per_chunk = mp4_be32(stsc + 8 + 12 * i + 4);
+		last_chunk = (i + 1 < nstsc) ? mp4_be32(stsc + 8 + 12 * (i + 1)) : nchunks + 1;
+		if ((chunk == 0) || (last_chunk > nchunks + 1))
+		{
+			return 0;
+		}
+		for (; (chunk < last_chunk) && (s < in->nsamples); chunk++)
+		{
+			off = co64 ? (int64_t)mp4_be64(stco + 8 + 8 * (chunk - 1)) : (int64_t)mp4_be32(stco + 8 + 4 * (chunk - 1));
+			for (j = 0; (j < per_chunk) && (s < in->nsamples); j++, s++)
+			{
+				in->size[s] = const_size ? const_size : mp4_be32(stsz + 12 + 4 * s);
+				in->offset[s] = off;
+				off += in->size[s];
+			}
+		}
+	}
+	if (s < in->nsamples)
+	{
+		return 0;
+	}
+
+	in->start[0] = 0;
+	for (s = 0; s < in->nsamples; s++)
+	{
+		in->start[s + 1] = in->start[s] + in->size[s];
+		if (in->ac4)
+		{
+			in->start[s + 1] += (in->size[s] < 0xffff) ? MP4_AC4_HDR_SHORT : MP4_AC4_HDR_LONG;
+		}
+	}
+
+	return 1;
+}		//		mp4_samples()
+
+/* Find the track and its sample table, returns 0 with the reason in err if there is none */
+static int mp4_track(Mp4_Input *in, const uint8_t *moov, int64_t moov_len,
+					 int track_id,			/* IN: track_ID to use, 0 for the first Dolby audio track */
+					 Run_Error *err)
+{
+	const uint8_t *end = moov + moov_len;
+	const uint8_t *trak, *trak_end, *tkhd, *tkhd_end, *mdia, *mdia_end, *minf, *minf_end;
+	const uint8_t *stbl, *stbl_end, *stsd, *stsd_end;
+	uint32_t id;
+
+	for (; (trak = mp4_find(moov, end, "trak", &trak_end)) != NULL; moov = trak_end)
+	{
+		if (((tkhd = mp4_find(trak, trak_end, "tkhd", &tkhd_end)) == NULL) || (tkhd_end - tkhd < 24)
+			|| ((mdia = mp4_find(trak, trak_end, "mdia", &mdia_end)) == NULL)
+			|| ((minf = mp4_find(mdia, mdia_end, "minf", &minf_end)) == NULL)
+			|| ((stbl = mp4_find(minf, minf_end, "stbl", &stbl_end)) == NULL)
+			|| ((stsd = mp4_find(stbl, stbl_end, "stsd", &stsd_end)) == NULL) || (stsd_end - stsd < 16))
+		{
+			continue;
+		}
+		/* version 1 has 64-bit times ahead of track_ID */
+		id = mp4_be32(tkhd + (tkhd[0] ? 20 : 12));
+		if (track_id && (id != (uint32_t)track_id))
+		{
+			continue;
+		}
+
+		/* the first sample entry names the coding */
+		in->codec = !memcmp(stsd + 12, "ac-3", 4) ? "AC-3" : !memcmp(stsd + 12, "ec-3", 4) ? "E-AC-3"
+			: !memcmp(stsd + 12, "ac-4", 4) ? "AC-4" : NULL;
+		if (!in->codec)
+		{
+			if (track_id)
+			{
+				return run_error(err, ERR_BAD_INPUT, -1, -1, "MP4 track %d is not AC-3, E-AC-3 or AC-4", track_id);
+			}
+			continue;
+		}
+		in->track_id = id;
+		in->ac4 = !memcmp(stsd + 12, "ac-4", 4);
+		if (!mp4_samples(in, stbl, stbl_end))
+		{
+			return run_error(err, ERR_BAD_INPUT, -1, -1, "MP4 track %u has a damaged sample table", id);
+		}
+		return 1;
+	}
+
+	if (track_id)
+	{
+		return run_error(err, ERR_BAD_INPUT, -1, -1, "MP4 track %d not found", track_id);
+	}
+	return run_error(err, ERR_BAD_INPUT, -1, -1, "MP4 input has no AC-3, E-AC-3 or AC-4 track");
+}		//		mp4_track()
+
+/* Sample holding stream position pos, the one after the last if pos is at the end */
+static uint32_t mp4_sample_at(Mp4_Input *in, int64_t pos)
+{
+	uint32_t lo = 0, hi = in->nsamples, mid;
+
+	/* reads are mostly in order */
+	if ((in->cur < in->nsamples) && (pos >= in->start[in->cur]))
+	{
+		if (pos < in->start[in->cur + 1])
+		{
+			return in->cur;
+		}
+		if ((in->cur + 1 < in->nsamples) && (pos < in->start[in->cur + 2]))
+		{
+			return in->cur + 1;
+		}
+	}
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (in->start[mid + 1] <= pos)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+static ssize_t mp4_read(void *cookie, char *buf, size_t size)
+{
+	Mp4_Input *in = (Mp4_Input *)cookie;
+	uint8_t hdr[MP4_AC4_HDR_LONG];
+	int64_t within;
+	size_t done = 0, n;
+	int hdr_len;
+	uint32_t s;
+
+	while ((done < size) && ((s = mp4_sample_at(in, in->pos)) < in->nsamples))
+	{
+		in->cur = s;
+		within = in->pos - in->start[s];
+		hdr_len = (int)(in->start[s + 1] - in->start[s] - in->size[s]);
+		if (within < hdr_len)
+		{
+			/* the AC-4 sync frame header */
+			hdr[0] = 0xac;
+			hdr[1] = 0x40;
+			if (hdr_len == MP4_AC4_HDR_SHORT)
+			{
+				hdr[2] = (uint8_t)(in->size[s] >> 8);
+				hdr[3] = (uint8_t)in->size[s];
+			}
+			else
+			{
+				hdr[2] = hdr[3] = 0xff;
+				hdr[4] = (uint8_t)(in->size[s] >> 16);
+				hdr[5] = (uint8_t)(in->size[s] >> 8);
+				hdr[6] = (uint8_t)in->size[s];
+			}
+			n = (size_t)(hdr_len - within);
+			n = (n < size - done) ? n : size - done;
+			memcpy(buf + done, hdr + within, n);
+		}
+		else
+		{
+			n = (size_t)(in->start[s + 1] - in->pos);
+			n = (n < size - done) ? n : size - done;
+			if (mp4_pread(in, in->offset[s] + within - hdr_len, buf + done, n) != n)
+			{
+				/* the sample table points past the end of the file */
+				errno = EIO;
+				return done ? (ssize_t)done : -1;
+			}
+		}
+		done += n;
+		in->pos += n;
+	}
+
+	return (ssize_t)done;
+}		//		mp4_read()
+
+static int mp4_seek(void *cookie, off64_t *offset, int whence)
+{
+	Mp4_Input *in = (Mp4_Input *)cookie;
+	int64_t base;
+
+	switch (whence)
+	{
+		case SEEK_SET:
+			base = 0;
+			break;
+		case SEEK_CUR:
+			base = in->pos;
+			break;
+		case SEEK_END:
+			base = in->start[in->nsamples];
+			break;
+		default:
+			errno = EINVAL;
+			return -1;
+	}
+	if (base + *offset < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	in->pos = base + *offset;
+	*offset = in->pos;
+
+	return 0;
+}
+
+static void mp4_free(Mp4_Input *in)
+{
+	if (in->map)
+	{
+		munmap(in->map, in->map_len);
+	}
+	free(in->offset);
+	free(in->size);
+	free(in->start);
+	free(in);
+}
+
+static int mp4_close(void *cookie)
+{
+	Mp4_Input *in = (Mp4_Input *)cookie;
+
+	printf("MP4 input: track %u (%s), %u samples, %lld bytes\n", in->track_id, in->codec, in->nsamples,
+		(long long)in->start[in->nsamples]);
+	fclose(in->file);
+	mp4_free(in);
+
+	return 0;
+}
+#endif /* __linux__ */
+
+/* Open a track of an MP4 file as an elementary stream input,
+   NULL with the reason in err if it has none, the input then stays with the caller */
+FILE *mp4_input(FILE *infile,				/* IN: MP4 file opened for reading, owned by the returned stream */
+				int track_id,				/* IN: track_ID to use, 0 for the first AC-3, E-AC-3 or AC-4 track */
+				Run_Error *err)				/* OUT: why the input cannot be used */
+{
+#ifdef __linux__
+	cookie_io_functions_t io = { mp4_read, NULL, mp4_seek, mp4_close };
+	Mp4_Input *in;
+	struct stat st;
+	uint8_t *moov;
+	int64_t moov_len = 0;
+	int fragmented;
+	FILE *fp;
+
+	if ((in = (Mp4_Input *)calloc(1, sizeof(Mp4_Input))) == NULL)
+	{
+		run_error(err, ERR_NO_MEMORY, -1, -1, "Unable to allocate MP4 input");
+		return(NULL);
+	}
+	in->file = infile;
+
+	/* a file is mapped, a stream through another cookie is read where each sample is */
+	if ((fileno(infile) >= 0) && !fstat(fileno(infile), &st) && S_ISREG(st.st_mode) && (st.st_size > 0)
+		&& ((in->map = (uint8_t *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(infile), 0)) != MAP_FAILED))
+	{
+		in->map_len = st.st_size;
+	}
+	else
+	{
+		in->map = NULL;
+	}
+
+	if ((moov = mp4_load_moov(in, &moov_len, &fragmented)) == NULL)
+	{
+		run_error(err, ERR_BAD_INPUT, -1, -1, fragmented ? "Fragmented MP4 input is not supported" : "MP4 input has no moov box");
+		mp4_free(in);
+		return(NULL);
+	}
+	if (!mp4_track(in, moov, moov_len, track_id, err))
+	{
+		free(moov);
+		mp4_free(in);
+		return(NULL);
+	}
+	free(moov);
+	if (!in->nsamples && fragmented)
+	{
+		run_error(err, ERR_BAD_INPUT, -1, -1, "Fragmented MP4 input is not supported");
+		mp4_free(in);
+		return(NULL);
+	}
+	if (in->map)
+	{
+		madvise(in->map, in->map_len, MADV_SEQUENTIAL);
+	}
+
+	if ((fp = fopencookie(in, "rb", io)) == NULL)
+	{
+		run_error(err, ERR_NO_MEMORY, -1, -1, "Unable to open MP4 input stream");
+		mp4_free(in);
+	}
+
+	return(fp);
+#else
+	run_error(err, ERR_BAD_INPUT, -1, -1, "MP4 input is not supported on this platform");
+	return(NULL);
+#endif /* __linux__ */
+}		//		mp4_input()
@@ -0,0 +1,116 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	outmap.c
+ *		Preallocated, memory mapped output file
+ *
+ *		The formatter can predict the size of its output before writing any
+ *		of it. The output file is then allocated in one piece, so the file
+ *		system can give it contiguous extents, and mapped. The bursts are
+ *		copied straight into the map and the RIFF header is written once,
+ *		with its final sizes.
+ *
+ *	History:
+ *		10/19/26	Errors are returned to the caller instead of exiting
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "frame337.h"
+
+#ifdef UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif /* UNIX */
+
+/* Allocate and map the output file, returns 0 if that is not possible and the FILE should be used,
+   -1 if the allocation could not be undone */
+int map_output(Format_Ctx *ctx,			/* IN/OUT: format context, output file already open for update */
+			   size_t total_bytes)		/* IN: final size of the output file */
+{
+#ifdef UNIX
+	int fd;
+	void *map;
+
+	if (total_bytes == 0)
+	{
+		return 0;
+	}
+
+	fflush(ctx->file_info->smpte_file);
+	fd = fileno(ctx->file_info->smpte_file);
+
+	if (posix_fallocate(fd, 0, total_bytes) != 0)
+	{
+		return 0;
+	}
+
+	map = mmap(NULL, total_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+	{
+		if (ftruncate(fd, 0))
+		{
+			run_error(&ctx->file_info->err, ERR_WRITE_ERROR, -1, -1, "decode: Unable to write to output file");
+			return -1;
+		}
+		return 0;
+	}
+
+	madvise(map, total_bytes, MADV_SEQUENTIAL);
+
+	ctx->out_map = (uint8_t *)map;
+	ctx->out_map_len = total_bytes;
+	ctx->out_map_pos = 0;
+
+	return 1;
+#else
+	return 0;
+#endif /* UNIX */
+}		//		map_output()
+
+/* Unmap the output file, trimming it to what was written, returns 0 on error */
+int unmap_output(Format_Ctx *ctx)		/* IN/OUT: format context */
+{
+#ifdef UNIX
+	size_t len = ctx->out_map_len;
+
+	munmap(ctx->out_map, len);
+	ctx->out_map = NULL;
+	ctx->out_map_len = 0;
+
+	if (ctx->out_map_pos != len)
+	{
+		if (ftruncate(fileno(ctx->file_info->smpte_file), ctx->out_map_pos))
+		{
+			return run_error(&ctx->file_info->err, ERR_WRITE_ERROR, -1, -1, "decode: Unable to write to output file");
+		}
+	}
+#else
+	ctx->out_map = NULL;
+	ctx->out_map_len = 0;
+#endif /* UNIX */
+
+	return 1;
+}		//		unmap_output()
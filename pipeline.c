@@ -0,0 +1,324 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	pipeline.c
+ *		Reader/packer/writer stage runner for AC-3 SMPTE337 conversion program
+ *
+ *		The stages are either run one after the other on the calling thread,
+ *		or on three threads connected by bounded single-producer/single-consumer
+ *		queues. Buffers are recycled from the writer back to the reader, so
+ *		nothing is allocated once the stages are running and bursts are
+ *		written in the order they were read. A stage that fails stops the run,
+ *		the error itself is left in the run's context for the caller. Under
+ *		the real-time profile every burst is timed from the end of its read
+ *		to the end of its write.
+ *
+ *	History:
+ *		10/19/26	Queue occupancy only reported with -v
+ *		10/19/26	Bursts are timed under the real-time profile
+ *		10/19/26	A failing stage stops the run instead of the program
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "frame337.h"
+
+#ifdef UNIX
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define PIPE_QUEUE_LEN		16			/* power of 2, larger than PIPE_NUM_BUFS */
+#define PIPE_SPIN_COUNT		64			/* yields before a waiting stage starts sleeping */
+#define PIPE_SLEEP_NS		50000		/* sleep of a waiting stage */
+#define PIPE_END			-1			/* queued after the last buffer */
+#define PIPE_RT_STACK		(1024 * 1024)	/* thread stack under -rt, all of it is locked */
+
+/* Lock-free queue of buffer indices with one producer and one consumer thread */
+typedef struct
+{
+	atomic_uint head;					/* next slot written by the producer */
+	atomic_uint tail;					/* next slot read by the consumer */
+	int slot[PIPE_QUEUE_LEN];
+
+	/* statistics, only touched by the consumer */
+	unsigned long occupancy_sum;
+	unsigned long pops;
+	unsigned int occupancy_max;
+	unsigned long waits;				/* consumer found the queue empty */
+}Spsc_Queue;
+
+typedef struct
+{
+	void *ctx;
+	const Pipe_Stages *stages;
+	unsigned char *bufs;
+	size_t bufsize;
+	Spsc_Queue free_q;					/* writer -> reader, recycled buffers */
+	Spsc_Queue read_q;					/* reader -> packer */
+	Spsc_Queue pack_q;					/* packer -> writer */
+	atomic_int failed;					/* a stage failed, the rest only drain the queues */
+	Rt_Info *rt;						/* real-time profile, NULL unless -rt */
+	int64_t read_done[PIPE_QUEUE_LEN];	/* when each buffer's read finished, under -rt */
+}Pipe_Run;
+
+static void queue_push(Spsc_Queue *q, int value)
+{
+	unsigned int head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+	/* never full: fewer buffers are in flight than the queue holds */
+	q->slot[head & (PIPE_QUEUE_LEN - 1)] = value;
+	atomic_store_explicit(&q->head, head + 1, memory_order_release);
+}
+
+static int queue_pop(Spsc_Queue *q)
+{
+	unsigned int tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+	unsigned int head = atomic_load_explicit(&q->head, memory_order_acquire);
+	unsigned int spins = 0;
+	struct timespec pause = { 0, PIPE_SLEEP_NS };
+	int value;
+
+	if (head == tail)
+	{
+		q->waits++;
+		do
+		{
+			if (spins++ < PIPE_SPIN_COUNT)
+			{
+				sched_yield();
+			}
+			else
+			{
+				nanosleep(&pause, NULL);
+			}
+			head = atomic_load_explicit(&q->head, memory_order_acquire);
+		} while (head == tail);
+	}
+
+	q->occupancy_sum += head - tail;
+	if (head - tail > q->occupancy_max)
+	{
+		q->occupancy_max = head - tail;
+	}
+	q->pops++;
+
+	value = q->slot[tail & (PIPE_QUEUE_LEN - 1)];
+	atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+
+	return value;
+}
+
+static void *packer_thread(void *arg)
+{
+	Pipe_Run *run = (Pipe_Run *)arg;
+	int index;
+
+	while ((index = queue_pop(&run->read_q)) != PIPE_END)
+	{
+		if (!atomic_load(&run->failed) && !run->stages->pack(run->ctx, run->bufs + index * run->bufsize))
+		{
+			atomic_store(&run->failed, 1);
+		}
+		queue_push(&run->pack_q, index);
+	}
+	queue_push(&run->pack_q, PIPE_END);
+
+	return NULL;
+}
+
+static void *writer_thread(void *arg)
+{
+	Pipe_Run *run = (Pipe_Run *)arg;
+	int index;
+
+	while ((index = queue_pop(&run->pack_q)) != PIPE_END)
+	{
+		if (!atomic_load(&run->failed) && !run->stages->write(run->ctx, run->bufs + index * run->bufsize))
+		{
+			atomic_store(&run->failed, 1);
+		}
+		if (run->rt)
+		{
+			/* the queues' release and acquire order read_done[] between the threads */
+			rt_record(&run->rt->burst_hist, rt_now() - run->read_done[index]);
+		}
+		queue_push(&run->free_q, index);
+	}
+
+	return NULL;
+}
+
+static void print_queue_info(const char *name, const char *consumer, Spsc_Queue *q)
+{
+	printf("%-16s: average %4.2f, maximum %u, %s waited %lu times\n", name,
+		q->pops ? (double)q->occupancy_sum / (double)q->pops : 0.0,
+		q->occupancy_max, consumer, q->waits);
+}
+#endif /* UNIX */
+
+/* Run read, pack and write on every buffer until the reader reaches end of input */
+static int run_buffers(void *ctx,					/* IN/OUT: context passed to every stage */
+				const Pipe_Stages *stages,	/* IN: stage functions */
+				void *bufs,					/* IN: nbufs buffers of bufsize bytes each */
+				size_t bufsize,				/* IN: size of one buffer */
+				int nbufs,					/* IN: number of buffers */
+				int threaded,				/* IN: run each stage on its own thread */
+				int verbose,				/* IN: report the queue occupancy of a threaded run */
+				Rt_Info *rt)				/* IN/OUT: burst times are recorded here, or NULL */
+											/* returns 0 if the pack or write stage failed */
+{
+	int64_t start = 0, read_done = 0;
+#ifdef UNIX
+	Pipe_Run run;
+	pthread_attr_t attr;
+	pthread_t packer, writer;
+	int index;
+	int i;
+
+	if (threaded && nbufs > 1)
+	{
+		memset(&run, 0, sizeof(run));
+		run.ctx = ctx;
+		run.stages = stages;
+		run.bufs = (unsigned char *)bufs;
+		run.bufsize = bufsize;
+		run.rt = rt;
+
+		for (i = 0; i < nbufs && i < PIPE_QUEUE_LEN - 1; i++)
+		{
+			queue_push(&run.free_q, i);
+		}
+
+		/* locked memory is limited, keep the stacks small when all of it is locked */
+		pthread_attr_init(&attr);
+		if (rt)
+		{
+			pthread_attr_setstacksize(&attr, PIPE_RT_STACK);
+		}
+		if (pthread_create(&packer, &attr, packer_thread, &run))
+		{
+			pthread_attr_destroy(&attr);
+			error_msg("Unable to start pipeline threads, running the stages in turn", WARNING);
+			return run_buffers(ctx, stages, bufs, bufsize, nbufs, 0, verbose, rt);
+		}
+		if (pthread_create(&writer, &attr, writer_thread, &run))
+		{
+			/* nothing was read yet, the packer only sees the end */
+			queue_push(&run.read_q, PIPE_END);
+			pthread_join(packer, NULL);
+			pthread_attr_destroy(&attr);
+			error_msg("Unable to start pipeline threads, running the stages in turn", WARNING);
+			return run_buffers(ctx, stages, bufs, bufsize, nbufs, 0, verbose, rt);
+		}
+		pthread_attr_destroy(&attr);
+
+		for (;;)
+		{
+			index = queue_pop(&run.free_q);
+			start = rt ? rt_now() : 0;
+			if (atomic_load(&run.failed) || !stages->read(ctx, run.bufs + index * bufsize))
+			{
+				break;
+			}
+			if (rt)
+			{
+				run.read_done[index] = rt_now();
+				rt_record(&rt->read_hist, run.read_done[index] - start);
+			}
+			queue_push(&run.read_q, index);
+		}
+		queue_push(&run.read_q, PIPE_END);
+
+		pthread_join(packer, NULL);
+		pthread_join(writer, NULL);
+
+		if (verbose)
+		{
+			printf("Pipeline queue occupancy (%d buffers):\n", nbufs);
+			print_queue_info("free -> reader", "reader", &run.free_q);
+			print_queue_info("reader -> packer", "packer", &run.read_q);
+			print_queue_info("packer -> writer", "writer", &run.pack_q);
+		}
+
+		return !atomic_load(&run.failed);
+	}
+#else
+	if (threaded)
+	{
+		error_msg("Pipelined processing is not supported on this platform", WARNING);
+	}
+#endif /* UNIX */
+
+	for (;;)
+	{
+		start = rt ? rt_now() : 0;
+		if (!stages->read(ctx, bufs))
+		{
+			break;
+		}
+		if (rt)
+		{
+			read_done = rt_now();
+			rt_record(&rt->read_hist, read_done - start);
+		}
+		if (!stages->pack(ctx, bufs) || !stages->write(ctx, bufs))
+		{
+			return 0;
+		}
+		if (rt)
+		{
+			rt_record(&rt->burst_hist, rt_now() - read_done);
+		}
+	}
+
+	return 1;
+}
+
+/* Run the stages, under the real-time profile when rt is given */
+int run_stages(void *ctx,					/* IN/OUT: context passed to every stage */
+				const Pipe_Stages *stages,	/* IN: stage functions */
+				void *bufs,					/* IN: nbufs buffers of bufsize bytes each */
+				size_t bufsize,				/* IN: size of one buffer */
+				int nbufs,					/* IN: number of buffers */
+				int threaded,				/* IN: run each stage on its own thread */
+				int verbose,				/* IN: report the queue occupancy of a threaded run */
+				Rt_Info *rt)				/* IN/OUT: real-time profile, or NULL */
+											/* returns 0 if the pack or write stage failed */
+{
+	int status;
+
+	if (rt)
+	{
+		rt_start(rt, bufs, bufsize * nbufs);
+	}
+	status = run_buffers(ctx, stages, bufs, bufsize, nbufs, threaded, verbose, rt);
+	if (rt)
+	{
+		rt_stop(rt);
+	}
+
+	return status;
+}		//		run_stages()
@@ -0,0 +1,463 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	plan.c
+ *		Dry run of formatting, from the frame headers of the elementary stream
+ *
+ *		Only the headers needed to group frames into bursts are read, the
+ *		payloads are seeked over. Bursts are sized with the same cadence
+ *		tables the formatter uses, so the burst count and output size are
+ *		those formatting would produce. Each burst's fill is reported
+ *		relative to the space the formatter allows for it, so a stream
+ *		that would stop formatting with a data rate error is found before
+ *		any storage is committed to it.
+ *
+ *	History:
+ *		10/19/26	predict_format_size() walks the frame headers as the plan does
+ *		10/19/26	Dolby E frame buffer kept in Plan_Info, not a static
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "frame337.h"
+
+extern const uint16_t fratetab [NFSCOD];
+extern const int bitdepthtab [3];
+
+#define PLAN_AC4_TOC_BYTES	4			/* enough of the AC-4 TOC for the frame rate */
+
+static const char *dde_fps_name[] = { "unknown", "23.98", "24", "25", "29.97", "30" };
+static const char *ac4_fps_name[] = { "23.98", "24", "25", "29.97", "30", "47.95", "48", "50", "59.94", "60", "100", "119.88", "120", "23.44" };
+
+typedef struct
+{
+	Format_Ctx *ctx;
+	int stream_type;
+	long frames;
+	long bursts;
+	int64_t data_bytes;
+	int64_t sample_frames;				/* output duration in samples */
+	int rate_code;						/* Dolby E frame_rate_code or AC-4 frame_rate_index, -1 for DD/DD+ */
+	long rate_changes;
+	int burst_min, burst_max;			/* in words */
+	int payload_bits;					/* bits per sample of the payload words */
+	double fill_sum;
+	double fill_peak;
+	long peak_burst;
+	long over_limit;
+	double payload_bits_sum;
+	double kbps_peak;
+	const char *error;					/* why the walk stopped before the end of the input */
+	int64_t error_offset;
+	uint32_t dde_frame[MAX_DDE_BURST_SIZE];	/* only the start is read, the rest stays zero */
+}Plan_Info;
+
+/* Account for one burst the formatter would write */
+static void plan_burst(Plan_Info *plan,
+					   int burst_size,			/* IN: in output words */
+					   int bytes_per_word,		/* IN: of the output */
+					   double used,				/* IN: words of the burst taken, preamble included */
+					   double capacity,			/* IN: words the formatter allows to be taken */
+					   double payload_bits)		/* IN: elementary stream bits carried */
+{
+	Format_Ctx *ctx = plan->ctx;
+	double fill = used / capacity;
+	double kbps = payload_bits * ctx->wave_frate / (burst_size / 2) / 1000.0;
+
+	if (!plan->bursts || (burst_size < plan->burst_min))
+		plan->burst_min = burst_size;
+	if (!plan->bursts || (burst_size > plan->burst_max))
+		plan->burst_max = burst_size;
+	if (!plan->bursts || (fill > plan->fill_peak))
+	{
+		plan->fill_peak = fill;
+		plan->peak_burst = plan->bursts;
+	}
+	if (kbps > plan->kbps_peak)
+		plan->kbps_peak = kbps;
+	if (fill > 1.0)
+		plan->over_limit++;
+
+	plan->fill_sum += fill;
+	plan->payload_bits_sum += payload_bits;
+	plan->data_bytes += (int64_t)burst_size * bytes_per_word;
+	plan->sample_frames += burst_size / 2;
+	plan->bursts++;
+}
+
+static void plan_rate(Plan_Info *plan, int rate_code)
+{
+	if (plan->bursts && (rate_code != plan->rate_code))
+	{
+		plan->rate_changes++;
+	}
+	plan->rate_code = rate_code;
+}
+
+/* One Dolby E frame, the frame rate comes from the metadata segment at its start */
+static int plan_dde_burst(Plan_Info *plan)
+{
+	Format_Ctx *ctx = plan->ctx;
+	File_Info *file_info = ctx->file_info;
+	uint32_t *frame = plan->dde_frame;
+	int64_t start = ftell64(file_info->ac3file);
+	int64_t frame_bytes = (int64_t)(file_info->dolbye_frame_sz + PRMBLSIZE) * sizeof(uint32_t);
+	int head = (file_info->dolbye_frame_sz + PRMBLSIZE < 16) ? file_info->dolbye_frame_sz + PRMBLSIZE : 16;
+	int fps, size;
+
+	ctx->wave_bps = 24;
+	ctx->wave_frate = 48000;
+
+	if ((start + frame_bytes > ctx->file_length)
+		|| (fread(frame, sizeof(uint32_t), head, file_info->ac3file) != (size_t)head))
+	{
+		plan->error = "Dolby E frame truncated";
+		return 0;
+	}
+	fps = get_dde_frame_rate(frame, file_info->bit_depth);
+	if ((size = dde_burst_size(ctx, fps)) != 0)
+	{
+		ctx->burst_size = size;
+	}
+	else if (!plan->bursts)
+	{
+		plan->error = "Unsupported Dolby E frame rate";
+		return 0;
+	}
+	ctx->dde_frame_ctr++;
+	plan_rate(plan, fps);
+
+	plan->payload_bits = bitdepthtab[file_info->bit_depth];
+	plan->frames++;
+	plan_burst(plan, ctx->burst_size, 3, file_info->dolbye_frame_sz + PRMBLSIZE, ctx->burst_size,
+		(double)file_info->dolbye_frame_sz * bitdepthtab[file_info->bit_depth]);
+
+	fseek64(file_info->ac3file, start + frame_bytes, SEEK_SET);
+	return 1;
+}
+
+/* DD/DD+ frames up to a full set of 6 blocks, grouped exactly as format_read_burst() does */
+static int plan_dd_burst(Plan_Info *plan)
+{
+	Format_Ctx *ctx = plan->ctx;
+	FILE *fp = ctx->file_info->ac3file;
+	SLC_INFO *sinfo = &ctx->sinfo;
+	uint16_t hdr[4 + TC_FRMSIZE / 2];
+	long numbytes = 0;
+	int numblocks = 0;
+	int lastnumblocks = 0;
+	int frameset = 0;
+	int nframes = 0;
+	unsigned int accumwords = PRMBLSIZE;
+	int status;
+
+	ctx->wave_bps = 16;
+
+	while (!frameset && !ctx->done)
+	{
+		/* readtype 3 seeks over the timecode and the frame after parsing its header */
+		if ((status = get_timeslice(3, hdr, fp, &numbytes, sinfo, 0, 0)) != ERR_NO_ERROR)
+		{
+			ctx->done = 1;
+			if (status != ERR_EOF)
+			{
+				plan->error = "DD/DD+ sync lost";
+				plan->error_offset = ftell64(fp);
+			}
+			break;
+		}
+		ctx->wave_frate = fratetab[sinfo->fscod];
+
+		if (numblocks == 0)
+		{
+			lastnumblocks = sinfo->numblks;
+		}
+		if (sinfo->numblks != lastnumblocks)
+		{
+			fseek64(fp, -sinfo->framesize * sizeof(short), SEEK_CUR);
+			break;
+		}
+		if (ftell64(fp) > ctx->file_length)
+		{
+			/* the formatter cannot read the rest of this frame */
+			ctx->done = 1;
+			plan->error = "DD/DD+ frame truncated";
+			break;
+		}
+
+		ctx->burst_size = sinfo->is_ddp ? DD_PLUS_BURST_SIZE : DD_BURST_SIZE;
+		plan->stream_type = sinfo->is_ddp ? EAC3 : AC3;
+
+		if (((sinfo->strmtyp == 0) || (sinfo->strmtyp == 2)) && (sinfo->substreamid == 0))
+		{
+			numblocks += sinfo->numblks;
+		}
+		accumwords += sinfo->framesize;
+		nframes++;
+		plan->frames++;
+
+		/* look ahead at the next frame, a set ends before the next independent substream 0 */
+		if (get_timeslice(3, hdr, fp, &numbytes, sinfo, 1, 0) != ERR_NO_ERROR)
+		{
+			ctx->done = 1;
+		}
+		else
+		{
+			fseek64(fp, -8, SEEK_CUR);
+		}
+		if ((numblocks == 6) && (((sinfo->strmtyp == 0) || (sinfo->strmtyp == 2)) && (sinfo->substreamid == 0)))
+		{
+			frameset = 1;
+		}
+	}
+
+	if (!nframes || (ctx->done && !numblocks))
+	{
+		return 0;
+	}
+
+	plan->payload_bits = 16;
+	plan_burst(plan, ctx->burst_size, 2, accumwords, ctx->burst_size - 4, (double)(accumwords - PRMBLSIZE) * 16);
+
+	return(!plan->error);
+}
+
+/* One AC-4 frame, the frame rate comes from the start of its TOC */
+static int plan_ac4_burst(Plan_Info *plan, int with_crc)
+{
+	Format_Ctx *ctx = plan->ctx;
+	FILE *fp = ctx->file_info->ac3file;
+	int64_t start = ftell64(fp);
+	uint8_t hdr[7];
+	uint8_t toc[PLAN_AC4_TOC_BYTES];
+	AC4_BITREADER bs = { toc, sizeof(toc), 0 };
+	int framesiz, raw_framesiz, hdr_len = 4;
+	int fr_idx;
+	int size;
+
+	ctx->wave_bps = 16;
+	ctx->wave_frate = 48000;
+
+	if (fread(hdr, 1, 4, fp) != 4)
+	{
+		plan->error = "AC-4 frame truncated";
+		return 0;
+	}
+	if ((hdr[2] == 0xFF) && (hdr[3] == 0xFF))
+	{
+		/* extended length field */
+		if (fread(&hdr[4], 1, 3, fp) != 3)
+		{
+			plan->error = "AC-4 frame truncated";
+			return 0;
+		}
+		raw_framesiz = (hdr[4] << 16) | (hdr[5] << 8) | hdr[6];
+		hdr_len = 7;
+	}
+	else
+	{
+		raw_framesiz = (hdr[2] << 8) | hdr[3];
+	}
+	framesiz = raw_framesiz + hdr_len + (with_crc ? 2 : 0);
+
+	memset(toc, 0, sizeof(toc));
+	if ((start + framesiz > ctx->file_length)
+		|| (fread(toc, 1, (raw_framesiz < PLAN_AC4_TOC_BYTES) ? raw_framesiz : PLAN_AC4_TOC_BYTES, fp) == 0))
+	{
+		plan->error = "AC-4 frame truncated";
+		return 0;
+	}
+
+	/* bitstream_version, sequence_counter, wait_frames */
+	ac4_bread(&bs, 2);
+	ac4_bread(&bs, 10);
+	if (ac4_bread(&bs, 1) && ac4_bread(&bs, 3))
+	{
+		ac4_bread(&bs, 2);
+	}
+	if (!ac4_bread(&bs, 1))
+	{
+		plan->error = "AC-4 sample rate must be 48 kHz";
+		return 0;
+	}
+	fr_idx = ac4_bread(&bs, 4);
+	if (!(size = ac4_burst_size(ctx, fr_idx)))
+	{
+		plan->error = "Unsupported AC-4 frame rate";
+		return 0;
+	}
+	ctx->burst_size = size;
+	ctx->AC4_AES_burst_count++;
+	plan_rate(plan, fr_idx);
+
+	plan->payload_bits = 16;
+	plan->frames++;
+	plan_burst(plan, ctx->burst_size, 2, (framesiz + 4) / 2.0, ctx->burst_size, (double)framesiz * 8);
+
+	fseek64(fp, start + framesiz, SEEK_SET);
+	return 1;
+}
+
+static void write_plan(Plan_Info *plan, FILE *fp)
+{
+	Format_Ctx *ctx = plan->ctx;
+	static const char *type_name[] = { "AC-3", "E-AC-3", "Dolby E", "AC-4", "unknown" };
+	int64_t header = wave_header_fits(WAVE_RIFF, plan->data_bytes) ? WAVE_HEADER_SIZE : WAVE_HEADER_SIZE_RF64;
+	double seconds = ctx->wave_frate ? (double)plan->sample_frames / ctx->wave_frate : 0.0;
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"input\": ");
+	json_string(fp, ctx->file_info->ac3fname);
+	fprintf(fp, ",\n");
+	fprintf(fp, "  \"stream_type\": \"%s\",\n", type_name[plan->stream_type]);
+	fprintf(fp, "  \"frames\": %ld,\n", plan->frames);
+	fprintf(fp, "  \"bursts\": %ld,\n", plan->bursts);
+	if (plan->rate_code < 0)
+	{
+		fprintf(fp, "  \"frame_rate\": null,\n");
+	}
+	else
+	{
+		fprintf(fp, "  \"frame_rate\": \"%s fps\",\n", (plan->stream_type == DOLBYE) 
+			? dde_fps_name[(plan->rate_code <= FPS_30) ? plan->rate_code : 0] : ac4_fps_name[plan->rate_code]);
+	}
+	fprintf(fp, "  \"frame_rate_changes\": %ld,\n", plan->rate_changes);
+	fprintf(fp, "  \"burst_words\": { \"min\": %d, \"max\": %d, \"cadence\": %s },\n", plan->burst_min, plan->burst_max, 
+		(plan->burst_min != plan->burst_max) ? "true" : "false");
+	fprintf(fp, "  \"sample_rate\": %d,\n", ctx->wave_frate);
+	fprintf(fp, "  \"bits_per_sample\": %d,\n", ctx->wave_bps);
+	fprintf(fp, "  \"duration\": %.3f,\n", seconds);
+	fprintf(fp, "  \"wave_layout\": \"%s\",\n", (header == WAVE_HEADER_SIZE) ? "RIFF" : "RF64");
+	fprintf(fp, "  \"data_bytes\": %lld,\n", (long long)plan->data_bytes);
+	fprintf(fp, "  \"output_bytes\": %lld,\n", (long long)(header + plan->data_bytes));
+	fprintf(fp, "  \"utilization\": { \"average\": %.4f, \"peak\": %.4f, \"peak_burst\": %ld, \"over_limit\": %ld },\n",
+		plan->bursts ? plan->fill_sum / plan->bursts : 0.0, plan->fill_peak, plan->peak_burst, plan->over_limit);
+	fprintf(fp, "  \"payload_kbps\": { \"average\": %.1f, \"peak\": %.1f, \"limit\": %.1f },\n",
+		seconds ? plan->payload_bits_sum / seconds / 1000.0 : 0.0, plan->kbps_peak, 
+		2.0 * plan->payload_bits * ctx->wave_frate / 1000.0);
+	if (plan->error)
+	{
+		fprintf(fp, "  \"error\": { \"message\": \"%s\", \"offset\": %lld },\n", plan->error, (long long)plan->error_offset);
+	}
+	fprintf(fp, "  \"complete\": %s\n", (!plan->error && !plan->over_limit) ? "true" : "false");
+	fprintf(fp, "}\n");
+}
+
+/* Walk the input from its current position to the end, burst by burst */
+static void plan_walk(Plan_Info *plan)
+{
+	File_Info *file_info = plan->ctx->file_info;
+	uint8_t sync[2];
+	int dolbye;
+	int more = 1;
+
+	plan->stream_type = UNKNOWN;
+	plan->rate_code = -1;
+
+	while (more)
+	{
+		plan->error_offset = ftell64(file_info->ac3file);
+
+		dolbye = parse_preamble(file_info);
+		if (dolbye == SMPTE_DDE_ID)
+		{
+			plan->stream_type = DOLBYE;
+			more = plan_dde_burst(plan);
+			continue;
+		}
+		else if (dolbye)
+		{
+			/* fewer than a preamble's worth of bytes left, the formatter stops here too */
+			break;
+		}
+
+		if (fread(sync, 1, 2, file_info->ac3file) != 2)
+		{
+			break;
+		}
+		fseek64(file_info->ac3file, -2, SEEK_CUR);
+
+		if (((sync[0] << 8 | sync[1]) == SYNC_WD) || ((sync[1] << 8 | sync[0]) == SYNC_WD))
+		{
+			more = plan_dd_burst(plan);
+		}
+		else if (((sync[0] << 8 | sync[1]) == AC4SIMPLE_SYNC_WD0) || ((sync[0] << 8 | sync[1]) == AC4SIMPLE_SYNC_WD1))
+		{
+			plan->stream_type = AC4;
+			more = plan_ac4_burst(plan, (sync[0] << 8 | sync[1]) == AC4SIMPLE_SYNC_WD1);
+		}
+		else
+		{
+			plan->error = "input file type not recognized";
+			more = 0;
+		}
+	}
+}		//		plan_walk()
+
+/* Plan formatting of the input without writing it, the report goes to the given file */
+int plan_format(Format_Ctx *ctx,		/* IN: format context, input open at its start */
+				FILE *report,			/* IN: JSON report destination */
+				int verbose)			/* IN: print a summary */
+										/* returns 1 if the input can be formatted */
+{
+	Plan_Info plan = { 0 };
+
+	plan.ctx = ctx;
+	plan_walk(&plan);
+
+	write_plan(&plan, report);
+
+	if (verbose)
+	{
+		fprintf(stderr, "Planned %ld bursts from %ld frames, %lld bytes of output\n", plan.bursts, plan.frames,
+			(long long)plan.data_bytes);
+	}
+
+	return(!plan.error && !plan.over_limit);
+}		//		plan_format()
+
+/* Predict the number of data bytes the formatter will write, from the frame headers only */
+int64_t predict_format_size(Format_Ctx *ctx)	/* IN/OUT: format context, wave_bps and wave_frate are set */
+												/* returns -1 if the input cannot be formatted */
+{
+	Format_Ctx scratch = *ctx;
+	Plan_Info plan = { 0 };
+	int64_t start = ftell64(ctx->file_info->ac3file);
+
+	/* the walk moves the cadence and frame state, which the formatter starts from again */
+	plan.ctx = &scratch;
+	plan_walk(&plan);
+	fseek64(ctx->file_info->ac3file, start, SEEK_SET);
+
+	if (plan.error)
+	{
+		run_error(&ctx->file_info->err, ERR_BAD_INPUT, plan.error_offset, plan.frames, "%s", plan.error);
+		return(-1);
+	}
+
+	ctx->wave_bps = scratch.wave_bps;
+	ctx->wave_frate = scratch.wave_frate;
+
+	return(plan.data_bytes);
+}		//		predict_format_size()
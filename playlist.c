@@ -0,0 +1,443 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	playlist.c
+ *		Several elementary streams formatted one after another into one output
+ *
+ *		The playlist is a text file with one input per line, optionally
+ *		followed by -ts[<pid>] or -mp4[<track>] for a transport stream or
+ *		MP4 input. Blank lines and lines starting with # are skipped. The
+ *		reader stage runs format_read_burst() over each input in turn, so
+ *		one run writes everything in one pass, and the inputs may be of
+ *		different codecs as long as they give the same output word size.
+ *
+ *		The fractional rate cadence of Dolby E and AC-4 carries across the
+ *		joins: when the codec changes, the next one's cadence counter
+ *		continues from the last one's. With a grid, each input is followed
+ *		by a pause burst up to the next video frame boundary of the grid
+ *		rate, counted from the start of the output, and the cadence
+ *		counters are set to that frame, so every input starts on the grid.
+ *
+ *	History:
+ *		10/19/26	Each entry starts a new timecode timeline for -fillgaps
+ *		10/19/26	-rt input buffer given to each input as it is opened
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "frame337.h"
+
+#include <ctype.h>
+
+#define PLAYLIST_LINE_MAX	4096
+#define GRID_CYCLE			DDE_2997_REPRATE	/* video frames in a grid cycle */
+#define GRID_PAUSE_MIN		6					/* words in the smallest pause burst */
+
+typedef struct
+{
+	char *fname;
+	int ts_mode;
+	int ts_pid;							/* -1 for the first Dolby audio stream */
+	int mp4_mode;
+	int mp4_track;						/* 0 for the first Dolby audio track */
+}Playlist_Entry;
+
+struct Playlist
+{
+	Playlist_Entry *entry;
+	int nentries;
+	int cur;							/* input being read */
+	int at_end;							/* the last input has been read */
+
+	int grid;							/* pad each input to a video frame boundary */
+	int grid_frame[GRID_CYCLE];			/* sample frames of each video frame in a cycle */
+	int64_t grid_cycle_len;
+	int64_t pad;						/* sample frames of padding still to be written */
+
+	int wave_bps;						/* of the first burst, 0 before it */
+	int last_type;						/* stream type of the last data burst */
+	long pad_bursts;
+	int64_t pad_samples;
+};
+
+/* Grid frame sizes of a video frame rate, as the Dolby E and AC-4 cadence tables give them */
+static int grid_rate(struct Playlist *pl, const char *rate)
+{
+	int i;
+
+	for (i = 0; i < GRID_CYCLE; i++)
+	{
+		if (!strcmp(rate, "23.98") || !strcmp(rate, "23.976"))
+		{
+			pl->grid_frame[i] = DDE_BURST_SIZE_2398FPS / 2;
+		}
+		else if (!strcmp(rate, "24"))
+		{
+			pl->grid_frame[i] = DDE_BURST_SIZE_24FPS / 2;
+		}
+		else if (!strcmp(rate, "25"))
+		{
+			pl->grid_frame[i] = DDE_BURST_SIZE_25FPS / 2;
+		}
+		else if (!strcmp(rate, "29.97"))
+		{
+			pl->grid_frame[i] = DDE_BURST_SIZE_2997FPS[i] / 2;
+		}
+		else if (!strcmp(rate, "30"))
+		{
+			pl->grid_frame[i] = DDE_BURST_SIZE_30FPS / 2;
+		}
+		else if (!strcmp(rate, "50"))
+		{
+			pl->grid_frame[i] = AC4_BURST_SIZE_50FPS / 2;
+		}
+		else if (!strcmp(rate, "59.94"))
+		{
+			pl->grid_frame[i] = AC4_BURST_SIZE_599FPS[i] / 2;
+		}
+		else if (!strcmp(rate, "60"))
+		{
+			pl->grid_frame[i] = AC4_BURST_SIZE_60FPS / 2;
+		}
+		else
+		{
+			return(0);
+		}
+		pl->grid_cycle_len += pl->grid_frame[i];
+	}
+	pl->grid = 1;
+
+	return(1);
+}		//		grid_rate()
+
+/* Index of the first grid frame starting at or after sample, and the sample frames to it */
+static int64_t grid_next(struct Playlist *pl,
+						 int64_t sample,			/* IN: sample frames from the start of the output */
+						 int64_t *pad)				/* OUT: sample frames to the frame boundary */
+{
+	int64_t cycle = sample / pl->grid_cycle_len;
+	int64_t pos = cycle * pl->grid_cycle_len;
+	int i;
+
+	for (i = 0; pos < sample; i++)
+	{
+		pos += pl->grid_frame[i];
+	}
+	*pad = pos - sample;
+
+	return(cycle * GRID_CYCLE + i);
+}
+
+/* Parse one playlist line into an entry, returns 0 if it holds no input */
+static int parse_entry(char *line, Playlist_Entry *e)
+{
+	char *end = line + strlen(line);
+	char *opt;
+
+	while ((end > line) && isspace((unsigned char)end[-1]))
+	{
+		*--end = 0;
+	}
+	while (isspace((unsigned char)*line))
+	{
+		line++;
+	}
+	if (!*line || (*line == '#'))
+	{
+		return(0);
+	}
+
+	e->ts_mode = e->mp4_mode = 0;
+	e->ts_pid = -1;
+	e->mp4_track = 0;
+
+	/* an input option after the last space, the name itself may hold spaces */
+	if (((opt = strrchr(line, ' ')) != NULL) || ((opt = strrchr(line, '\t')) != NULL))
+	{
+		if (!strncmp(opt + 1, "-ts", 3))
+		{
+			e->ts_mode = 1;
+			e->ts_pid = *(opt + 4) ? (int)strtol(opt + 4, NULL, 0) : -1;
+		}
+		else if (!strncmp(opt + 1, "-mp4", 4))
+		{
+			e->mp4_mode = 1;
+			e->mp4_track = atoi(opt + 5);
+		}
+		if (e->ts_mode || e->mp4_mode)
+		{
+			while ((opt > line) && isspace((unsigned char)opt[-1]))
+			{
+				opt--;
+			}
+			*opt = 0;
+		}
+	}
+	if ((e->fname = strdup(line)) == NULL)
+	{
+		return(-1);
+	}
+
+	return(1);
+}		//		parse_entry()
+
+/* Open an input of the playlist as the formatter's input */
+static int open_entry(Format_Ctx *ctx, int n)
+{
+	File_Info *file_info = ctx->file_info;
+	Playlist_Entry *e = &ctx->playlist->entry[n];
+	FILE *fp;
+
+	if ((fp = fopen(e->fname, "rb")) == NULL)
+	{
+		return run_error(&file_info->err, ERR_READ_ERROR, -1, -1, "decode: Input file, %s, not found.", e->fname);
+	}
+	if (file_info->rt)
+	{
+		/* the last input is closed by now, its buffer is free again */
+		rt_stdio(file_info->rt, fp, NULL);
+	}
+	fseek64(fp, 0, SEEK_END);
+	ctx->file_length = ftell64(fp);
+	rewind(fp);
+
+	if (e->ts_mode && ((fp = ts_input(fp, e->ts_pid, ctx->verbose)) == NULL))
+	{
+		return run_error(&file_info->err, ERR_BAD_INPUT, -1, -1, "Unable to open transport stream input %s", e->fname);
+	}
+	if (e->mp4_mode)
+	{
+		if ((fp = mp4_input(fp, e->mp4_track, &file_info->err)) == NULL)
+		{
+			return(0);
+		}
+		fseek64(fp, 0, SEEK_END);
+		ctx->file_length = ftell64(fp);
+		rewind(fp);
+	}
+
+	file_info->ac3file = fp;
+	file_info->ac3fname = e->fname;
+	ctx->playlist->cur = n;
+	if (ctx->verbose)
+	{
+		printf("\nPlaylist: input %d of %d, %s\n", n + 1, ctx->playlist->nentries, e->fname);
+	}
+
+	return(1);
+}		//		open_entry()
+
+/* Finish an input: pad it to the grid, carry the cadence over and open the next one */
+static int next_entry(Format_Ctx *ctx)
+{
+	struct Playlist *pl = ctx->playlist;
+	int64_t frame;
+
+	if (pl->grid)
+	{
+		/* the next input starts on the frame after the padding */
+		frame = grid_next(pl, ctx->out_samples, &pl->pad);
+		ctx->dde_frame_ctr = ctx->AC4_AES_burst_count = (int)(frame % GRID_CYCLE);
+	}
+	else if (pl->last_type == DOLBYE)
+	{
+		ctx->AC4_AES_burst_count = ctx->dde_frame_ctr;
+	}
+	else if (pl->last_type == AC4)
+	{
+		ctx->dde_frame_ctr = ctx->AC4_AES_burst_count;
+	}
+
+	if (pl->cur + 1 >= pl->nentries)
+	{
+		pl->at_end = 1;
+		return(1);
+	}
+	if (fclose(ctx->file_info->ac3file))
+	{
+		return run_error(&ctx->file_info->err, ERR_READ_ERROR, -1, -1, "decode: Unable to close input file, %s.", ctx->file_info->ac3fname);
+	}
+	ctx->file_info->ac3file = NULL;
+	if (!open_entry(ctx, pl->cur + 1))
+	{
+		return(0);
+	}
+
+	/* what the reader learnt about the last input */
+	ctx->done = 0;
+	ctx->flushbuf = 0;
+	ctx->resync_family = RESYNC_ANY;
+	ctx->unsized_skip = 0;
+	ctx->ac4_seq_cnt = 0;
+	ctx->tc_valid = 0;
+
+	return(1);
+}		//		next_entry()
+
+/* Read the playlist and open its first input, returns 0 on error */
+int open_playlist(Format_Ctx *ctx,			/* IN/OUT: format context, playlist, input and file_length are set */
+				  const char *list_fname,	/* IN: playlist file */
+				  const char *grid)			/* IN: video frame rate to pad each input to, NULL for none */
+{
+	File_Info *file_info = ctx->file_info;
+	struct Playlist *pl;
+	Playlist_Entry *grown;
+	char line[PLAYLIST_LINE_MAX];
+	FILE *fp;
+	int alloc = 0;
+	int status;
+
+	if ((pl = (struct Playlist *)calloc(1, sizeof(struct Playlist))) == NULL)
+	{
+		return run_error(&file_info->err, ERR_NO_MEMORY, -1, -1, "Unable to allocate playlist");
+	}
+	ctx->playlist = pl;
+	if (grid && !grid_rate(pl, grid))
+	{
+		return run_error(&file_info->err, ERR_BAD_INPUT, -1, -1, "Grid rate %s is not 23.98, 24, 25, 29.97, 30, 50, 59.94 or 60", grid);
+	}
+	if ((fp = fopen(list_fname, "r")) == NULL)
+	{
+		return run_error(&file_info->err, ERR_READ_ERROR, -1, -1, "decode: Playlist, %s, not found.", list_fname);
+	}
+
+	while (fgets(line, sizeof(line), fp))
+	{
+		if (pl->nentries == alloc)
+		{
+			alloc = alloc ? 2 * alloc : 16;
+			if ((grown = (Playlist_Entry *)realloc(pl->entry, alloc * sizeof(Playlist_Entry))) == NULL)
+			{
+				fclose(fp);
+				return run_error(&file_info->err, ERR_NO_MEMORY, -1, -1, "Unable to allocate playlist");
+			}
+			pl->entry = grown;
+		}
+		if ((status = parse_entry(line, &pl->entry[pl->nentries])) < 0)
+		{
+			fclose(fp);
+			return run_error(&file_info->err, ERR_NO_MEMORY, -1, -1, "Unable to allocate playlist");
+		}
+		pl->nentries += status;
+	}
+	fclose(fp);
+
+	if (!pl->nentries)
+	{
+		return run_error(&file_info->err, ERR_BAD_INPUT, -1, -1, "Playlist %s has no inputs", list_fname);
+	}
+
+	return open_entry(ctx, 0);
+}		//		open_playlist()
+
+/* Format stage 1 over every input of the playlist in turn */
+int playlist_read_burst(void *context,		/* IN/OUT: Format_Ctx */
+						void *buffer)		/* OUT: Burst_Buf to be filled */
+											/* returns 1 if a burst was read, 0 at end of the last input */
+{
+	Format_Ctx *ctx = (Format_Ctx *)context;
+	struct Playlist *pl = ctx->playlist;
+	Burst_Buf *burst = (Burst_Buf *)buffer;
+	int words;
+
+	for (;;)
+	{
+		if (pl->pad > 0)
+		{
+			/* at most one video frame, in the word size of the input before it */
+			words = (int)(2 * pl->pad);
+			fill_pause_words(ctx, burst, words < GRID_PAUSE_MIN ? GRID_PAUSE_MIN : words);
+			burst->burst_size = words;
+			if (words < GRID_PAUSE_MIN)
+			{
+				/* too short for a pause burst, silence keeps the time */
+				memset(burst->data, 0, sizeof(burst->data));
+			}
+			ctx->out_samples += pl->pad;
+			pl->pad_samples += pl->pad;
+			pl->pad_bursts++;
+			pl->pad = 0;
+			return(1);
+		}
+		if (pl->at_end)
+		{
+			return(0);
+		}
+
+		if (format_read_burst(ctx, buffer))
+		{
+			if (!pl->wave_bps)
+			{
+				pl->wave_bps = ctx->wave_bps;
+			}
+			else if (ctx->wave_bps != pl->wave_bps)
+			{
+				return run_error(&ctx->file_info->err, ERR_BAD_INPUT, -1, -1, "%s needs %d-bit output, the inputs before it %d-bit",
+					ctx->file_info->ac3fname, ctx->wave_bps, pl->wave_bps);
+			}
+			if (!burst->pause)
+			{
+				pl->last_type = burst->stream_type;
+			}
+			return(1);
+		}
+		if ((ctx->file_info->err.code != ERR_NO_ERROR) || !next_entry(ctx))
+		{
+			return(0);
+		}
+	}
+}		//		playlist_read_burst()
+
+/* Free the playlist, the input being read stays open */
+void close_playlist(Format_Ctx *ctx)
+{
+	struct Playlist *pl = ctx->playlist;
+	int i;
+
+	if (pl)
+	{
+		for (i = 0; i < pl->nentries; i++)
+		{
+			free(pl->entry[i].fname);
+		}
+		free(pl->entry);
+		free(pl);
+		ctx->playlist = NULL;
+	}
+}		//		close_playlist()
+
+void show_playlist_stats(Format_Ctx *ctx)	/* IN: format context after the conversion */
+{
+	struct Playlist *pl = ctx->playlist;
+
+	if (pl)
+	{
+		printf("Playlist: %d of %d inputs formatted", pl->cur + 1, pl->nentries);
+		if (pl->grid)
+		{
+			printf(", %ld pause bursts of %lld sample frames padding to the grid", pl->pad_bursts, (long long)pl->pad_samples);
+		}
+		printf("\n");
+	}
+}		//		show_playlist_stats()
@@ -0,0 +1,461 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	resync.c
+ *		Recovery from damaged elementary stream input while formatting
+ *
+ *		Before a frame is read, the bytes at the input position are checked:
+ *		a frame must parse, and either the next frame header must follow it
+ *		where its size says, its CRC must check, or the input must end with
+ *		it. If not, the input is searched forward with memchr() over large
+ *		blocks for the first sync word (of the stream being formatted, or of
+ *		any known stream before the first burst) passing the same check. The
+ *		skipped range is logged, and the time it held is filled with pause
+ *		bursts of the stream's own burst period, so the output keeps its
+ *		length and cadence.
+ *
+ *	History:
+ *		10/19/26	Pause preamble shared with bursts whose frames were all dropped
+ *		10/19/26	Errors are returned to the caller instead of exiting
+ *		10/19/26	No byte estimate for streams that time their own gaps
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "frame337.h"
+
+#define RESYNC_STEP			65536					/* bytes searched per read */
+#define RESYNC_LOOKAHEAD	(MAX_DDE_BURST_SIZE * 4 + 64)	/* the largest frame and the next header */
+#define RESYNC_DD_LOOKAHEAD	(4096 + TC_FRMSIZE + 64)		/* the largest DD/DD+ frame, timecode and next header */
+#define PAUSE_DATA_TYPE		3						/* SMPTE 338 pause data type */
+
+#ifdef LITEND
+#define DDE_PA_BYTE			3						/* most significant byte of a 32-bit word */
+#else
+#define DDE_PA_BYTE			0
+#endif
+
+/* A byte that can start a frame, and where it sits in the frame */
+typedef struct
+{
+	uint8_t byte;
+	int offset;
+	int family;
+}Resync_Key;
+
+static const Resync_Key resync_keys[] =
+{
+	{ (SYNC_WD >> 8) & 0xFF, 0, RESYNC_DD },				/* 0x0B77 */
+	{ SYNC_WD & 0xFF, 0, RESYNC_DD },						/* 0x770B, byte reversed */
+	{ (AC4SIMPLE_SYNC_WD0 >> 8) & 0xFF, 0, RESYNC_AC4 },	/* 0xAC40 and 0xAC41 */
+	{ (PREAMBLE_A16 >> 8) & 0xFF, DDE_PA_BYTE, RESYNC_DDE },
+	{ (PREAMBLE_A20 >> 12) & 0xFF, DDE_PA_BYTE, RESYNC_DDE },
+	{ (PREAMBLE_A24 >> 16) & 0xFF, DDE_PA_BYTE, RESYNC_DDE }
+};
+
+#define RESYNC_NKEYS	(int)(sizeof(resync_keys) / sizeof(resync_keys[0]))
+
+/* Stream family of a stream type, RESYNC_ANY if it has none */
+int stream_family(int stream_type)
+{
+	switch (stream_type)
+	{
+		case AC3:
+		case EAC3:
+			return(RESYNC_DD);
+		case AC4:
+			return(RESYNC_AC4);
+		case DOLBYE:
+			return(RESYNC_DDE);
+		default:
+			return(RESYNC_ANY);
+	}
+}		//		stream_family()
+
+/* Size of a Dolby E frame and its preamble, as parse_preamble() reads them, 0 if none starts at p */
+static int dde_frame_size(const uint8_t *p, int avail)
+{
+	uint32_t w[PRMBLSIZE];
+
+	if (avail < (int)sizeof(w))
+	{
+		return(0);
+	}
+	memcpy(w, p, sizeof(w));
+
+	if (((w[0] >> 16) == PREAMBLE_A16) && ((w[1] >> 16) == PREAMBLE_B16) && ((w[2] >> 16) == PREAMBLE_C16))
+		return((PRMBLSIZE + (int)(w[3] >> 16) / 16) * 4);
+	if (((w[0] >> 12) == PREAMBLE_A20) && ((w[1] >> 12) == PREAMBLE_B20) && ((w[2] >> 12) == PREAMBLE_C20))
+		return((PRMBLSIZE + (int)(w[3] >> 12) / 20) * 4);
+	if (((w[0] >> 8) == PREAMBLE_A24) && ((w[1] >> 8) == PREAMBLE_B24) && ((w[2] >> 8) == PREAMBLE_C24))
+		return((PRMBLSIZE + (int)(w[3] >> 8) / 24) * 4);
+	return(0);
+}
+
+/* Size of a frame of the family at p, 0 if none starts there */
+static int frame_size_at(const uint8_t *p, int avail, int family)
+{
+	if (avail < 2)
+	{
+		return(0);
+	}
+	switch (family)
+	{
+		case RESYNC_DD:
+			if (((p[0] == 0x0B) && (p[1] == 0x77)) || ((p[0] == 0x77) && (p[1] == 0x0B)))
+				return(crc_frame_size(p, avail));
+			return(0);
+		case RESYNC_AC4:
+			return((p[0] == 0xAC) ? crc_frame_size(p, avail) : 0);
+		case RESYNC_DDE:
+			return(dde_frame_size(p, avail));
+	}
+	return(0);
+}
+
+/* A timecode frame, as get_timeslice() accepts between DD frames */
+static int is_tc_frame(const uint8_t *p, int avail)
+{
+	return((avail >= 2) && (((p[0] == 0x01) && (p[1] == 0x10)) || ((p[0] == 0x10) && (p[1] == 0x01))));
+}
+
+/* A whole frame starts at p: the next header follows it, its CRC checks, or the input ends with it */
+static int frame_valid_at(const uint8_t *p,		/* IN: candidate */
+						  int avail,			/* IN: bytes from p to the end of the window */
+						  int at_eof,			/* IN: the window ends where the input does */
+						  int family,			/* IN: RESYNC_DD, RESYNC_AC4 or RESYNC_DDE */
+						  int in_sequence)		/* IN: p is where the last frame ended, not a search hit */
+{
+	int size = frame_size_at(p, avail, family);
+	int rest;
+	int crc;
+
+	if ((size <= 0) || (size > avail))
+	{
+		return(0);
+	}
+	rest = avail - size;
+	p += size;
+
+	if ((rest == 0) && at_eof)
+	{
+		return(1);
+	}
+	if ((family == RESYNC_DD) && is_tc_frame(p, rest))
+	{
+		return(1);
+	}
+	if (frame_size_at(p, rest, family) > 0)
+	{
+		return(1);
+	}
+
+	/* the damage starts right after it: keep a frame that proves itself whole, or one in sequence that cannot */
+	crc = (family == RESYNC_DDE) ? CRC_NONE : crc_check_frame(p - size, size);
+	return((crc == CRC_OK) || (in_sequence && (crc == CRC_NONE)));
+}
+
+/* Position the input at the next whole frame after a damaged one, queueing pauses for the lost time */
+int resync_input(Format_Ctx *ctx,		/* IN/OUT: format context, pause_bursts is added to */
+				 int64_t bad_pos)		/* IN: start of the frame that could not be parsed */
+										/* returns 1 if a frame was found, 0 if the input ended first */
+{
+	FILE *infile = ctx->file_info->ac3file;
+	int family = ctx->resync_family;
+	const uint8_t *next[RESYNC_NKEYS];
+	const uint8_t *hit;
+	uint8_t *buf;
+	int64_t pos = bad_pos + 1;
+	int64_t found = -1;
+	int64_t skipped;
+	size_t nread, limit, c;
+	int at_eof, k, best;
+	int lost = 0;
+	char errstr[ERR_STR_BUF_LEN];
+
+	if ((buf = (uint8_t *)malloc(RESYNC_STEP + RESYNC_LOOKAHEAD)) == NULL)
+	{
+		/* stops the run like the end of the input, with the error kept */
+		return run_error(&ctx->file_info->err, ERR_NO_MEMORY, bad_pos, ctx->framecount, "Unable to allocate resync buffer");
+	}
+
+	while (found < 0)
+	{
+		fseek64(infile, pos, SEEK_SET);
+		nread = fread(buf, 1, RESYNC_STEP + RESYNC_LOOKAHEAD, infile);
+		at_eof = (nread < RESYNC_STEP + RESYNC_LOOKAHEAD);
+		limit = at_eof ? nread : RESYNC_STEP;
+
+		/* merge the memchr() hits of every key byte, in order of the frame start they imply */
+		for (k = 0; k < RESYNC_NKEYS; k++)
+		{
+			next[k] = NULL;
+			if (((family == RESYNC_ANY) || (family == resync_keys[k].family)) && (limit > (size_t)resync_keys[k].offset))
+			{
+				next[k] = (const uint8_t *)memchr(buf + resync_keys[k].offset, resync_keys[k].byte, limit - resync_keys[k].offset);
+			}
+		}
+		while (found < 0)
+		{
+			best = -1;
+			for (k = 0; k < RESYNC_NKEYS; k++)
+			{
+				if (next[k] && ((best < 0) || (next[k] - resync_keys[k].offset < next[best] - resync_keys[best].offset)))
+				{
+					best = k;
+				}
+			}
+			if (best < 0)
+			{
+				break;
+			}
+			hit = next[best];
+			c = (size_t)(hit - resync_keys[best].offset - buf);
+			if (frame_valid_at(buf + c, (int)(nread - c), at_eof, resync_keys[best].family, 0))
+			{
+				found = pos + (int64_t)c;
+				ctx->resync_family = resync_keys[best].family;
+			}
+			next[best] = (const uint8_t *)memchr(hit + 1, resync_keys[best].byte, buf + limit - (hit + 1));
+		}
+		if (at_eof)
+		{
+			break;
+		}
+		pos += RESYNC_STEP;
+	}
+	free(buf);
+
+	if (found < 0)
+	{
+		fseek64(infile, 0, SEEK_END);
+		skipped = ftell64(infile) - bad_pos;
+	}
+	else
+	{
+		fseek64(infile, found, SEEK_SET);
+		skipped = found - bad_pos;
+
+		/* the skipped bytes held about as much time as the same number of bytes before them */
+		if (gap_timed(ctx))
+		{
+			/* the stream's own timing accounts for them when it resumes */
+		}
+		else if (ctx->burst_bytes > 0)
+		{
+			lost = (int)((skipped + ctx->burst_bytes / 2) / ctx->burst_bytes);
+		}
+		else
+		{
+			ctx->unsized_skip += skipped;
+		}
+	}
+
+	ctx->pause_bursts += lost;
+	ctx->resync_count++;
+	ctx->resync_skipped += skipped;
+	ctx->resync_pauses += lost;
+
+	if ((found >= 0) && gap_timed(ctx))
+	{
+		snprintf(errstr, ERR_STR_BUF_LEN, "resync: skipped input bytes %lld to %lld (%lld bytes), timed by the stream",
+			(long long)bad_pos, (long long)(bad_pos + skipped - 1), (long long)skipped);
+	}
+	else if ((found >= 0) && (ctx->burst_bytes <= 0))
+	{
+		snprintf(errstr, ERR_STR_BUF_LEN, "resync: skipped input bytes %lld to %lld (%lld bytes), pause bursts follow the first burst",
+			(long long)bad_pos, (long long)(bad_pos + skipped - 1), (long long)skipped);
+	}
+	else
+	{
+		snprintf(errstr, ERR_STR_BUF_LEN, "resync: skipped input bytes %lld to %lld (%lld bytes%s), %d pause bursts",
+			(long long)bad_pos, (long long)(bad_pos + skipped - 1), (long long)skipped, (found < 0) ? ", to the end" : "", lost);
+	}
+	error_msg(errstr, WARNING);
+
+	return(found >= 0);
+}		//		resync_input()
+
+/* Check for a whole frame at the input position, resynchronising past damage if there is none */
+int resync_frame(Format_Ctx *ctx)		/* IN/OUT: format context */
+										/* returns RESYNC_OK, RESYNC_MOVED or RESYNC_END */
+{
+	FILE *infile = ctx->file_info->ac3file;
+	uint8_t buf[RESYNC_LOOKAHEAD];
+	int64_t pos = ftell64(infile);
+	size_t want = (ctx->resync_family == RESYNC_DD) ? RESYNC_DD_LOOKAHEAD : sizeof(buf);
+	size_t nread;
+	int at_eof, family, skip;
+
+	nread = fread(buf, 1, want, infile);
+	at_eof = (nread < want);
+	fseek64(infile, pos, SEEK_SET);
+
+	if (nread == 0)
+	{
+		/* a clean end of input is left to the reader */
+		return(RESYNC_OK);
+	}
+
+	/* get_timeslice() steps over a timecode frame in front of a DD frame */
+	skip = ((ctx->resync_family != RESYNC_AC4) && (ctx->resync_family != RESYNC_DDE)
+		&& is_tc_frame(buf, (int)nread) && (nread > TC_FRMSIZE)) ? TC_FRMSIZE : 0;
+
+	for (family = RESYNC_DD; family <= RESYNC_DDE; family++)
+	{
+		if (((ctx->resync_family == RESYNC_ANY) || (ctx->resync_family == family))
+			&& frame_valid_at(buf + skip, (int)nread - skip, at_eof, family, ctx->resync_family != RESYNC_ANY))
+		{
+			return(RESYNC_OK);
+		}
+	}
+
+	return(resync_input(ctx, pos) ? RESYNC_MOVED : RESYNC_END);
+}		//		resync_frame()
+
+/* Note a burst read whole, which sets what is searched for and how much time a skipped byte held */
+void resync_burst_read(Format_Ctx *ctx,		/* IN/OUT: format context */
+					   int64_t nbytes)		/* IN: input bytes of the burst */
+{
+	int lost;
+
+	ctx->resync_family = stream_family(ctx->file_info->stream_type);
+	ctx->burst_bytes = nbytes;
+
+	/* damage before the first burst could not be timed until now */
+	if (ctx->unsized_skip && (nbytes > 0))
+	{
+		lost = (int)((ctx->unsized_skip + nbytes / 2) / nbytes);
+		ctx->pause_bursts += lost;
+		ctx->resync_pauses += lost;
+		ctx->unsized_skip = 0;
+	}
+}		//		resync_burst_read()
+
+/* Skip a frame the reader could not use and read the burst again from the next whole frame */
+int resync_read_burst(Format_Ctx *ctx,	/* IN/OUT: format context */
+					  void *buffer,		/* OUT: Burst_Buf to be filled */
+					  int64_t bad_pos)	/* IN: start of the frame */
+										/* returns as format_read_burst() does */
+{
+	if (!resync_input(ctx, bad_pos))
+	{
+		ctx->done = 1;
+		return(0);
+	}
+	return(format_read_burst(ctx, buffer));
+}		//		resync_read_burst()
+
+/* Fill a burst with a pause burst of burst_size words, already in output layout */
+void fill_pause_words(Format_Ctx *ctx,		/* IN: format context */
+					  Burst_Buf *burst,		/* OUT: pause burst, written as it is */
+					  int burst_size)		/* IN: burst period in words, at least 6 */
+{
+	uint16_t *words = (uint16_t *)burst->data;
+	uint32_t *Eiobuf = burst->data;
+	uint8_t *outbyteptr = (uint8_t *)burst->data;
+	int shift;
+	int i;
+
+	burst->pause = 1;
+	burst->skipped = 0;
+	burst->stream_type = ctx->file_info->stream_type;
+	burst->out = (unsigned char *)burst->data;
+
+	if (stream_family(ctx->file_info->stream_type) == RESYNC_DDE)
+	{
+		/* 16, 20 or 24 bits left justified in 24-bit words, like the Dolby E bursts around it */
+		shift = 4 * ctx->file_info->bit_depth;
+		memset(Eiobuf, 0, burst_size * sizeof(uint32_t));
+		Eiobuf[0] = (uint32_t)PREAMBLE_A16 << 16;
+		Eiobuf[1] = (uint32_t)PREAMBLE_B16 << 16;
+		Eiobuf[2] = (uint32_t)(PAUSE_DATA_TYPE | (ctx->file_info->bit_depth << 5) | (ctx->nStreamNum << 13)) << 16;
+		Eiobuf[3] = (uint32_t)(2 * (16 + shift)) << (16 - shift);	/* Pd, payload of two words */
+		Eiobuf[4] = (uint32_t)(burst_size / 2) << 16;				/* gap length in sample frames */
+		if (shift)
+		{
+			Eiobuf[0] = (uint32_t)(ctx->file_info->bit_depth == BITD20 ? PREAMBLE_A20 : PREAMBLE_A24) << (16 - shift);
+			Eiobuf[1] = (uint32_t)(ctx->file_info->bit_depth == BITD20 ? PREAMBLE_B20 : PREAMBLE_B24) << (16 - shift);
+		}
+		for (i = 0; i < burst_size; i++)
+		{
+			*outbyteptr++ = (uint8_t)(Eiobuf[i] >> 8);
+			*outbyteptr++ = (uint8_t)(Eiobuf[i] >> 16);
+			*outbyteptr++ = (uint8_t)(Eiobuf[i] >> 24);
+		}
+		burst->out_wordbytes = 3;
+	}
+	else
+	{
+		memset(words, 0, burst_size * sizeof(uint16_t));
+		fill_pause_preamble(ctx, words, burst_size);
+		burst->out_wordbytes = 2;
+	}
+	burst->burst_size = burst_size;
+}		//		fill_pause_words()
+
+/* Write the first PAUSE_PREAMBLE_WORDS 16-bit words of a pause burst, the rest of it is zero */
+void fill_pause_preamble(Format_Ctx *ctx,		/* IN: format context */
+						 uint16_t *words,		/* OUT: start of the burst */
+						 int burst_size)		/* IN: burst period in words */
+{
+	words[0] = PREAMBLE_A16;
+	words[1] = PREAMBLE_B16;
+	words[2] = (uint16_t)(PAUSE_DATA_TYPE | (ctx->nStreamNum << 13));
+	words[3] = 2 * 16;											/* Pd, payload of two words */
+	words[4] = (uint16_t)(burst_size / 2);						/* gap length in sample frames */
+}		//		fill_pause_preamble()
+
+/* Fill a burst with a pause burst of the stream's burst period, already in output layout */
+void fill_pause_burst(Format_Ctx *ctx,	/* IN/OUT: format context, cadence position advances */
+					  Burst_Buf *burst)	/* OUT: pause burst, written as it is */
+{
+	int burst_size;
+
+	if (stream_family(ctx->file_info->stream_type) == RESYNC_DDE)
+	{
+		burst_size = dde_burst_size(ctx, ctx->dde_fps);
+		ctx->dde_frame_ctr++;
+	}
+	else if (stream_family(ctx->file_info->stream_type) == RESYNC_AC4)
+	{
+		burst_size = ac4_burst_size(ctx, ctx->ac4_fr_idx);
+		ctx->AC4_AES_burst_count++;
+	}
+	else
+	{
+		burst_size = ctx->burst_size;
+	}
+	fill_pause_words(ctx, burst, burst_size);
+}		//		fill_pause_burst()
+
+/* Report what resynchronisation skipped */
+void show_resync_stats(Format_Ctx *ctx)	/* IN: format context after the conversion */
+{
+	if (ctx->resync)
+	{
+		printf("Resync: %ld damaged ranges, %lld bytes skipped, %ld pause bursts\n", ctx->resync_count,
+			(long long)ctx->resync_skipped, ctx->resync_pauses);
+	}
+}		//		show_resync_stats()
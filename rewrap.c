@@ -0,0 +1,265 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+/****************************************************************************
+ *	File:	rewrap.c
+ *		Moving SMPTE 337 bursts to a new sample size without deformatting
+ *
+ *		The input is scanned for preambles as when deformatting. Each burst,
+ *		preamble included, is copied word for word into samples of the new
+ *		size at the same sample position, and the samples between bursts are
+ *		written as zeros. A burst keeps the data word size it was formatted
+ *		with, so Pc and Pd still describe it and only the container changes:
+ *		16-bit bursts go into 16, 24 or 32-bit samples, 20 and 24-bit bursts
+ *		into 24 or 32-bit samples. The output is always a WAV file with as
+ *		many sample frames as the input.
+ *
+ *	History:
+ *		10/19/26	Errors say the data word size is kept, only the container changes
+ *		10/19/26	Errors are returned to the caller instead of exiting
+ *		10/19/26	Preamble search picked once for the sample size
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "frame337.h"
+
+#define RW_CHUNK_WORDS		4096		/* words converted per read */
+#define RW_PCM_RATE			48000		/* sample rate given to a raw PCM input */
+
+typedef struct
+{
+	File_Info *file_info;
+	int in_bytes;						/* bytes per input word */
+	int out_bytes;						/* bytes per output word */
+	int64_t in_start;					/* offset of the first input word */
+	int64_t out_words;					/* words written so far */
+	uint8_t inbuf[RW_CHUNK_WORDS * 4];
+	uint8_t outbuf[RW_CHUNK_WORDS * 4];
+}Rewrap_Ctx;
+
+/* Write converted words to the output, returns 0 on error */
+static int rewrap_write(Rewrap_Ctx *ctx,	/* IN/OUT: rewrap context */
+						int nwords)			/* IN: words in outbuf */
+{
+	if (fwrite(ctx->outbuf, ctx->out_bytes, nwords, ctx->file_info->ac3file) != (size_t)nwords)
+	{
+		return run_error(&ctx->file_info->err, ERR_WRITE_ERROR, -1, -1, "decode: Unable to write to output file, %s.",
+			ctx->file_info->ac3fname);
+	}
+	ctx->out_words += nwords;
+
+	return 1;
+}		//		rewrap_write()
+
+/* Write zero words up to a word position of the output, returns 0 on error */
+static int rewrap_zeros(Rewrap_Ctx *ctx,	/* IN/OUT: rewrap context */
+						int64_t to_word)	/* IN: word position to stop at */
+{
+	int n;
+
+	memset(ctx->outbuf, 0, sizeof(ctx->outbuf));
+	while (ctx->out_words < to_word)
+	{
+		n = (to_word - ctx->out_words > RW_CHUNK_WORDS) ? RW_CHUNK_WORDS : (int)(to_word - ctx->out_words);
+		if (!rewrap_write(ctx, n))
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}		//		rewrap_zeros()
+
+/* Copy words from the input position to the output, keeping the top bit_depth bits of each, returns 0 on error */
+static int rewrap_copy(Rewrap_Ctx *ctx,		/* IN/OUT: rewrap context */
+					   int64_t nwords,		/* IN: words to copy */
+					   int bit_depth)		/* IN: data word size of the burst */
+{
+	uint32_t mask = 0xFFFFFFFFu << (32 - bit_depth);
+	uint32_t word;
+	uint8_t *in, *out;
+	int n, got, i, j;
+
+	while (nwords > 0)
+	{
+		n = (nwords > RW_CHUNK_WORDS) ? RW_CHUNK_WORDS : (int)nwords;
+		if ((got = (int)fread(ctx->inbuf, ctx->in_bytes, n, ctx->file_info->smpte_file)) <= 0)
+		{
+			/* cut short at the end of the input, the caller pads it */
+			return 1;
+		}
+
+		/* left align the little endian input word, then store its top bytes */
+		in = ctx->inbuf;
+		out = ctx->outbuf;
+		for (i = 0; i < got; i++)
+		{
+			word = 0;
+			for (j = 0; j < ctx->in_bytes; j++)
+			{
+				word |= (uint32_t)in[j] << (32 - 8 * (ctx->in_bytes - j));
+			}
+			word &= mask;
+			for (j = 0; j < ctx->out_bytes; j++)
+			{
+				out[j] = (uint8_t)(word >> (32 - 8 * (ctx->out_bytes - j)));
+			}
+			in += ctx->in_bytes;
+			out += ctx->out_bytes;
+		}
+		if (!rewrap_write(ctx, got))
+		{
+			return 0;
+		}
+		nwords -= got;
+	}
+
+	return 1;
+}		//		rewrap_copy()
+
+/* Write the header, then every burst and the zeros around them */
+static long rewrap_bursts(Rewrap_Ctx *ctx,		/* IN/OUT: rewrap context, input at its data */
+						  Getsync_Fn getsync,	/* IN: preamble search for the input's sample size */
+						  int out_bps,			/* IN: output bits per sample */
+						  int frate,			/* IN: sample rate of the output */
+						  int verbose)			/* IN: print a summary */
+												/* returns the number of bursts, -1 on error */
+{
+	File_Info *file_info = ctx->file_info;
+	uint8_t dfbuf[4 * PRMBLSIZE];
+	uint8_t hdr[WAVE_HEADER_SIZE_RF64];
+	int layout;
+	int nbits, payload_bits;
+	int64_t in_words, pa, here;
+	long bursts = 0;
+
+	/* the output holds as many words as the input, so its header is final from the start */
+	ctx->in_start = ftell64(file_info->smpte_file);
+	fseek64(file_info->smpte_file, 0, SEEK_END);
+	in_words = (ftell64(file_info->smpte_file) - ctx->in_start) / ctx->in_bytes;
+	fseek64(file_info->smpte_file, ctx->in_start, SEEK_SET);
+
+	layout = wave_header_fits(WAVE_RIFF, in_words * ctx->out_bytes) ? WAVE_RIFF : WAVE_RF64;
+	make_wave_header(hdr, layout, in_words * ctx->out_bytes, out_bps, frate);
+	if (fwrite(hdr, wave_header_size(layout), 1, file_info->ac3file) != 1)
+	{
+		run_error(&file_info->err, ERR_WRITE_ERROR, -1, -1, "decode: Unable to write to output file, %s.", file_info->ac3fname);
+		return(-1);
+	}
+
+	while ((nbits = getsync(file_info, dfbuf)))
+	{
+		/* getsync() leaves a Dolby E burst at Pa and the others after Pd */
+		here = (ftell64(file_info->smpte_file) - ctx->in_start) / ctx->in_bytes;
+		pa = (file_info->stream_type == DOLBYE) ? here : here - PRMBLSIZE;
+		payload_bits = (file_info->stream_type == DOLBYE) ? nbits - PRMBLSIZE * file_info->bit_depth : nbits;
+
+		if (file_info->bit_depth > out_bps)
+		{
+			run_error(&file_info->err, ERR_BAD_OUTPUT, ctx->in_start + pa * ctx->in_bytes, bursts,
+				"rewrap: %d-bit burst at frame %lld does not fit %d-bit samples, only the container changes, not the data word size",
+				file_info->bit_depth, (long long)(pa / 2), out_bps);
+			return(-1);
+		}
+
+		if (!rewrap_zeros(ctx, pa))
+		{
+			return(-1);
+		}
+		fseek64(file_info->smpte_file, ctx->in_start + pa * ctx->in_bytes, SEEK_SET);
+		if (!rewrap_copy(ctx, PRMBLSIZE + (payload_bits + file_info->bit_depth - 1) / file_info->bit_depth, file_info->bit_depth))
+		{
+			return(-1);
+		}
+		bursts++;
+	}
+	if (file_info->err.code || !rewrap_zeros(ctx, in_words))
+	{
+		/* the preamble search stopped on damage */
+		return(-1);
+	}
+
+	if (verbose)
+	{
+		printf("Rewrapped %ld bursts from %d-bit to %d-bit samples, %lld frames\n", bursts, file_info->bits_per_sample,
+			out_bps, (long long)(in_words / 2));
+	}
+
+	return(bursts);
+}		//		rewrap_bursts()
+
+/* Copy the bursts of a SMPTE file into samples of another size */
+long rewrap(File_Info *file_info,		/* IN: input positioned at its data, output open */
+			Wave_Struct *wavInfo,		/* IN: input container, WAVE_IN_PCM for raw PCM */
+			int out_bps,				/* IN: output bits per sample, 0 to keep the input's */
+			int verbose)				/* IN: print a summary */
+										/* returns the number of bursts, -1 on an error in file_info->err */
+{
+	Rewrap_Ctx *ctx;
+	Getsync_Fn getsync;
+	int frate = (wavInfo->container == WAVE_IN_PCM) ? RW_PCM_RATE : wavInfo->sample_rate;
+	long bursts = -1;
+
+	getsync = select_getsync(file_info);
+
+	if (!out_bps)
+	{
+		out_bps = file_info->bits_per_sample;
+	}
+	if (!getsync)
+	{
+		run_error(&file_info->err, ERR_BAD_INPUT, -1, -1, "Unknown bit depth");
+	}
+	else if ((out_bps != 16) && (out_bps != 24) && (out_bps != 32))
+	{
+		run_error(&file_info->err, ERR_BAD_OUTPUT, -1, -1, "rewrap: Output samples must be 16, 24 or 32 bits, the bursts keep their data word size");
+	}
+	else if ((ctx = (Rewrap_Ctx *)calloc(1, sizeof(Rewrap_Ctx))) == NULL)
+	{
+		run_error(&file_info->err, ERR_NO_MEMORY, -1, -1, "Unable to allocate rewrap buffers");
+	}
+	else
+	{
+		ctx->file_info = file_info;
+		ctx->in_bytes = file_info->bytes_per_word;
+		ctx->out_bytes = out_bps / 8;
+
+		bursts = rewrap_bursts(ctx, getsync, out_bps, frate, verbose);
+
+		free(ctx);
+	}
+
+	/* closed after an error as well, the caller may go on with another file */
+	if (fclose (file_info->smpte_file))
+	{
+		run_error(&file_info->err, ERR_READ_ERROR, -1, -1, "decode: Unable to close input file, %s.", file_info->smpte_fname);
+		bursts = -1;
+	}
+	if (fclose (file_info->ac3file))
+	{
+		run_error(&file_info->err, ERR_WRITE_ERROR, -1, -1, "decode: Unable to close output file, %s.", file_info->ac3fname);
+		bursts = -1;
+	}
+
+	return(bursts);
+}		//		rewrap()
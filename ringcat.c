@@ -0,0 +1,186 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	ringcat.c
+ *		Reference consumer of the shared memory burst ring
+ *
+ *		Usage: ringcat <name> [<output.pcm>]
+ *
+ *		Waits for frame337 -shm<name> to create the ring, then writes the
+ *		samples of every burst, in order, to the output (stdout if none is
+ *		given) until the producer marks the end. Each slot is written from
+ *		where it lies in the ring and released. Sequence gaps are reported,
+ *		and the ring is unlinked at the end. A real playout process would
+ *		hand the slot to its audio device instead of writing it.
+ *
+ *	History:
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "shmring.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define RINGCAT_ATTACH_SECS		30			/* wait this long for the producer to create the ring */
+#define RINGCAT_POLL_NS			10000000
+#define RINGCAT_WAIT_NS			100000000	/* longest futex wait */
+
+/* Map the ring once the producer has created and initialised it */
+static Shm_Ring_Header *attach(const char *path, size_t *len)
+{
+	struct timespec pause = { 0, RINGCAT_POLL_NS };
+	struct stat st;
+	Shm_Ring_Header *hdr;
+	void *map;
+	int tries;
+	int fd;
+
+	for (tries = 0; tries < RINGCAT_ATTACH_SECS * (1000000000 / RINGCAT_POLL_NS); tries++)
+	{
+		if (((fd = shm_open(path, O_RDWR, 0)) >= 0) && !fstat(fd, &st) && (st.st_size >= SHM_RING_HEADER_SIZE))
+		{
+			map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			close(fd);
+			if (map == MAP_FAILED)
+			{
+				return NULL;
+			}
+			hdr = (Shm_Ring_Header *)map;
+			if (!memcmp(hdr->magic, SHM_RING_MAGIC, sizeof(hdr->magic)))
+			{
+				atomic_thread_fence(memory_order_acquire);
+				if ((hdr->version != SHM_RING_VERSION)
+					|| ((size_t)hdr->header_size + (size_t)hdr->slot_count * hdr->slot_size > (size_t)st.st_size))
+				{
+					fprintf(stderr, "ringcat: %s is not a version %d ring\n", path, SHM_RING_VERSION);
+					munmap(map, st.st_size);
+					return NULL;
+				}
+				*len = st.st_size;
+				return hdr;
+			}
+			munmap(map, st.st_size);
+		}
+		else if (fd >= 0)
+		{
+			close(fd);
+		}
+		nanosleep(&pause, NULL);
+	}
+	fprintf(stderr, "ringcat: no ring %s appeared\n", path);
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct timespec timeout = { 0, RINGCAT_WAIT_NS };
+	Shm_Ring_Header *hdr;
+	Shm_Ring_Slot *slot;
+	char path[256];
+	FILE *out = stdout;
+	size_t len;
+	uint64_t seq = 0;
+	uint64_t frames = 0;
+	long gaps = 0;
+	long pauses = 0;
+	uint32_t seen;
+	int state;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: ringcat <name> [<output.pcm>]\n");
+		return 1;
+	}
+	snprintf(path, sizeof(path), "%s%s", (*argv[1] == '/') ? "" : "/", argv[1]);
+	if ((argc > 2) && ((out = fopen(argv[2], "wb")) == NULL))
+	{
+		fprintf(stderr, "ringcat: unable to create %s\n", argv[2]);
+		return 1;
+	}
+	if ((hdr = attach(path, &len)) == NULL)
+	{
+		return 1;
+	}
+
+	for (;;)
+	{
+		/* the futex is read first, so a publish after the checks ends the wait at once */
+		seen = atomic_load_explicit(&hdr->data_futex, memory_order_acquire);
+		state = atomic_load_explicit(&hdr->state, memory_order_acquire);
+
+		while (seq < atomic_load_explicit(&hdr->write_seq, memory_order_acquire))
+		{
+			slot = (Shm_Ring_Slot *)((uint8_t *)hdr + hdr->header_size + (seq % hdr->slot_count) * hdr->slot_size);
+			if (slot->seq != seq)
+			{
+				gaps++;
+			}
+			if (slot->flags & SHM_RING_PAUSE)
+			{
+				pauses++;
+			}
+			if (fwrite(slot + 1, 1, slot->bytes, out) != slot->bytes)
+			{
+				fprintf(stderr, "ringcat: write error\n");
+				return 1;
+			}
+			frames += slot->frames;
+			seq++;
+
+			atomic_store_explicit(&hdr->read_seq, seq, memory_order_release);
+			atomic_fetch_add_explicit(&hdr->space_futex, 1, memory_order_release);
+			syscall(SYS_futex, (uint32_t *)&hdr->space_futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+		}
+
+		/* the state was read before the last check of write_seq, so every slot is in */
+		if (state != SHM_RING_RUNNING)
+		{
+			break;
+		}
+		syscall(SYS_futex, (uint32_t *)&hdr->data_futex, FUTEX_WAIT, seen, &timeout, NULL, 0);
+	}
+
+	fprintf(stderr, "ringcat: %llu bursts, %llu sample frames, %ld pause bursts, %ld sequence gaps%s\n",
+		(unsigned long long)seq, (unsigned long long)frames, pauses, gaps,
+		(state == SHM_RING_FAILED) ? ", the producer failed" : "");
+
+	munmap(hdr, len);
+	shm_unlink(path);
+	if (fclose(out))
+	{
+		return 1;
+	}
+
+	return (gaps || (state == SHM_RING_FAILED)) ? 1 : 0;
+}
@@ -0,0 +1,251 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	rt.c
+ *		Real-time profile for live playout
+ *
+ *		With -rt the stage runner is made safe to run against a clock. The
+ *		stdio streams get buffers owned by the run instead of allocating
+ *		their own on first use, the burst buffers and the stack are touched
+ *		and then locked into memory so the steady state neither allocates
+ *		nor page faults, and the process optionally moves to SCHED_FIFO.
+ *		The time taken by every burst goes into a histogram, reported at
+ *		the end of the run, whose maximum is the bound to plan against.
+ *		Everything is released again before the output header is written.
+ *
+ *	History:
+ *		10/19/26	stdio buffers given before first use of the streams
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "frame337.h"
+#include <time.h>
+
+#ifdef UNIX
+#include <errno.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif /* UNIX */
+
+#define RT_STACK_PREFAULT	(256 * 1024)	/* stack touched before the run */
+#define RT_PAGE_SIZE		4096			/* stride when touching memory */
+
+/* Monotonic time in nanoseconds */
+int64_t rt_now(void)
+{
+	struct timespec ts;
+
+#ifdef UNIX
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+	timespec_get(&ts, TIME_UTC);
+#endif /* UNIX */
+	return((int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+/* Add one time to a histogram, no allocation or I/O */
+void rt_record(Rt_Hist *hist,				/* IN/OUT: histogram */
+				int64_t ns)					/* IN: time taken */
+{
+	int64_t us = ns / 1000;
+	int i = 0;
+
+	while ((i < RT_HIST_BUCKETS - 1) && (us >= ((int64_t)1 << i)))
+	{
+		i++;
+	}
+	hist->bucket[i]++;
+
+	if (!hist->count || (ns < hist->min_ns))
+	{
+		hist->min_ns = ns;
+	}
+	if (ns > hist->max_ns)
+	{
+		hist->max_ns = ns;
+	}
+	hist->total_ns += ns;
+	hist->count++;
+}
+
+/* Give stdio streams buffers owned by the run, called as soon as they are opened */
+void rt_stdio(Rt_Info *rt,					/* IN/OUT: real-time state owning the buffers */
+				FILE *infile,				/* IN: input stream not yet read or moved, or NULL */
+				FILE *outfile)				/* IN: output stream not yet written or moved, or NULL */
+{
+	/* setvbuf() is only defined before any other operation on the stream */
+	if (infile && setvbuf(infile, (char *)rt->inbuf, _IOFBF, RT_STDIO_BUF))
+	{
+		error_msg("Unable to set the input buffer, stdio may allocate during the run", WARNING);
+	}
+	if (outfile && setvbuf(outfile, (char *)rt->outbuf, _IOFBF, RT_STDIO_BUF))
+	{
+		error_msg("Unable to set the output buffer, stdio may allocate during the run", WARNING);
+	}
+}
+
+/* Touch the stack the stages will run on, so it is mapped before it is locked */
+static void rt_prefault_stack(void)
+{
+	unsigned char stack[RT_STACK_PREFAULT];
+	volatile unsigned char *p = stack;
+	int i;
+
+	for (i = 0; i < RT_STACK_PREFAULT; i += RT_PAGE_SIZE)
+	{
+		p[i] = 0;
+	}
+}
+
+/* Fault in and lock the run's memory and switch to the real-time scheduler */
+void rt_start(Rt_Info *rt,					/* IN/OUT: real-time state */
+				void *bufs,					/* IN: buffers recycled by the run */
+				size_t len)					/* IN: their total size in bytes */
+{
+	volatile unsigned char *p = (volatile unsigned char *)bufs;
+	size_t i;
+
+	/* the buffers come from calloc(), rewriting a zero keeps them as they are */
+	for (i = 0; i < len; i += RT_PAGE_SIZE)
+	{
+		p[i] = p[i];
+	}
+	/* the stdio buffers are in use by now and may hold input, so they are rewritten in place as well */
+	p = (volatile unsigned char *)rt->inbuf;
+	for (i = 0; i < RT_STDIO_BUF; i += RT_PAGE_SIZE)
+	{
+		p[i] = p[i];
+	}
+	p = (volatile unsigned char *)rt->outbuf;
+	for (i = 0; i < RT_STDIO_BUF; i += RT_PAGE_SIZE)
+	{
+		p[i] = p[i];
+	}
+	rt_prefault_stack();
+
+#ifdef UNIX
+	/* later mappings, the pipeline threads' stacks among them, are locked as they are made */
+	if (mlockall(MCL_CURRENT | MCL_FUTURE))
+	{
+		error_msg("Unable to lock memory, the run may page fault", WARNING);
+	}
+	else
+	{
+		rt->locked = 1;
+	}
+
+	if (rt->priority)
+	{
+		struct sched_param param = { 0 };
+
+		param.sched_priority = rt->priority;
+		if (sched_setscheduler(0, SCHED_FIFO, &param))
+		{
+			error_msg(errno == EPERM ? "Not permitted to use SCHED_FIFO, keeping the normal scheduler"
+				: "Unable to use SCHED_FIFO, keeping the normal scheduler", WARNING);
+		}
+		else
+		{
+			rt->fifo = 1;
+		}
+	}
+#else
+	error_msg("Memory locking and real-time scheduling are not supported on this platform", WARNING);
+#endif /* UNIX */
+}
+
+/* Undo rt_start(), the rest of the program is not time critical */
+void rt_stop(Rt_Info *rt)					/* IN/OUT: real-time state */
+{
+#ifdef UNIX
+	if (rt->fifo)
+	{
+		struct sched_param param = { 0 };
+
+		sched_setscheduler(0, SCHED_OTHER, &param);
+	}
+	if (rt->locked)
+	{
+		/* MCL_FUTURE would count every later allocation against RLIMIT_MEMLOCK */
+		munlockall();
+	}
+#endif /* UNIX */
+}
+
+/* Upper bound of the bucket holding a fraction of the times, in microseconds */
+static int64_t rt_percentile(const Rt_Hist *hist, double fraction)
+{
+	long want = (long)(fraction * hist->count + 0.5);
+	long seen = 0;
+	int i;
+
+	for (i = 0; i < RT_HIST_BUCKETS - 1; i++)
+	{
+		seen += hist->bucket[i];
+		if (seen >= want)
+		{
+			break;
+		}
+	}
+	return((int64_t)1 << i);
+}
+
+static void show_rt_hist(const char *name, const Rt_Hist *hist)
+{
+	int i;
+
+	if (!hist->count)
+	{
+		return;
+	}
+	printf("%s: %ld bursts, min %lld us, average %lld us, max %lld us\n", name, hist->count,
+		(long long)(hist->min_ns / 1000), (long long)(hist->total_ns / hist->count / 1000),
+		(long long)(hist->max_ns / 1000));
+	printf("  p50 < %lld us, p99 < %lld us, p99.9 < %lld us\n", (long long)rt_percentile(hist, 0.5),
+		(long long)rt_percentile(hist, 0.99), (long long)rt_percentile(hist, 0.999));
+	for (i = 0; i < RT_HIST_BUCKETS; i++)
+	{
+		if (hist->bucket[i])
+		{
+			if (i < RT_HIST_BUCKETS - 1)
+			{
+				printf("  < %8lld us: %ld\n", (long long)((int64_t)1 << i), hist->bucket[i]);
+			}
+			else
+			{
+				printf("  >=%8lld us: %ld\n", (long long)((int64_t)1 << (i - 1)), hist->bucket[i]);
+			}
+		}
+	}
+}
+
+void show_rt_stats(Rt_Info *rt)
+{
+	printf("Real-time: memory %s, %s\n", rt->locked ? "locked" : "not locked",
+		rt->fifo ? "SCHED_FIFO" : "normal scheduler");
+	/* reading includes any wait for a live input to grow */
+	show_rt_hist("Burst read", &rt->read_hist);
+	show_rt_hist("Burst pack and write", &rt->burst_hist);
+}
@@ -0,0 +1,366 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	rtp.c
+ *		RTP output of the SMPTE 337 stream, 24-bit linear (L24) payload
+ *
+ *		Instead of the output file, the formatted samples are cut into RTP
+ *		packets of one packet time (1 ms or 125 us at 48 kHz, stereo) and
+ *		sent to a UDP destination, as an AES67 / ST 2110 receiver expects
+ *		them. 16-bit samples go in the top of the 24-bit words. The RTP
+ *		timestamp is the sample position in the stream, plus a random
+ *		start. Packets are queued and sent together with sendmmsg(). When
+ *		paced, each millisecond of packets is sent when its first sample is
+ *		due by the wall clock, counted from the first send; otherwise as
+ *		fast as the input is read.
+ *
+ *	History:
+ *		10/19/26	sendmmsg() path built on Linux only
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#ifdef __linux__
+#define _GNU_SOURCE					/* sendmmsg() */
+#endif /* __linux__ */
+
+#include "frame337.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <netdb.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#define RTP_HEADER_SIZE		12
+#define RTP_VERSION			0x80		/* V=2, no padding, extension or CSRCs */
+#define RTP_PAYLOAD_TYPE	97			/* dynamic, announced as L24/48000/2 */
+#define RTP_CHANNELS		2
+#define RTP_SAMPLE_BYTES	3
+#define RTP_MAX_FRAMES		(RTP_CLOCK / 1000)	/* sample frames in the longest packet time, 1 ms */
+#define RTP_PACKET_SIZE		(RTP_HEADER_SIZE + RTP_MAX_FRAMES * RTP_CHANNELS * RTP_SAMPLE_BYTES)
+#define RTP_BATCH			64			/* packets sent by one sendmmsg() */
+
+struct Rtp_Sender
+{
+	int fd;							/* connected UDP socket */
+	int frames_per_packet;
+	int batch_len;					/* packets queued before a send */
+	int pace;
+	uint16_t seq;
+	uint32_t ssrc;
+	uint32_t ts_base;
+	int64_t frames;					/* sample frames put in packets so far */
+	int fill;						/* sample frames in the packet being filled */
+	int nqueued;					/* complete packets waiting to be sent */
+	int64_t start_ns;				/* wall clock of sample frame 0, set by the first paced send */
+	long packets;
+	long batches;
+	long refused;					/* packets lost because nothing listened at the destination */
+	long late;						/* paced sends that were already behind the clock */
+	uint8_t packet[RTP_BATCH][RTP_PACKET_SIZE];
+	struct iovec iov[RTP_BATCH];
+	struct mmsghdr msg[RTP_BATCH];
+};
+
+static void put_be16(uint8_t *p, uint16_t v)
+{
+	p[0] = (uint8_t)(v >> 8);
+	p[1] = (uint8_t)v;
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)(v >> 24);
+	p[1] = (uint8_t)(v >> 16);
+	p[2] = (uint8_t)(v >> 8);
+	p[3] = (uint8_t)v;
+}
+
+/* Send the queued packets, at the wall clock time of the first one when pacing */
+static int rtp_send(Format_Ctx *ctx)
+{
+	struct Rtp_Sender *rtp = ctx->rtp;
+	struct timespec due;
+	int64_t due_ns, now;
+	int sent = 0;
+	int n;
+
+	if (rtp->pace)
+	{
+		now = rt_now();
+		if (!rtp->start_ns)
+		{
+			rtp->start_ns = now;
+		}
+		due_ns = rtp->start_ns + (rtp->frames - (int64_t)rtp->nqueued * rtp->frames_per_packet - rtp->fill)
+			* 1000000000 / RTP_CLOCK;
+		if (due_ns > now)
+		{
+			due.tv_sec = due_ns / 1000000000;
+			due.tv_nsec = due_ns % 1000000000;
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+			{
+			}
+		}
+		else if (due_ns < now - 1000000)
+		{
+			rtp->late++;
+		}
+	}
+
+	while (sent < rtp->nqueued)
+	{
+		if ((n = sendmmsg(rtp->fd, &rtp->msg[sent], rtp->nqueued - sent, 0)) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno != ECONNREFUSED)
+			{
+				return run_error(&ctx->file_info->err, ERR_WRITE_ERROR, -1, ctx->framecount, "Unable to send RTP packets: %s", strerror(errno));
+			}
+			/* an ICMP port unreachable for an earlier packet, the receiver may start later */
+			rtp->refused++;
+			n = 1;
+		}
+		sent += n;
+	}
+	rtp->packets += rtp->nqueued;
+	rtp->batches++;
+	rtp->nqueued = 0;
+
+	return 1;
+}
+
+/* Close the packet being filled and queue it, sending the queue when it is full */
+static int rtp_queue(Format_Ctx *ctx)
+{
+	struct Rtp_Sender *rtp = ctx->rtp;
+
+	rtp->fill = 0;
+	if (++rtp->nqueued == rtp->batch_len)
+	{
+		return rtp_send(ctx);
+	}
+	return 1;
+}
+#endif /* __linux__ */
+
+/* Open a UDP socket to host:port ([host]:port for IPv6) */
+int open_rtp(Format_Ctx *ctx,			/* IN/OUT: format context, rtp is set */
+			 const char *dest,			/* IN: destination */
+			 int ptime_us,				/* IN: packet time in microseconds */
+			 int pace)					/* IN: send by the wall clock */
+										/* returns 0 on error */
+{
+#ifdef __linux__
+	struct Rtp_Sender *rtp;
+	struct addrinfo hints = { 0 };
+	struct addrinfo *addr, *ai;
+	char host[ERR_STR_BUF_LEN];
+	const char *port;
+	int status;
+	int fd = -1;
+	int i;
+
+	port = strrchr(dest, ':');
+	if (!port || (port == dest) || (port - dest >= (int)sizeof(host)) || !*(port + 1))
+	{
+		return run_error(&ctx->file_info->err, ERR_BAD_OUTPUT, -1, -1, "RTP destination %s is not host:port", dest);
+	}
+	if ((*dest == '[') && (*(port - 1) == ']'))
+	{
+		/* [v6 address]:port */
+		snprintf(host, sizeof(host), "%.*s", (int)(port - dest - 2), dest + 1);
+	}
+	else
+	{
+		snprintf(host, sizeof(host), "%.*s", (int)(port - dest), dest);
+	}
+	port++;
+
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	if ((status = getaddrinfo(host, port, &hints, &addr)) != 0)
+	{
+		return run_error(&ctx->file_info->err, ERR_BAD_OUTPUT, -1, -1, "RTP destination %s: %s", dest, gai_strerror(status));
+	}
+	for (ai = addr; ai; ai = ai->ai_next)
+	{
+		if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+		{
+			continue;
+		}
+		if (!connect(fd, ai->ai_addr, ai->ai_addrlen))
+		{
+			break;
+		}
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(addr);
+	if (fd < 0)
+	{
+		return run_error(&ctx->file_info->err, ERR_BAD_OUTPUT, -1, -1, "Unable to open a socket to %s", dest);
+	}
+
+	if ((rtp = (struct Rtp_Sender *)calloc(1, sizeof(struct Rtp_Sender))) == NULL)
+	{
+		close(fd);
+		return run_error(&ctx->file_info->err, ERR_NO_MEMORY, -1, -1, "Unable to allocate RTP packets");
+	}
+	rtp->fd = fd;
+	rtp->frames_per_packet = ptime_us * (RTP_CLOCK / 1000) / 1000;
+	rtp->pace = pace;
+
+	/* paced, a send holds one millisecond so packets leave close to their time */
+	rtp->batch_len = pace ? RTP_MAX_FRAMES / rtp->frames_per_packet : RTP_BATCH;
+
+	/* RFC 3550 wants the sequence number, timestamp and SSRC to start at random */
+	srand((unsigned int)(rt_now() ^ getpid()));
+	rtp->seq = (uint16_t)rand();
+	rtp->ts_base = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+	rtp->ssrc = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+
+	for (i = 0; i < RTP_BATCH; i++)
+	{
+		rtp->iov[i].iov_base = rtp->packet[i];
+		rtp->iov[i].iov_len = RTP_HEADER_SIZE + rtp->frames_per_packet * RTP_CHANNELS * RTP_SAMPLE_BYTES;
+		rtp->msg[i].msg_hdr.msg_iov = &rtp->iov[i];
+		rtp->msg[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	ctx->rtp = rtp;
+	return 1;
+#else
+	return run_error(&ctx->file_info->err, ERR_BAD_OUTPUT, -1, -1, "RTP output is not supported on this platform");
+#endif /* __linux__ */
+}		//		open_rtp()
+
+/* Cut one packed burst into RTP packets, sending them a batch at a time */
+int rtp_write_burst(Format_Ctx *ctx,	/* IN/OUT: format context */
+					Burst_Buf *burst)	/* IN: packed burst */
+										/* returns 0 on error */
+{
+#ifdef __linux__
+	struct Rtp_Sender *rtp = ctx->rtp;
+	const uint8_t *in = burst->out;
+	int nsamples = burst->burst_size;
+	uint8_t *p;
+	int i;
+
+	/* a Dolby E burst can end in the middle of a sample frame's packet, the next burst goes on filling it */
+	for (i = 0; i < nsamples; i += RTP_CHANNELS)
+	{
+		p = rtp->packet[rtp->nqueued];
+		if (!rtp->fill)
+		{
+			p[0] = RTP_VERSION;
+			p[1] = RTP_PAYLOAD_TYPE;
+			put_be16(p + 2, rtp->seq++);
+			put_be32(p + 4, rtp->ts_base + (uint32_t)rtp->frames);
+			put_be32(p + 8, rtp->ssrc);
+		}
+		p += RTP_HEADER_SIZE + rtp->fill * RTP_CHANNELS * RTP_SAMPLE_BYTES;
+
+		/* little endian words of the output file, big endian 24-bit samples on the wire */
+		if (burst->out_wordbytes == 2)
+		{
+			p[0] = in[1];
+			p[1] = in[0];
+			p[2] = 0;
+			p[3] = in[3];
+			p[4] = in[2];
+			p[5] = 0;
+		}
+		else
+		{
+			p[0] = in[2];
+			p[1] = in[1];
+			p[2] = in[0];
+			p[3] = in[5];
+			p[4] = in[4];
+			p[5] = in[3];
+		}
+		in += RTP_CHANNELS * burst->out_wordbytes;
+		rtp->frames++;
+
+		if ((++rtp->fill == rtp->frames_per_packet) && !rtp_queue(ctx))
+		{
+			return 0;
+		}
+	}
+#endif /* __linux__ */
+
+	return 1;
+}		//		rtp_write_burst()
+
+/* Send what is left, the last packet padded with silence, and close the socket */
+int close_rtp(Format_Ctx *ctx,			/* IN/OUT: format context, rtp is freed */
+			  int failed)				/* IN: the run stopped on an error, nothing more is sent */
+										/* returns 0 on error */
+{
+	int status = 1;
+#ifdef __linux__
+	struct Rtp_Sender *rtp = ctx->rtp;
+
+	if (!failed)
+	{
+		if (rtp->fill)
+		{
+			memset(rtp->packet[rtp->nqueued] + RTP_HEADER_SIZE + rtp->fill * RTP_CHANNELS * RTP_SAMPLE_BYTES, 0,
+				(rtp->frames_per_packet - rtp->fill) * RTP_CHANNELS * RTP_SAMPLE_BYTES);
+			rtp->frames += rtp->frames_per_packet - rtp->fill;
+			rtp->fill = 0;
+			rtp->nqueued++;
+		}
+		if (rtp->nqueued)
+		{
+			status = rtp_send(ctx);
+		}
+	}
+	close(rtp->fd);
+
+	ctx->rtp_packets = rtp->packets;
+	ctx->rtp_batches = rtp->batches;
+	ctx->rtp_refused = rtp->refused;
+	ctx->rtp_late = rtp->late;
+	free(rtp);
+#endif /* __linux__ */
+	ctx->rtp = NULL;
+
+	return status;
+}		//		close_rtp()
+
+void show_rtp_stats(Format_Ctx *ctx)
+{
+	if (ctx->rtp_packets)
+	{
+		printf("RTP: %ld packets in %ld sends, %ld refused by the destination, %ld sent late\n",
+			ctx->rtp_packets, ctx->rtp_batches, ctx->rtp_refused, ctx->rtp_late);
+	}
+}
@@ -0,0 +1,485 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	rtpin.c
+ *		RTP input for live deformatting, the mirror of rtp.c
+ *
+ *		L24 stereo RTP packets are received on a UDP socket, a batch at a
+ *		time with recvmmsg(), and put in a jitter buffer by sequence number.
+ *		In order packets are converted to little endian samples of the -b
+ *		size and handed to the deformatter through a stdio cookie stream,
+ *		so the preamble search reads them as it reads a PCM file. A missing
+ *		packet is given up on once RTPIN_REORDER later ones have arrived,
+ *		and its time is filled with silence so the sample positions of the
+ *		bursts after it stay right. A packet that arrives after its place
+ *		was filled is late and dropped. The stream ends when nothing has
+ *		arrived for RTPIN_IDLE_SECS. The last RTPIN_HISTORY bytes handed
+ *		over are kept, so stdio can seek back within its buffer.
+ *
+ *	History:
+ *		10/19/26	recvmmsg() and the cookie stream built on Linux only
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#ifdef __linux__
+#define _GNU_SOURCE					/* fopencookie(), recvmmsg() */
+#endif /* __linux__ */
+
+#include "frame337.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+
+#define RTPIN_BATCH			32				/* packets received by one recvmmsg() */
+#define RTPIN_SLOTS			64				/* jitter buffer, power of 2 */
+#define RTPIN_REORDER		16				/* later packets in before a missing one is lost */
+#define RTPIN_PACKET_SIZE	1500
+#define RTPIN_HISTORY		(512 * 1024)	/* stream bytes kept, power of 2 */
+#define RTPIN_IDLE_SECS		10				/* the stream ends after this long without a packet */
+#define RTPIN_RCVBUF		(4 * 1024 * 1024)
+#define RTPIN_FRAME_BYTES	6				/* L24 stereo sample frame */
+
+typedef struct
+{
+	int fd;
+	int sample_bytes;					/* bytes per sample handed over, 2, 3 or 4 */
+	int verbose;
+	int idle;							/* seconds without a packet */
+	int ended;
+
+	/* jitter buffer */
+	int started;						/* the first packet set ssrc and next_seq */
+	uint32_t ssrc;
+	uint16_t next_seq;					/* next packet to hand over */
+	uint16_t high_seq;					/* latest packet received */
+	int last_frames;					/* sample frames of the last packet, the size of a lost one */
+	int nheld;
+	int held[RTPIN_SLOTS];
+	int len[RTPIN_SLOTS];				/* payload bytes */
+	uint8_t slot[RTPIN_SLOTS][RTPIN_PACKET_SIZE];
+
+	/* receive batch */
+	uint8_t rx[RTPIN_BATCH][RTPIN_PACKET_SIZE];
+	struct iovec iov[RTPIN_BATCH];
+	struct mmsghdr msg[RTPIN_BATCH];
+
+	/* stream handed over */
+	int64_t produced;					/* bytes converted so far */
+	int64_t pos;						/* read position */
+	uint8_t hist[RTPIN_HISTORY];
+
+	long packets;
+	long lost;
+	long late;
+	long reordered;
+	long duplicates;
+	long foreign;						/* other SSRCs or not L24 stereo */
+}Rtp_Input;
+
+/* Append one packet's samples, or silence for a lost one, to the stream */
+static void rtpin_produce(Rtp_Input *in, const uint8_t *payload, int frames)
+{
+	uint32_t value = 0;
+	int nsamples = frames * 2;
+	int i, j;
+
+	for (i = 0; i < nsamples; i++)
+	{
+		/* big endian 24 bits on the wire, the top of a little endian sample handed over */
+		if (payload)
+		{
+			value = ((uint32_t)payload[0] << 24) | ((uint32_t)payload[1] << 16) | ((uint32_t)payload[2] << 8);
+			payload += 3;
+		}
+		value >>= 32 - 8 * in->sample_bytes;
+		for (j = 0; j < in->sample_bytes; j++)
+		{
+			in->hist[in->produced++ & (RTPIN_HISTORY - 1)] = (uint8_t)(value >> (8 * j));
+		}
+	}
+}
+
+/* Hand over packets in sequence, returns the number handed over */
+static int rtpin_release(Rtp_Input *in,
+						 int flush)				/* IN: give up on every missing packet */
+{
+	int released = 0;
+	int idx;
+
+	/* leave most of the history for seeking back */
+	while (in->nheld && (in->produced - in->pos < RTPIN_HISTORY / 2))
+	{
+		idx = in->next_seq & (RTPIN_SLOTS - 1);
+		if (in->held[idx])
+		{
+			in->last_frames = in->len[idx] / RTPIN_FRAME_BYTES;
+			rtpin_produce(in, in->slot[idx], in->last_frames);
+			in->held[idx] = 0;
+			in->nheld--;
+		}
+		else if (flush || ((uint16_t)(in->high_seq - in->next_seq) >= RTPIN_REORDER))
+		{
+			rtpin_produce(in, NULL, in->last_frames);
+			in->lost++;
+		}
+		else
+		{
+			break;
+		}
+		in->next_seq++;
+		released++;
+	}
+
+	return released;
+}
+
+/* Put a received packet in the jitter buffer */
+static void rtpin_insert(Rtp_Input *in, const uint8_t *pkt, int len)
+{
+	int hdr_len;
+	int idx;
+	uint16_t seq;
+	uint32_t ssrc;
+
+	if ((len < 12) || ((pkt[0] & 0xc0) != 0x80))
+	{
+		in->foreign++;
+		return;
+	}
+	hdr_len = 12 + (pkt[0] & 0x0f) * 4;
+	if ((pkt[0] & 0x10) && (len >= hdr_len + 4))
+	{
+		/* header extension */
+		hdr_len += 4 + ((pkt[hdr_len + 2] << 8) | pkt[hdr_len + 3]) * 4;
+	}
+	if ((pkt[0] & 0x20) && (len > hdr_len))
+	{
+		/* padding */
+		len -= pkt[len - 1];
+	}
+	len -= hdr_len;
+	seq = (uint16_t)((pkt[2] << 8) | pkt[3]);
+	ssrc = ((uint32_t)pkt[8] << 24) | ((uint32_t)pkt[9] << 16) | ((uint32_t)pkt[10] << 8) | pkt[11];
+
+	if ((len <= 0) || (len % RTPIN_FRAME_BYTES) || (in->started && (ssrc != in->ssrc)))
+	{
+		in->foreign++;
+		return;
+	}
+	in->packets++;
+	if (!in->started)
+	{
+		in->started = 1;
+		in->ssrc = ssrc;
+		in->next_seq = in->high_seq = seq;
+		in->last_frames = len / RTPIN_FRAME_BYTES;
+	}
+
+	if ((int16_t)(seq - in->next_seq) < 0)
+	{
+		in->late++;
+		return;
+	}
+	/* too far ahead for the buffer, what it still waits for is lost */
+	while ((uint16_t)(seq - in->next_seq) >= RTPIN_SLOTS)
+	{
+		idx = in->next_seq & (RTPIN_SLOTS - 1);
+		rtpin_produce(in, in->held[idx] ? in->slot[idx] : NULL, in->held[idx] ? in->len[idx] / RTPIN_FRAME_BYTES : in->last_frames);
+		in->lost += !in->held[idx];
+		in->nheld -= in->held[idx];
+		in->held[idx] = 0;
+		in->next_seq++;
+	}
+
+	idx = seq & (RTPIN_SLOTS - 1);
+	if (in->held[idx])
+	{
+		in->duplicates++;
+		return;
+	}
+	if ((int16_t)(seq - in->high_seq) < 0)
+	{
+		in->reordered++;
+	}
+	else
+	{
+		in->high_seq = seq;
+	}
+	memcpy(in->slot[idx], pkt + hdr_len, len);
+	in->len[idx] = len;
+	in->held[idx] = 1;
+	in->nheld++;
+}
+
+/* Make more of the stream available, returns 0 at its end and -1 on a socket error */
+static int rtpin_fill(Rtp_Input *in)
+{
+	int n;
+	int i;
+
+	for (;;)
+	{
+		if (rtpin_release(in, in->ended))
+		{
+			return 1;
+		}
+		if (in->ended)
+		{
+			return 0;
+		}
+
+		if ((n = recvmmsg(in->fd, in->msg, RTPIN_BATCH, MSG_WAITFORONE, NULL)) < 0)
+		{
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			{
+				/* a receive timeout of a second */
+				if (++in->idle >= RTPIN_IDLE_SECS)
+				{
+					if (in->verbose)
+					{
+						printf("\nRTP: no packets for %d seconds, finishing\n", RTPIN_IDLE_SECS);
+					}
+					in->ended = 1;
+				}
+				continue;
+			}
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return -1;
+		}
+
+		in->idle = 0;
+		for (i = 0; i < n; i++)
+		{
+			rtpin_insert(in, in->rx[i], in->msg[i].msg_len);
+		}
+	}
+}
+
+static ssize_t rtpin_read(void *cookie, char *buf, size_t size)
+{
+	Rtp_Input *in = (Rtp_Input *)cookie;
+	size_t n, first;
+	int status;
+
+	while (in->pos >= in->produced)
+	{
+		if ((status = rtpin_fill(in)) <= 0)
+		{
+			return status;
+		}
+	}
+
+	n = (size_t)(in->produced - in->pos);
+	if (n > size)
+	{
+		n = size;
+	}
+	first = RTPIN_HISTORY - (size_t)(in->pos & (RTPIN_HISTORY - 1));
+	if (first > n)
+	{
+		first = n;
+	}
+	memcpy(buf, &in->hist[in->pos & (RTPIN_HISTORY - 1)], first);
+	memcpy(buf + first, in->hist, n - first);
+	in->pos += n;
+
+	return (ssize_t)n;
+}
+
+/* Seek within what is kept, or forward by reading, there is no end to seek to */
+static int rtpin_seek(void *cookie, off64_t *offset, int whence)
+{
+	Rtp_Input *in = (Rtp_Input *)cookie;
+	int64_t target;
+
+	switch (whence)
+	{
+		case SEEK_SET:
+			target = *offset;
+			break;
+		case SEEK_CUR:
+			target = in->pos + *offset;
+			break;
+		default:
+			errno = ESPIPE;
+			return -1;
+	}
+	if ((target < 0) || (target < in->produced - RTPIN_HISTORY / 2))
+	{
+		errno = ESPIPE;
+		return -1;
+	}
+	while (target > in->produced)
+	{
+		in->pos = in->produced;
+		if (rtpin_fill(in) <= 0)
+		{
+			return -1;
+		}
+	}
+	in->pos = target;
+	*offset = target;
+
+	return 0;
+}
+
+static int rtpin_close(void *cookie)
+{
+	Rtp_Input *in = (Rtp_Input *)cookie;
+
+	printf("RTP input: %ld packets, %ld lost, %ld late, %ld reordered, %ld duplicates, %ld not ours\n",
+		in->packets, in->lost, in->late, in->reordered, in->duplicates, in->foreign);
+	close(in->fd);
+	free(in);
+
+	return 0;
+}
+
+/* Socket bound to [host:]port, joined to the group if host is a multicast address */
+static int rtpin_socket(const char *addr)
+{
+	struct addrinfo hints = { 0 };
+	struct addrinfo *res, *ai;
+	struct timeval timeout = { 1, 0 };
+	char host[ERR_STR_BUF_LEN];
+	const char *port = strrchr(addr, ':');
+	int rcvbuf = RTPIN_RCVBUF;
+	int fd = -1;
+
+	host[0] = '\0';
+	if (port)
+	{
+		if ((*addr == '[') && (port > addr + 1) && (*(port - 1) == ']'))
+		{
+			snprintf(host, sizeof(host), "%.*s", (int)(port - addr - 2), addr + 1);
+		}
+		else
+		{
+			snprintf(host, sizeof(host), "%.*s", (int)(port - addr), addr);
+		}
+		port++;
+	}
+	else
+	{
+		port = addr;
+	}
+
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_flags = AI_PASSIVE;
+	if (getaddrinfo(*host ? host : NULL, port, &hints, &res))
+	{
+		return -1;
+	}
+	for (ai = res; ai; ai = ai->ai_next)
+	{
+		if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+		{
+			continue;
+		}
+		if (!bind(fd, ai->ai_addr, ai->ai_addrlen))
+		{
+			break;
+		}
+		close(fd);
+		fd = -1;
+	}
+	if (fd >= 0)
+	{
+		if ((ai->ai_family == AF_INET) && IN_MULTICAST(ntohl(((struct sockaddr_in *)ai->ai_addr)->sin_addr.s_addr)))
+		{
+			struct ip_mreq mreq = { 0 };
+
+			mreq.imr_multiaddr = ((struct sockaddr_in *)ai->ai_addr)->sin_addr;
+			mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+			setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+		}
+		else if ((ai->ai_family == AF_INET6) && IN6_IS_ADDR_MULTICAST(&((struct sockaddr_in6 *)ai->ai_addr)->sin6_addr))
+		{
+			struct ipv6_mreq mreq6 = { 0 };
+
+			mreq6.ipv6mr_multiaddr = ((struct sockaddr_in6 *)ai->ai_addr)->sin6_addr;
+			setsockopt(fd, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mreq6, sizeof(mreq6));
+		}
+		/* the deformatter may fall behind for a moment, the kernel holds the packets meanwhile */
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	}
+	freeaddrinfo(res);
+
+	return fd;
+}
+#endif /* __linux__ */
+
+/* Open an RTP stream as an input of samples of bits_per_sample, NULL if the socket cannot be opened */
+FILE *rtp_input(const char *addr,			/* IN: [host:]port to receive on, host a unicast or multicast address */
+				int bits_per_sample,		/* IN: 16, 24 or 32, sample size handed to the deformatter */
+				int verbose)				/* IN: report why the stream ended */
+{
+#ifdef __linux__
+	cookie_io_functions_t io = { rtpin_read, NULL, rtpin_seek, rtpin_close };
+	Rtp_Input *in;
+	FILE *fp;
+	int i;
+
+	if ((in = (Rtp_Input *)calloc(1, sizeof(Rtp_Input))) == NULL)
+	{
+		return(NULL);
+	}
+	if ((in->fd = rtpin_socket(addr)) < 0)
+	{
+		free(in);
+		return(NULL);
+	}
+	in->sample_bytes = bits_per_sample / 8;
+	in->verbose = verbose;
+	for (i = 0; i < RTPIN_BATCH; i++)
+	{
+		in->iov[i].iov_base = in->rx[i];
+		in->iov[i].iov_len = RTPIN_PACKET_SIZE;
+		in->msg[i].msg_hdr.msg_iov = &in->iov[i];
+		in->msg[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	if ((fp = fopencookie(in, "rb", io)) == NULL)
+	{
+		close(in->fd);
+		free(in);
+	}
+
+	return(fp);
+#else
+	error_msg("RTP input is not supported on this platform", WARNING);
+	return(NULL);
+#endif /* __linux__ */
+}		//		rtp_input()
@@ -0,0 +1,201 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	shmring.c
+ *		Shared memory burst ring, an output a local playout process reads
+ *		in place
+ *
+ *		Instead of the output file, each finished burst is copied into the
+ *		next slot of a POSIX shared memory ring and published with a
+ *		sequence number. The consumer is woken through a futex in the
+ *		ring, reads the samples where they are and releases the slot. The
+ *		layout and protocol are in shmring.h, ringcat.c is a reference
+ *		consumer. The writer waits while the ring is full, so a consumer
+ *		playing in real time paces the run.
+ *
+ *	History:
+ *		10/19/26	Futex ring built on Linux only
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "frame337.h"
+
+#ifdef __linux__
+#include "shmring.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define RING_WAIT_NS		100000000	/* longest futex wait, rechecks a ring whose wake was missed */
+
+static void ring_wait(_Atomic uint32_t *word, uint32_t seen)
+{
+	struct timespec timeout = { 0, RING_WAIT_NS };
+
+	syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, seen, &timeout, NULL, 0);
+}
+
+static void ring_wake(_Atomic uint32_t *word)
+{
+	atomic_fetch_add_explicit(word, 1, memory_order_release);
+	syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+#endif /* __linux__ */
+
+/* Create the ring /name, replacing one left by an earlier run */
+int open_ring(Format_Ctx *ctx,			/* IN/OUT: format context, ring is set */
+			  const char *name)			/* IN: shared memory object name, with or without the leading / */
+										/* returns 0 on error */
+{
+#ifdef __linux__
+	Shm_Ring_Header *hdr;
+	char path[ERR_STR_BUF_LEN];
+	size_t len;
+	void *map;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s%s", (*name == '/') ? "" : "/", name);
+	len = SHM_RING_HEADER_SIZE + (size_t)SHM_RING_SLOTS * (sizeof(Shm_Ring_Slot) + SHM_RING_SLOT_DATA);
+
+	/* a consumer still attached to an old ring keeps its own copy */
+	shm_unlink(path);
+	if ((fd = shm_open(path, O_CREAT | O_EXCL | O_RDWR, 0660)) < 0)
+	{
+		return run_error(&ctx->file_info->err, ERR_BAD_OUTPUT, -1, -1, "Unable to create shared memory ring %s", path);
+	}
+	if (ftruncate(fd, len))
+	{
+		close(fd);
+		shm_unlink(path);
+		return run_error(&ctx->file_info->err, ERR_NO_MEMORY, -1, -1, "Unable to size shared memory ring %s", path);
+	}
+	map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		shm_unlink(path);
+		return run_error(&ctx->file_info->err, ERR_NO_MEMORY, -1, -1, "Unable to map shared memory ring %s", path);
+	}
+
+	/* ftruncate() zeroed the counters */
+	hdr = (Shm_Ring_Header *)map;
+	hdr->version = SHM_RING_VERSION;
+	hdr->header_size = SHM_RING_HEADER_SIZE;
+	hdr->slot_count = SHM_RING_SLOTS;
+	hdr->slot_size = sizeof(Shm_Ring_Slot) + SHM_RING_SLOT_DATA;
+	hdr->sample_rate = 48000;
+	hdr->channels = 2;
+	hdr->producer_pid = (int32_t)getpid();
+	atomic_store_explicit(&hdr->state, SHM_RING_RUNNING, memory_order_relaxed);
+
+	/* a consumer waiting for the ring trusts the rest once it sees the magic */
+	atomic_thread_fence(memory_order_release);
+	memcpy(hdr->magic, SHM_RING_MAGIC, sizeof(hdr->magic));
+
+	ctx->ring = hdr;
+	ctx->ring_len = len;
+	ctx->ring_frames = 0;
+	ctx->ring_waits = 0;
+
+	return 1;
+#else
+	return run_error(&ctx->file_info->err, ERR_BAD_OUTPUT, -1, -1, "Shared memory output is not supported on this platform");
+#endif /* __linux__ */
+}		//		open_ring()
+
+/* Publish one packed burst in the next slot, waiting for the consumer while the ring is full */
+int ring_write_burst(Format_Ctx *ctx,	/* IN/OUT: format context */
+					 Burst_Buf *burst)	/* IN: packed burst */
+										/* returns 0 on error */
+{
+#ifdef __linux__
+	Shm_Ring_Header *hdr = ctx->ring;
+	Shm_Ring_Slot *slot;
+	size_t nbytes = (size_t)burst->out_wordbytes * burst->burst_size;
+	uint64_t seq = atomic_load_explicit(&hdr->write_seq, memory_order_relaxed);
+	uint32_t seen;
+
+	if (nbytes > SHM_RING_SLOT_DATA)
+	{
+		return run_error(&ctx->file_info->err, ERR_LIMIT, -1, -1, "Burst of %lu bytes does not fit a ring slot", (unsigned long)nbytes);
+	}
+
+	if (seq - atomic_load_explicit(&hdr->read_seq, memory_order_acquire) >= hdr->slot_count)
+	{
+		ctx->ring_waits++;
+		for (;;)
+		{
+			/* read the futex before the check, so a release in between ends the wait at once */
+			seen = atomic_load_explicit(&hdr->space_futex, memory_order_acquire);
+			if (seq - atomic_load_explicit(&hdr->read_seq, memory_order_acquire) < hdr->slot_count)
+			{
+				break;
+			}
+			ring_wait(&hdr->space_futex, seen);
+		}
+	}
+
+	slot = (Shm_Ring_Slot *)((uint8_t *)hdr + hdr->header_size + (seq % hdr->slot_count) * hdr->slot_size);
+	slot->seq = seq;
+	slot->first_frame = ctx->ring_frames;
+	slot->bytes = (uint32_t)nbytes;
+	slot->word_bytes = burst->out_wordbytes;
+	slot->frames = (uint32_t)(nbytes / (2 * burst->out_wordbytes));
+	slot->stream_type = burst->stream_type;
+	slot->flags = (burst->pause ? SHM_RING_PAUSE : 0) | (burst->skipped ? SHM_RING_SKIPPED : 0);
+	memcpy(slot + 1, burst->out, nbytes);
+
+	atomic_store_explicit(&hdr->write_seq, seq + 1, memory_order_release);
+	ring_wake(&hdr->data_futex);
+	ctx->ring_frames += slot->frames;
+#endif /* __linux__ */
+
+	return 1;
+}		//		ring_write_burst()
+
+/* Mark the end of the stream and detach, the object stays for the consumer */
+void close_ring(Format_Ctx *ctx,		/* IN/OUT: format context, ring is cleared */
+				int failed)				/* IN: the run stopped on an error */
+{
+#ifdef __linux__
+	atomic_store_explicit(&ctx->ring->state, failed ? SHM_RING_FAILED : SHM_RING_DONE, memory_order_release);
+	ring_wake(&ctx->ring->data_futex);
+	munmap(ctx->ring, ctx->ring_len);
+#endif /* __linux__ */
+	ctx->ring = NULL;
+}		//		close_ring()
+
+void show_ring_stats(Format_Ctx *ctx)
+{
+	if (ctx->ring_frames)
+	{
+		printf("Ring: %lld sample frames published, full %ld times\n", (long long)ctx->ring_frames, ctx->ring_waits);
+	}
+}
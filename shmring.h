@@ -0,0 +1,96 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	shmring.h
+ *		Layout of the shared memory burst ring written by frame337 -shm<name>
+ *
+ *		The ring is the POSIX shared memory object /<name>. It starts with a
+ *		Shm_Ring_Header of header_size bytes, followed by slot_count slots of
+ *		slot_size bytes. Slot n of the stream is at
+ *		header_size + (n % slot_count) * slot_size and holds a Shm_Ring_Slot
+ *		followed by the burst: interleaved stereo samples at sample_rate,
+ *		little endian, word_bytes per sample, exactly as in the WAV output.
+ *
+ *		There is one producer and one consumer. The producer fills slot
+ *		write_seq, then increments write_seq (release) and data_futex and
+ *		wakes data_futex. It never fills a slot until the consumer has moved
+ *		read_seq past the slot's previous use, waiting on space_futex. The
+ *		consumer reads slots below write_seq (acquire) in place, then
+ *		increments read_seq (release) and space_futex and wakes space_futex.
+ *		Both futexes are shared, not FUTEX_PRIVATE. The magic is written
+ *		last when the ring is created. state leaves SHM_RING_RUNNING after
+ *		the last slot is published, and the object is left for the consumer
+ *		to unlink.
+ *
+ *	History:
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define SHM_RING_MAGIC			"F337RNG"	/* 8 bytes with the terminator */
+#define SHM_RING_VERSION		1
+#define SHM_RING_HEADER_SIZE	128			/* offset of slot 0 */
+#define SHM_RING_SLOTS			32			/* slots in a ring */
+#define SHM_RING_SLOT_DATA		16384		/* largest burst, a Dolby E frame of 4096 32-bit words */
+
+enum { SHM_RING_RUNNING, SHM_RING_DONE, SHM_RING_FAILED };	/* Shm_Ring_Header.state */
+#define SHM_RING_PAUSE			1			/* Shm_Ring_Slot.flags: pause burst, no audio */
+#define SHM_RING_SKIPPED		2			/* Shm_Ring_Slot.flags: frames failed their CRC, written as silence */
+
+typedef struct Shm_Ring_Header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t slot_count;
+	uint32_t slot_size;					/* bytes from one slot to the next, with the Shm_Ring_Slot */
+	uint32_t sample_rate;
+	uint32_t channels;
+	int32_t producer_pid;
+	_Atomic uint32_t state;				/* SHM_RING_RUNNING, SHM_RING_DONE or SHM_RING_FAILED */
+	_Atomic uint32_t data_futex;		/* changes when a slot is published or the state changes */
+	_Atomic uint32_t space_futex;		/* changes when a slot is released */
+	_Atomic uint64_t write_seq;			/* slots published since the ring was created */
+	_Atomic uint64_t read_seq;			/* slots released by the consumer */
+}Shm_Ring_Header;
+
+typedef struct
+{
+	uint64_t seq;						/* position in the stream, from 0 */
+	uint64_t first_frame;				/* sample frames in the stream before this burst */
+	uint32_t bytes;						/* burst bytes following this header */
+	uint32_t frames;					/* stereo sample frames in the burst */
+	uint32_t word_bytes;				/* 2 or 3 */
+	uint32_t stream_type;				/* 0 AC-3, 1 E-AC-3, 2 Dolby E, 3 AC-4 */
+	uint32_t flags;						/* SHM_RING_PAUSE, SHM_RING_SKIPPED */
+	uint32_t reserved;
+}Shm_Ring_Slot;
+
+#endif /* SHMRING_H */
@@ -30,6 +30,9 @@ import glob
 import string
 import filecmp
 import sys
+import socket
+import threading
+import wave
 
 # Test script for frame337 framer tool
 #
@@ -48,6 +51,7 @@ os_dir = subprocess.check_output('uname', shell=True)
 ref_frame337 = 'ref_bin/' + os_dir.strip() + '/smpte.exe'
 ref_frame337_ac4 =  'ref_bin/' + os_dir.strip() + '/smpte_app_lin64_ac4'
 dut_frame337 = tools_dir + os_dir.strip() + '/frame337'
+dut_ringcat = tools_dir + os_dir.strip() + '/ringcat'
 
 # Enums
 
@@ -69,6 +73,124 @@ def process_files(arguments, input_dir, input_ext, tool_exec, output_dir, output
 		print "Created %s" % output_file_name
 	
 
+# Fixtures for cases of run_test_cases.txt that need more than one run
+# Each is a setup called with the case before frame337 runs, returning a state,
+# and a teardown called with the case, the state and frame337's exit status, returning whether it passed
+
+def option_value(arguments, option):
+	for word in arguments.split():
+		if word.startswith(option):
+			return word[len(option):]
+	return None
+
+def run_step(cmd):
+	print "DUT cmd: " + cmd
+	step = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, shell=True)
+	print step.communicate()[0]
+	return step.returncode == 0
+
+def append_setup(case):
+	# the first part of the input, @append=<file>, is formatted into the output the case appends to
+	arguments = " ".join(w for w in case['arguments'].split() if w != '-append')
+	return run_step(dut_frame337 + ' ' + arguments + ' -i' + case['value'] + ' -o' + case['dut'])
+
+def fails_teardown(case, state, return_code):
+	# what was written before the abort is kept, only the exit status tells
+	return return_code != 0
+
+def joined_setup(case):
+	# the reference is a single run over the inputs of the playlist joined end to end
+	with open(case['input'], 'r') as f:
+		input_files = [l.strip() for l in f if l.strip() and not l.startswith('#')]
+	stem = os.path.splitext(case['dut'])[0] + '_joined'
+	joined_input_file_name = stem + os.path.splitext(input_files[0])[1]
+	with open(joined_input_file_name, 'wb') as joined:
+		for input_file in input_files:
+			with open(input_file, 'rb') as f:
+				joined.write(f.read())
+	case['ref'] = stem + os.path.splitext(case['dut'])[1]
+	arguments = " ".join(w for w in case['arguments'].split() if not w.startswith('-playlist'))
+	return run_step(dut_frame337 + ' ' + arguments + ' -i' + joined_input_file_name + ' -o' + case['ref'])
+
+def ring_setup(case):
+	# ringcat waits for the ring and writes the samples of its bursts where frame337 would write its output
+	cmd = dut_ringcat + ' ' + option_value(case['arguments'], '-shm') + ' ' + case['dut']
+	print "DUT cmd: " + cmd
+	return subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, shell=True)
+
+def ring_teardown(case, consumer, return_code):
+	print consumer.communicate()[0]
+	return (return_code == 0) and (consumer.returncode == 0)
+
+def rtp_out_receive(rx, packets):
+	first_seq = None
+	try:
+		while True:
+			pkt = bytearray(rx.recv(2048))
+			seq = (pkt[2] << 8) | pkt[3]
+			if first_seq is None:
+				first_seq = seq
+			packets[(seq - first_seq) & 0xffff] = pkt[12:]
+	except socket.timeout:
+		pass
+	rx.close()
+
+def rtp_out_setup(case):
+	# L24 packets, 12 byte headers, are received here and put back in order of sequence number
+	(host, port) = option_value(case['arguments'], '-rtp').split(':')
+	rx = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+	rx.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 << 20)
+	rx.bind((host, int(port)))
+	rx.settimeout(2.0)
+	packets = {}
+	receiver = threading.Thread(target=rtp_out_receive, args=(rx, packets))
+	receiver.start()
+	return (receiver, packets)
+
+def rtp_out_teardown(case, state, return_code):
+	(receiver, packets) = state
+	receiver.join()
+	if (return_code != 0) or not packets or (len(packets) != max(packets) + 1):
+		return False
+	payload = bytearray().join(packets[i] for i in sorted(packets))
+	# the samples are sent big endian, the last packet is filled out with silence
+	samples = bytearray()
+	for i in range(0, len(payload), 3):
+		samples += payload[i:i + 3][::-1]
+	ref_bytes = os.path.getsize(case['ref']) - 44
+	if any(samples[ref_bytes:]):
+		return False
+	# written as the 24-bit WAV file the output would have been
+	out = wave.open(case['dut'], 'wb')
+	out.setnchannels(2)
+	out.setsampwidth(3)
+	out.setframerate(48000)
+	out.writeframes(str(samples[:ref_bytes]))
+	out.close()
+	return True
+
+def rtp_in_setup(case):
+	# a paced RTP output of the input is sent to the receiver once it is listening
+	cmd = 'sleep 1; ' + dut_frame337 + ' -pace -rtp' + option_value(case['arguments'], '-rtpin') + ' -i' + case['input']
+	print "DUT cmd: " + cmd
+	return subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, shell=True)
+
+def rtp_in_teardown(case, sender, return_code):
+	print sender.communicate()[0]
+	return (return_code == 0) and (sender.returncode == 0)
+
+def ok_teardown(case, state, return_code):
+	return state and (return_code == 0)
+
+fixtures = {
+	'append': (append_setup, ok_teardown),
+	'fails': (None, fails_teardown),
+	'joined': (joined_setup, ok_teardown),
+	'ring': (ring_setup, ring_teardown),
+	'rtpout': (rtp_out_setup, rtp_out_teardown),
+	'rtpin': (rtp_in_setup, rtp_in_teardown),
+}
+
 class Tester:
 	'Base Testing Class'
 
@@ -111,28 +233,47 @@ class Tester:
 			for line in f:
 				line_words = line.split()
 				if (len(line_words) > 1):
-					input_file = line_words[0]
-					file_stem = os.path.splitext(os.path.basename(input_file))[0]
-					ref_output_file_name = line_words[1]
-					if len(line_words) > 2:
-						arguments = " ".join(line_words[2:len(line_words)])
-					else:
-						arguments = ''
-					dut_output_file_name = 'dut_output/tid' + (str(self.test_id)).zfill(3) + '_' + file_stem + os.path.splitext(ref_output_file_name)[1]
-					cmd = dut_frame337 + ' ' + arguments + ' -i' + input_file + ' -o' + dut_output_file_name
-					print "DUT cmd: " + cmd
-					dut_test_output = subprocess.check_output(cmd , stderr=subprocess.STDOUT, shell=True)
-					print dut_test_output
-					if(filecmp.cmp(ref_output_file_name, dut_output_file_name)):
-						print input_file + " -> " + dut_output_file_name + " Passed"
-						self.passed += 1
-					else:
-						print input_file + " -> " + dut_output_file_name + " Failed"
-						self.failed += 1
-					self.test_id += 1
+					# @name or @name=value picks a fixture, +suffix=reference compares another output file
+					arguments = [w for w in line_words[2:] if w[0] not in '@+']
+					fixture = [w[1:].split('=', 1) for w in line_words[2:] if w[0] == '@']
+					extra_files = [tuple(w[1:].split('=', 1)) for w in line_words[2:] if w[0] == '+']
+					setup = teardown = None
+					value = None
+					if fixture:
+						(setup, teardown) = fixtures[fixture[0][0]]
+						value = fixture[0][1] if len(fixture[0]) > 1 else None
+					self.run_case(" ".join(arguments), line_words[0], line_words[1], setup, teardown, extra_files, value)
 				else:
 					print >> sys.stderr, 'Test cases file is truncated at line: ' + line
 
+	def run_case(self, arguments, input_file, ref_output_file_name, setup=None, teardown=None, extra_files=[], value=None):
+		# a reference of - or -.ext is made by the setup or not compared, .ext names the output
+		file_stem = os.path.splitext(os.path.basename(input_file))[0]
+		dut_output_file_name = 'dut_output/tid' + (str(self.test_id)).zfill(3) + '_' + file_stem + os.path.splitext(ref_output_file_name)[1]
+		case = {'arguments': arguments, 'input': input_file, 'ref': ref_output_file_name, 'dut': dut_output_file_name, 'value': value}
+		state = None
+		if setup:
+			state = setup(case)
+		cmd = dut_frame337 + ' ' + arguments + ' -i' + input_file + ' -o' + dut_output_file_name
+		print "DUT cmd: " + cmd
+		dut = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, shell=True)
+		print dut.communicate()[0]
+		if teardown:
+			passed = teardown(case, state, dut.returncode)
+		else:
+			passed = (dut.returncode == 0)
+		if passed and (os.path.splitext(case['ref'])[0] != '-'):
+			passed = filecmp.cmp(case['ref'], dut_output_file_name)
+		for (suffix, ref_extra_file_name) in extra_files:
+			passed = passed and filecmp.cmp(ref_extra_file_name, dut_output_file_name + suffix)
+		if passed:
+			print input_file + " -> " + dut_output_file_name + " Passed"
+			self.passed += 1
+		else:
+			print input_file + " -> " + dut_output_file_name + " Failed"
+			self.failed += 1
+		self.test_id += 1
+
 	def run_error_case(self, arguments, input_file, output_ext):
 		file_stem = os.path.splitext(os.path.basename(input_file))[0]
 		dut_output_file_name = 'dut_output/tid' + (str(self.test_id)).zfill(3) + '_' + file_stem + output_ext
@@ -0,0 +1,297 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+/****************************************************************************
+ *	File:	timecode.c
+ *		Keeping the timecode frames of a DD/DD+ stream
+ *
+ *		The timecode frames between DD/DD+ frames are not formatted into the
+ *		bursts, so with -timecode they are kept beside them instead. Each one
+ *		goes in an index, <output>.tc, one line per timecode frame with the
+ *		burst and sample frame of the output the next audio frame starts at
+ *		and the timecode as HH:MM:SS:FF, or "invalid" for a frame that does
+ *		not decode. The first valid one also sets the TimeReference of a BWF
+ *		bext chunk, the sample frames from midnight to the first sample of
+ *		the output.
+ *
+ *		After the sync word a timecode frame holds one 16-bit word each for
+ *		the hours, minutes, seconds and frames of the video frame the next
+ *		audio frame starts in, then the frame rate as FPS_2398..FPS_30, in
+ *		the byte order of the sync word. Timecode is counted non-drop.
+ *
+ *		The bext chunk is written after the data chunk, so the header layouts
+ *		stay as they are and an output can still be appended to or followed;
+ *		an appending run drops the old chunk with everything else after the
+ *		data and writes a new one, keeping the old TimeReference. Its date
+ *		and time are left empty, so a run gives the same bytes every time.
+ *
+ *	History:
+ *		10/19/26	Timecode frames decoded, TimeReference written to a bext chunk
+ *		10/19/26	Raw timecode frames indexed, no bext TimeReference until they are decoded
+ *		10/19/26	Errors are returned to the caller instead of exiting
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "frame337.h"
+
+#define TC_INDEX_EXT		".tc"
+#define TC_BURST_SAMPLES	1536		/* sample frames in a DD/DD+ burst period */
+#define TC_SAMPLE_RATE		48000
+#define TC_DAY_SAMPLES		(24LL * 3600 * TC_SAMPLE_RATE)
+#define BEXT_SIZE			602			/* bext chunk body, version 1 without coding history */
+
+/* Frame rate of a timecode rate code, as num/den */
+static int tc_rate(int code, int *num, int *den)
+{
+	switch (code)
+	{
+		case FPS_2398:
+			*num = 24000; *den = 1001;
+			return(1);
+		case FPS_24:
+			*num = 24; *den = 1;
+			return(1);
+		case FPS_25:
+			*num = 25; *den = 1;
+			return(1);
+		case FPS_2997:
+			*num = 30000; *den = 1001;
+			return(1);
+		case FPS_30:
+			*num = 30; *den = 1;
+			return(1);
+		default:
+			return(0);
+	}
+}
+
+/* Read the fields of a timecode frame */
+int decode_timecode(const uint16_t *tc,		/* IN: timecode frame in native byte order */
+					Timecode *time)			/* OUT: hours, minutes, seconds, frames and rate */
+											/* returns 0 if the frame does not hold a valid timecode */
+{
+	int num, den;
+
+	if ((tc[TC_WORD_SYNC] != TC_SYNC_WD) || !tc_rate(tc[TC_WORD_RATE], &num, &den))
+	{
+		return(0);
+	}
+	time->hours = tc[TC_WORD_HOURS];
+	time->minutes = tc[TC_WORD_MINUTES];
+	time->seconds = tc[TC_WORD_SECONDS];
+	time->frames = tc[TC_WORD_FRAMES];
+	time->rate = tc[TC_WORD_RATE];
+
+	/* frames counted per timecode second, 24 for 23.98 and 30 for 29.97 */
+	if ((time->hours > 23) || (time->minutes > 59) || (time->seconds > 59) || (time->frames >= (num + den - 1) / den))
+	{
+		return(0);
+	}
+
+	return(1);
+}		//		decode_timecode()
+
+/* Sample frames from midnight to the start of a timecode */
+int64_t tc_samples(const Timecode *time)	/* IN: decoded timecode */
+{
+	int num, den;
+	int64_t frames;
+
+	tc_rate(time->rate, &num, &den);
+	frames = ((int64_t)time->hours * 3600 + time->minutes * 60 + time->seconds) * ((num + den - 1) / den) + time->frames;
+
+	/* non-drop timecode, each frame lasts den/num seconds */
+	return(frames * TC_SAMPLE_RATE * den / num);
+}		//		tc_samples()
+
+/* Open the timecode index of an output, appending to it when the output is appended to */
+FILE *open_tc_index(const char *out_fname,	/* IN: output file name */
+					int append,				/* IN: the output already holds bursts */
+					Run_Error *err)			/* OUT: why the index could not be opened */
+											/* returns NULL on error */
+{
+	char *name;
+	FILE *fp;
+
+	if ((name = (char *)malloc(strlen(out_fname) + sizeof(TC_INDEX_EXT))) == NULL)
+	{
+		run_error(err, ERR_NO_MEMORY, -1, -1, "Unable to allocate timecode index name");
+		return(NULL);
+	}
+	strcpy(name, out_fname);
+	strcat(name, TC_INDEX_EXT);
+
+	if ((fp = fopen(name, append ? "a" : "w")) == NULL)
+	{
+		run_error(err, ERR_WRITE_ERROR, -1, -1, "decode: Unable to create timecode index, %s.", name);
+		free(name);
+		return(NULL);
+	}
+	if (ftell(fp) == 0)
+	{
+		fprintf(fp, "# burst\tsample\ttimecode\n");
+	}
+
+	free(name);
+	return(fp);
+}		//		open_tc_index()
+
+/* Record a DD/DD+ timecode frame against the output position of the audio frame after it */
+void index_timecode(Format_Ctx *ctx,		/* IN/OUT: format context, index open */
+					const uint16_t *tc,		/* IN: timecode frame in native byte order */
+					int numblocks)			/* IN: audio blocks of the burst being read before the frame */
+{
+	Timecode time;
+	int64_t sample;
+
+	/* pause bursts queued for a gap or damage go in ahead of the frame */
+	sample = ctx->out_samples + (int64_t)numblocks * 256 + (int64_t)ctx->pause_bursts * TC_BURST_SAMPLES;
+
+	fprintf(ctx->tc_index, "%lld\t%lld\t", (long long)(sample / TC_BURST_SAMPLES), (long long)sample);
+	ctx->tc_count++;
+	if (!decode_timecode(tc, &time))
+	{
+		fprintf(ctx->tc_index, "invalid\n");
+		return;
+	}
+	fprintf(ctx->tc_index, "%02d:%02d:%02d:%02d\n", time.hours, time.minutes, time.seconds, time.frames);
+
+	if (!ctx->have_time_ref)
+	{
+		/* back from the frame to the first sample of the output, past midnight if need be */
+		ctx->time_ref = tc_samples(&time) - sample;
+		while (ctx->time_ref < 0)
+		{
+			ctx->time_ref += TC_DAY_SAMPLES;
+		}
+		ctx->have_time_ref = 1;
+	}
+}		//		index_timecode()
+
+/* Take the TimeReference from the bext chunk at the end of an output about to be appended to */
+void resume_time_ref(Format_Ctx *ctx)		/* IN/OUT: format context, output open for update */
+{
+	FILE *fp = ctx->file_info->smpte_file;
+	uint8_t chunk[8 + BEXT_SIZE];
+	int32_t size32;
+	uint32_t time_low, time_high;
+	int64_t length;
+
+	/* this tool writes it last, so it is the only place to look */
+	fseek64(fp, 0, SEEK_END);
+	length = ftell64(fp);
+	if (length < (int64_t)sizeof(chunk) + WAVE_HEADER_SIZE)
+	{
+		return;
+	}
+	fseek64(fp, length - sizeof(chunk), SEEK_SET);
+	if (fread(chunk, sizeof(chunk), 1, fp) != 1)
+	{
+		return;
+	}
+	memcpy(&size32, &chunk[4], 4);
+	if (memcmp(&chunk[0], "bext", 4) || (size32 != BEXT_SIZE))
+	{
+		return;
+	}
+
+	/* the first sample of the output has not moved */
+	memcpy(&time_low, &chunk[8 + 338], 4);
+	memcpy(&time_high, &chunk[8 + 342], 4);
+	ctx->time_ref = ((int64_t)time_high << 32) | time_low;
+	ctx->have_time_ref = 1;
+}		//		resume_time_ref()
+
+/* Add a bext chunk after the data chunk of a finished output and count it in the RIFF size */
+int write_bext(Format_Ctx *ctx,				/* IN/OUT: format context, time reference found */
+			   int64_t data_bytes)			/* IN: size of the data chunk */
+											/* returns 0 on error */
+{
+	FILE *fp = ctx->file_info->smpte_file;
+	uint8_t chunk[8 + BEXT_SIZE] = { 0 };
+	uint8_t *bext = &chunk[8];
+	uint8_t hdr[WAVE_HEADER_SIZE_RF64];
+	int32_t size32 = BEXT_SIZE;
+	uint32_t riff32;
+	uint32_t time_low = (uint32_t)ctx->time_ref;
+	uint32_t time_high = (uint32_t)(ctx->time_ref >> 32);
+	uint16_t version = 1;
+	int64_t riff64;
+
+	memcpy(&chunk[0], "bext", 4);
+	memcpy(&chunk[4], &size32, 4);
+	snprintf((char *)&bext[0], 256, "SMPTE 337 bursts, timecode from the elementary stream");
+	snprintf((char *)&bext[256], 32, "frame337 " FRAME337_VERSION);
+	memcpy(&bext[338], &time_low, 4);
+	memcpy(&bext[342], &time_high, 4);
+	memcpy(&bext[346], &version, 2);
+
+	fflush(fp);
+	rewind(fp);
+	if (fread(hdr, 1, ctx->header_size, fp) != (size_t)ctx->header_size)
+	{
+		return run_error(&ctx->file_info->err, ERR_READ_ERROR, -1, -1, "decode: Unable to read output file");
+	}
+	/* a reserved header is RF64 by now if the data outgrew RIFF */
+	if (!memcmp(&hdr[0], "RF64", 4))
+	{
+		memcpy(&riff64, &hdr[20], 8);
+		riff64 += sizeof(chunk);
+		memcpy(&hdr[20], &riff64, 8);
+	}
+	else if (ctx->header_size + data_bytes + sizeof(chunk) - 8 <= WAVE_RIFF_MAX)
+	{
+		memcpy(&riff32, &hdr[4], 4);
+		riff32 += sizeof(chunk);
+		memcpy(&hdr[4], &riff32, 4);
+	}
+	else
+	{
+		error_msg("timecode: no room left in the RIFF size for a bext chunk, not written", WARNING);
+		return 1;
+	}
+
+	fseek64(fp, ctx->header_size + data_bytes, SEEK_SET);
+	fwrite(chunk, sizeof(chunk), 1, fp);
+	rewind(fp);
+	if ((fwrite(hdr, ctx->header_size, 1, fp) != 1) || fflush(fp))
+	{
+		return run_error(&ctx->file_info->err, ERR_WRITE_ERROR, -1, -1, "decode: Unable to write to output file");
+	}
+
+	return 1;
+}		//		write_bext()
+
+/* Report the timecode frames kept */
+void show_tc_stats(Format_Ctx *ctx)		/* IN: format context after formatting */
+{
+	if (ctx->tc_index)
+	{
+		printf("Timecode: %ld frames indexed", ctx->tc_count);
+		if (ctx->have_time_ref)
+		{
+			printf(", TimeReference %lld", (long long)ctx->time_ref);
+		}
+		printf("\n");
+	}
+}		//		show_tc_stats()
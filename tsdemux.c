@@ -0,0 +1,638 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	tsdemux.c
+ *		MPEG-2 transport stream input for formatting
+ *
+ *		The audio elementary stream of one PID is taken out of a transport
+ *		stream (188 byte packets, or 192 byte M2TS packets) as it is read
+ *		and handed to the formatter through a stdio cookie stream, so the
+ *		frame reader sees the same bytes it would read from an ES file.
+ *		Without a PID the first AC-3, E-AC-3 or AC-4 stream of the first
+ *		program in the PAT is used. A plain file is mapped and walked in
+ *		place, and each PES payload is copied once, straight from its
+ *		packet to the bytes handed over. There is no PES reassembly
+ *		buffer. The last TS_HISTORY bytes handed over are kept, so stdio
+ *		can seek back within a frame.
+ *
+ *		Continuity counter errors are counted. The PTS of each PES is
+ *		compared with the step between the two before it, and a larger
+ *		step is reported as missing time.
+ *
+ *	History:
+ *		10/19/26	Cookie stream demux built on Linux only
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#ifdef __linux__
+#define _GNU_SOURCE					/* fopencookie() */
+#endif /* __linux__ */
+
+#include "frame337.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TS_PACKET_SIZE		188
+#define TS_M2TS_SIZE		192				/* 4 byte arrival time stamp, then the packet */
+#define TS_SYNC				0x47
+#define TS_READ_PACKETS		512				/* packets read at a time when the input cannot be mapped */
+#define TS_HISTORY			(1024 * 1024)	/* stream bytes kept, power of 2 */
+#define TS_SECTION_MAX		1024			/* PAT and PMT sections are at most 1021 bytes */
+#define TS_PES_HDR_MAX		(9 + 255)
+#define TS_PTS_CLOCK		90000
+#define TS_PTS_MASK			((1LL << 33) - 1)
+#define TS_PTS_JUMP			(10 * TS_PTS_CLOCK)	/* a larger step is a discontinuity, not a gap */
+
+typedef struct
+{
+	FILE *file;
+	int verbose;
+	int ended;
+
+	/* packets, mapped or read a block at a time */
+	uint8_t *map;
+	size_t map_len;
+	const uint8_t *block;
+	size_t block_len;
+	size_t block_pos;
+	int packet_size;					/* 188 or 192 */
+	int prefix;							/* bytes before the sync byte */
+	uint8_t rd[TS_READ_PACKETS * TS_M2TS_SIZE];
+
+	/* stream selection */
+	int pid;							/* audio PID, -1 until the PMT names one */
+	int pmt_pid;						/* -1 until the PAT names one */
+	const char *codec;					/* NULL for a PID that was given */
+	uint8_t sect[TS_SECTION_MAX];
+	int sect_len;						/* bytes of the PSI section collected */
+	int sect_pid;						/* PID it is collected from, -1 for none */
+
+	/* PES */
+	int cc;								/* last continuity counter, -1 before the first packet */
+	int in_pes;							/* a PES has started, its payload is handed over */
+	int hdr_len;						/* PES header bytes collected, -1 once it is complete */
+	uint8_t hdr[TS_PES_HDR_MAX];
+	int64_t last_pts;					/* -1 before the first */
+	int64_t last_step;					/* 0 until two PTS have been seen */
+
+	/* stream handed over */
+	int64_t produced;					/* bytes taken out of PES so far */
+	int64_t pos;						/* read position */
+	uint8_t hist[TS_HISTORY];
+
+	long packets;						/* of the audio PID */
+	long pes;
+	long cc_errors;
+	long errors;						/* transport error indicator set or scrambled */
+	long gaps;
+	int64_t gap_ticks;
+	long jumps;							/* PTS discontinuities */
+	int64_t sync_lost;					/* bytes skipped to find packet sync */
+}Ts_Input;
+
+/* Append PES payload to the stream */
+static void ts_produce(Ts_Input *in, const uint8_t *p, int len)
+{
+	int first = TS_HISTORY - (int)(in->produced & (TS_HISTORY - 1));
+
+	if (first > len)
+	{
+		first = len;
+	}
+	memcpy(&in->hist[in->produced & (TS_HISTORY - 1)], p, first);
+	memcpy(in->hist, p + first, len - first);
+	in->produced += len;
+}
+
+/* Check the step from the last PTS, a step half as long again as the one before is missing time */
+static void ts_pts(Ts_Input *in, int64_t pts)
+{
+	int64_t step;
+
+	in->pes++;
+	if (in->last_pts >= 0)
+	{
+		step = (pts - in->last_pts) & TS_PTS_MASK;
+		if ((step == 0) || (step > TS_PTS_JUMP))
+		{
+			/* backwards, repeated or far ahead, the timeline was restarted */
+			in->jumps++;
+			in->last_step = 0;
+			if (in->verbose)
+			{
+				printf("TS input: PTS discontinuity at %.3f s\n", (double)pts / TS_PTS_CLOCK);
+			}
+		}
+		else if (in->last_step && (step > in->last_step + in->last_step / 2))
+		{
+			in->gaps++;
+			in->gap_ticks += step - in->last_step;
+			if (in->verbose)
+			{
+				printf("TS input: %.1f ms missing before PTS %.3f s\n",
+					1000. * (step - in->last_step) / TS_PTS_CLOCK, (double)pts / TS_PTS_CLOCK);
+			}
+		}
+		else
+		{
+			in->last_step = step;
+		}
+	}
+	in->last_pts = pts;
+}
+
+/* Take the audio PID from a complete PMT section */
+static void ts_pmt(Ts_Input *in, const uint8_t *s, int len)
+{
+	int pos, end, es_len, d, dend;
+	int stream_type, pid;
+	const char *codec;
+
+	if ((s[0] != 0x02) || (len < 16))
+	{
+		return;
+	}
+	pos = 12 + (((s[10] & 0x0f) << 8) | s[11]);
+	end = len - 4;					/* CRC_32 */
+	for (; pos + 5 <= end; pos += 5 + es_len)
+	{
+		stream_type = s[pos];
+		pid = ((s[pos + 1] & 0x1f) << 8) | s[pos + 2];
+		es_len = ((s[pos + 3] & 0x0f) << 8) | s[pos + 4];
+		codec = (stream_type == 0x81) ? "AC-3" : (stream_type == 0x87) ? "E-AC-3" : NULL;
+
+		/* DVB carries them as private data, named by a descriptor */
+		dend = pos + 5 + es_len;
+		for (d = pos + 5; !codec && (stream_type == 0x06) && (d + 2 <= dend) && (dend <= end); d += 2 + s[d + 1])
+		{
+			if (s[d] == 0x6a)
+			{
+				codec = "AC-3";
+			}
+			else if (s[d] == 0x7a)
+			{
+				codec = "E-AC-3";
+			}
+			else if ((s[d] == 0x7f) && (s[d + 1] >= 1) && (s[d + 2] == 0x15))
+			{
+				codec = "AC-4";
+			}
+		}
+		if (codec)
+		{
+			in->pid = pid;
+			in->codec = codec;
+			return;
+		}
+	}
+}		//		ts_pmt()
+
+/* Collect a PAT or PMT section, act on it once it is complete */
+static void ts_psi(Ts_Input *in, int pid, int pusi, const uint8_t *p, int len)
+{
+	int need, n, prog, i;
+
+	if (pusi)
+	{
+		/* pointer_field, the end of a previous section comes first */
+		if ((len < 1) || (1 + p[0] >= len))
+		{
+			return;
+		}
+		len -= 1 + p[0];
+		p += 1 + p[0];
+		in->sect_pid = pid;
+		in->sect_len = 0;
+	}
+	else if (in->sect_pid != pid)
+	{
+		return;
+	}
+
+	n = (len < TS_SECTION_MAX - in->sect_len) ? len : TS_SECTION_MAX - in->sect_len;
+	memcpy(in->sect + in->sect_len, p, n);
+	in->sect_len += n;
+	if (in->sect_len < 3)
+	{
+		return;
+	}
+	need = 3 + (((in->sect[1] & 0x0f) << 8) | in->sect[2]);
+	if ((need > TS_SECTION_MAX) || (in->sect_len < need))
+	{
+		/* wait for the rest, or give up on a section too long to be PSI */
+		in->sect_pid = (need > TS_SECTION_MAX) ? -1 : in->sect_pid;
+		return;
+	}
+	in->sect_pid = -1;
+
+	if ((pid == 0) && (in->sect[0] == 0x00))
+	{
+		/* the first program that is not the network PID */
+		for (i = 8; i + 4 <= need - 4; i += 4)
+		{
+			prog = (in->sect[i] << 8) | in->sect[i + 1];
+			if (prog)
+			{
+				in->pmt_pid = ((in->sect[i + 2] & 0x1f) << 8) | in->sect[i + 3];
+				break;
+			}
+		}
+	}
+	else if (pid == in->pmt_pid)
+	{
+		ts_pmt(in, in->sect, need);
+	}
+}		//		ts_psi()
+
+/* Hand over the payload of one packet of the audio PID */
+static void ts_pes(Ts_Input *in, int pusi, const uint8_t *p, int len)
+{
+	int need, n;
+	const uint8_t *h = in->hdr;
+
+	if (pusi)
+	{
+		in->in_pes = 1;
+		in->hdr_len = 0;
+	}
+	else if (!in->in_pes)
+	{
+		/* the tail of a PES that started before the input did */
+		return;
+	}
+
+	if (in->hdr_len >= 0)
+	{
+		/* the PES header may run into the next packet */
+		need = (in->hdr_len < 9) ? 9 : 9 + h[8];
+		while (len && (in->hdr_len < need))
+		{
+			n = (need - in->hdr_len < len) ? need - in->hdr_len : len;
+			memcpy(in->hdr + in->hdr_len, p, n);
+			in->hdr_len += n;
+			p += n;
+			len -= n;
+			if ((in->hdr_len == 9) && (need == 9))
+			{
+				if (h[0] || h[1] || (h[2] != 1))
+				{
+					/* not a PES, wait for the next start */
+					in->in_pes = 0;
+					return;
+				}
+				need = 9 + h[8];
+			}
+		}
+		if (in->hdr_len < need)
+		{
+			return;
+		}
+		in->hdr_len = -1;
+		if ((h[7] & 0x80) && (h[8] >= 5))
+		{
+			ts_pts(in, ((int64_t)(h[9] & 0x0e) << 29) | (h[10] << 22) | ((h[11] & 0xfe) << 14)
+				| (h[12] << 7) | (h[13] >> 1));
+		}
+	}
+	if (len > 0)
+	{
+		ts_produce(in, p, len);
+	}
+}		//		ts_pes()
+
+/* Demultiplex one packet */
+static void ts_packet(Ts_Input *in, const uint8_t *p)
+{
+	int pid = ((p[1] & 0x1f) << 8) | p[2];
+	int pusi = p[1] & 0x40;
+	int afc = (p[3] >> 4) & 0x03;
+	int cc = p[3] & 0x0f;
+	int off = 4;
+
+	if (afc & 0x02)
+	{
+		off += 1 + p[4];
+	}
+	if (!(afc & 0x01) || (off >= TS_PACKET_SIZE))
+	{
+		/* adaptation field only, the continuity counter does not advance */
+		return;
+	}
+
+	if (pid != in->pid)
+	{
+		if ((in->pid < 0) && ((pid == 0) || (pid == in->pmt_pid)) && !(p[1] & 0x80))
+		{
+			ts_psi(in, pid, pusi, p + off, TS_PACKET_SIZE - off);
+		}
+		return;
+	}
+
+	in->packets++;
+	if ((p[1] & 0x80) || (p[3] & 0xc0))
+	{
+		/* the payload cannot be used, the frame reader will find the damage */
+		in->errors++;
+		in->cc = cc;
+		return;
+	}
+	if (in->cc >= 0)
+	{
+		if (cc == in->cc)
+		{
+			/* a repeated packet */
+			return;
+		}
+		if (cc != ((in->cc + 1) & 0x0f))
+		{
+			in->cc_errors++;
+		}
+	}
+	in->cc = cc;
+	ts_pes(in, pusi, p + off, TS_PACKET_SIZE - off);
+}		//		ts_packet()
+
+/* Next packet, NULL at the end of the input. Sync is found again after damage */
+static const uint8_t *ts_next(Ts_Input *in)
+{
+	const uint8_t *p;
+	size_t left, n;
+
+	for (;;)
+	{
+		left = in->block_len - in->block_pos;
+		if (left < (size_t)in->packet_size)
+		{
+			if (in->map || in->ended)
+			{
+				return(NULL);
+			}
+			/* keep the part packet, read behind it */
+			memmove(in->rd, in->block + in->block_pos, left);
+			n = fread(in->rd + left, 1, sizeof(in->rd) - left, in->file);
+			in->block = in->rd;
+			in->block_len = left + n;
+			in->block_pos = 0;
+			if (n == 0)
+			{
+				in->ended = 1;
+			}
+			continue;
+		}
+		p = in->block + in->block_pos + in->prefix;
+		if (p[0] == TS_SYNC)
+		{
+			in->block_pos += in->packet_size;
+			return(p);
+		}
+		in->block_pos++;
+		in->sync_lost++;
+	}
+}		//		ts_next()
+
+/* Demultiplex until more of the stream is handed over, returns 0 at the end, -1 on a read error */
+static int ts_fill(Ts_Input *in)
+{
+	int64_t before = in->produced;
+	const uint8_t *p;
+
+	/* leave most of the history for seeking back */
+	while ((in->produced == before) && (in->produced - in->pos < TS_HISTORY / 2))
+	{
+		if ((p = ts_next(in)) == NULL)
+		{
+			return (in->map || !ferror(in->file)) ? 0 : -1;
+		}
+		ts_packet(in, p);
+	}
+
+	return 1;
+}
+
+/* Packet size and offset of the sync byte, taken from the first four packets */
+static void ts_detect(Ts_Input *in)
+{
+	static const int sizes[][2] = { { TS_PACKET_SIZE, 0 }, { TS_M2TS_SIZE, 4 } };
+	const uint8_t *p = in->block + in->block_pos;
+	size_t len = in->block_len - in->block_pos;
+	int i, k;
+
+	in->packet_size = TS_PACKET_SIZE;
+	in->prefix = 0;
+	for (i = 0; i < 2; i++)
+	{
+		for (k = 0; (k < 4) && ((size_t)(sizes[i][1] + k * sizes[i][0]) < len); k++)
+		{
+			if (p[sizes[i][1] + k * sizes[i][0]] != TS_SYNC)
+			{
+				break;
+			}
+		}
+		/* a short input has fewer packets to check */
+		if ((k == 4) || ((k > 0) && ((size_t)(sizes[i][1] + k * sizes[i][0]) >= len)))
+		{
+			in->packet_size = sizes[i][0];
+			in->prefix = sizes[i][1];
+			return;
+		}
+	}
+}
+
+static ssize_t ts_read(void *cookie, char *buf, size_t size)
+{
+	Ts_Input *in = (Ts_Input *)cookie;
+	size_t n, first;
+	int status;
+
+	while (in->pos >= in->produced)
+	{
+		if ((status = ts_fill(in)) <= 0)
+		{
+			return status;
+		}
+	}
+
+	n = (size_t)(in->produced - in->pos);
+	if (n > size)
+	{
+		n = size;
+	}
+	first = TS_HISTORY - (size_t)(in->pos & (TS_HISTORY - 1));
+	if (first > n)
+	{
+		first = n;
+	}
+	memcpy(buf, &in->hist[in->pos & (TS_HISTORY - 1)], first);
+	memcpy(buf + first, in->hist, n - first);
+	in->pos += n;
+
+	return (ssize_t)n;
+}
+
+/* Seek within what is kept, or forward by demultiplexing, the end is found by demultiplexing all of it */
+static int ts_seek(void *cookie, off64_t *offset, int whence)
+{
+	Ts_Input *in = (Ts_Input *)cookie;
+	int64_t target;
+	int status;
+
+	if (whence == SEEK_END)
+	{
+		do
+		{
+			in->pos = in->produced;
+		} while ((status = ts_fill(in)) > 0);
+		if (status < 0)
+		{
+			return -1;
+		}
+	}
+	switch (whence)
+	{
+		case SEEK_SET:
+			target = *offset;
+			break;
+		case SEEK_CUR:
+			target = in->pos + *offset;
+			break;
+		case SEEK_END:
+			target = in->produced + *offset;
+			break;
+		default:
+			errno = EINVAL;
+			return -1;
+	}
+	if ((target < 0) || (target < in->produced - TS_HISTORY / 2))
+	{
+		errno = ESPIPE;
+		return -1;
+	}
+	while (target > in->produced)
+	{
+		in->pos = in->produced;
+		if (ts_fill(in) <= 0)
+		{
+			/* past the end, as a file allows */
+			break;
+		}
+	}
+	in->pos = target;
+	*offset = target;
+
+	return 0;
+}		//		ts_seek()
+
+static int ts_close(void *cookie)
+{
+	Ts_Input *in = (Ts_Input *)cookie;
+
+	if (in->pid < 0)
+	{
+		printf("TS input: no AC-3, E-AC-3 or AC-4 stream found\n");
+	}
+	else
+	{
+		printf("TS input: PID 0x%04x%s%s%s, %ld packets, %ld PES, %ld continuity errors, %ld damaged, "
+			"%ld PTS gaps (%.1f ms), %ld discontinuities\n", in->pid, in->codec ? " (" : "", in->codec ? in->codec : "",
+			in->codec ? ")" : "", in->packets, in->pes, in->cc_errors, in->errors, in->gaps,
+			1000. * in->gap_ticks / TS_PTS_CLOCK, in->jumps);
+	}
+	if (in->sync_lost)
+	{
+		printf("TS input: %lld bytes skipped to find packet sync\n", (long long)in->sync_lost);
+	}
+	if (in->map)
+	{
+		munmap(in->map, in->map_len);
+	}
+	fclose(in->file);
+	free(in);
+
+	return 0;
+}
+#endif /* __linux__ */
+
+/* Open the audio of a transport stream as an elementary stream input,
+   NULL if it cannot be wrapped, the input then stays with the caller */
+FILE *ts_input(FILE *infile,				/* IN: transport stream opened for reading, owned by the returned stream */
+			   int pid,						/* IN: audio PID, -1 for the first Dolby audio stream in the PMT */
+			   int verbose)					/* IN: report each PTS gap */
+{
+#ifdef __linux__
+	cookie_io_functions_t io = { ts_read, NULL, ts_seek, ts_close };
+	Ts_Input *in;
+	struct stat st;
+	int64_t start = ftello(infile);
+	FILE *fp;
+
+	if ((in = (Ts_Input *)calloc(1, sizeof(Ts_Input))) == NULL)
+	{
+		return(NULL);
+	}
+	in->file = infile;
+	in->verbose = verbose;
+	in->pid = pid;
+	in->pmt_pid = -1;
+	in->sect_pid = -1;
+	in->cc = -1;
+	in->last_pts = -1;
+
+	/* a file is walked in place, a stream through another cookie is read a block at a time */
+	if ((fileno(infile) >= 0) && !fstat(fileno(infile), &st) && S_ISREG(st.st_mode) && (st.st_size > start)
+		&& ((in->map = (uint8_t *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(infile), 0)) != MAP_FAILED))
+	{
+		madvise(in->map, st.st_size, MADV_SEQUENTIAL);
+		in->map_len = st.st_size;
+		in->block = in->map;
+		in->block_len = in->map_len;
+		in->block_pos = start;
+	}
+	else
+	{
+		in->map = NULL;
+		in->block = in->rd;
+		in->block_len = fread(in->rd, 1, sizeof(in->rd), infile);
+	}
+	ts_detect(in);
+
+	if ((fp = fopencookie(in, "rb", io)) == NULL)
+	{
+		if (in->map)
+		{
+			munmap(in->map, in->map_len);
+		}
+		free(in);
+	}
+
+	return(fp);
+#else
+	error_msg("Transport stream input is not supported on this platform", WARNING);
+	return(NULL);
+#endif /* __linux__ */
+}		//		ts_input()
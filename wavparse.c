@@ -0,0 +1,394 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	wavparse.c
+ *		Parsing the container of a SMPTE 337 input for deformatting
+ *
+ *		Classic RIFF WAVE, RF64 and BW64 (EBU Tech 3306, ITU-R BS.2088)
+ *		and Sony Wave64 are accepted. Chunks other than fmt, data and ds64,
+ *		such as the bext and iXML chunks of a BWF capture, are skipped by
+ *		their 64-bit size. The data chunk's offset and length are returned
+ *		so deformatting can stop at the end of the audio rather than read
+ *		on into any chunks that follow it.
+ *
+ *	History:
+ *		10/19/26	Data chunk limit built on Linux only, fopencookie() is glibc
+ *		10/19/26	Errors are returned to the caller instead of exiting
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#ifdef __linux__
+#define _GNU_SOURCE					/* fopencookie() */
+#endif /* __linux__ */
+
+#include "frame337.h"
+
+#define W64_CHUNK_HEADER	24			/* 16-byte GUID, 64-bit size including the header */
+#define RIFF_SIZE_UNKNOWN	0xFFFFFFFFU	/* written by capture tools that could not go back */
+
+/* Wave64 GUIDs are the RIFF chunk id followed by a common suffix, except for the file's riff GUID */
+static const uint8_t w64_riff_guid[16] = { 'r', 'i', 'f', 'f', 0x2E, 0x91, 0xCF, 0x11, 0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00 };
+static const uint8_t w64_guid_suffix[12] = { 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+
+static const char *wave_error_text[] =
+{
+	"No error",
+	"Input is not a wave file",
+	"Wave file header is truncated",
+	"Wave file has no fmt chunk before its data",
+	"Wave file has no data chunk",
+	"RF64 file has no valid ds64 chunk",
+	"Wave file must have 2 channels",
+	"Only 16, 24 and 32 bit wave files are supported"
+};
+
+/* Read the next chunk id and size, W64 ids are reduced to their RIFF equivalent */
+static int read_chunk_header(FILE *fp,			/* IN: input positioned at a chunk */
+							 int container,		/* IN: WAVE_IN_RIFF, WAVE_IN_RF64 or WAVE_IN_W64 */
+							 char *id,			/* OUT: 4 character chunk id */
+							 int64_t *size)		/* OUT: chunk payload size, without header or padding */
+												/* returns 0 at end of file */
+{
+	uint8_t hdr[W64_CHUNK_HEADER];
+	uint32_t size32;
+
+	if (container == WAVE_IN_W64)
+	{
+		if (fread(hdr, 1, W64_CHUNK_HEADER, fp) != W64_CHUNK_HEADER)
+		{
+			return 0;
+		}
+		if (memcmp(&hdr[4], w64_guid_suffix, sizeof(w64_guid_suffix)))
+		{
+			memcpy(id, "????", 4);
+		}
+		else
+		{
+			memcpy(id, hdr, 4);
+		}
+		memcpy(size, &hdr[16], 8);
+		*size -= W64_CHUNK_HEADER;
+	}
+	else
+	{
+		if (fread(hdr, 1, 8, fp) != 8)
+		{
+			return 0;
+		}
+		memcpy(id, hdr, 4);
+		memcpy(&size32, &hdr[4], 4);
+		*size = size32;
+	}
+
+	return(*size >= 0);
+}
+
+/* Bytes of padding after a chunk payload */
+static int chunk_padding(int container, int64_t size)
+{
+	if (container == WAVE_IN_W64)
+	{
+		return (int)((8 - (size & 7)) & 7);
+	}
+	return (int)(size & 1);
+}
+
+/* Check that a RIFF chunk header could start here, for data chunks whose size may have wrapped */
+static int looks_like_chunk(FILE *fp, int64_t offset)
+{
+	char id[4];
+	int i;
+
+	if (fseek64(fp, offset, SEEK_SET) || (fread(id, 1, 4, fp) != 4))
+	{
+		return 0;
+	}
+	for (i = 0; i < 4; i++)
+	{
+		if ((id[i] < 0x20) || (id[i] > 0x7E))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* This function reads a wave file header for deformatting */
+int parse_wave_header(FILE *infile,				/* IN: input at the start of the file */
+					  Wave_Struct *wavInfo)		/* OUT: format and data chunk location */
+												/* returns WAVE_OK, or a WAVE_ERR code, WAVE_ERR_NOT_WAVE for raw PCM */
+{
+	uint8_t hdr[16];
+	uint8_t fmt[16];
+	uint8_t ds64[24];
+	char id[4];
+	int64_t size;
+	int64_t ds64_data_size = -1;
+	int64_t file_size;
+	int64_t data_end;
+	uint16_t short_val;
+	int have_fmt = 0;
+
+	memset(wavInfo, 0, sizeof(Wave_Struct));
+	wavInfo->container = WAVE_IN_PCM;
+	wavInfo->data_length = -1;
+
+	if (fread(hdr, 1, 12, infile) != 12)
+	{
+		return(WAVE_ERR_NOT_WAVE);
+	}
+	if (!memcmp(&hdr[0], "RIFF", 4) && !memcmp(&hdr[8], "WAVE", 4))
+	{
+		wavInfo->container = WAVE_IN_RIFF;
+	}
+	else if ((!memcmp(&hdr[0], "RF64", 4) || !memcmp(&hdr[0], "BW64", 4)) && !memcmp(&hdr[8], "WAVE", 4))
+	{
+		wavInfo->container = WAVE_IN_RF64;
+	}
+	else if (!memcmp(hdr, w64_riff_guid, 12))
+	{
+		/* the rest of the riff GUID, its 64-bit size and the wave GUID */
+		if ((fread(&hdr[12], 1, 4, infile) != 4) || memcmp(hdr, w64_riff_guid, 16)
+			|| (fread(hdr, 1, 8, infile) != 8) || (fread(hdr, 1, 16, infile) != 16))
+		{
+			return(WAVE_ERR_TRUNCATED);
+		}
+		if (memcmp(hdr, "wave", 4) || memcmp(&hdr[4], w64_guid_suffix, sizeof(w64_guid_suffix)))
+		{
+			return(WAVE_ERR_NOT_WAVE);
+		}
+		wavInfo->container = WAVE_IN_W64;
+	}
+	else
+	{
+		// Assume a PCM file
+		return(WAVE_ERR_NOT_WAVE);
+	}
+
+	while (1)
+	{
+		if (!read_chunk_header(infile, wavInfo->container, id, &size))
+		{
+			return(WAVE_ERR_NO_DATA);
+		}
+
+		if (!memcmp(id, "ds64", 4) && (wavInfo->container == WAVE_IN_RF64))
+		{
+			if ((size < (int64_t)sizeof(ds64)) || (fread(ds64, 1, sizeof(ds64), infile) != sizeof(ds64)))
+			{
+				return(WAVE_ERR_DS64);
+			}
+			memcpy(&ds64_data_size, &ds64[8], 8);
+			size -= sizeof(ds64);
+		}
+		else if (!memcmp(id, "fmt ", 4))
+		{
+			if ((size < (int64_t)sizeof(fmt)) || (fread(fmt, 1, sizeof(fmt), infile) != sizeof(fmt)))
+			{
+				return(WAVE_ERR_TRUNCATED);
+			}
+			size -= sizeof(fmt);
+
+			memcpy(&short_val, &fmt[2], 2);
+			wavInfo->nchannels = short_val;
+			memcpy(&wavInfo->sample_rate, &fmt[4], 4);
+			memcpy(&short_val, &fmt[14], 2);
+			wavInfo->nbits = short_val;
+
+			if (wavInfo->nchannels != 2)
+			{
+				return(WAVE_ERR_CHANNELS);
+			}
+			if ((wavInfo->nbits % 8 != 0) || (wavInfo->nbits > 32) || (wavInfo->nbits < 16))
+			{
+				return(WAVE_ERR_BITS);
+			}
+			have_fmt = 1;
+		}
+		else if (!memcmp(id, "data", 4))
+		{
+			if (!have_fmt)
+			{
+				return(WAVE_ERR_NO_FMT);
+			}
+			break;
+		}
+
+		// Advance beyond the rest of this subchunk, and unsupported subchunks
+		if (fseek64(infile, size + chunk_padding(wavInfo->container, size), SEEK_CUR))
+		{
+			return(WAVE_ERR_TRUNCATED);
+		}
+	}
+
+	wavInfo->data_offset = ftell64(infile);
+	if (wavInfo->container == WAVE_IN_RF64)
+	{
+		if (ds64_data_size < 0)
+		{
+			return(WAVE_ERR_DS64);
+		}
+		if (size == RIFF_SIZE_UNKNOWN)
+		{
+			size = ds64_data_size;
+		}
+	}
+
+	fseek64(infile, 0, SEEK_END);
+	file_size = ftell64(infile);
+	data_end = wavInfo->data_offset + size;
+
+	/*
+	 * A placeholder size, or one larger than the file as in an interrupted
+	 * capture, means the data runs to the end of the file. A classic RIFF
+	 * file over 4 GiB written by a tool without RF64 support has its data
+	 * size wrapped, which shows up as audio rather than a chunk after it.
+	 */
+	if (((wavInfo->container == WAVE_IN_RIFF) && ((size == 0) || (size == RIFF_SIZE_UNKNOWN)))
+		|| (data_end >= file_size)
+		|| ((wavInfo->container == WAVE_IN_RIFF) && !looks_like_chunk(infile, data_end + chunk_padding(WAVE_IN_RIFF, size))))
+	{
+		wavInfo->data_length = -1;
+	}
+	else
+	{
+		wavInfo->data_length = size;
+	}
+
+	fseek64(infile, wavInfo->data_offset, SEEK_SET);
+
+	return(WAVE_OK);
+}		//		parse_wave_header()
+
+/* Text for a parse_wave_header() error */
+const char *wave_error_msg(int err)
+{
+	if ((err < 0) || (err >= (int)(sizeof(wave_error_text) / sizeof(wave_error_text[0]))))
+	{
+		return("Unknown wave file error");
+	}
+	return(wave_error_text[err]);
+}
+
+#ifdef __linux__
+typedef struct
+{
+	FILE *file;						/* underlying input, closed with the stream */
+	int64_t pos;
+	int64_t end;
+}Limit_Stream;
+
+static ssize_t limit_stream_read(void *cookie, char *buf, size_t size)
+{
+	Limit_Stream *ls = (Limit_Stream *)cookie;
+	size_t n;
+
+	if (ls->pos >= ls->end)
+	{
+		return 0;
+	}
+	if ((int64_t)size > ls->end - ls->pos)
+	{
+		size = (size_t)(ls->end - ls->pos);
+	}
+	n = fread(buf, 1, size, ls->file);
+	if ((n == 0) && ferror(ls->file))
+	{
+		return -1;
+	}
+	ls->pos += n;
+
+	return(n);
+}
+
+static int limit_stream_seek(void *cookie, off64_t *offset, int whence)
+{
+	Limit_Stream *ls = (Limit_Stream *)cookie;
+	int64_t base;
+
+	switch (whence)
+	{
+		case SEEK_SET:
+			base = 0;
+			break;
+		case SEEK_CUR:
+			base = ls->pos;
+			break;
+		case SEEK_END:
+			base = ls->end;
+			break;
+		default:
+			return -1;
+	}
+	if ((base + *offset < 0) || fseek64(ls->file, base + *offset, SEEK_SET))
+	{
+		return -1;
+	}
+	ls->pos = base + *offset;
+	*offset = ls->pos;
+
+	return 0;
+}
+
+static int limit_stream_close(void *cookie)
+{
+	Limit_Stream *ls = (Limit_Stream *)cookie;
+
+	fclose(ls->file);
+	free(ls);
+
+	return 0;
+}
+#endif /* __linux__ */
+
+/* Make an input end at the end of its data chunk, NULL if it cannot be wrapped, the input then stays with the caller */
+FILE *limit_input(FILE *infile,				/* IN: input, owned by the returned stream */
+				  int64_t end)				/* IN: offset reads stop at */
+{
+#ifdef __linux__
+	Limit_Stream *ls;
+	cookie_io_functions_t io = { limit_stream_read, NULL, limit_stream_seek, limit_stream_close };
+	FILE *fp;
+
+	if ((ls = (Limit_Stream *)calloc(1, sizeof(Limit_Stream))) == NULL)
+	{
+		return(NULL);
+	}
+	ls->file = infile;
+	ls->pos = ftell64(infile);
+	ls->end = end;
+
+	if ((fp = fopencookie(ls, "rb", io)) == NULL)
+	{
+		free(ls);
+	}
+
+	return(fp);
+#else
+	/* chunks after the data are scanned for preambles like the audio, as before */
+	(void)end;
+	return(infile);
+#endif /* __linux__ */
+}		//		limit_input()
@@ -0,0 +1,542 @@
+/************************************************************************************************************
+ * Copyright (c) 2026, Dolby Laboratories Inc.
+ * All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ *    and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or
+ *    promote products derived from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ ************************************************************************************************************/
+
+/****************************************************************************
+ *	File:	zerocopy.c
+ *		Zero-copy formatting of AC-3/E-AC-3 elementary streams
+ *
+ *		The input file is memory mapped and the frame headers are parsed in
+ *		place. Each burst is described by an I/O vector of the preamble, the
+ *		mapped frames and a shared block of zeros for the padding, and is
+ *		written with a single writev(). Frames that need byte reversal are
+ *		swapped into a buffer owned by the burst, which is reused for every
+ *		burst that passes through it.
+ *
+ *	History:
+ *		10/19/26	A burst whose frames were all dropped carries a pause burst
+ *		10/19/26	Errors are returned to the caller instead of exiting
+ *		10/19/26	Created
+ ***************************************************************************/
+
+#include "frame337.h"
+
+#ifdef UNIX
+#include <errno.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#define ZC_ZERO_BYTES	4096								/* size of the shared padding block */
+#define ZC_MAX_IOV		(MAX_BURST_FRAMES + 1 + 4)			/* frames, preamble, leading and trailing padding */
+
+extern const int16_t varratetab [NFSCOD] [NDATARATE];
+extern const uint16_t fratetab [NFSCOD];
+
+static const uint8_t zc_zeros[ZC_ZERO_BYTES];
+
+/* One burst described as references into the mapped input */
+typedef struct
+{
+	int burst_size;						/* in 16-bit words */
+	unsigned int accumwords;
+	int burst_info_ddp;
+	int is_ddp;
+	int nwords;
+	int framesizecod;
+	int sampratecod;
+	int nframes;
+	struct
+	{
+		const uint8_t *p;				/* frame in the mapped input */
+		int nwords;
+		short byte_rev;
+	} frames[MAX_BURST_FRAMES];
+	uint16_t preamble[PRMBLSIZE];
+	int niov;
+	struct iovec iov[ZC_MAX_IOV];
+	uint16_t swapbuf[BUFWORDSIZE];		/* byte reversed frames */
+}Zc_Burst;
+
+static int zc_read_burst(void *context, void *buffer);
+static int zc_pack_burst(void *context, void *buffer);
+static int zc_write_burst(void *context, void *buffer);
+
+static const Pipe_Stages zc_stages = { zc_read_burst, zc_pack_burst, zc_write_burst };
+
+/* In-place counterpart of get_timeslice(2, ...): locate the next frame in the mapped input, skipping timecode */
+static int get_timeslice_mem(Format_Ctx *ctx,			/* IN/OUT: input map and position */
+							 SLC_INFO *sinfo,			/* OUT: Time slice info structure */
+							 int justinfo,				/* IN: return just the slice info (1) or the frame as well (0) */
+							 const uint8_t **frame)		/* OUT: start of the frame in the map */
+{
+	uint16_t syncword;
+	uint16_t header[4];
+	short tc = 0;
+	short tcread = 0;
+	short ddread = 0;
+	int status;
+
+	sinfo->has_tc = 0;
+	sinfo->byte_rev = 0;
+	sinfo->bytecount = 0;
+	*frame = NULL;
+
+	while(1)
+	{
+		if(ctx->in_pos + sizeof(syncword) > ctx->in_len)
+		{
+			return((ddread || tcread) ? ERR_NO_ERROR : ERR_EOF);
+		}
+		memcpy(&syncword, ctx->in_map + ctx->in_pos, sizeof(syncword));
+
+		switch (syncword)
+		{
+		case TC_SYNC_WD:
+		case TC_SYNC_WD_REV:
+			sinfo->has_tc = 1;
+			tc = 1;
+			break;
+		case SYNC_WD:
+		case SYNC_WD_REV:
+			tc = 0;
+			break;
+		default:
+			return(ERR_SYNCH_ERROR);
+		}
+
+		if(tc)
+		{
+			/* If already read a TC frame or DD/DD+ frame, and detect another, must be a new timeslice */
+			if(tcread || ddread)
+			{
+				break;
+			}
+			ctx->in_pos += TC_FRMSIZE;
+			sinfo->bytecount += TC_FRMSIZE;
+			tcread = 1;
+		}
+		else
+		{
+			/* If already read a DD/DD+ frame, and detect another, must be a new timeslice */
+			if(ddread)
+			{
+				break;
+			}
+			if(ctx->in_pos + sizeof(header) > ctx->in_len)
+			{
+				return(ERR_READ_ERROR);
+			}
+			memcpy(header, ctx->in_map + ctx->in_pos, sizeof(header));
+
+			if((status = parse_dd_frame_header(header, sinfo)) != ERR_NO_ERROR)
+			{
+				return(status);
+			}
+
+			if(justinfo)
+			{
+				ctx->in_pos += sizeof(header);
+				break;
+			}
+
+			if(ctx->in_pos + sinfo->framesize * sizeof(uint16_t) > ctx->in_len)
+			{
+				return(ERR_READ_ERROR);
+			}
+			*frame = ctx->in_map + ctx->in_pos;
+			ctx->in_pos += sinfo->framesize * sizeof(uint16_t);
+			sinfo->bytecount += (sinfo->framesize * sizeof(uint16_t));
+			ddread = 1;
+		}
+	}
+
+	return(ERR_NO_ERROR);
+}
+
+/* Zero-copy stage 1: collect the frames of the next frameset from the map */
+static int zc_read_burst(void *context, void *buffer)
+{
+	Format_Ctx *ctx = (Format_Ctx *)context;
+	Zc_Burst *burst = (Zc_Burst *)buffer;
+	SLC_INFO *sinfo = &ctx->sinfo;
+	const uint8_t *frame;
+	uint16_t syncword;
+	short status;
+	int64_t numframes;
+	double percent;
+	int numblocks = 0;
+	int lastnumblocks = 0;
+	int frameset = 0;
+	int keep;
+	unsigned int accumwords = PRMBLSIZE;
+
+	if(ctx->done)
+	{
+		return 0;
+	}
+
+	/* same end of input rule as parse_preamble(), which needs a whole preamble */
+	if(ctx->in_pos + PRMBLSIZE * sizeof(int) > ctx->in_len)
+	{
+		ctx->done = 1;
+		return 0;
+	}
+
+	memcpy(&syncword, ctx->in_map + ctx->in_pos, sizeof(syncword));
+	if(syncword != SYNC_WD && syncword != SYNC_WD_REV)
+	{
+		return format_error(ctx, ERR_SYNCH_ERROR, "zero-copy mode supports AC-3 and E-AC-3 input only");
+	}
+
+	ctx->wave_bps = 16;
+	burst->nframes = 0;
+
+	while(!frameset && !ctx->done)
+	{
+		status = get_timeslice_mem(ctx, sinfo, 0, &frame);
+
+		ctx->wave_frate = fratetab[sinfo->fscod];
+
+		if(numblocks == 0){ lastnumblocks = sinfo->numblks; }
+
+		/* if blocks per frame changes at non-frameset boundary */
+		if(sinfo->numblks != lastnumblocks)
+		{
+			ctx->in_pos -= sinfo->framesize * sizeof(uint16_t);
+			break; //write out partial frame set
+		}
+
+		ctx->burst_size = sinfo->is_ddp ? DD_PLUS_BURST_SIZE : DD_BURST_SIZE;
+		burst->burst_info_ddp = sinfo->is_ddp;
+
+		if(status)
+		{
+			ctx->done = checkstatus(ctx, status);
+			if((numblocks > 0) && (status == ERR_EOF)){ ctx->flushbuf = 1; }
+			continue;
+		}
+
+		ctx->nwords = sinfo->framesize;
+		ctx->framesizecod = sinfo->frmsizecod;
+		ctx->sampratecod = sinfo->fscod;
+
+		if(burst->nframes >= MAX_BURST_FRAMES)
+		{
+			return format_error(ctx, ERR_LIMIT, "decode: too many frames in frameset");
+		}
+
+		/* a dropped frame still counts towards the frameset, its time is left silent */
+		keep = (ctx->file_info->crc.policy == CRC_OFF) || crc_verify(&ctx->file_info->crc, frame, sinfo->framesize * 2);
+		if(ctx->file_info->crc.aborted)
+		{
+			ctx->done = 1;
+			return crc_abort_error(&ctx->file_info->crc, &ctx->file_info->err, frame - ctx->in_map);
+		}
+		if(keep)
+		{
+			burst->frames[burst->nframes].p = frame;
+			burst->frames[burst->nframes].nwords = ctx->nwords;
+			burst->frames[burst->nframes].byte_rev = sinfo->byte_rev;
+			burst->nframes++;
+		}
+
+		numframes = ctx->file_length / (2 * ctx->nwords);
+		percent = 100. * (1. / (double) numframes);
+
+		if (ctx->verbose)
+		{
+			printf ("\nReformatting frame %ld     (%d%% done)\n", ctx->framecount,
+				(int)(ctx->framecount * percent));
+
+			if(ctx->framecount == 0)
+			{
+				if(sinfo->is_ddp == 0)
+				{
+					printf("Dolby Digital frames detected\nBlocks per frame: 6\n");
+					printf("bsid: %d\n", sinfo->bsid);
+				}
+				else
+				{
+					printf("Dolby Digital Plus frames detected\nBlocks per frame: %d\n", sinfo->numblks);
+					printf("bsid: %d\n", sinfo->bsid);
+				}
+			}
+		}
+
+		/* increment # of blocks received on independent or transcoded frames*/
+		if(((sinfo->strmtyp == 0) || (sinfo->strmtyp == 2)) && (sinfo->substreamid == 0))
+		{
+			numblocks += sinfo->numblks;
+		}
+
+		if(keep)
+		{
+			accumwords += ctx->nwords;
+		}
+
+		if(ctx->nwords + PRMBLSIZE > ctx->burst_size - 4)
+		{
+			return format_error(ctx, ERR_LIMIT, "decode: frame size too large for SMPTE format");
+		}
+
+		if(accumwords > (unsigned int) ctx->burst_size - 4)
+		{
+			return format_error(ctx, ERR_LIMIT, "decode: Accumulation of frameset data exceeds 1.536Mbps data limit");
+		}
+
+		ctx->framecount++;
+
+		//look ahead at next frame *required to support substreams*
+		status = get_timeslice_mem(ctx, sinfo, 1, &frame);
+		if(status)
+		{
+			ctx->done = checkstatus(ctx, status);
+			if((numblocks > 0) && (status == ERR_EOF)){ ctx->flushbuf = 1; }
+		}
+		ctx->in_pos -= 4 * sizeof(uint16_t);	// rewind by look ahead amount
+
+		if((numblocks == 6) && (((sinfo->strmtyp == 0) || (sinfo->strmtyp == 2)) && (sinfo->substreamid == 0)))
+		{
+			frameset = 1;
+		}
+	}
+
+	if(ctx->done && !ctx->flushbuf)
+	{
+		return 0;
+	}
+
+	burst->burst_size = ctx->burst_size;
+	burst->accumwords = accumwords;
+	burst->is_ddp = sinfo->is_ddp;
+	if(ctx->altformat && burst->is_ddp)
+	{
+		return format_error(ctx, ERR_BAD_INPUT, "decode: Cannot use alternate packing with DD+ inputs.");
+	}
+	burst->nwords = ctx->nwords;
+	burst->framesizecod = ctx->framesizecod;
+	burst->sampratecod = ctx->sampratecod;
+
+	return 1;
+}
+
+/* Append zero padding to the burst I/O vector */
+static void zc_add_padding(Zc_Burst *burst, size_t nbytes)
+{
+	size_t len;
+
+	while(nbytes > 0)
+	{
+		len = (nbytes > ZC_ZERO_BYTES) ? ZC_ZERO_BYTES : nbytes;
+		burst->iov[burst->niov].iov_base = (void *)zc_zeros;
+		burst->iov[burst->niov].iov_len = len;
+		burst->niov++;
+		nbytes -= len;
+	}
+}
+
+/* Zero-copy stage 2: build the I/O vector, swapping only frames that need it */
+static int zc_pack_burst(void *context, void *buffer)
+{
+	Format_Ctx *ctx = (Format_Ctx *)context;
+	Zc_Burst *burst = (Zc_Burst *)buffer;
+	uint16_t *swap_p = burst->swapbuf;
+	const uint16_t *in_p;
+	int lead_words = 0;
+	int used_words;
+	int size_23;
+	int i, j;
+
+	burst->preamble[0] = (uint16_t) 0x0f872;						/* IEC958_SYNCA */
+	burst->preamble[1] = (uint16_t) 0x04e1f;						/* IEC958_SYNCB */
+	burst->preamble[2] = (uint16_t)((burst->burst_info_ddp ? SMPTE_DD_PLUS_ID : SMPTE_DD_ID) | (ctx->nStreamNum << 13));
+	burst->preamble[3] = (uint16_t)((burst->accumwords - PRMBLSIZE)*16);		/* length code */
+
+	burst->niov = 0;
+	used_words = burst->accumwords;
+
+	if(burst->nframes == 0)
+	{
+		/* every frame failed its CRC, a pause burst keeps the burst period */
+		fill_pause_preamble(ctx, swap_p, burst->burst_size);
+		burst->iov[burst->niov].iov_base = swap_p;
+		burst->iov[burst->niov].iov_len = PAUSE_PREAMBLE_WORDS * sizeof(uint16_t);
+		burst->niov++;
+		zc_add_padding(burst, (burst->burst_size - PAUSE_PREAMBLE_WORDS) * sizeof(uint16_t));
+		return 1;
+	}
+
+	if(ctx->altformat)
+	{
+		/* align the 2/3 point of the last frame as the copying path does */
+		size_23 = (int) (varratetab [burst->sampratecod] [burst->framesizecod]);
+		lead_words = 2048 - size_23 - PRMBLSIZE;
+		used_words = PRMBLSIZE + burst->nwords;
+		zc_add_padding(burst, lead_words * sizeof(uint16_t));
+		if (ctx->verbose)
+		{
+			printf ("Two thirds size = %d", size_23);
+		}
+	}
+
+	burst->iov[burst->niov].iov_base = burst->preamble;
+	burst->iov[burst->niov].iov_len = sizeof(burst->preamble);
+	burst->niov++;
+
+	for(j = 0; j < burst->nframes; j++)
+	{
+		if(burst->frames[j].byte_rev)
+		{
+			in_p = (const uint16_t *)burst->frames[j].p;
+			for(i = 0; i < burst->frames[j].nwords; i++)
+			{
+				swap_p[i] = bytereverse(in_p[i]);
+			}
+			burst->iov[burst->niov].iov_base = swap_p;
+			swap_p += burst->frames[j].nwords;
+		}
+		else
+		{
+			burst->iov[burst->niov].iov_base = (void *)burst->frames[j].p;
+		}
+		burst->iov[burst->niov].iov_len = burst->frames[j].nwords * sizeof(uint16_t);
+		burst->niov++;
+	}
+
+	zc_add_padding(burst, (burst->burst_size - lead_words - used_words) * sizeof(uint16_t));
+
+	return 1;
+}
+
+/* Zero-copy stage 3: write the burst with one system call, or copy it into the output map */
+static int zc_write_burst(void *context, void *buffer)
+{
+	Format_Ctx *ctx = (Format_Ctx *)context;
+	Zc_Burst *burst = (Zc_Burst *)buffer;
+	struct iovec *iov = burst->iov;
+	int niov = burst->niov;
+	ssize_t written;
+	int i;
+
+	if(ctx->out_map)
+	{
+		for(i = 0; i < niov; i++)
+		{
+			if(ctx->out_map_pos + iov[i].iov_len > ctx->out_map_len)
+			{
+				return run_error(&ctx->file_info->err, ERR_LIMIT, -1, -1, "decode: Output exceeds the predicted size");
+			}
+			memcpy(ctx->out_map + ctx->out_map_pos, iov[i].iov_base, iov[i].iov_len);
+			ctx->out_map_pos += iov[i].iov_len;
+		}
+		return 1;
+	}
+
+	while(niov > 0)
+	{
+		written = writev(ctx->out_fd, iov, niov);
+		if(written < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			return run_error(&ctx->file_info->err, ERR_WRITE_ERROR, -1, -1, "decode: Unable to write to output file, %s.",
+				ctx->file_info->smpte_fname);
+		}
+		/* skip what was written, partial writes resume mid vector */
+		while(niov > 0 && (size_t)written >= iov->iov_len)
+		{
+			written -= iov->iov_len;
+			iov++;
+			niov--;
+		}
+		if(niov > 0)
+		{
+			iov->iov_base = (uint8_t *)iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+
+	return 1;
+}
+#endif /* UNIX */
+
+/* Format an AC-3/E-AC-3 file from a memory map of the input, returns 0 if the input is not suitable,
+   1 once it was formatted or stopped on an error in the file info */
+int format_zerocopy(Format_Ctx *ctx,	/* IN/OUT: format context, files already open */
+					int threaded)		/* IN: run the stages on separate threads */
+{
+#ifdef UNIX
+	File_Info *file_info = ctx->file_info;
+	Zc_Burst *bursts;
+	int nbursts;
+	uint16_t syncword;
+	void *map;
+
+	if(ctx->file_length < (int64_t)sizeof(syncword))
+	{
+		return 0;
+	}
+
+	map = mmap(NULL, ctx->file_length, PROT_READ, MAP_PRIVATE, fileno(file_info->ac3file), 0);
+	if(map == MAP_FAILED)
+	{
+		return 0;
+	}
+
+	memcpy(&syncword, map, sizeof(syncword));
+	if(syncword != SYNC_WD && syncword != SYNC_WD_REV)
+	{
+		munmap(map, ctx->file_length);
+		return 0;
+	}
+
+	madvise(map, ctx->file_length, MADV_SEQUENTIAL);
+
+	ctx->in_map = (const uint8_t *)map;
+	ctx->in_len = ctx->file_length;
+	ctx->in_pos = 0;
+
+	fflush(file_info->smpte_file);
+	ctx->out_fd = fileno(file_info->smpte_file);
+
+	nbursts = threaded ? PIPE_NUM_BUFS : 1;
+	if((bursts = (Zc_Burst *)calloc(nbursts, sizeof(Zc_Burst))) == NULL)
+	{
+		run_error(&file_info->err, ERR_NO_MEMORY, -1, -1, "Unable to allocate burst buffers");
+	}
+	else
+	{
+		run_stages(ctx, &zc_stages, bursts, sizeof(Zc_Burst), nbursts, threaded, ctx->verbose, file_info->rt);
+		free(bursts);
+	}
+	munmap(map, ctx->file_length);
+	ctx->in_map = NULL;
+
+	return 1;
+#else
+	return 0;
+#endif /* UNIX */
+}